@@ -1,18 +1,24 @@
 #!/bin/bash
 
-THREADS=`grep "BLITZ_NUM_THREADS" Makefile.config | cut -d " " -f3`
+# thread counts to sweep, one binary for all of them
+THREADS_LIST=${THREADS_LIST:-"1 2 4 8 16"}
 
-echo ${THREADS}
+mkdir -p log
 
-./bin/blitz example/experiments/mnist_conv.yaml &> log/mnist_conv_"${THREADS}".log
-echo "mnist_conv finish"
-./bin/blitz example/experiments/mnist_conv_batch.yaml &> log/mnist_conv_batch_"${THREADS}".log
-echo "mnist_conv_batch finish"
-./bin/blitz example/experiments/cifar10_conv.yaml &> log/cifar10_conv_"${THREADS}".log
-echo "cifar10_conv finish"
-./bin/blitz example/experiments/cifar10_conv_batch.yaml &> log/cifar10_conv_batch_"${THREADS}".log
-echo "cifar10_conv_batch finish"
-./bin/blitz example/experiments/alexnet_conv.yaml &> log/alexnet_conv_"${THREADS}".log
-echo "alexnet_conv finish"
-./bin/blitz example/experiments/alexnet_conv_batch.yaml &> log/alexnet_conv_batch_"${THREADS}".log
-echo "alexnet_conv_batch finish"
+for THREADS in ${THREADS_LIST}; do
+  echo ${THREADS}
+  export BLITZ_NUM_THREADS=${THREADS}
+
+  ./bin/blitz example/experiments/mnist_conv.yaml &> log/mnist_conv_"${THREADS}".log
+  echo "mnist_conv finish"
+  ./bin/blitz example/experiments/mnist_conv_batch.yaml &> log/mnist_conv_batch_"${THREADS}".log
+  echo "mnist_conv_batch finish"
+  ./bin/blitz example/experiments/cifar10_conv.yaml &> log/cifar10_conv_"${THREADS}".log
+  echo "cifar10_conv finish"
+  ./bin/blitz example/experiments/cifar10_conv_batch.yaml &> log/cifar10_conv_batch_"${THREADS}".log
+  echo "cifar10_conv_batch finish"
+  ./bin/blitz example/experiments/alexnet_conv.yaml &> log/alexnet_conv_"${THREADS}".log
+  echo "alexnet_conv finish"
+  ./bin/blitz example/experiments/alexnet_conv_batch.yaml &> log/alexnet_conv_batch_"${THREADS}".log
+  echo "alexnet_conv_batch finish"
+done
@@ -0,0 +1,93 @@
+import argparse
+import h5py
+import numpy as np
+import struct
+import sys
+
+# Converts a list of hdf5 files, the data_path format of blitz, into one
+# uncompressed record file (src/data/record.h) that blitz maps directly.
+# Record files are told apart by their magic, they take the place of the
+# list files under a new data_path prefix, e.g. data_path: data/MNIST_rec
+#   python HDF5ToRecord.py data/MNIST_train_data.log data/MNIST_rec_train_data.log
+# Images can be stored as uint8 or float16, a quarter or half of the size,
+# and are normalized by data_mean and data_scale while batches are filled:
+#   python HDF5ToRecord.py --type uint8 --multiply 255 \
+#     data/MNIST_train_data.log data/MNIST_rec_train_data.log
+# with data_scale: 0.00392157 in the model file.
+# One-hot labels become one int32 class index per sample, for
+# label_type: sparse in the model file:
+#   python HDF5ToRecord.py --type int32 --argmax \
+#     data/MNIST_train_label.log data/MNIST_rec_train_label.log
+
+PY3 = (sys.version_info[0] >= 3)
+
+range = range
+if not PY3:
+  range = xrange
+
+RECORD_MAGIC = b'BLITZREC'
+RECORD_VERSION = 1
+RECORD_ALIGNMENT = 4096
+RECORD_TYPES = {'float32': (0, '<f4'), 'uint8': (1, 'u1'),
+    'float16': (2, '<f2'), 'int32': (3, '<i4')}
+# magic, version, type, num_sample, sample_size, data_offset
+HEADER_FORMAT = '<8sIIQQQ'
+
+# rows converted at a time, bounds memory for large files
+CHUNK_ROWS = 4096
+
+def read_list(list_file):
+  with open(list_file, 'r') as f:
+    return f.read().split()
+
+def convert(list_file, record_file, type_name, multiply, argmax):
+  record_type, dtype = RECORD_TYPES[type_name]
+  files = read_list(list_file)
+  num_sample = 0
+  sample_size = None
+  for fname in files:
+    with h5py.File(fname, 'r') as f:
+      num = int(np.array(f['sample_num']))
+      size = 1 if argmax else int(np.prod(f['data'].shape[1:]))
+      if sample_size is None:
+        sample_size = size
+      elif sample_size != size:
+        raise ValueError('sample size mismatch: ' + fname)
+      num_sample += num
+
+  with open(record_file, 'wb') as out:
+    header = struct.pack(HEADER_FORMAT, RECORD_MAGIC, RECORD_VERSION,
+        record_type, num_sample, sample_size, RECORD_ALIGNMENT)
+    out.write(header + b'\0' * (RECORD_ALIGNMENT - len(header)))
+    for fname in files:
+      with h5py.File(fname, 'r') as f:
+        data = f['data']
+        num = int(np.array(f['sample_num']))
+        for begin in range(0, num, CHUNK_ROWS):
+          end = min(begin + CHUNK_ROWS, num)
+          rows = np.asarray(data[begin:end])
+          if argmax:
+            rows = np.argmax(rows.reshape(end - begin, -1), axis=1)
+          if multiply != 1:
+            rows = rows * multiply
+          if dtype == 'u1':
+            rows = np.clip(np.rint(rows), 0, 255)
+          rows = rows.astype(dtype)
+          out.write(rows.reshape(end - begin, sample_size).tobytes())
+
+  print('%s: %d samples of %d %s elements' % (record_file, num_sample,
+    sample_size, type_name))
+
+if __name__ == '__main__':
+  parser = argparse.ArgumentParser()
+  parser.add_argument('--type', choices=sorted(RECORD_TYPES.keys()),
+      default='float32', help='element type of the record file')
+  parser.add_argument('--multiply', type=float, default=1,
+      help='factor applied before the conversion, 255 for [0, 1] images')
+  parser.add_argument('--argmax', action='store_true',
+      help='store the class index of one-hot rows')
+  parser.add_argument('list_file')
+  parser.add_argument('record_file')
+  args = parser.parse_args()
+  convert(args.list_file, args.record_file, args.type, args.multiply,
+      args.argmax)
@@ -0,0 +1,100 @@
+import argparse
+import h5py
+import numpy as np
+import os
+import sys
+
+# Converts a list of hdf5 files, the data_path format of blitz, into sparse
+# samples for a model whose first layer is Affine.
+# By default every file becomes one of "indptr", "indices" and "values"
+# sets (scipy csr, zero based columns) next to its sample_num, and a new
+# list names them:
+#   python HDF5ToSparse.py data/BOW_train_data.log data/BOW_csr_train_data.log
+# The label list stays as it is. With --libsvm the output is one libsvm
+# file instead, its lines lead with the class index of the one-hot labels:
+#   python HDF5ToSparse.py --libsvm --label data/BOW_train_label.log \
+#     data/BOW_train_data.log data/BOW_svm_train_data.log
+# and data_path and label_path may both name it, label_type: sparse.
+
+PY3 = (sys.version_info[0] >= 3)
+
+range = range
+if not PY3:
+  range = xrange
+
+# rows converted at a time, bounds memory for large files
+CHUNK_ROWS = 4096
+
+def read_list(list_file):
+  with open(list_file, 'r') as f:
+    return f.read().split()
+
+def sparse_rows(rows):
+  rows = rows.reshape(rows.shape[0], -1)
+  row_index, column = np.nonzero(rows)
+  indptr = np.searchsorted(row_index, np.arange(rows.shape[0] + 1))
+  return indptr, column, rows[row_index, column]
+
+def convert_hdf5(list_file, out_list):
+  prefix = os.path.splitext(out_list)[0]
+  out_files = []
+  for i, fname in enumerate(read_list(list_file)):
+    out_name = '%s_%d.h5' % (prefix, i)
+    with h5py.File(fname, 'r') as f, h5py.File(out_name, 'w') as out:
+      data = f['data']
+      num = int(np.array(f['sample_num']))
+      indptr = [np.zeros(1, dtype=np.int64)]
+      indices = []
+      values = []
+      nnz = 0
+      for begin in range(0, num, CHUNK_ROWS):
+        end = min(begin + CHUNK_ROWS, num)
+        ptr, column, value = sparse_rows(np.asarray(data[begin:end]))
+        indptr.append(ptr[1:].astype(np.int64) + nnz)
+        indices.append(column.astype(np.int32))
+        values.append(value.astype(np.float32))
+        nnz += len(column)
+      out['indptr'] = np.concatenate(indptr)
+      out['indices'] = np.concatenate(indices)
+      out['values'] = np.concatenate(values)
+      out['sample_num'] = np.int32(num)
+    out_files.append(os.path.abspath(out_name))
+    print('%s: %d samples %d non zeros' % (out_name, num, nnz))
+  with open(out_list, 'w') as f:
+    f.write('\n'.join(out_files) + '\n')
+
+def convert_libsvm(list_file, label_list, out_file):
+  label_files = read_list(label_list) if label_list else None
+  with open(out_file, 'w') as out:
+    for i, fname in enumerate(read_list(list_file)):
+      with h5py.File(fname, 'r') as f:
+        data = f['data']
+        num = int(np.array(f['sample_num']))
+        labels = np.zeros(num)
+        if label_files:
+          with h5py.File(label_files[i], 'r') as l:
+            label = np.asarray(l['data'][:num])
+            labels = np.argmax(label.reshape(num, -1), axis=1)
+        for begin in range(0, num, CHUNK_ROWS):
+          end = min(begin + CHUNK_ROWS, num)
+          ptr, column, value = sparse_rows(np.asarray(data[begin:end]))
+          for j in range(end - begin):
+            pairs = ' '.join('%d:%.9g' % (c + 1, v) for c, v in
+                zip(column[ptr[j]:ptr[j + 1]], value[ptr[j]:ptr[j + 1]]))
+            out.write(('%g %s\n' % (labels[begin + j], pairs)).rstrip() +
+                '\n')
+  print('%s: written' % out_file)
+
+if __name__ == '__main__':
+  parser = argparse.ArgumentParser()
+  parser.add_argument('--libsvm', action='store_true',
+      help='write one libsvm file instead of sparse hdf5 files')
+  parser.add_argument('--label', default=None,
+      help='list of one-hot label files, leading values of libsvm lines')
+  parser.add_argument('list_file')
+  parser.add_argument('out_file')
+  args = parser.parse_args()
+  if args.libsvm:
+    convert_libsvm(args.list_file, args.label, args.out_file)
+  else:
+    convert_hdf5(args.list_file, args.out_file)
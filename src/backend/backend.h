@@ -67,6 +67,14 @@ class Backend {
     const TensorType<DType>* input, const TensorType<DType>* target,
     TensorType<DType>* output);
 
+  // target holds one class index per sample
+  static DType CrossEntropyMultiSparseApplyFunc(
+    const TensorType<DType>* input, const TensorType<DType>* target);
+
+  static void CrossEntropyMultiSparseDerivativeFunc(
+    const TensorType<DType>* input, const TensorType<DType>* target,
+    TensorType<DType>* output);
+
   static void BiasForwardFunc(
     const TensorType<DType>* input, const TensorType<DType>* bias,
     TensorType<DType>* output);
@@ -88,6 +96,17 @@ class Backend {
     TensorType<DType>* gamma_update, TensorType<DType>* beta_update,
     TensorType<DType>* output);
 
+  // output[i, j] = weight[input[i, j]], ids index rows of weight
+  static void EmbeddingForwardFunc(
+    const TensorType<DType>* input, const TensorType<DType>* weight,
+    TensorType<DType>* output);
+
+  // update[id] = sum of the backward_input rows of id, for the sorted
+  // distinct ids of input in rows; other rows of update are left as they are
+  static void EmbeddingBackwardUpdateFunc(
+    const TensorType<DType>* input, const TensorType<DType>* backward_input,
+    TensorType<DType>* update, vector<int>* rows);
+
   static void GradientdescentFunc(
     const DType momentum_coef, const DType learning_rate,
     const DType decay, const int batch_size,
@@ -95,12 +114,34 @@ class Backend {
     TensorType<DType>* gradient,
     TensorType<DType>* velocity);
 
+  // GradientdescentFunc on rows of weight only, velocity of other rows
+  // is not decayed (lazy momentum)
+  static void SparseGradientdescentFunc(
+    const int* rows, const size_t num_rows,
+    const DType momentum_coef, const DType learning_rate,
+    const DType decay, const int batch_size,
+    TensorType<DType>* weight,
+    TensorType<DType>* gradient,
+    TensorType<DType>* velocity);
+
   static void MatrixDotFunc(
     const TensorType<DType>* left, const TensorType<DType>* right,
     const bool transa, const bool transb,
     const DType alpha, const DType beta,
     TensorType<DType>* output, const string& kernel = "blas");
 
+  // output = left * right, left in compressed sparse rows
+  static void SparseMatrixDotFunc(
+    const size_t* row_offset, const int* column, const DType* value,
+    const TensorType<DType>* right, TensorType<DType>* output);
+
+  // output += left^T * right, only rows of output that left touches
+  // output rows of the columns of the batch, listed ascending in rows,
+  // are cleared and written, the other rows are left as they are
+  static void SparseMatrixTransposeDotFunc(
+    const size_t* row_offset, const int* column, const DType* value,
+    const TensorType<DType>* right, TensorType<DType>* output, vector<int>* rows);
+
   static void MaximumFunc(
     const TensorType<DType>* left, const TensorType<DType>* right,
     TensorType<DType>* output);
@@ -178,9 +219,23 @@ class Backend {
     vector<shared_ptr<TensorType<DType> > >* update_batch,
     TensorType<DType>* update);
 
+  // chunk parallel, several samples side by side in one gemm
+  static void Convolution2DForwardFunc(
+    const TensorType<DType>* input, const TensorType<DType>* weight,
+    const int padding_height, const int padding_width,
+    const int stride_height, const int stride_width,
+    TensorType<DType>* unpack, TensorType<DType>* chunk, TensorType<DType>* output);
+
+  static void Convolution2DUpdateFunc(
+    const TensorType<DType>* input, const TensorType<DType>* output,
+    const int padding_height, const int padding_width,
+    const int stride_height, const int stride_width,
+    TensorType<DType>* unpack, TensorType<DType>* chunk, TensorType<DType>* update);
+
   // naive parallel
   static void Convolution2DForwardFunc(
     const TensorType<DType>* input, const TensorType<DType>* weight,
+    const int padding_height, const int padding_width,
     const int stride_height, const int stride_width,
     TensorType<DType>* output);
 
@@ -213,9 +268,15 @@ class Backend {
   static void HostCopyToFunc(const DType* source, const size_t size,
     DType* target);
 
+  static void HostCopyFromFunc(const DType* source, const size_t size,
+    DType* target);
+
   static float EvaluateClassifyFunc(
     const TensorType<DType>* output, const TensorType<DType>* target);
 
+  static float EvaluateClassifySparseFunc(
+    const TensorType<DType>* output, const TensorType<DType>* target);
+
   static float EvaluateRegressFunc(
     const TensorType<DType>* output, const TensorType<DType>* target);
 
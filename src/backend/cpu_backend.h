@@ -3,7 +3,6 @@
 
 #include "backend/backend.h"
 
-#include <omp.h>
 #include <cmath>
 #include <string>
 #include <vector>
@@ -13,6 +12,7 @@
 
 #include "util/blitz_cpu_function.h"
 #include "util/blitz_cpu_avx.h"
+#include "util/blitz_thread_pool.h"
 #include "backend/cpu_tensor.h"
 
 namespace blitz {
@@ -78,6 +78,14 @@ class Backend<CPUTensor, DType> {
     const CPUTensor<DType>* input, const CPUTensor<DType>* target,
     CPUTensor<DType>* output);
 
+  // target holds one class index per sample
+  static DType CrossEntropyMultiSparseApplyFunc(
+    const CPUTensor<DType>* input, const CPUTensor<DType>* target);
+
+  static void CrossEntropyMultiSparseDerivativeFunc(
+    const CPUTensor<DType>* input, const CPUTensor<DType>* target,
+    CPUTensor<DType>* output);
+
   static void BiasForwardFunc(
     const CPUTensor<DType>* input, const CPUTensor<DType>* bias,
     CPUTensor<DType>* output);
@@ -99,6 +107,17 @@ class Backend<CPUTensor, DType> {
     CPUTensor<DType>* gamma_update, CPUTensor<DType>* beta_update,
     CPUTensor<DType>* output);
 
+  // output[i, j] = weight[input[i, j]], ids index rows of weight
+  static void EmbeddingForwardFunc(
+    const CPUTensor<DType>* input, const CPUTensor<DType>* weight,
+    CPUTensor<DType>* output);
+
+  // update[id] = sum of the backward_input rows of id, for the sorted
+  // distinct ids of input in rows; other rows of update are left as they are
+  static void EmbeddingBackwardUpdateFunc(
+    const CPUTensor<DType>* input, const CPUTensor<DType>* backward_input,
+    CPUTensor<DType>* update, vector<int>* rows);
+
   static void GradientdescentFunc(
     const DType momentum_coef, const DType learning_rate,
     const DType decay, const int batch_size,
@@ -106,12 +125,34 @@ class Backend<CPUTensor, DType> {
     CPUTensor<DType>* gradient,
     CPUTensor<DType>* velocity);
 
+  // GradientdescentFunc on rows of weight only, velocity of other rows
+  // is not decayed (lazy momentum)
+  static void SparseGradientdescentFunc(
+    const int* rows, const size_t num_rows,
+    const DType momentum_coef, const DType learning_rate,
+    const DType decay, const int batch_size,
+    CPUTensor<DType>* weight,
+    CPUTensor<DType>* gradient,
+    CPUTensor<DType>* velocity);
+
   static void MatrixDotFunc(
     const CPUTensor<DType>* left, const CPUTensor<DType>* right,
     const bool transa, const bool transb,
     const DType alpha, const DType beta,
     CPUTensor<DType>* output, const string& kernel = "blas");
 
+  // output = left * right, left in compressed sparse rows
+  static void SparseMatrixDotFunc(
+    const size_t* row_offset, const int* column, const DType* value,
+    const CPUTensor<DType>* right, CPUTensor<DType>* output);
+
+  // output += left^T * right, only rows of output that left touches
+  // output rows of the columns of the batch, listed ascending in rows,
+  // are cleared and written, the other rows are left as they are
+  static void SparseMatrixTransposeDotFunc(
+    const size_t* row_offset, const int* column, const DType* value,
+    const CPUTensor<DType>* right, CPUTensor<DType>* output, vector<int>* rows);
+
   static void MaximumFunc(
     const CPUTensor<DType>* left, const CPUTensor<DType>* right,
     CPUTensor<DType>* output);
@@ -200,9 +241,23 @@ class Backend<CPUTensor, DType> {
     const int stride_height, const int stride_width,
     CPUTensor<DType>* input);
 
+  // chunk parallel, several samples side by side in one gemm
+  static void Convolution2DForwardFunc(
+    const CPUTensor<DType>* input, const CPUTensor<DType>* weight,
+    const int padding_height, const int padding_width,
+    const int stride_height, const int stride_width,
+    CPUTensor<DType>* unpack, CPUTensor<DType>* chunk, CPUTensor<DType>* output);
+
+  static void Convolution2DUpdateFunc(
+    const CPUTensor<DType>* input, const CPUTensor<DType>* output,
+    const int padding_height, const int padding_width,
+    const int stride_height, const int stride_width,
+    CPUTensor<DType>* unpack, CPUTensor<DType>* chunk, CPUTensor<DType>* update);
+
   // naive parallel
   static void Convolution2DForwardFunc(
     const CPUTensor<DType>* input, const CPUTensor<DType>* weight,
+    const int padding_height, const int padding_width,
     const int stride_height, const int stride_width,
     CPUTensor<DType>* output);
 
@@ -223,9 +278,15 @@ class Backend<CPUTensor, DType> {
   static void HostCopyToFunc(const DType* source, const size_t size,
     DType* target);
 
+  static void HostCopyFromFunc(const DType* source, const size_t size,
+    DType* target);
+
   static float EvaluateClassifyFunc(
     const CPUTensor<DType>* output, const CPUTensor<DType>* target);
 
+  static float EvaluateClassifySparseFunc(
+    const CPUTensor<DType>* output, const CPUTensor<DType>* target);
+
   static float EvaluateRegressFunc(
     const CPUTensor<DType>* output, const CPUTensor<DType>* target);
 
@@ -4,6 +4,814 @@
 #include <string>
 #include <algorithm>
 
+// minimal number of elements per parallel chunk,
+// smaller loops are not worth a fork on the pool
+const size_t kCPUElementGrain = 8192;
+
+inline size_t CPURowGrain(size_t dim) {
+  return dim >= kCPUElementGrain ? 1 : kCPUElementGrain / (dim + 1) + 1;
+}
+
+// elementwise kernels, output[i] = Op(left[i], right[i])
+struct CPUMaximumOp {
+  template<typename DType>
+  static DType Apply(DType left, DType right) {
+    return std::max(left, right);
+  }
+};
+
+struct CPUMinusOp {
+  template<typename DType>
+  static DType Apply(DType left, DType right) {
+    return left - right;
+  }
+};
+
+struct CPUAddOp {
+  template<typename DType>
+  static DType Apply(DType left, DType right) {
+    return left + right;
+  }
+};
+
+struct CPUMultiplyOp {
+  template<typename DType>
+  static DType Apply(DType left, DType right) {
+    return left * right;
+  }
+};
+
+template<typename DType, typename Op>
+class CPUBinaryKernel {
+ public:
+  CPUBinaryKernel(const DType* left, const DType* right, DType* output) :
+    left_(left), right_(right), output_(output) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    for (size_t i = begin; i < end; ++i) {
+      output_[i] = Op::Apply(left_[i], right_[i]);
+    }
+  }
+
+ private:
+  const DType* left_;
+  const DType* right_;
+  DType* output_;
+};
+
+template<typename DType, typename Op>
+class CPUScalarKernel {
+ public:
+  CPUScalarKernel(const DType* left, const DType right, DType* output) :
+    left_(left), right_(right), output_(output) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    for (size_t i = begin; i < end; ++i) {
+      output_[i] = Op::Apply(left_[i], right_);
+    }
+  }
+
+ private:
+  const DType* left_;
+  const DType right_;
+  DType* output_;
+};
+
+template<typename DType>
+class CPURectlinApplyKernel {
+ public:
+  CPURectlinApplyKernel(const DType* input, const DType slope,
+    DType* output) : input_(input), slope_(slope), output_(output) {}
+
+  // [begin, end) in elements
+  void operator()(size_t begin, size_t end, int tid) {
+    DType compare_value = static_cast<DType>(0);
+    for (size_t i = begin; i < end; ++i) {
+      output_[i] = std::max(input_[i], compare_value) +
+        slope_ * std::min(input_[i], compare_value);
+    }
+  }
+
+ private:
+  const DType* input_;
+  const DType slope_;
+  DType* output_;
+};
+
+#ifdef BLITZ_AVX
+template<typename DType>
+class CPURectlinApplyAVXKernel {
+ public:
+  CPURectlinApplyAVXKernel(const DType* input, const DType slope,
+    DType* output) : input_(input), output_(output) {
+    DType compare_value = static_cast<DType>(0);
+    BlitzAVXBroadcast<DType>(&slope, &slope_reg_);
+    BlitzAVXBroadcast<DType>(&compare_value, &compare_value_reg_);
+  }
+
+  // [begin, end) in avx registers
+  void operator()(size_t begin, size_t end, int tid) {
+    const size_t avx_width = BLITZ_AVX_WIDTH / sizeof(DType);
+    BlitzAVXReg<DType> input_reg, output_reg, left_reg, right_reg;
+    for (size_t i = begin * avx_width; i < end * avx_width; i += avx_width) {
+      BlitzAVXLoad<DType>(input_ + i, &input_reg);
+      BlitzAVXMax<DType>(&input_reg, &compare_value_reg_, &left_reg);
+      BlitzAVXMin<DType>(&input_reg, &compare_value_reg_, &right_reg);
+      output_reg.v = left_reg.v + slope_reg_.v * right_reg.v;
+      BlitzAVXStore<DType>(output_ + i, &output_reg);
+    }
+  }
+
+ private:
+  const DType* input_;
+  DType* output_;
+  BlitzAVXReg<DType> slope_reg_, compare_value_reg_;
+};
+#endif
+
+template<typename DType>
+class CPURectlinDerivativeKernel {
+ public:
+  CPURectlinDerivativeKernel(const DType* input, const DType slope,
+    DType* output) : input_(input), slope_(slope), output_(output) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    DType compare_value = static_cast<DType>(0);
+    for (size_t i = begin; i < end; ++i) {
+      DType greater = input_[i] > compare_value ? 1.0 : 0.0;
+      DType less = input_[i] <= compare_value ? slope_ : 0.0;
+      output_[i] = (greater + less) * output_[i];
+    }
+  }
+
+ private:
+  const DType* input_;
+  const DType slope_;
+  DType* output_;
+};
+
+template<typename DType>
+class CPULogisticApplyKernel {
+ public:
+  CPULogisticApplyKernel(const DType* input, DType* output) :
+    input_(input), output_(output) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    for (size_t i = begin; i < end; ++i) {
+      output_[i] = 1 / (exp(-input_[i]) + 1);
+    }
+  }
+
+ private:
+  const DType* input_;
+  DType* output_;
+};
+
+// [begin, end) in samples
+template<typename DType>
+class CPUSoftmaxApplyKernel {
+ public:
+  CPUSoftmaxApplyKernel(const DType* input, const size_t dim,
+    DType* output) : input_(input), dim_(dim), output_(output) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    for (size_t i = begin; i < end; ++i) {
+      DType sum = 0;
+      for (size_t j = 0; j < dim_; ++j) {
+        size_t index = i * dim_ + j;
+        output_[index] = exp(input_[index]);
+        sum += output_[index];
+      }
+
+      for (size_t j = 0; j < dim_; ++j) {
+        output_[i * dim_ + j] /= sum;
+      }
+    }
+  }
+
+ private:
+  const DType* input_;
+  const size_t dim_;
+  DType* output_;
+};
+
+// reductions return the partial result of [begin, end)
+template<typename DType>
+class CPUCrossEntropyBinaryKernel {
+ public:
+  CPUCrossEntropyBinaryKernel(const DType* input, const DType* target) :
+    input_(input), target_(target) {}
+
+  DType operator()(size_t begin, size_t end) {
+    DType output = 0;
+    for (size_t i = begin; i < end; ++i) {
+      output += -BlitzCPUSafeLog(input_[i]) * target_[i] -
+        BlitzCPUSafeLog(1 - input_[i]) * (1 - target_[i]);
+    }
+    return output;
+  }
+
+ private:
+  const DType* input_;
+  const DType* target_;
+};
+
+template<typename DType>
+class CPUCrossEntropyMultiKernel {
+ public:
+  CPUCrossEntropyMultiKernel(const DType* input, const DType* target) :
+    input_(input), target_(target) {}
+
+  DType operator()(size_t begin, size_t end) {
+    DType output = 0;
+    for (size_t i = begin; i < end; ++i) {
+      output += BlitzCPUSafeLog(input_[i]) * target_[i];
+    }
+    return output;
+  }
+
+ private:
+  const DType* input_;
+  const DType* target_;
+};
+
+// a sparse target is the class index of a row of dim values, files may
+// hold anything
+template<typename DType>
+void CPUCheckClassIndices(const DType* target, const size_t num_sample,
+  const size_t dim) {
+  for (size_t i = 0; i < num_sample; ++i) {
+    CHECK(target[i] >= 0 && target[i] < dim &&
+      target[i] == std::floor(target[i])) <<
+      "Class index out of range: " << target[i];
+  }
+}
+
+// [begin, end) in samples, target holds class indices
+template<typename DType>
+class CPUCrossEntropyMultiSparseKernel {
+ public:
+  CPUCrossEntropyMultiSparseKernel(const DType* input, const DType* target,
+    const size_t dim) : input_(input), target_(target), dim_(dim) {}
+
+  DType operator()(size_t begin, size_t end) {
+    DType output = 0;
+    for (size_t i = begin; i < end; ++i) {
+      output += BlitzCPUSafeLog(
+        input_[i * dim_ + static_cast<size_t>(target_[i])]);
+    }
+    return output;
+  }
+
+ private:
+  const DType* input_;
+  const DType* target_;
+  const size_t dim_;
+};
+
+// output = input - one_hot(target), one row per sample
+template<typename DType>
+class CPUCrossEntropyMultiSparseDerivativeKernel {
+ public:
+  CPUCrossEntropyMultiSparseDerivativeKernel(const DType* input,
+    const DType* target, const size_t dim, DType* output) :
+    input_(input), target_(target), dim_(dim), output_(output) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    memcpy(output_ + begin * dim_, input_ + begin * dim_,
+      sizeof(DType) * (end - begin) * dim_);
+    for (size_t i = begin; i < end; ++i) {
+      output_[i * dim_ + static_cast<size_t>(target_[i])] -= 1;
+    }
+  }
+
+ private:
+  const DType* input_;
+  const DType* target_;
+  const size_t dim_;
+  DType* output_;
+};
+
+template<typename DType>
+class CPUSquareSumKernel {
+ public:
+  CPUSquareSumKernel(const DType* input, const DType* target) :
+    input_(input), target_(target) {}
+
+  DType operator()(size_t begin, size_t end) {
+    DType sum_square = 0;
+    for (size_t i = begin; i < end; ++i) {
+      sum_square += pow(input_[i] - target_[i], 2);
+    }
+    return sum_square;
+  }
+
+ private:
+  const DType* input_;
+  const DType* target_;
+};
+
+template<typename DType>
+class CPUAbsSumKernel {
+ public:
+  CPUAbsSumKernel(const DType* input, const DType* target) :
+    input_(input), target_(target) {}
+
+  DType operator()(size_t begin, size_t end) {
+    DType sum_abs = 0;
+    for (size_t i = begin; i < end; ++i) {
+      sum_abs += fabs(input_[i] - target_[i]);
+    }
+    return sum_abs;
+  }
+
+ private:
+  const DType* input_;
+  const DType* target_;
+};
+
+template<typename DType>
+class CPUAbsMeanDerivativeKernel {
+ public:
+  CPUAbsMeanDerivativeKernel(const DType* input, const DType* target,
+    DType* output) : input_(input), target_(target), output_(output) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    for (size_t i = begin; i < end; ++i) {
+      if (input_[i] > target_[i]) {
+        output_[i] = 1;
+      } else if (input_[i] < target_[i]) {
+        output_[i] = -1;
+      } else {
+        output_[i] = 0;
+      }
+    }
+  }
+
+ private:
+  const DType* input_;
+  const DType* target_;
+  DType* output_;
+};
+
+// [begin, end) in samples
+template<typename DType>
+class CPUBiasForwardKernel {
+ public:
+  CPUBiasForwardKernel(const DType* input, const DType* bias,
+    const size_t dim, DType* output) :
+    input_(input), bias_(bias), dim_(dim), output_(output) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    for (size_t i = begin; i < end; ++i) {
+      for (size_t j = 0; j < dim_; ++j) {
+        output_[i * dim_ + j] = input_[i * dim_ + j] + bias_[j];
+      }
+    }
+  }
+
+ private:
+  const DType* input_;
+  const DType* bias_;
+  const size_t dim_;
+  DType* output_;
+};
+
+// [begin, end) in features, samples are accumulated row by row
+// so that every chunk streams through contiguous memory
+template<typename DType>
+class CPUBiasBackwardUpdateKernel {
+ public:
+  CPUBiasBackwardUpdateKernel(const DType* input, const size_t num_sample,
+    const size_t dim, DType* update) :
+    input_(input), num_sample_(num_sample), dim_(dim), update_(update) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    for (size_t j = 0; j < num_sample_; ++j) {
+      const DType* input_slice = input_ + j * dim_;
+      for (size_t i = begin; i < end; ++i) {
+        update_[i] += input_slice[i];
+      }
+    }
+  }
+
+ private:
+  const DType* input_;
+  const size_t num_sample_;
+  const size_t dim_;
+  DType* update_;
+};
+
+// [begin, end) in features
+template<typename DType>
+class CPUBatchNormForwardKernel {
+ public:
+  CPUBatchNormForwardKernel(const DType* input, const DType* gamma,
+    const DType* beta, const DType epsilon,
+    const size_t num_sample, const size_t dim,
+    DType* input_var, DType* input_hat, DType* output) :
+    input_(input), gamma_(gamma), beta_(beta), epsilon_(epsilon),
+    num_sample_(num_sample), dim_(dim), input_var_(input_var),
+    input_hat_(input_hat), output_(output) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    for (size_t i = begin; i < end; ++i) {
+      DType mean = 0.0;
+      for (size_t j = 0; j < num_sample_; ++j) {
+        mean += input_[j * dim_ + i];
+      }
+      mean /= num_sample_;
+
+      DType var;
+      for (size_t j = 0; j < num_sample_; ++j) {
+        var = input_[j * dim_ + i] - mean;
+        input_var_[i] += var * var;
+      }
+      input_var_[i] /= num_sample_;
+
+      DType divider = sqrt(input_var_[i] + epsilon_);
+
+      size_t index = 0;
+      for (size_t j = 0; j < num_sample_; ++j) {
+        index = j * dim_ + i;
+        input_hat_[index] = (input_[index] - mean) / divider;
+        output_[index] = gamma_[i] * input_hat_[index] + beta_[i];
+      }
+    }
+  }
+
+ private:
+  const DType* input_;
+  const DType* gamma_;
+  const DType* beta_;
+  const DType epsilon_;
+  const size_t num_sample_;
+  const size_t dim_;
+  DType* input_var_;
+  DType* input_hat_;
+  DType* output_;
+};
+
+// [begin, end) in features
+template<typename DType>
+class CPUBatchNormBackwardKernel {
+ public:
+  CPUBatchNormBackwardKernel(const DType* backward_input,
+    const DType* forward_input_hat, const DType* forward_input_var,
+    const DType* gamma, const DType epsilon,
+    const size_t num_sample, const size_t dim,
+    DType* gamma_update, DType* beta_update, DType* output) :
+    backward_input_(backward_input), forward_input_hat_(forward_input_hat),
+    forward_input_var_(forward_input_var), gamma_(gamma), epsilon_(epsilon),
+    num_sample_(num_sample), dim_(dim), gamma_update_(gamma_update),
+    beta_update_(beta_update), output_(output) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    for (size_t i = begin; i < end; ++i) {
+      for (size_t j = 0; j < num_sample_; ++j) {
+        const size_t index = j * dim_ + i;
+        gamma_update_[i] += forward_input_hat_[index] *
+          backward_input_[index];
+        beta_update_[i] += backward_input_[index];
+      }
+
+      DType xhat;
+      for (size_t j = 0; j < num_sample_; ++j) {
+        const size_t index = j * dim_ + i;
+        xhat = (forward_input_hat_[index] * gamma_update_[i] +
+          beta_update_[i]) / num_sample_;
+        output_[index] = gamma_[i] * (backward_input_[index] -
+          xhat) / sqrt(forward_input_var_[i] + epsilon_);
+      }
+    }
+  }
+
+ private:
+  const DType* backward_input_;
+  const DType* forward_input_hat_;
+  const DType* forward_input_var_;
+  const DType* gamma_;
+  const DType epsilon_;
+  const size_t num_sample_;
+  const size_t dim_;
+  DType* gamma_update_;
+  DType* beta_update_;
+  DType* output_;
+};
+
+// [begin, end) in rows of a compressed sparse left,
+// output[i] = sum of value[j] * right[column[j]]
+template<typename DType>
+class CPUSparseDotKernel {
+ public:
+  CPUSparseDotKernel(const size_t* row_offset, const int* column,
+    const DType* value, const DType* right, const size_t dim,
+    DType* output) : row_offset_(row_offset), column_(column),
+    value_(value), right_(right), dim_(dim), output_(output) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    for (size_t i = begin; i < end; ++i) {
+      DType* output = output_ + i * dim_;
+      memset(output, 0, sizeof(DType) * dim_);
+      for (size_t j = row_offset_[i]; j < row_offset_[i + 1]; ++j) {
+        const DType* right = right_ + column_[j] * dim_;
+        const DType value = value_[j];
+        for (size_t k = 0; k < dim_; ++k) {
+          output[k] += value * right[k];
+        }
+      }
+    }
+  }
+
+ private:
+  const size_t* row_offset_;
+  const int* column_;
+  const DType* value_;
+  const DType* right_;
+  const size_t dim_;
+  DType* output_;
+};
+
+// [begin, end) in columns of output, rows do not race,
+// output[column[j]] += value[j] * right[i]
+template<typename DType>
+class CPUSparseTransposeDotKernel {
+ public:
+  CPUSparseTransposeDotKernel(const size_t* row_offset, const int* column,
+    const DType* value, const DType* right, const size_t rows,
+    const size_t dim, DType* output) : row_offset_(row_offset),
+    column_(column), value_(value), right_(right), rows_(rows), dim_(dim),
+    output_(output) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    for (size_t i = 0; i < rows_; ++i) {
+      const DType* right = right_ + i * dim_;
+      for (size_t j = row_offset_[i]; j < row_offset_[i + 1]; ++j) {
+        DType* output = output_ + column_[j] * dim_;
+        const DType value = value_[j];
+        for (size_t k = begin; k < end; ++k) {
+          output[k] += value * right[k];
+        }
+      }
+    }
+  }
+
+ private:
+  const size_t* row_offset_;
+  const int* column_;
+  const DType* value_;
+  const DType* right_;
+  const size_t rows_;
+  const size_t dim_;
+  DType* output_;
+};
+
+// [begin, end) in rows, clears whole rows of output
+template<typename DType>
+class CPUClearRowsKernel {
+ public:
+  CPUClearRowsKernel(const int* rows, const size_t dim, DType* output) :
+    rows_(rows), dim_(dim), output_(output) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    for (size_t i = begin; i < end; ++i) {
+      memset(output_ + static_cast<size_t>(rows_[i]) * dim_, 0,
+        sizeof(DType) * dim_);
+    }
+  }
+
+ private:
+  const int* rows_;
+  const size_t dim_;
+  DType* output_;
+};
+
+// [begin, end) in ids, output[i] = weight[input[i]]
+template<typename DType>
+class CPUEmbeddingForwardKernel {
+ public:
+  CPUEmbeddingForwardKernel(const DType* input, const DType* weight,
+    const size_t vocab, const size_t dim, DType* output) :
+    input_(input), weight_(weight), vocab_(vocab), dim_(dim),
+    output_(output) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    for (size_t i = begin; i < end; ++i) {
+      CHECK(input_[i] >= 0 && input_[i] < vocab_) <<
+        "Embedding id out of range: " << input_[i];
+      memcpy(output_ + i * dim_,
+        weight_ + static_cast<size_t>(input_[i]) * dim_,
+        sizeof(DType) * dim_);
+    }
+  }
+
+ private:
+  const DType* input_;
+  const DType* weight_;
+  const size_t vocab_;
+  const size_t dim_;
+  DType* output_;
+};
+
+// [begin, end) in distinct ids, the positions of rows[i] are
+// position[offset[i]], ..., position[offset[i + 1] - 1]; no two ids race
+template<typename DType>
+class CPUEmbeddingBackwardUpdateKernel {
+ public:
+  CPUEmbeddingBackwardUpdateKernel(const int* rows, const size_t* offset,
+    const size_t* position, const DType* backward_input, const size_t dim,
+    DType* update) : rows_(rows), offset_(offset), position_(position),
+    backward_input_(backward_input), dim_(dim), update_(update) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    for (size_t i = begin; i < end; ++i) {
+      DType* update = update_ + static_cast<size_t>(rows_[i]) * dim_;
+      memset(update, 0, sizeof(DType) * dim_);
+      for (size_t j = offset_[i]; j < offset_[i + 1]; ++j) {
+        const DType* backward_input = backward_input_ + position_[j] * dim_;
+        for (size_t k = 0; k < dim_; ++k) {
+          update[k] += backward_input[k];
+        }
+      }
+    }
+  }
+
+ private:
+  const int* rows_;
+  const size_t* offset_;
+  const size_t* position_;
+  const DType* backward_input_;
+  const size_t dim_;
+  DType* update_;
+};
+
+template<typename DType>
+class CPUGradientdescentKernel {
+ public:
+  CPUGradientdescentKernel(const DType momentum_coef,
+    const DType learning_rate, const DType decay, const int batch_size,
+    DType* weight, DType* gradient, DType* velocity) :
+    momentum_coef_(momentum_coef), learning_rate_(learning_rate),
+    decay_(decay), batch_size_(batch_size), weight_(weight),
+    gradient_(gradient), velocity_(velocity) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    for (size_t i = begin; i < end; ++i) {
+      gradient_[i] /= batch_size_;
+      velocity_[i] = velocity_[i] * momentum_coef_ - learning_rate_ *
+        (gradient_[i] + decay_ * weight_[i]);
+      weight_[i] = weight_[i] + velocity_[i];
+    }
+  }
+
+ private:
+  const DType momentum_coef_;
+  const DType learning_rate_;
+  const DType decay_;
+  const int batch_size_;
+  DType* weight_;
+  DType* gradient_;
+  DType* velocity_;
+};
+
+// [begin, end) in rows, the update of CPUGradientdescentKernel
+template<typename DType>
+class CPUSparseGradientdescentKernel {
+ public:
+  CPUSparseGradientdescentKernel(const int* rows, const size_t dim,
+    const DType momentum_coef, const DType learning_rate, const DType decay,
+    const int batch_size, DType* weight, DType* gradient, DType* velocity) :
+    rows_(rows), dim_(dim), kernel_(momentum_coef, learning_rate, decay,
+    batch_size, weight, gradient, velocity) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    for (size_t i = begin; i < end; ++i) {
+      const size_t first = static_cast<size_t>(rows_[i]) * dim_;
+      kernel_(first, first + dim_, tid);
+    }
+  }
+
+ private:
+  const int* rows_;
+  const size_t dim_;
+  CPUGradientdescentKernel<DType> kernel_;
+};
+
+#ifdef BLITZ_AVX
+template<typename DType>
+class CPUGradientdescentAVXKernel {
+ public:
+  CPUGradientdescentAVXKernel(const DType momentum_coef,
+    const DType learning_rate, const DType decay, const int batch_size,
+    DType* weight, DType* gradient, DType* velocity) :
+    weight_(weight), gradient_(gradient), velocity_(velocity) {
+    const DType batch_size_float = static_cast<DType>(batch_size);
+    BlitzAVXBroadcast<DType>(&batch_size_float, &batch_size_reg_);
+    BlitzAVXBroadcast<DType>(&momentum_coef, &momentum_coef_reg_);
+    BlitzAVXBroadcast<DType>(&learning_rate, &learning_rate_reg_);
+    BlitzAVXBroadcast<DType>(&decay, &decay_reg_);
+  }
+
+  // [begin, end) in avx registers
+  void operator()(size_t begin, size_t end, int tid) {
+    const size_t avx_width = BLITZ_AVX_WIDTH / sizeof(DType);
+    BlitzAVXReg<DType> gradient_reg, velocity_reg, weight_reg;
+    for (size_t i = begin * avx_width; i < end * avx_width; i += avx_width) {
+      BlitzAVXLoad<DType>(gradient_ + i, &gradient_reg);
+      BlitzAVXLoad<DType>(velocity_ + i, &velocity_reg);
+      BlitzAVXLoad<DType>(weight_ + i, &weight_reg);
+      gradient_reg.v = gradient_reg.v / batch_size_reg_.v;
+      velocity_reg.v = velocity_reg.v * momentum_coef_reg_.v -
+        learning_rate_reg_.v * (gradient_reg.v + decay_reg_.v * weight_reg.v);
+      weight_reg.v = weight_reg.v + velocity_reg.v;
+      BlitzAVXStore<DType>(gradient_ + i, &gradient_reg);
+      BlitzAVXStore<DType>(velocity_ + i, &velocity_reg);
+      BlitzAVXStore<DType>(weight_ + i, &weight_reg);
+    }
+  }
+
+ private:
+  DType* weight_;
+  DType* gradient_;
+  DType* velocity_;
+  BlitzAVXReg<DType> batch_size_reg_, momentum_coef_reg_,
+    learning_rate_reg_, decay_reg_;
+};
+#endif
+
+template<typename DType>
+class CPUBinaryMaskKernel {
+ public:
+  CPUBinaryMaskKernel(const DType keep, DType* output) :
+    keep_(keep), output_(output) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    for (size_t i = begin; i < end; ++i) {
+      output_[i] = output_[i] < keep_ ? DType(1) : DType(0);
+    }
+  }
+
+ private:
+  const DType keep_;
+  DType* output_;
+};
+
+// [begin, end) in samples, returns the number of hits
+template<typename DType>
+class CPUEvaluateClassifyKernel {
+ public:
+  CPUEvaluateClassifyKernel(const DType* output, const DType* target,
+    const size_t dim) : output_(output), target_(target), dim_(dim) {}
+
+  float operator()(size_t begin, size_t end) {
+    float correct = 0.0f;
+    for (size_t i = begin; i < end; ++i) {
+      DType max = output_[i * dim_];
+      size_t max_index = 0;
+      for (size_t j = 1; j < dim_; ++j) {
+        if (max < output_[i * dim_ + j]) {
+          max_index = j;
+          max = output_[i * dim_ + j];
+        }
+      }
+
+      if (target_[i * dim_ + max_index] == static_cast<DType>(1)) {
+        correct += 1.0f;
+      }
+    }
+    return correct;
+  }
+
+ private:
+  const DType* output_;
+  const DType* target_;
+  const size_t dim_;
+};
+
+// [begin, end) in samples, target holds class indices
+template<typename DType>
+class CPUEvaluateClassifySparseKernel {
+ public:
+  CPUEvaluateClassifySparseKernel(const DType* output, const DType* target,
+    const size_t dim) : output_(output), target_(target), dim_(dim) {}
+
+  float operator()(size_t begin, size_t end) {
+    float correct = 0.0f;
+    for (size_t i = begin; i < end; ++i) {
+      const DType* row = output_ + i * dim_;
+      const size_t max_index = std::max_element(row, row + dim_) - row;
+      if (max_index == static_cast<size_t>(target_[i])) {
+        correct += 1.0f;
+      }
+    }
+    return correct;
+  }
+
+ private:
+  const DType* output_;
+  const DType* target_;
+  const size_t dim_;
+};
 
 template<typename DType>
 void Backend<CPUTensor, DType>::RectlinApplyFunc(
@@ -12,34 +820,19 @@ void Backend<CPUTensor, DType>::RectlinApplyFunc(
   CPUTensor<DType>* output) {
   CHECK_EQ(input->size(), output->size());
 
-  DType compare_value = static_cast<DType>(0);
+  const size_t size = input->size();
 #ifdef BLITZ_AVX
-  size_t avx_width = BLITZ_AVX_WIDTH / sizeof(DType);
-  size_t remain = input->size() % avx_width;
-  BlitzAVXReg<DType> compare_value_reg, input_reg, output_reg,
-    slope_reg, left_reg, right_reg;
-  BlitzAVXBroadcast<DType>(&slope, &slope_reg);
-  BlitzAVXBroadcast<DType>(&compare_value, &compare_value_reg);
-  for (size_t i = 0; i < remain; ++i) {
-    (*output)[i] = std::max((*input)[i], compare_value) +
-      slope * std::min((*input)[i], compare_value);
-  }
-  #pragma omp parallel for private(input_reg, output_reg, left_reg,\
-    right_reg)
-  for (size_t i = remain; i < input->size(); i += avx_width) {
-    BlitzAVXLoad<DType>(input->data() + i, &input_reg);
-    BlitzAVXMax<DType>(&input_reg, &compare_value_reg, &left_reg);
-    BlitzAVXMin<DType>(&input_reg, &compare_value_reg, &right_reg);
-    output_reg.v = left_reg.v + slope_reg.v * right_reg.v;
-    BlitzAVXStore<DType>(output->data() + i, &output_reg);
-  }
-
+  // aligned registers first, the unaligned tail is done in scalar
+  const size_t avx_width = BLITZ_AVX_WIDTH / sizeof(DType);
+  const size_t num_reg = size / avx_width;
+  CPURectlinApplyAVXKernel<DType> avx_kernel(input->data(), slope,
+    output->data());
+  BlitzParallelFor(0, num_reg, avx_kernel, kCPUElementGrain / avx_width);
+  CPURectlinApplyKernel<DType> kernel(input->data(), slope, output->data());
+  kernel(num_reg * avx_width, size, 0);
 #else
-  #pragma omp parallel for
-  for (size_t i = 0; i < input->size(); ++i) {
-    (*output)[i] = std::max((*input)[i], compare_value) +
-      slope * std::min((*input)[i], compare_value);
-  }
+  CPURectlinApplyKernel<DType> kernel(input->data(), slope, output->data());
+  BlitzParallelFor(0, size, kernel, kCPUElementGrain);
 #endif
 }
 
@@ -50,13 +843,9 @@ void Backend<CPUTensor, DType>::RectlinDerivativeFunc(
   CPUTensor<DType>* output) {
   CHECK_EQ(input->size(), output->size());
 
-  DType compare_value = static_cast<DType>(0);
-  #pragma omp parallel for
-  for (size_t i = 0; i < input->size(); ++i) {
-    DType greater = (*input)[i] > compare_value ? 1.0 : 0.0;
-    DType less = (*input)[i] <= compare_value ? slope : 0.0;
-    (*output)[i] = (greater + less) * (*output)[i];
-  }
+  CPURectlinDerivativeKernel<DType> kernel(input->data(), slope,
+    output->data());
+  BlitzParallelFor(0, input->size(), kernel, kCPUElementGrain);
 }
 
 template<typename DType>
@@ -65,10 +854,8 @@ void Backend<CPUTensor, DType>::LogisticApplyFunc(
   CPUTensor<DType>* output) {
   CHECK_EQ(input->size(), output->size());
 
-  #pragma omp parallel for
-  for (size_t i = 0; i < input->size(); ++i) {
-    (*output)[i] = 1 / (exp(-(*input)[i]) + 1);
-  }
+  CPULogisticApplyKernel<DType> kernel(input->data(), output->data());
+  BlitzParallelFor(0, input->size(), kernel, kCPUElementGrain);
 }
 
 template<typename DType>
@@ -87,19 +874,8 @@ void Backend<CPUTensor, DType>::SoftmaxApplyFunc(
   size_t num_sample = input->shape()[0];
   size_t dim = input->size() / num_sample;
 
-  #pragma omp parallel for
-  for (size_t i = 0; i < num_sample; ++i) {
-    DType sum = 0;
-    for (size_t j = 0; j < dim; ++j) {
-      size_t index = i * dim + j;
-      (*output)[index] = exp((*input)[index]);
-      sum += (*output)[index];
-    }
-
-    for (size_t j = 0; j < dim; ++j) {
-      (*output)[i * dim + j] /= sum;
-    }
-  }
+  CPUSoftmaxApplyKernel<DType> kernel(input->data(), dim, output->data());
+  BlitzParallelFor(0, num_sample, kernel, CPURowGrain(dim));
 }
 
 template<typename DType>
@@ -115,19 +891,9 @@ DType Backend<CPUTensor, DType>::CrossEntropyBinaryApplyFunc(
   const CPUTensor<DType>* input,
   const CPUTensor<DType>* target) {
   CHECK_EQ(input->size(), target->size());
-  DType private_output = 0;
-  DType output = 0;
-  #pragma omp parallel firstprivate(private_output)
-  {
-    #pragma omp for
-    for (size_t i = 0; i < input->size(); ++i) {
-      private_output += -BlitzCPUSafeLog((*input)[i]) * (*target)[i] -
-      BlitzCPUSafeLog(1 - (*input)[i]) * (1 - (*target)[i]);
-    }
-
-    #pragma omp atomic
-    output += private_output;
-  }
+  CPUCrossEntropyBinaryKernel<DType> kernel(input->data(), target->data());
+  DType output = BlitzParallelSum<DType>(0, input->size(), kernel,
+    kCPUElementGrain);
 
   output /= (input->shape())[0];
   return output;
@@ -137,24 +903,10 @@ template<typename DType>
 DType Backend<CPUTensor, DType>::SquareMeanApplyFunc(
   const CPUTensor<DType>* input, const CPUTensor<DType>* target) {
   CHECK_EQ(input->size(), target->size());
-  DType sum_square = 0;
-  DType sum = 0;
-
   size_t batch_size = input->shape()[0];
-  size_t dim = input->size() / batch_size;
-  #pragma omp parallel firstprivate(sum_square)
-  {
-    #pragma omp for
-    for (size_t i = 0; i < batch_size; ++i) {
-      for (size_t j = 0; j < dim; ++j) {
-        sum_square += pow((*input)[i * dim + j] -
-          (*target)[i * dim + j], 2);
-      }
-    }
-
-    #pragma omp atomic
-    sum += sum_square;
-  }
+  CPUSquareSumKernel<DType> kernel(input->data(), target->data());
+  DType sum = BlitzParallelSum<DType>(0, input->size(), kernel,
+    kCPUElementGrain);
   return sum / (2 * batch_size);
 }
 
@@ -172,24 +924,10 @@ DType Backend<CPUTensor, DType>::AbsMeanApplyFunc(
   const CPUTensor<DType>* input,
   const CPUTensor<DType>* target) {
   CHECK_EQ(input->size(), target->size());
-  DType sum_abs = 0;
-  DType sum = 0;
-
   size_t batch_size = input->shape()[0];
-  size_t dim = input->size() / batch_size;
-  #pragma omp parallel firstprivate(sum_abs)
-  {
-    #pragma omp for
-    for (size_t i = 0; i < batch_size; ++i) {
-      for (size_t j = 0; j < dim; ++j) {
-        sum_abs += fabs((*input)[i * dim + j] -
-          (*target)[i * dim + j]);
-      }
-    }
-
-    #pragma omp atomic
-    sum += sum_abs;
-  }
+  CPUAbsSumKernel<DType> kernel(input->data(), target->data());
+  DType sum = BlitzParallelSum<DType>(0, input->size(), kernel,
+    kCPUElementGrain);
   return sum / batch_size;
 }
 
@@ -199,20 +937,9 @@ void Backend<CPUTensor, DType>::AbsMeanDerivativeFunc(
   CPUTensor<DType>* output) {
   CHECK_EQ(input->size(), target->size());
   CHECK_EQ(output->size(), target->size());
-  size_t batch_size = input->shape()[0];
-  size_t dim = input->size() / batch_size;
-  #pragma omp parallel for
-  for (size_t i = 0; i < batch_size; ++i) {
-    for (size_t j = 0; j < dim; ++j) {
-      if ((*input)[i * dim + j] > (*target)[i * dim + j]) {
-        (*output)[i * dim + j] = 1;
-      } else if ((*input)[i * dim + j] < (*target)[i * dim + j]) {
-        (*output)[i * dim + j] = -1;
-      } else {
-        (*output)[i * dim + j] = 0;
-      }
-    }
-  }
+  CPUAbsMeanDerivativeKernel<DType> kernel(input->data(), target->data(),
+    output->data());
+  BlitzParallelFor(0, input->size(), kernel, kCPUElementGrain);
 }
 
 template<typename DType>
@@ -226,19 +953,9 @@ template<typename DType>
 DType Backend<CPUTensor, DType>::CrossEntropyMultiApplyFunc(
   const CPUTensor<DType>* input, const CPUTensor<DType>* target) {
   CHECK_EQ(input->size(), target->size());
-  DType private_output = 0;
-  DType output = 0;
-
-  #pragma omp parallel firstprivate(private_output)
-  {
-    #pragma omp for
-    for (size_t i = 0; i < input->size(); ++i) {
-      private_output += BlitzCPUSafeLog((*input)[i]) * (*target)[i];
-    }
-
-    #pragma omp atomic
-    output += -private_output;
-  }
+  CPUCrossEntropyMultiKernel<DType> kernel(input->data(), target->data());
+  DType output = -BlitzParallelSum<DType>(0, input->size(), kernel,
+    kCPUElementGrain);
 
   output /= (input->shape())[0];
   return output;
@@ -251,6 +968,36 @@ void Backend<CPUTensor, DType>::CrossEntropyMultiDerivativeFunc(
   MinusFunc(input, target, output);
 }
 
+template<typename DType>
+DType Backend<CPUTensor, DType>::CrossEntropyMultiSparseApplyFunc(
+  const CPUTensor<DType>* input, const CPUTensor<DType>* target) {
+  const size_t num_sample = input->shape()[0];
+  const size_t dim = input->size() / num_sample;
+  CHECK_EQ(target->size(), num_sample);
+  CPUCheckClassIndices(target->data(), num_sample, dim);
+  CPUCrossEntropyMultiSparseKernel<DType> kernel(input->data(),
+    target->data(), dim);
+  DType output = -BlitzParallelSum<DType>(0, num_sample, kernel,
+    CPURowGrain(dim));
+
+  output /= num_sample;
+  return output;
+}
+
+template<typename DType>
+void Backend<CPUTensor, DType>::CrossEntropyMultiSparseDerivativeFunc(
+  const CPUTensor<DType>* input, const CPUTensor<DType>* target,
+  CPUTensor<DType>* output) {
+  CHECK_EQ(input->size(), output->size());
+  const size_t num_sample = input->shape()[0];
+  const size_t dim = input->size() / num_sample;
+  CHECK_EQ(target->size(), num_sample);
+  CPUCheckClassIndices(target->data(), num_sample, dim);
+  CPUCrossEntropyMultiSparseDerivativeKernel<DType> kernel(input->data(),
+    target->data(), dim, output->data());
+  BlitzParallelFor(0, num_sample, kernel, CPURowGrain(dim));
+}
+
 template<typename DType>
 void Backend<CPUTensor, DType>::BiasForwardFunc(
   const CPUTensor<DType>* input, const CPUTensor<DType>* bias,
@@ -259,12 +1006,9 @@ void Backend<CPUTensor, DType>::BiasForwardFunc(
   size_t num_sample = input->shape()[0];
   size_t dim = input->size() / num_sample;
 
-  #pragma omp parallel for
-  for (size_t i = 0; i < num_sample; ++i) {
-    for (size_t j = 0; j < dim; ++j) {
-      (*output)[i * dim + j] = (*input)[i * dim + j] + (*bias)[j];
-    }
-  }
+  CPUBiasForwardKernel<DType> kernel(input->data(), bias->data(), dim,
+    output->data());
+  BlitzParallelFor(0, num_sample, kernel, CPURowGrain(dim));
 }
 
 template<typename DType>
@@ -273,12 +1017,9 @@ void Backend<CPUTensor, DType>::BiasBackwardUpdateFunc(
   size_t num_sample = input->shape()[0];
   size_t dim = input->size() / num_sample;
 
-  #pragma omp parallel for
-  for (size_t i = 0; i < dim; ++i) {
-    for (size_t j = 0; j < num_sample; ++j) {
-      (*update)[i] += (*input)[j * dim + i];
-    }
-  }
+  CPUBiasBackwardUpdateKernel<DType> kernel(input->data(), num_sample, dim,
+    update->data());
+  BlitzParallelFor(0, dim, kernel, CPURowGrain(num_sample));
 }
 
 template<typename DType>
@@ -292,32 +1033,10 @@ void Backend<CPUTensor, DType>::BatchNormForwardFunc(
   input_var->Fill(0);
   input_hat->Fill(0);
 
-  #pragma omp parallel for
-  for (size_t i = 0; i < dim; ++i) {
-    DType mean = 0.0;
-    for (size_t j = 0; j < num_sample; ++j) {
-      mean += (*input)[j * dim + i];
-    }
-    mean /= num_sample;
-
-    DType var;
-    for (size_t j = 0; j < num_sample; ++j) {
-      var = (*input)[j * dim + i] - mean;
-      (*input_var)[i] += var * var;
-    }
-    (*input_var)[i] /= num_sample;
-
-    DType divider = sqrt((*input_var)[i] + epsilon);
-
-    size_t index = 0;
-    for (size_t j = 0; j < num_sample; ++j) {
-      index = j * dim + i;
-      (*input_hat)[index] = ((*input)[index] -
-        mean) / divider;
-      (*output)[index] = (*gamma)[i] * (*input_hat)[index] +
-        (*beta)[i];
-    }
-  }
+  CPUBatchNormForwardKernel<DType> kernel(input->data(), gamma->data(),
+    beta->data(), epsilon, num_sample, dim, input_var->data(),
+    input_hat->data(), output->data());
+  BlitzParallelFor(0, dim, kernel, CPURowGrain(num_sample));
 }
 
 template<typename DType>
@@ -331,24 +1050,56 @@ void Backend<CPUTensor, DType>::BatchNormBackwardFunc(
   size_t num_sample = backward_input->shape()[0];
   size_t dim = backward_input->size() / num_sample;
 
-  #pragma omp parallel for
-  for (size_t i = 0; i < dim; ++i) {
-    for (size_t j = 0; j < num_sample; ++j) {
-      const size_t index = j * dim + i;
-      (*gamma_update)[i] += (*forward_input_hat)[index] *
-        (*backward_input)[index];
-      (*beta_update)[i] += (*backward_input)[index];
-    }
+  CPUBatchNormBackwardKernel<DType> kernel(backward_input->data(),
+    forward_input_hat->data(), forward_input_var->data(), gamma->data(),
+    epsilon, num_sample, dim, gamma_update->data(), beta_update->data(),
+    output->data());
+  BlitzParallelFor(0, dim, kernel, CPURowGrain(num_sample));
+}
+
+template<typename DType>
+void Backend<CPUTensor, DType>::EmbeddingForwardFunc(
+  const CPUTensor<DType>* input, const CPUTensor<DType>* weight,
+  CPUTensor<DType>* output) {
+  const size_t vocab = (weight->shape())[0];
+  const size_t dim = weight->size() / vocab;
+  CHECK_EQ(input->size() * dim, output->size());
+  CPUEmbeddingForwardKernel<DType> kernel(input->data(), weight->data(),
+    vocab, dim, output->data());
+  BlitzParallelFor(0, input->size(), kernel, CPURowGrain(dim));
+}
 
-    DType xhat;
-    for (size_t j = 0; j < num_sample; ++j) {
-      const size_t index = j * dim + i;
-      xhat = ((*forward_input_hat)[index] * (*gamma_update)[i] +
-        (*beta_update)[i]) / num_sample;
-      (*output)[index] = (*gamma)[i] * ((*backward_input)[index] -
-        xhat) / sqrt((*forward_input_var)[i] + epsilon);
+template<typename DType>
+void Backend<CPUTensor, DType>::EmbeddingBackwardUpdateFunc(
+  const CPUTensor<DType>* input, const CPUTensor<DType>* backward_input,
+  CPUTensor<DType>* update, vector<int>* rows) {
+  const size_t dim = update->size() / (update->shape())[0];
+  const size_t size = input->size();
+  CHECK_EQ(size * dim, backward_input->size());
+  // positions grouped by id, ids ascending
+  vector<std::pair<int, size_t> > ids(size);
+  for (size_t i = 0; i < size; ++i) {
+    ids[i] = std::make_pair(static_cast<int>((*input)[i]), i);
+  }
+  std::sort(ids.begin(), ids.end());
+  rows->clear();
+  vector<size_t> offset;
+  vector<size_t> position(size);
+  for (size_t i = 0; i < size; ++i) {
+    if (i == 0 || ids[i].first != ids[i - 1].first) {
+      rows->push_back(ids[i].first);
+      offset.push_back(i);
     }
+    position[i] = ids[i].second;
+  }
+  offset.push_back(size);
+  if (rows->empty()) {
+    return;
   }
+  CPUEmbeddingBackwardUpdateKernel<DType> kernel(&(*rows)[0], &offset[0],
+    &position[0], backward_input->data(), dim, update->data());
+  BlitzParallelFor(0, rows->size(), kernel,
+    CPURowGrain(size / rows->size() * dim));
 }
 
 template<typename DType>
@@ -368,46 +1119,38 @@ void Backend<CPUTensor, DType>::GradientdescentFunc(
   LOG(INFO) << "batch_size: " << batch_size;
 #endif
 
+  const size_t size = velocity->size();
+  CPUGradientdescentKernel<DType> kernel(momentum_coef, learning_rate, decay,
+    batch_size, weight->data(), gradient->data(), velocity->data());
 #ifdef BLITZ_AVX
-  size_t avx_width = BLITZ_AVX_WIDTH / sizeof(DType);
-  size_t remain = velocity->size() % avx_width;
-  const DType batch_size_float = static_cast<DType>(batch_size);
-  BlitzAVXReg<DType> gradient_reg, batch_size_reg, velocity_reg,
-    momentum_coef_reg, learning_rate_reg, decay_reg, weight_reg;
-  BlitzAVXBroadcast<DType>(&batch_size_float, &batch_size_reg);
-  BlitzAVXBroadcast<DType>(&momentum_coef, &momentum_coef_reg);
-  BlitzAVXBroadcast<DType>(&learning_rate, &learning_rate_reg);
-  BlitzAVXBroadcast<DType>(&decay, &decay_reg);
-  for (size_t i = 0; i < remain; ++i) {
-    (*gradient)[i] /= batch_size;
-    (*velocity)[i] = (*velocity)[i] * momentum_coef - learning_rate *
-      ((*gradient)[i] + decay * (*weight)[i]);
-    (*weight)[i] = (*weight)[i] + (*velocity)[i];
-  }
-  #pragma omp parallel for private(gradient_reg, velocity_reg, weight_reg)
-  for (size_t i = remain; i < velocity->size(); i += avx_width) {
-    BlitzAVXLoad<DType>(gradient->data() + i, &gradient_reg);
-    BlitzAVXLoad<DType>(velocity->data() + i, &velocity_reg);
-    BlitzAVXLoad<DType>(weight->data() + i, &weight_reg);
-    gradient_reg.v = gradient_reg.v / batch_size_reg.v;
-    velocity_reg.v = velocity_reg.v * momentum_coef_reg.v - learning_rate_reg.v *
-      (gradient_reg.v + decay_reg.v * weight_reg.v);
-    weight_reg.v = weight_reg.v + velocity_reg.v;
-    BlitzAVXStore<DType>(gradient->data() + i, &gradient_reg);
-    BlitzAVXStore<DType>(velocity->data() + i, &velocity_reg);
-    BlitzAVXStore<DType>(weight->data() + i, &weight_reg);
-  }
+  const size_t avx_width = BLITZ_AVX_WIDTH / sizeof(DType);
+  const size_t num_reg = size / avx_width;
+  CPUGradientdescentAVXKernel<DType> avx_kernel(momentum_coef, learning_rate,
+    decay, batch_size, weight->data(), gradient->data(), velocity->data());
+  BlitzParallelFor(0, num_reg, avx_kernel, kCPUElementGrain / avx_width);
+  kernel(num_reg * avx_width, size, 0);
 #else
-  #pragma omp parallel for
-  for (size_t i = 0; i < velocity->size(); ++i) {
-    (*gradient)[i] /= batch_size;
-    (*velocity)[i] = (*velocity)[i] * momentum_coef - learning_rate *
-      ((*gradient)[i] + decay * (*weight)[i]);
-    (*weight)[i] = (*weight)[i] + (*velocity)[i];
-  }
+  BlitzParallelFor(0, size, kernel, kCPUElementGrain);
 #endif
 }
 
+template<typename DType>
+void Backend<CPUTensor, DType>::SparseGradientdescentFunc(
+  const int* rows, const size_t num_rows,
+  const DType momentum_coef, const DType learning_rate,
+  const DType decay, const int batch_size,
+  CPUTensor<DType>* weight,
+  CPUTensor<DType>* gradient,
+  CPUTensor<DType>* velocity) {
+  CHECK_EQ(weight->size(), gradient->size());
+  CHECK_EQ(gradient->size(), velocity->size());
+  const size_t dim = weight->size() / (weight->shape())[0];
+  CPUSparseGradientdescentKernel<DType> kernel(rows, dim, momentum_coef,
+    learning_rate, decay, batch_size, weight->data(), gradient->data(),
+    velocity->data());
+  BlitzParallelFor(0, num_rows, kernel, CPURowGrain(dim));
+}
+
 template<typename DType>
 void Backend<CPUTensor, DType>::MatrixDotFunc(
   const CPUTensor<DType>* left, const CPUTensor<DType>* right,
@@ -434,16 +1177,53 @@ void Backend<CPUTensor, DType>::MatrixDotFunc(
     output->data(), alpha, beta);
 }
 
+template<typename DType>
+void Backend<CPUTensor, DType>::SparseMatrixDotFunc(
+  const size_t* row_offset, const int* column, const DType* value,
+  const CPUTensor<DType>* right, CPUTensor<DType>* output) {
+  const size_t rows = (output->shape())[0];
+  const size_t dim = output->size() / rows;
+  CHECK_EQ(dim, right->size() / (right->shape())[0]);
+  CPUSparseDotKernel<DType> kernel(row_offset, column, value, right->data(),
+    dim, output->data());
+  // a row costs about its non zeros times dim
+  const size_t row_cost = (row_offset[rows] - row_offset[0]) / rows * dim;
+  BlitzParallelFor(0, rows, kernel, CPURowGrain(row_cost));
+}
+
+template<typename DType>
+void Backend<CPUTensor, DType>::SparseMatrixTransposeDotFunc(
+  const size_t* row_offset, const int* column, const DType* value,
+  const CPUTensor<DType>* right, CPUTensor<DType>* output,
+  vector<int>* rows) {
+  const size_t batch = (right->shape())[0];
+  const size_t dim = right->size() / batch;
+  CHECK_EQ(dim, output->size() / (output->shape())[0]);
+  // only the rows of the columns of the batch are cleared
+  rows->assign(column + row_offset[0], column + row_offset[batch]);
+  std::sort(rows->begin(), rows->end());
+  rows->erase(std::unique(rows->begin(), rows->end()), rows->end());
+  if (rows->empty()) {
+    return;
+  }
+  CPUClearRowsKernel<DType> clear_kernel(&(*rows)[0], dim, output->data());
+  BlitzParallelFor(0, rows->size(), clear_kernel, CPURowGrain(dim));
+  CPUSparseTransposeDotKernel<DType> kernel(row_offset, column, value,
+    right->data(), batch, dim, output->data());
+  // a column costs about the non zeros of the batch
+  BlitzParallelFor(0, dim, kernel,
+    CPURowGrain(row_offset[batch] - row_offset[0]));
+}
+
 template<typename DType>
 void Backend<CPUTensor, DType>::MaximumFunc(
   const CPUTensor<DType>* left, const CPUTensor<DType>* right,
   CPUTensor<DType>* output) {
   CHECK_EQ(left->size(), right->size());
   CHECK_EQ(right->size(), output->size());
-  #pragma omp parallel for
-  for (size_t i = 0; i < left->size(); ++i) {
-    (*output)[i] = std::max((*left)[i], (*right)[i]);
-  }
+  CPUBinaryKernel<DType, CPUMaximumOp> kernel(left->data(), right->data(),
+    output->data());
+  BlitzParallelFor(0, left->size(), kernel, kCPUElementGrain);
 }
 
 template<typename DType>
@@ -452,10 +1232,9 @@ void Backend<CPUTensor, DType>::MaximumFunc(
   const DType right,
   CPUTensor<DType>* output) {
   CHECK_EQ(left->size(), output->size());
-  #pragma omp parallel for
-  for (size_t i = 0; i < left->size(); ++i) {
-    (*output)[i] = std::max((*left)[i], right);
-  }
+  CPUScalarKernel<DType, CPUMaximumOp> kernel(left->data(), right,
+    output->data());
+  BlitzParallelFor(0, left->size(), kernel, kCPUElementGrain);
 }
 
 template<typename DType>
@@ -465,10 +1244,9 @@ void Backend<CPUTensor, DType>::MinusFunc(
   CHECK_EQ(left->size(), right->size());
   CHECK_EQ(right->size(), output->size());
 
-  #pragma omp parallel for
-  for (size_t i = 0; i < left->size(); ++i) {
-    (*output)[i] = (*left)[i] - (*right)[i];
-  }
+  CPUBinaryKernel<DType, CPUMinusOp> kernel(left->data(), right->data(),
+    output->data());
+  BlitzParallelFor(0, left->size(), kernel, kCPUElementGrain);
 }
 
 template<typename DType>
@@ -477,10 +1255,9 @@ void Backend<CPUTensor, DType>::MinusFunc(
   const DType right,
   CPUTensor<DType>* output) {
   CHECK_EQ(left->size(), output->size());
-  #pragma omp parallel for
-  for (size_t i = 0; i < left->size(); ++i) {
-    (*output)[i] = (*left)[i] - right;
-  }
+  CPUScalarKernel<DType, CPUMinusOp> kernel(left->data(), right,
+    output->data());
+  BlitzParallelFor(0, left->size(), kernel, kCPUElementGrain);
 }
 
 template<typename DType>
@@ -499,10 +1276,9 @@ void Backend<CPUTensor, DType>::AddFunc(
   CPUTensor<DType>* output) {
   CHECK_EQ(left->size(), right->size());
   CHECK_EQ(right->size(), output->size());
-  #pragma omp parallel for
-  for (size_t i = 0; i < left->size(); ++i) {
-    (*output)[i] = (*left)[i] + (*right)[i];
-  }
+  CPUBinaryKernel<DType, CPUAddOp> kernel(left->data(), right->data(),
+    output->data());
+  BlitzParallelFor(0, left->size(), kernel, kCPUElementGrain);
 }
 
 template<typename DType>
@@ -511,10 +1287,9 @@ void Backend<CPUTensor, DType>::MultiplyFunc(
   CPUTensor<DType>* output) {
   CHECK_EQ(left->size(), right->size());
   CHECK_EQ(right->size(), output->size());
-  #pragma omp parallel for
-  for (size_t i = 0; i < left->size(); ++i) {
-    (*output)[i] = (*left)[i] * (*right)[i];
-  }
+  CPUBinaryKernel<DType, CPUMultiplyOp> kernel(left->data(), right->data(),
+    output->data());
+  BlitzParallelFor(0, left->size(), kernel, kCPUElementGrain);
 }
 
 template<typename DType>
@@ -522,10 +1297,9 @@ void Backend<CPUTensor, DType>::MultiplyFunc(
   const CPUTensor<DType>* left, const DType right,
   CPUTensor<DType>* output) {
   CHECK_EQ(left->size(), output->size());
-  #pragma omp parallel for
-  for (size_t i = 0; i < left->size(); ++i) {
-    (*output)[i] = (*left)[i] * right;
-  }
+  CPUScalarKernel<DType, CPUMultiplyOp> kernel(left->data(), right,
+    output->data());
+  BlitzParallelFor(0, left->size(), kernel, kCPUElementGrain);
 }
 
 template<typename DType>
@@ -534,14 +1308,8 @@ void Backend<CPUTensor, DType>::MakeBinaryMaskFunc(
   const DType keep, CPUTensor<DType>* output) {
   Backend<CPUTensor, DType>::UniformDistributionFunc(low, high, output);
 
-  #pragma omp parallel for
-  for (size_t i = 0; i < output->size(); ++i) {
-    if ((*output)[i] < keep) {
-      (*output)[i] = DType(1);
-    } else {
-      (*output)[i] = DType(0);
-    }
-  }
+  CPUBinaryMaskKernel<DType> kernel(keep, output->data());
+  BlitzParallelFor(0, output->size(), kernel, kCPUElementGrain);
 }
 
 template<typename DType>
@@ -592,30 +1360,38 @@ void Backend<CPUTensor, DType>::HostCopyToFunc(
   BlitzCPUCopy(source, size, target);
 }
 
+template<typename DType>
+void Backend<CPUTensor, DType>::HostCopyFromFunc(
+  const DType* source, const size_t size, DType* target) {
+  BlitzCPUCopy(source, size, target);
+}
+
 template<typename DType>
 float Backend<CPUTensor, DType>::EvaluateClassifyFunc(
   const CPUTensor<DType>* output, const CPUTensor<DType>* target) {
   size_t num_sample = output->shape()[0];
   size_t dim = output->size() / num_sample;
 
-  float correct = 0.0f;
-  #pragma omp parallel for
-  for (size_t i = 0; i < num_sample; ++i) {
-    DType max = (*output)[i * dim];
-    size_t max_index = 0;
-    for (size_t j = 1; j < dim; ++j) {
-      if (max < (*output)[i * dim + j]) {
-        max_index = j;
-        max = (*output)[i * dim + j];
-      }
-    }
+  CPUEvaluateClassifyKernel<DType> kernel(output->data(), target->data(),
+    dim);
+  float correct = BlitzParallelSum<float>(0, num_sample, kernel,
+    CPURowGrain(dim));
 
-    if ((*target)[i * dim + max_index] ==
-      static_cast<DType>(1)) {
-      #pragma omp atomic
-      correct += 1.0f;
-    }
-  }
+  return correct / num_sample;
+}
+
+template<typename DType>
+float Backend<CPUTensor, DType>::EvaluateClassifySparseFunc(
+  const CPUTensor<DType>* output, const CPUTensor<DType>* target) {
+  size_t num_sample = output->shape()[0];
+  size_t dim = output->size() / num_sample;
+  CHECK_EQ(target->size(), num_sample);
+  CPUCheckClassIndices(target->data(), num_sample, dim);
+
+  CPUEvaluateClassifySparseKernel<DType> kernel(output->data(),
+    target->data(), dim);
+  float correct = BlitzParallelSum<float>(0, num_sample, kernel,
+    CPURowGrain(dim));
 
   return correct / num_sample;
 }
@@ -626,18 +1402,9 @@ float Backend<CPUTensor, DType>::EvaluateRegressFunc(
   size_t num_sample = output->shape()[0];
   size_t dim = output->size() / num_sample;
 
-  DType result = 0.0;
-  DType correct = 0.0;
-  #pragma omp parallel for firstprivate(correct)
-  for (size_t i = 0; i < num_sample; ++i) {
-    DType correct = 0.0;
-    for (size_t j = 0; j < dim; ++j) {
-      correct += fabs((*output)[i] - (*target)[i]);
-    }
-
-    #pragma omp atomic
-    result += correct;
-  }
+  CPUAbsSumKernel<DType> kernel(output->data(), target->data());
+  DType result = BlitzParallelSum<DType>(0, num_sample * dim, kernel,
+    kCPUElementGrain);
 
   return result / num_sample;
 }
@@ -242,59 +242,134 @@ void Backend<CPUTensor, DType>::Convolution2DUpdateFunc(
   #endif  // BLITZ_PERFORMANCE
 }
 
-// batch parallel
+// batch parallel kernels, [begin, end) in (sample, tile) items,
+// every thread unpacks into its own buffer.
+// Small batches are split further inside every sample so that all threads
+// stay busy: forward and update over output pixels, backward over input
+// channels, whose packs write disjoint slices of the input.
+
+// output pixels of a tile are never fewer than this
+const int kCPUConvTileColumns = 32;
+
+// tiles per sample for batch_size samples, a finer split is taken only
+// when it shortens the critical path by an eighth
+inline int CPUConvTiles(const int batch_size, const int max_tiles) {
+  const int num_threads = ThreadPool::GetInstance().num_threads();
+  const int limit = std::min(max_tiles, num_threads);
+  int best_tiles = 1;
+  // in units of one whole sample per thread
+  double best_path = static_cast<double>(
+    (batch_size + num_threads - 1) / num_threads);
+  for (int tiles = 2; tiles <= limit; ++tiles) {
+    const int items = batch_size * tiles;
+    const double path = static_cast<double>(
+      (items + num_threads - 1) / num_threads) / tiles;
+    if (path < best_path * 0.875) {
+      best_path = path;
+      best_tiles = tiles;
+    }
+  }
+  return best_tiles;
+}
+
+// unpack only the output pixels [column_begin, column_end),
+// unpack is (channel * filter_height * filter_width) rows
+// of unpack_stride elements
 template<typename DType>
-void Backend<CPUTensor, DType>::Convolution2DForwardFunc(
-  const CPUTensor<DType>* input, const CPUTensor<DType>* weight,
+void CPUUnpack2DColumns(const DType* input, const int channel,
+  const int input_height, const int input_width,
+  const int filter_height, const int filter_width,
+  const int output_width,
   const int padding_height, const int padding_width,
   const int stride_height, const int stride_width,
-  vector<shared_ptr<CPUTensor<DType> > >* unpack_batch,
-  CPUTensor<DType>* output) {
-  // shape decode
-  // input
-  const Shape& input_shape = input->shape();
-  const int batch_size = input_shape[0];
-  const int input_channel = input_shape[1];
-  const int input_height = input_shape[2];
-  const int input_width = input_shape[3];
-  // filter
-  const Shape& filter_shape = weight->shape();
-  const int filter_height = filter_shape[2];
-  const int filter_width = filter_shape[3];
-  // output
-  const Shape& output_shape = output->shape();
-  const int output_channel = output_shape[1];
-  const int output_height = output_shape[2];
-  const int output_width = output_shape[3];
-
-  int batch_input_offset;
-  int batch_output_offset;
-  const int input_batch_offset = input_channel * input_height * input_width;
-  const int output_batch_offset = output_channel * output_height * output_width;
-  const int dim_left = output_channel;
-  const int dim_right = output_height * output_width;
-  const int dim_common = input_channel * filter_height * filter_width;
+  const int column_begin, const int column_end,
+  const int unpack_stride, DType* unpack) {
+  const int input_channel_offset = input_height * input_width;
+  for (int channel_index = 0; channel_index < channel; ++channel_index) {
+    const DType* input_slice = input + channel_index * input_channel_offset;
+    for (int filter_height_index = 0; filter_height_index < filter_height;
+        ++filter_height_index) {
+      for (int filter_width_index = 0; filter_width_index < filter_width;
+          ++filter_width_index) {
+        int unpack_index = ((channel_index * filter_height +
+          filter_height_index) * filter_width + filter_width_index) *
+          unpack_stride;
+        int output_height_index = column_begin / output_width;
+        int output_width_index = column_begin % output_width;
+        for (int column = column_begin; column < column_end; ++column) {
+          int filter_height_offset = output_height_index * stride_height -
+            padding_height + filter_height_index;
+          int filter_width_offset = output_width_index * stride_width -
+            padding_width + filter_width_index;
+          if (filter_height_offset < 0 ||
+            filter_height_offset >= input_height ||
+            filter_width_offset < 0 || filter_width_offset >= input_width) {
+            unpack[unpack_index++] = 0;
+          } else {
+            unpack[unpack_index++] = input_slice[filter_height_offset *
+              input_width + filter_width_offset];
+          }
+          if (++output_width_index == output_width) {
+            output_width_index = 0;
+            ++output_height_index;
+          }
+        }
+      }
+    }
+  }
+}
 
-  #ifdef BLITZ_PERFORMANCE
-  time_point<system_clock> start, end;
-  duration<double> gemm_time = duration<double>::zero();
-  duration<double> unpack_time = duration<double>::zero();
-  double average_gemm_time = 0.0;
-  double average_unpack_time = 0.0;
-  #endif  // BLITZ_PERFORMANCE
+template<typename DType>
+class CPUConvForwardBatchKernel {
+ public:
+  CPUConvForwardBatchKernel(const CPUTensor<DType>* input,
+    const CPUTensor<DType>* weight,
+    const int padding_height, const int padding_width,
+    const int stride_height, const int stride_width,
+    const int tiles,
+    vector<shared_ptr<CPUTensor<DType> > >* unpack_batch,
+    CPUTensor<DType>* output) :
+    input_(input), weight_(weight),
+    padding_height_(padding_height), padding_width_(padding_width),
+    stride_height_(stride_height), stride_width_(stride_width),
+    tiles_(tiles), unpack_batch_(unpack_batch), output_(output)
+#ifdef BLITZ_PERFORMANCE
+    , gemm_time_(unpack_batch->size(), 0.0),
+    unpack_time_(unpack_batch->size(), 0.0)
+#endif  // BLITZ_PERFORMANCE
+    {}
 
-  #pragma omp parallel private(batch_input_offset, batch_output_offset)
-  {
-    int tid = omp_get_thread_num();
+  void operator()(size_t begin, size_t end, int tid) {
+    // shape decode
+    const Shape& input_shape = input_->shape();
+    const int input_channel = input_shape[1];
+    const int input_height = input_shape[2];
+    const int input_width = input_shape[3];
+    const Shape& filter_shape = weight_->shape();
+    const int filter_height = filter_shape[2];
+    const int filter_width = filter_shape[3];
+    const Shape& output_shape = output_->shape();
+    const int output_channel = output_shape[1];
+    const int output_height = output_shape[2];
+    const int output_width = output_shape[3];
 
+    const int input_batch_offset = input_channel * input_height * input_width;
+    const int output_batch_offset = output_channel * output_height *
+      output_width;
+    const int columns = output_height * output_width;
+    const int dim_left = output_channel;
+    const int dim_common = input_channel * filter_height * filter_width;
+    DType* unpack = (*unpack_batch_)[tid]->data();
     #ifdef BLITZ_PERFORMANCE
-      #pragma omp for private(start, end)
-    #else
-      #pragma omp for
-    #endif
-    for (int batch_index = 0; batch_index < batch_size; ++batch_index) {
-      batch_input_offset = batch_index * input_batch_offset;
-      batch_output_offset = batch_index *  output_batch_offset;
+    time_point<system_clock> start, end_time;
+    #endif  // BLITZ_PERFORMANCE
+
+    for (size_t item = begin; item < end; ++item) {
+      const int batch_index = item / tiles_;
+      const int tile = item % tiles_;
+      const int column_begin = tile * columns / tiles_;
+      const int column_end = (tile + 1) * columns / tiles_;
+      const int dim_right = column_end - column_begin;
       #ifdef BLITZ_PERFORMANCE
       start = system_clock::now();
       #endif  // BLITZ_PERFORMANCE
@@ -303,47 +378,331 @@ void Backend<CPUTensor, DType>::Convolution2DForwardFunc(
       // (input_width * input_height)
       // to
       // (input_channel * filter_height * filter_width)
-      // (output_width * output_height)
-      Unpack2DFunc(input->Slice(batch_input_offset),
-        input_channel, input_height, input_width, filter_height, filter_width,
-        output_height, output_width, padding_height, padding_width,
-        stride_height, stride_width,
-        (*unpack_batch)[tid]->data());
+      // (column_end - column_begin)
+      if (tiles_ == 1) {
+        Backend<CPUTensor, DType>::Unpack2DFunc(
+          input_->Slice(batch_index * input_batch_offset),
+          input_channel, input_height, input_width,
+          filter_height, filter_width, output_height, output_width,
+          padding_height_, padding_width_, stride_height_, stride_width_,
+          unpack);
+      } else {
+        CPUUnpack2DColumns(input_->Slice(batch_index * input_batch_offset),
+          input_channel, input_height, input_width,
+          filter_height, filter_width, output_width,
+          padding_height_, padding_width_, stride_height_, stride_width_,
+          column_begin, column_end, column_end - column_begin, unpack);
+      }
       #ifdef BLITZ_PERFORMANCE
-      end = system_clock::now();
-      #pragma omp critical
-      unpack_time += end - start;
+      end_time = system_clock::now();
+      unpack_time_[tid] += duration<double>(end_time - start).count();
+      start = end_time;
       #endif  // BLITZ_PERFORMANCE
+      // gemm generate
+      // (output_channel) * (column_end - column_begin)
+      BlitzCPUGemm(false, false, dim_left, dim_right, dim_common,
+        const_cast<CPUTensor<DType>*>(weight_)->data(), dim_common,
+        unpack, dim_right,
+        output_->Slice(batch_index * output_batch_offset + column_begin),
+        columns, static_cast<DType>(1), static_cast<DType>(0));
+      #ifdef BLITZ_PERFORMANCE
+      end_time = system_clock::now();
+      gemm_time_[tid] += duration<double>(end_time - start).count();
+      #endif  // BLITZ_PERFORMANCE
+    }
+  }
+
+#ifdef BLITZ_PERFORMANCE
+  vector<double> gemm_time_;
+  vector<double> unpack_time_;
+#endif  // BLITZ_PERFORMANCE
+
+ private:
+  const CPUTensor<DType>* input_;
+  const CPUTensor<DType>* weight_;
+  const int padding_height_;
+  const int padding_width_;
+  const int stride_height_;
+  const int stride_width_;
+  const int tiles_;
+  vector<shared_ptr<CPUTensor<DType> > >* unpack_batch_;
+  CPUTensor<DType>* output_;
+};
 
+template<typename DType>
+class CPUConvBackwardBatchKernel {
+ public:
+  CPUConvBackwardBatchKernel(const CPUTensor<DType>* output,
+    const CPUTensor<DType>* weight,
+    const int padding_height, const int padding_width,
+    const int stride_height, const int stride_width,
+    const int tiles,
+    vector<shared_ptr<CPUTensor<DType> > >* pack_batch,
+    CPUTensor<DType>* input) :
+    output_(output), weight_(weight),
+    padding_height_(padding_height), padding_width_(padding_width),
+    stride_height_(stride_height), stride_width_(stride_width),
+    tiles_(tiles), pack_batch_(pack_batch), input_(input)
+#ifdef BLITZ_PERFORMANCE
+    , gemm_time_(pack_batch->size(), 0.0),
+    pack_time_(pack_batch->size(), 0.0)
+#endif  // BLITZ_PERFORMANCE
+    {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    // shape decode
+    const Shape& input_shape = input_->shape();
+    const int input_channel = input_shape[1];
+    const int input_height = input_shape[2];
+    const int input_width = input_shape[3];
+    const Shape& filter_shape = weight_->shape();
+    const int filter_height = filter_shape[2];
+    const int filter_width = filter_shape[3];
+    const Shape& output_shape = output_->shape();
+    const int output_channel = output_shape[1];
+    const int output_height = output_shape[2];
+    const int output_width = output_shape[3];
+
+    const int input_channel_offset = input_height * input_width;
+    const int input_batch_offset = input_channel * input_channel_offset;
+    const int output_batch_offset = output_channel * output_height *
+      output_width;
+    const int filter_channel_offset = filter_height * filter_width;
+    const int dim_right = output_height * output_width;
+    const int dim_common = output_channel;
+    DType* pack = (*pack_batch_)[tid]->data();
+    #ifdef BLITZ_PERFORMANCE
+    time_point<system_clock> start, end_time;
+    #endif  // BLITZ_PERFORMANCE
+
+    for (size_t item = begin; item < end; ++item) {
+      const int batch_index = item / tiles_;
+      const int tile = item % tiles_;
+      const int channel_begin = tile * input_channel / tiles_;
+      const int channel_end = (tile + 1) * input_channel / tiles_;
+      const int dim_left = (channel_end - channel_begin) *
+        filter_channel_offset;
       #ifdef BLITZ_PERFORMANCE
       start = system_clock::now();
       #endif  // BLITZ_PERFORMANCE
       // gemm generate
-      // (output_channel) * (output_height * output_width)
-      BlitzCPUGemm(false, false, dim_left, dim_right, dim_common,
-      const_cast<CPUTensor<DType>*>(weight)->data(),
-      (*unpack_batch)[tid]->data(),
-      output->Slice(batch_output_offset),
-      static_cast<DType>(1), static_cast<DType>(0));
-
+      // (output_width * output_height) *
+      // ((channel_end - channel_begin) * filter_height * filter_width)
+      BlitzCPUGemm(true, false, dim_left, dim_right, dim_common,
+        const_cast<CPUTensor<DType>*>(weight_)->Slice(
+          channel_begin * filter_channel_offset),
+        input_channel * filter_channel_offset,
+        const_cast<CPUTensor<DType>*>(output_)->Slice(
+          batch_index * output_batch_offset), dim_right,
+        pack, dim_right, static_cast<DType>(1), static_cast<DType>(0));
+      #ifdef BLITZ_PERFORMANCE
+      end_time = system_clock::now();
+      gemm_time_[tid] += duration<double>(end_time - start).count();
+      start = end_time;
+      #endif  // BLITZ_PERFORMANCE
+      // pack
+      // ((channel_end - channel_begin) * filter_height * filter_width) *
+      // (output_width * output_height)
+      // to
+      // (channel_end - channel_begin) *
+      // (input_height * input_width)
+      Backend<CPUTensor, DType>::Pack2DFunc(pack,
+        channel_end - channel_begin, input_height, input_width,
+        filter_height, filter_width, output_height, output_width,
+        padding_height_, padding_width_, stride_height_, stride_width_,
+        input_->Slice(batch_index * input_batch_offset +
+          channel_begin * input_channel_offset));
       #ifdef BLITZ_PERFORMANCE
-      end = system_clock::now();
-      #pragma omp critical
-      gemm_time += end - start;
+      end_time = system_clock::now();
+      pack_time_[tid] += duration<double>(end_time - start).count();
       #endif  // BLITZ_PERFORMANCE
     }
+  }
+
+#ifdef BLITZ_PERFORMANCE
+  vector<double> gemm_time_;
+  vector<double> pack_time_;
+#endif  // BLITZ_PERFORMANCE
+
+ private:
+  const CPUTensor<DType>* output_;
+  const CPUTensor<DType>* weight_;
+  const int padding_height_;
+  const int padding_width_;
+  const int stride_height_;
+  const int stride_width_;
+  const int tiles_;
+  vector<shared_ptr<CPUTensor<DType> > >* pack_batch_;
+  CPUTensor<DType>* input_;
+};
+
+template<typename DType>
+class CPUConvUpdateBatchKernel {
+ public:
+  CPUConvUpdateBatchKernel(const CPUTensor<DType>* input,
+    const CPUTensor<DType>* output,
+    const int padding_height, const int padding_width,
+    const int stride_height, const int stride_width,
+    const int tiles,
+    vector<shared_ptr<CPUTensor<DType> > >* unpack_batch,
+    vector<shared_ptr<CPUTensor<DType> > >* update_batch) :
+    input_(input), output_(output),
+    padding_height_(padding_height), padding_width_(padding_width),
+    stride_height_(stride_height), stride_width_(stride_width),
+    tiles_(tiles), unpack_batch_(unpack_batch), update_batch_(update_batch)
+#ifdef BLITZ_PERFORMANCE
+    , gemm_time_(unpack_batch->size(), 0.0),
+    unpack_time_(unpack_batch->size(), 0.0)
+#endif  // BLITZ_PERFORMANCE
+    {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    // shape decode
+    const Shape& input_shape = input_->shape();
+    const int input_channel = input_shape[1];
+    const int input_height = input_shape[2];
+    const int input_width = input_shape[3];
+    const Shape& filter_shape = (*update_batch_)[tid]->shape();
+    const int filter_height = filter_shape[2];
+    const int filter_width = filter_shape[3];
+    const Shape& output_shape = output_->shape();
+    const int output_channel = output_shape[1];
+    const int output_height = output_shape[2];
+    const int output_width = output_shape[3];
+
+    const int input_batch_offset = input_channel * input_height * input_width;
+    const int output_batch_offset = output_channel * output_height *
+      output_width;
+    const int columns = output_height * output_width;
+    const int dim_left = output_channel;
+    const int dim_right = input_channel * filter_height * filter_width;
+    DType* unpack = (*unpack_batch_)[tid]->data();
     #ifdef BLITZ_PERFORMANCE
-    if (tid == 0) {
-      average_unpack_time = unpack_time.count() /
-        omp_get_num_threads();
-      average_gemm_time = gemm_time.count() /
-        omp_get_num_threads();
+    time_point<system_clock> start, end_time;
+    #endif  // BLITZ_PERFORMANCE
+
+    for (size_t item = begin; item < end; ++item) {
+      const int batch_index = item / tiles_;
+      const int tile = item % tiles_;
+      const int column_begin = tile * columns / tiles_;
+      const int column_end = (tile + 1) * columns / tiles_;
+      const int dim_common = column_end - column_begin;
+      #ifdef BLITZ_PERFORMANCE
+      start = system_clock::now();
+      #endif  // BLITZ_PERFORMANCE
+      // unpack
+      // (input_channel) *
+      // (input_width * input_height)
+      // to
+      // (input_channel * filter_height * filter_width)
+      // (column_end - column_begin)
+      if (tiles_ == 1) {
+        Backend<CPUTensor, DType>::Unpack2DFunc(
+          input_->Slice(batch_index * input_batch_offset),
+          input_channel, input_height, input_width,
+          filter_height, filter_width, output_height, output_width,
+          padding_height_, padding_width_, stride_height_, stride_width_,
+          unpack);
+      } else {
+        CPUUnpack2DColumns(input_->Slice(batch_index * input_batch_offset),
+          input_channel, input_height, input_width,
+          filter_height, filter_width, output_width,
+          padding_height_, padding_width_, stride_height_, stride_width_,
+          column_begin, column_end, column_end - column_begin, unpack);
+      }
+      #ifdef BLITZ_PERFORMANCE
+      end_time = system_clock::now();
+      unpack_time_[tid] += duration<double>(end_time - start).count();
+      start = end_time;
+      #endif  // BLITZ_PERFORMANCE
+      // gemm generate
+      // (output_channel) *
+      // (input_channel * filter_height * filter_width)
+      BlitzCPUGemm(false, true, dim_left, dim_right, dim_common,
+        const_cast<CPUTensor<DType>*>(output_)->Slice(
+          batch_index * output_batch_offset + column_begin), columns,
+        unpack, dim_common, (*update_batch_)[tid]->data(), dim_right,
+        static_cast<DType>(1), static_cast<DType>(1));
+      #ifdef BLITZ_PERFORMANCE
+      end_time = system_clock::now();
+      gemm_time_[tid] += duration<double>(end_time - start).count();
+      #endif  // BLITZ_PERFORMANCE
     }
-    #endif
   }
+
+#ifdef BLITZ_PERFORMANCE
+  vector<double> gemm_time_;
+  vector<double> unpack_time_;
+#endif  // BLITZ_PERFORMANCE
+
+ private:
+  const CPUTensor<DType>* input_;
+  const CPUTensor<DType>* output_;
+  const int padding_height_;
+  const int padding_width_;
+  const int stride_height_;
+  const int stride_width_;
+  const int tiles_;
+  vector<shared_ptr<CPUTensor<DType> > >* unpack_batch_;
+  vector<shared_ptr<CPUTensor<DType> > >* update_batch_;
+};
+
+// update[i] += sum of the per thread updates, [begin, end) in elements
+template<typename DType>
+class CPUBatchReduceKernel {
+ public:
+  CPUBatchReduceKernel(vector<shared_ptr<CPUTensor<DType> > >* batch,
+    CPUTensor<DType>* output) : batch_(batch), output_(output) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    DType* output = output_->data();
+    for (size_t j = 0; j < batch_->size(); ++j) {
+      const DType* slice = (*batch_)[j]->data();
+      for (size_t i = begin; i < end; ++i) {
+        output[i] += slice[i];
+      }
+    }
+  }
+
+ private:
+  vector<shared_ptr<CPUTensor<DType> > >* batch_;
+  CPUTensor<DType>* output_;
+};
+
+#ifdef BLITZ_PERFORMANCE
+inline double CPUAverageTime(const vector<double>& times) {
+  double sum = 0.0;
+  for (size_t i = 0; i < times.size(); ++i) {
+    sum += times[i];
+  }
+  return sum / times.size();
+}
+#endif  // BLITZ_PERFORMANCE
+
+// batch parallel
+template<typename DType>
+void Backend<CPUTensor, DType>::Convolution2DForwardFunc(
+  const CPUTensor<DType>* input, const CPUTensor<DType>* weight,
+  const int padding_height, const int padding_width,
+  const int stride_height, const int stride_width,
+  vector<shared_ptr<CPUTensor<DType> > >* unpack_batch,
+  CPUTensor<DType>* output) {
+  CHECK_GE(unpack_batch->size(),
+    static_cast<size_t>(ThreadPool::GetInstance().num_threads()));
+  const int batch_size = input->shape()[0];
+  const Shape& output_shape = output->shape();
+  const int tiles = CPUConvTiles(batch_size,
+    output_shape[2] * output_shape[3] / kCPUConvTileColumns);
+  CPUConvForwardBatchKernel<DType> kernel(input, weight,
+    padding_height, padding_width, stride_height, stride_width,
+    tiles, unpack_batch, output);
+  BlitzParallelFor(0, batch_size * tiles, kernel);
+
   #ifdef BLITZ_PERFORMANCE
-  LOG(INFO) << "Forward convolution average gemm: " << average_gemm_time;
-  LOG(INFO) << "Forward convolution average unpack: " << average_unpack_time;
+  LOG(INFO) << "Forward convolution average gemm: " <<
+    CPUAverageTime(kernel.gemm_time_);
+  LOG(INFO) << "Forward convolution average unpack: " <<
+    CPUAverageTime(kernel.unpack_time_);
   #endif  // BLITZ_PERFORMANCE
 }
 
@@ -354,102 +713,232 @@ void Backend<CPUTensor, DType>::Convolution2DBackwardFunc(
   const int stride_height, const int stride_width,
   vector<shared_ptr<CPUTensor<DType> > >* pack_batch,
   CPUTensor<DType>* input) {
+  CHECK_GE(pack_batch->size(),
+    static_cast<size_t>(ThreadPool::GetInstance().num_threads()));
+  const int batch_size = input->shape()[0];
+  const int tiles = CPUConvTiles(batch_size, input->shape()[1]);
+  input->Fill(0);
+  CPUConvBackwardBatchKernel<DType> kernel(output, weight,
+    padding_height, padding_width, stride_height, stride_width,
+    tiles, pack_batch, input);
+  BlitzParallelFor(0, batch_size * tiles, kernel);
+
+  #ifdef BLITZ_PERFORMANCE
+  LOG(INFO) << "Backward convolution average gemm: " <<
+    CPUAverageTime(kernel.gemm_time_);
+  LOG(INFO) << "Backward convolution average pack: " <<
+    CPUAverageTime(kernel.pack_time_);
+  #endif  // BLITZ_PERFORMANCE
+}
+
+template<typename DType>
+void Backend<CPUTensor, DType>::Convolution2DUpdateFunc(
+  const CPUTensor<DType>* input, const CPUTensor<DType>* output,
+  const int padding_height, const int padding_width,
+  const int stride_height, const int stride_width,
+  vector<shared_ptr<CPUTensor<DType> > >* unpack_batch,
+  vector<shared_ptr<CPUTensor<DType> > >* update_batch,
+  CPUTensor<DType>* update) {
+  CHECK_GE(unpack_batch->size(),
+    static_cast<size_t>(ThreadPool::GetInstance().num_threads()));
+  CHECK_EQ(unpack_batch->size(), update_batch->size());
+  const int batch_size = input->shape()[0];
+  const Shape& output_shape = output->shape();
+  const int tiles = CPUConvTiles(batch_size,
+    output_shape[2] * output_shape[3] / kCPUConvTileColumns);
+  CPUConvUpdateBatchKernel<DType> kernel(input, output,
+    padding_height, padding_width, stride_height, stride_width,
+    tiles, unpack_batch, update_batch);
+  BlitzParallelFor(0, batch_size * tiles, kernel);
+
+  // reduce the per thread updates without atomics
+  CPUBatchReduceKernel<DType> reduce_kernel(update_batch, update);
+  BlitzParallelFor(0, update->size(), reduce_kernel, kCPUElementGrain);
+
+  #ifdef BLITZ_PERFORMANCE
+  LOG(INFO) << "Backward convolution weight average gemm: " <<
+    CPUAverageTime(kernel.gemm_time_);
+  LOG(INFO) << "Backward convolution weight average unpack: " <<
+    CPUAverageTime(kernel.unpack_time_);
+  #endif  // BLITZ_PERFORMANCE
+}
+
+// chunk parallel, [begin, end) in (sample, channel) items of a chunk,
+// every item fills the filter_height * filter_width rows of its channel
+// in the columns of its sample
+template<typename DType>
+class CPUUnpack2DChunkKernel {
+ public:
+  CPUUnpack2DChunkKernel(const DType* input, const int channel,
+    const int input_height, const int input_width,
+    const int filter_height, const int filter_width,
+    const int output_height, const int output_width,
+    const int padding_height, const int padding_width,
+    const int stride_height, const int stride_width,
+    const int samples, DType* unpack) :
+    input_(input), channel_(channel),
+    input_height_(input_height), input_width_(input_width),
+    filter_height_(filter_height), filter_width_(filter_width),
+    output_height_(output_height), output_width_(output_width),
+    padding_height_(padding_height), padding_width_(padding_width),
+    stride_height_(stride_height), stride_width_(stride_width),
+    samples_(samples), unpack_(unpack) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    const int columns = output_height_ * output_width_;
+    const int unpack_stride = samples_ * columns;
+    const int input_channel_offset = input_height_ * input_width_;
+    const int filter_channel_offset = filter_height_ * filter_width_;
+    for (size_t item = begin; item < end; ++item) {
+      const int sample_index = item / channel_;
+      const int channel_index = item % channel_;
+      CPUUnpack2DColumns(input_ + item * input_channel_offset, 1,
+        input_height_, input_width_, filter_height_, filter_width_,
+        output_width_, padding_height_, padding_width_,
+        stride_height_, stride_width_, 0, columns, unpack_stride,
+        unpack_ + channel_index * filter_channel_offset * unpack_stride +
+        sample_index * columns);
+    }
+  }
+
+ private:
+  const DType* input_;
+  const int channel_;
+  const int input_height_;
+  const int input_width_;
+  const int filter_height_;
+  const int filter_width_;
+  const int output_height_;
+  const int output_width_;
+  const int padding_height_;
+  const int padding_width_;
+  const int stride_height_;
+  const int stride_width_;
+  const int samples_;
+  DType* unpack_;
+};
+
+// [begin, end) in (sample, channel) rows, moves them between
+// (samples) * (channel) * (columns) and (channel) * (samples * columns)
+template<typename DType>
+class CPUConvChunkCopyKernel {
+ public:
+  CPUConvChunkCopyKernel(DType* batch, const int channel, const int columns,
+    const int samples, DType* chunk, const bool to_chunk) :
+    batch_(batch), channel_(channel), columns_(columns),
+    samples_(samples), chunk_(chunk), to_chunk_(to_chunk) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    for (size_t item = begin; item < end; ++item) {
+      const int sample_index = item / channel_;
+      const int channel_index = item % channel_;
+      DType* batch = batch_ + item * columns_;
+      DType* chunk = chunk_ + (channel_index * samples_ + sample_index) *
+        columns_;
+      if (to_chunk_) {
+        BlitzCPUCopy(batch, columns_, chunk);
+      } else {
+        BlitzCPUCopy(chunk, columns_, batch);
+      }
+    }
+  }
+
+ private:
+  DType* batch_;
+  const int channel_;
+  const int columns_;
+  const int samples_;
+  DType* chunk_;
+  const bool to_chunk_;
+};
+
+// unpack holds (input_channel * filter_height * filter_width) *
+// (chunk_size * output_height * output_width), the chunk size follows it
+template<typename DType>
+void Backend<CPUTensor, DType>::Convolution2DForwardFunc(
+  const CPUTensor<DType>* input, const CPUTensor<DType>* weight,
+  const int padding_height, const int padding_width,
+  const int stride_height, const int stride_width,
+  CPUTensor<DType>* unpack, CPUTensor<DType>* chunk,
+  CPUTensor<DType>* output) {
   // shape decode
   // input
   const Shape& input_shape = input->shape();
-  const int batch_size = input_shape[0];
-  const int input_channel = input_shape[1];
-  const int input_height = input_shape[2];
-  const int input_width = input_shape[3];
+  int batch_size = input_shape[0];
+  int input_channel = input_shape[1];
+  int input_height = input_shape[2];
+  int input_width = input_shape[3];
   // filter
   const Shape& filter_shape = weight->shape();
-  const int filter_height = filter_shape[2];
-  const int filter_width = filter_shape[3];
+  int filter_height = filter_shape[2];
+  int filter_width = filter_shape[3];
   // output
   const Shape& output_shape = output->shape();
-  const int output_channel = output_shape[1];
-  const int output_height = output_shape[2];
-  const int output_width = output_shape[3];
+  int output_channel = output_shape[1];
+  int output_height = output_shape[2];
+  int output_width = output_shape[3];
 
-  int batch_input_offset;
-  int batch_output_offset;
+  const int columns = output_height * output_width;
+  const int chunk_size = unpack->shape()[1] / columns;
+  CHECK_GE(chunk_size, 1);
+  CHECK_GE(chunk->size(), static_cast<size_t>(output_channel *
+    chunk_size * columns));
   const int input_batch_offset = input_channel * input_height * input_width;
-  const int output_batch_offset = output_channel * output_height * output_width;
-  const int dim_left = input_channel * filter_height * filter_width;
-  const int dim_right = output_height * output_width;
-  const int dim_common = output_channel;
-  input->Fill(0);
-
+  const int output_batch_offset = output_channel * columns;
+  const int dim_left = output_channel;
+  const int dim_common = input_channel * filter_height * filter_width;
   #ifdef BLITZ_PERFORMANCE
   time_point<system_clock> start, end;
   duration<double> gemm_time = duration<double>::zero();
-  duration<double> pack_time = duration<double>::zero();
-  double average_gemm_time = 0.0;
-  double average_pack_time = 0.0;
+  duration<double> unpack_time = duration<double>::zero();
   #endif  // BLITZ_PERFORMANCE
 
-  #pragma omp parallel private(batch_input_offset, batch_output_offset)
-  {
-    int tid = omp_get_thread_num();
-
+  for (int batch_begin = 0; batch_begin < batch_size;
+      batch_begin += chunk_size) {
+    const int samples = std::min(chunk_size, batch_size - batch_begin);
+    const int dim_right = samples * columns;
     #ifdef BLITZ_PERFORMANCE
-      #pragma omp for private(start, end)
-    #else
-      #pragma omp for
+    start = system_clock::now();
     #endif
-    for (int batch_index = 0; batch_index < batch_size; ++batch_index) {
-      batch_input_offset = batch_index * input_batch_offset;
-      batch_output_offset = batch_index * output_batch_offset;
-      #ifdef BLITZ_PERFORMANCE
-      start = system_clock::now();
-      #endif  // BLITZ_PERFORMANCE
-      // gemm generate
-      // (output_width * output_height) *
-      // (input_channel * filter_height * filter_width)
-      BlitzCPUGemm(true, false, dim_left, dim_right, dim_common,
+    // unpack
+    // (samples) * (input_channel) *
+    // (input_width * input_height)
+    // to
+    // (input_channel * filter_height * filter_width)
+    // (samples * output_width * output_height)
+    CPUUnpack2DChunkKernel<DType> unpack_kernel(
+      input->Slice(batch_begin * input_batch_offset), input_channel,
+      input_height, input_width, filter_height, filter_width,
+      output_height, output_width, padding_height, padding_width,
+      stride_height, stride_width, samples, unpack->data());
+    BlitzParallelFor(0, samples * input_channel, unpack_kernel,
+      CPURowGrain(filter_height * filter_width * columns));
+    #ifdef BLITZ_PERFORMANCE
+    end = system_clock::now();
+    unpack_time += end - start;
+    start = end;
+    #endif
+    // gemm generate
+    // (output_channel) * (samples * output_height * output_width)
+    BlitzCPUGemm(false, false, dim_left, dim_right, dim_common,
       const_cast<CPUTensor<DType>*>(weight)->data(),
-      const_cast<CPUTensor<DType>*>(output)->Slice(batch_output_offset),
-      (*pack_batch)[tid]->data(),
+      unpack->data(), chunk->data(),
       static_cast<DType>(1), static_cast<DType>(0));
-      #ifdef BLITZ_PERFORMANCE
-      end = system_clock::now();
-      #pragma omp critical
-      gemm_time += end - start;
-      #endif  // BLITZ_PERFORMANCE
-
-      #ifdef BLITZ_PERFORMANCE
-      start = system_clock::now();
-      #endif  // BLITZ_PERFORMANCE
-      // pack
-      // (input_channel * filter_height * filter_width) *
-      // (output_width * output_height)
-      // to
-      // (input_channel) *
-      // (input_height * input_width)
-      Pack2DFunc((*pack_batch)[tid]->data(),
-        input_channel, input_height, input_width,
-        filter_height, filter_width, output_height, output_width,
-        padding_height, padding_width, stride_height, stride_width,
-        input->Slice(batch_input_offset));
-      #ifdef BLITZ_PERFORMANCE
-      end = system_clock::now();
-      #pragma omp critical
-      pack_time += end - start;
-      #endif  // BLITZ_PERFORMANCE
-    }
     #ifdef BLITZ_PERFORMANCE
-    if (tid == 0) {
-      average_pack_time = pack_time.count() /
-        omp_get_num_threads();
-      average_gemm_time = gemm_time.count() /
-        omp_get_num_threads();
-    }
+    end = system_clock::now();
+    gemm_time += end - start;
     #endif
+    // back to (samples) * (output_channel) * (output_height * output_width)
+    CPUConvChunkCopyKernel<DType> copy_kernel(
+      output->Slice(batch_begin * output_batch_offset), output_channel,
+      columns, samples, chunk->data(), false);
+    BlitzParallelFor(0, samples * output_channel, copy_kernel,
+      CPURowGrain(columns));
   }
 
   #ifdef BLITZ_PERFORMANCE
-  LOG(INFO) << "Backward convolution average gemm: " << average_gemm_time;
-  LOG(INFO) << "Backward convolution average pack: " << average_pack_time;
+  LOG(INFO) << "Forward convolution chunk gemm: " << gemm_time.count();
+  LOG(INFO) << "Forward convolution chunk unpack: " << unpack_time.count();
   #endif  // BLITZ_PERFORMANCE
 }
 
@@ -458,119 +947,192 @@ void Backend<CPUTensor, DType>::Convolution2DUpdateFunc(
   const CPUTensor<DType>* input, const CPUTensor<DType>* output,
   const int padding_height, const int padding_width,
   const int stride_height, const int stride_width,
-  vector<shared_ptr<CPUTensor<DType> > >* unpack_batch,
-  vector<shared_ptr<CPUTensor<DType> > >* update_batch,
+  CPUTensor<DType>* unpack, CPUTensor<DType>* chunk,
   CPUTensor<DType>* update) {
   // shape decode
   // input
   const Shape& input_shape = input->shape();
-  const int batch_size = input_shape[0];
-  const int input_channel = input_shape[1];
-  const int input_height = input_shape[2];
-  const int input_width = input_shape[3];
+  int batch_size = input_shape[0];
+  int input_channel = input_shape[1];
+  int input_height = input_shape[2];
+  int input_width = input_shape[3];
   // filter
   const Shape& filter_shape = update->shape();
-  const int filter_height = filter_shape[2];
-  const int filter_width = filter_shape[3];
+  int filter_height = filter_shape[2];
+  int filter_width = filter_shape[3];
   // output
   const Shape& output_shape = output->shape();
-  const int output_channel = output_shape[1];
-  const int output_height = output_shape[2];
-  const int output_width = output_shape[3];
+  int output_channel = output_shape[1];
+  int output_height = output_shape[2];
+  int output_width = output_shape[3];
 
-  int batch_input_offset;
-  int batch_output_offset;
+  const int columns = output_height * output_width;
+  const int chunk_size = unpack->shape()[1] / columns;
+  CHECK_GE(chunk_size, 1);
+  CHECK_GE(chunk->size(), static_cast<size_t>(output_channel *
+    chunk_size * columns));
   const int input_batch_offset = input_channel * input_height * input_width;
-  const int output_batch_offset = output_channel * output_height * output_width;
+  const int output_batch_offset = output_channel * columns;
   const int dim_left = output_channel;
   const int dim_right = input_channel * filter_height * filter_width;
-  const int dim_common = output_height * output_width;
-
   #ifdef BLITZ_PERFORMANCE
   time_point<system_clock> start, end;
   duration<double> gemm_time = duration<double>::zero();
   duration<double> unpack_time = duration<double>::zero();
-  double average_gemm_time = 0.0;
-  double average_unpack_time = 0.0;
   #endif  // BLITZ_PERFORMANCE
 
-  #pragma omp parallel private(batch_input_offset, batch_output_offset)
-  {
-    int tid = omp_get_thread_num();
-
+  for (int batch_begin = 0; batch_begin < batch_size;
+      batch_begin += chunk_size) {
+    const int samples = std::min(chunk_size, batch_size - batch_begin);
+    const int dim_common = samples * columns;
     #ifdef BLITZ_PERFORMANCE
-      #pragma omp for private(start, end)
-    #else
-      #pragma omp for
+    start = system_clock::now();
     #endif
-    for (int batch_index = 0; batch_index < batch_size; ++batch_index) {
-      batch_input_offset = batch_index * input_batch_offset;
-      batch_output_offset = batch_index * output_batch_offset;
-      #ifdef BLITZ_PERFORMANCE
-      start = system_clock::now();
-      #endif  // BLITZ_PERFORMANCE
-      // unpack
-      // (input_channel) *
-      // (input_width * input_height)
-      // to
-      // (input_channel * filter_height * filter_width)
-      // (output_width * output_height)
-      Unpack2DFunc(input->Slice(batch_input_offset),
-        input_channel, input_height, input_width,
-        filter_height, filter_width, output_height, output_width,
-        padding_height, padding_width, stride_height, stride_width,
-        (*unpack_batch)[tid]->data());
-      #ifdef BLITZ_PERFORMANCE
-      end = system_clock::now();
-      #pragma omp critical
-      unpack_time += end - start;
-      #endif  // BLITZ_PERFORMANCE
-
-      #ifdef BLITZ_PERFORMANCE
-      start = system_clock::now();
-      #endif  // BLITZ_PERFORMANCE
-      // gemm generate
-      // (output_channel) *
-      // (input_channel * filter_height * filter_width)
-      BlitzCPUGemm(false, true, dim_left, dim_right, dim_common,
-        const_cast<CPUTensor<DType>*>(output)->Slice(batch_output_offset),
-        (*unpack_batch)[tid]->data(), (*update_batch)[tid]->data(),
-        static_cast<DType>(1), static_cast<DType>(1));
-      #ifdef BLITZ_PERFORMANCE
-      end = system_clock::now();
-      #pragma omp critical
-      gemm_time += end - start;
-      #endif  // BLITZ_PERFORMANCE
-    }
-
-    for (size_t i = 0; i < update->size(); ++i) {
-      #pragma omp atomic
-      (*update)[i] += (*(*update_batch)[tid])[i];
-    }
-
+    // (samples) * (output_channel) * (output_height * output_width)
+    // to
+    // (output_channel) * (samples * output_height * output_width)
+    CPUConvChunkCopyKernel<DType> copy_kernel(
+      const_cast<CPUTensor<DType>*>(output)->Slice(
+        batch_begin * output_batch_offset), output_channel,
+      columns, samples, chunk->data(), true);
+    BlitzParallelFor(0, samples * output_channel, copy_kernel,
+      CPURowGrain(columns));
+    // unpack
+    // (samples) * (input_channel) *
+    // (input_width * input_height)
+    // to
+    // (input_channel * filter_height * filter_width)
+    // (samples * output_width * output_height)
+    CPUUnpack2DChunkKernel<DType> unpack_kernel(
+      input->Slice(batch_begin * input_batch_offset), input_channel,
+      input_height, input_width, filter_height, filter_width,
+      output_height, output_width, padding_height, padding_width,
+      stride_height, stride_width, samples, unpack->data());
+    BlitzParallelFor(0, samples * input_channel, unpack_kernel,
+      CPURowGrain(filter_height * filter_width * columns));
     #ifdef BLITZ_PERFORMANCE
-    if (tid == 0) {
-      average_unpack_time = unpack_time.count() /
-        omp_get_num_threads();
-      average_gemm_time = gemm_time.count() /
-        omp_get_num_threads();
-    }
+    end = system_clock::now();
+    unpack_time += end - start;
+    start = end;
+    #endif
+    // gemm generate
+    // (output_channel) *
+    // (input_channel * filter_height * filter_width)
+    BlitzCPUGemm(false, true, dim_left, dim_right, dim_common,
+      chunk->data(), unpack->data(), update->data(),
+      static_cast<DType>(1), static_cast<DType>(1));
+    #ifdef BLITZ_PERFORMANCE
+    end = system_clock::now();
+    gemm_time += end - start;
     #endif
   }
+
   #ifdef BLITZ_PERFORMANCE
-  LOG(INFO) << "Backward convolution weight average gemm: " <<
-    average_gemm_time;
-  LOG(INFO) << "Backward convolution weight average unpack: " <<
-    average_unpack_time;
+  LOG(INFO) << "Backward convolution weight chunk gemm: " <<
+    gemm_time.count();
+  LOG(INFO) << "Backward convolution weight chunk unpack: " <<
+    unpack_time.count();
   #endif  // BLITZ_PERFORMANCE
 }
 
 // naive parallel
+// one (image, output channel) plane per item, no unpack buffer
+template<typename DType>
+class CPUConvForwardDirectKernel {
+ public:
+  CPUConvForwardDirectKernel(const CPUTensor<DType>* input,
+    const CPUTensor<DType>* weight,
+    const int padding_height, const int padding_width,
+    const int stride_height, const int stride_width,
+    CPUTensor<DType>* output) :
+    input_(input), weight_(weight),
+    padding_height_(padding_height), padding_width_(padding_width),
+    stride_height_(stride_height), stride_width_(stride_width),
+    output_(output) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    // shape decode
+    const Shape& input_shape = input_->shape();
+    const int input_channel = input_shape[1];
+    const int input_height = input_shape[2];
+    const int input_width = input_shape[3];
+    const Shape& filter_shape = weight_->shape();
+    const int filter_height = filter_shape[2];
+    const int filter_width = filter_shape[3];
+    const Shape& output_shape = output_->shape();
+    const int output_channel = output_shape[1];
+    const int output_height = output_shape[2];
+    const int output_width = output_shape[3];
+
+    const int input_plane = input_height * input_width;
+    const int output_plane = output_height * output_width;
+    const int filter_plane = filter_height * filter_width;
+
+    for (size_t i = begin; i < end; ++i) {
+      const int batch_index = i / output_channel;
+      const int channel_index = i % output_channel;
+      DType* output = output_->Slice(i * output_plane);
+      for (int j = 0; j < output_plane; ++j) {
+        output[j] = 0;
+      }
+      for (int ic = 0; ic < input_channel; ++ic) {
+        const DType* input = input_->Slice(
+          (batch_index * input_channel + ic) * input_plane);
+        const DType* filter = weight_->Slice(
+          (channel_index * input_channel + ic) * filter_plane);
+        for (int fh = 0; fh < filter_height; ++fh) {
+          for (int fw = 0; fw < filter_width; ++fw) {
+            const DType w = filter[fh * filter_width + fw];
+            // output columns whose input column falls inside the image
+            const int offset_w = fw - padding_width_;
+            int ox_begin = 0;
+            if (offset_w < 0) {
+              ox_begin = (-offset_w + stride_width_ - 1) / stride_width_;
+            }
+            int ox_end = output_width;
+            if (input_width - offset_w <= 0) {
+              ox_end = 0;
+            } else if ((input_width - 1 - offset_w) / stride_width_ + 1 <
+              output_width) {
+              ox_end = (input_width - 1 - offset_w) / stride_width_ + 1;
+            }
+            for (int oy = 0; oy < output_height; ++oy) {
+              const int iy = oy * stride_height_ + fh - padding_height_;
+              if (iy < 0 || iy >= input_height) {
+                continue;
+              }
+              const DType* input_row = input + iy * input_width + offset_w;
+              DType* output_row = output + oy * output_width;
+              for (int ox = ox_begin; ox < ox_end; ++ox) {
+                output_row[ox] += w * input_row[ox * stride_width_];
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+ private:
+  const CPUTensor<DType>* input_;
+  const CPUTensor<DType>* weight_;
+  const int padding_height_;
+  const int padding_width_;
+  const int stride_height_;
+  const int stride_width_;
+  CPUTensor<DType>* output_;
+};
+
 template<typename DType>
 void Backend<CPUTensor, DType>::Convolution2DForwardFunc(
   const CPUTensor<DType>* input, const CPUTensor<DType>* weight,
+  const int padding_height, const int padding_width,
   const int stride_height, const int stride_width,
   CPUTensor<DType>* output) {
+  const Shape& output_shape = output->shape();
+  CPUConvForwardDirectKernel<DType> kernel(input, weight,
+    padding_height, padding_width, stride_height, stride_width, output);
+  BlitzParallelFor(0, output_shape[0] * output_shape[1], kernel);
 }
 
 #endif  // SRC_BACKEND_CPU_BACKEND_CONV_INL_H_
@@ -1,58 +1,148 @@
 #ifndef SRC_BACKEND_CPU_BACKEND_PACK_INL_H_
 #define SRC_BACKEND_CPU_BACKEND_PACK_INL_H_
 
+// [begin, end) in (channel * filter_height) rows of the unpack buffer
 template<typename DType>
-void Backend<CPUTensor, DType>::Unpack2DParallelFunc(
-  const DType* input, const int channel,
-  const int input_height, const int input_width,
-  const int filter_height, const int filter_width,
-  const int output_height, const int output_width,
-  const int padding_height, const int padding_width,
-  const int stride_height, const int stride_width,
-  DType* unpack) {
-  // (input_channel * filter_height * filter_width) *
-  // (output_width * output_height)
-  int unpack_index;
-  int channel_offset;
-  const int filter_channel_offset = filter_height * filter_width;
-  const int output_channel_offset = output_height * output_width;
-  const int input_channel_offset = input_height * input_width;
-  #pragma omp parallel for collapse(2) private(channel_offset, unpack_index)
-  for (int channel_index = 0; channel_index < channel; ++channel_index) {
-    for (int filter_height_index = 0; filter_height_index < filter_height;
-        ++filter_height_index) {
-      channel_offset = channel_index * input_channel_offset;
-      unpack_index = (channel_index * filter_channel_offset +
-        filter_height_index * filter_width) * output_channel_offset;
-      const DType* input_slice = input + channel_offset;
-      for (int filter_width_index = 0; filter_width_index < filter_width;
+class CPUUnpack2DKernel {
+ public:
+  CPUUnpack2DKernel(const DType* input, const int channel,
+    const int input_height, const int input_width,
+    const int filter_height, const int filter_width,
+    const int output_height, const int output_width,
+    const int padding_height, const int padding_width,
+    const int stride_height, const int stride_width,
+    DType* unpack) :
+    input_(input), channel_(channel),
+    input_height_(input_height), input_width_(input_width),
+    filter_height_(filter_height), filter_width_(filter_width),
+    output_height_(output_height), output_width_(output_width),
+    padding_height_(padding_height), padding_width_(padding_width),
+    stride_height_(stride_height), stride_width_(stride_width),
+    unpack_(unpack) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    const int filter_channel_offset = filter_height_ * filter_width_;
+    const int output_channel_offset = output_height_ * output_width_;
+    const int input_channel_offset = input_height_ * input_width_;
+    for (size_t row = begin; row < end; ++row) {
+      const int channel_index = row / filter_height_;
+      const int filter_height_index = row % filter_height_;
+      const DType* input_slice = input_ + channel_index * input_channel_offset;
+      int unpack_index = (channel_index * filter_channel_offset +
+        filter_height_index * filter_width_) * output_channel_offset;
+      for (int filter_width_index = 0; filter_width_index < filter_width_;
           ++filter_width_index) {
-        int filter_height_offset = -padding_height + filter_height_index;
-        for (int output_height_index = 0; output_height_index < output_height;
+        int filter_height_offset = -padding_height_ + filter_height_index;
+        for (int output_height_index = 0; output_height_index < output_height_;
             ++output_height_index) {
-          if (filter_height_offset < 0 || filter_height_offset >= input_height) {
-            for (int output_width_index = 0; output_width_index < output_width;
+          if (filter_height_offset < 0 ||
+            filter_height_offset >= input_height_) {
+            for (int output_width_index = 0; output_width_index < output_width_;
                 ++output_width_index) {
-              unpack[unpack_index++] = 0;
+              unpack_[unpack_index++] = 0;
             }
           } else {
-            int filter_width_offset = -padding_width + filter_width_index;
-            for (int output_width_index = 0; output_width_index < output_width;
+            int filter_width_offset = -padding_width_ + filter_width_index;
+            for (int output_width_index = 0; output_width_index < output_width_;
                 ++output_width_index) {
-              if (filter_width_offset < 0 || filter_width_offset >= input_width) {
-                unpack[unpack_index++] = 0;
+              if (filter_width_offset < 0 ||
+                filter_width_offset >= input_width_) {
+                unpack_[unpack_index++] = 0;
               } else {
-                unpack[unpack_index++] = input_slice[filter_height_offset * input_width +
-                  filter_width_offset];
+                unpack_[unpack_index++] = input_slice[filter_height_offset *
+                  input_width_ + filter_width_offset];
               }
-              filter_width_offset += stride_width;
+              filter_width_offset += stride_width_;
             }
           }
-          filter_height_offset += stride_height;
+          filter_height_offset += stride_height_;
         }
       }
     }
   }
+
+ private:
+  const DType* input_;
+  const int channel_;
+  const int input_height_;
+  const int input_width_;
+  const int filter_height_;
+  const int filter_width_;
+  const int output_height_;
+  const int output_width_;
+  const int padding_height_;
+  const int padding_width_;
+  const int stride_height_;
+  const int stride_width_;
+  DType* unpack_;
+};
+
+// [begin, end) in channels, every channel owns a disjoint input slice
+template<typename DType>
+class CPUPack2DKernel {
+ public:
+  CPUPack2DKernel(const DType* pack, const int channel,
+    const int input_height, const int input_width,
+    const int filter_height, const int filter_width,
+    const int output_height, const int output_width,
+    const int padding_height, const int padding_width,
+    const int stride_height, const int stride_width,
+    DType* input) :
+    pack_(pack), channel_(channel),
+    input_height_(input_height), input_width_(input_width),
+    filter_height_(filter_height), filter_width_(filter_width),
+    output_height_(output_height), output_width_(output_width),
+    padding_height_(padding_height), padding_width_(padding_width),
+    stride_height_(stride_height), stride_width_(stride_width),
+    input_(input) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    const int pack_channel_offset = filter_height_ * filter_width_ *
+      output_height_ * output_width_;
+    const int input_channel_offset = input_height_ * input_width_;
+    for (size_t channel_index = begin; channel_index < end; ++channel_index) {
+      Backend<CPUTensor, DType>::Pack2DFunc(
+        pack_ + channel_index * pack_channel_offset, 1,
+        input_height_, input_width_, filter_height_, filter_width_,
+        output_height_, output_width_, padding_height_, padding_width_,
+        stride_height_, stride_width_,
+        input_ + channel_index * input_channel_offset);
+    }
+  }
+
+ private:
+  const DType* pack_;
+  const int channel_;
+  const int input_height_;
+  const int input_width_;
+  const int filter_height_;
+  const int filter_width_;
+  const int output_height_;
+  const int output_width_;
+  const int padding_height_;
+  const int padding_width_;
+  const int stride_height_;
+  const int stride_width_;
+  DType* input_;
+};
+
+template<typename DType>
+void Backend<CPUTensor, DType>::Unpack2DParallelFunc(
+  const DType* input, const int channel,
+  const int input_height, const int input_width,
+  const int filter_height, const int filter_width,
+  const int output_height, const int output_width,
+  const int padding_height, const int padding_width,
+  const int stride_height, const int stride_width,
+  DType* unpack) {
+  // (input_channel * filter_height * filter_width) *
+  // (output_width * output_height)
+  CPUUnpack2DKernel<DType> kernel(input, channel,
+    input_height, input_width, filter_height, filter_width,
+    output_height, output_width, padding_height, padding_width,
+    stride_height, stride_width, unpack);
+  BlitzParallelFor(0, channel * filter_height, kernel,
+    CPURowGrain(filter_width * output_height * output_width));
 }
 
 template<typename DType>
@@ -64,47 +154,14 @@ void Backend<CPUTensor, DType>::Pack2DParallelFunc(
   const int padding_height, const int padding_width,
   const int stride_height, const int stride_width,
   DType* input) {
-  // memset
   // (input_channel * filter_height * filter_width) *
   // (output_width * output_height)
-  int pack_index;
-  int channel_offset;
-  const int filter_channel_offset = filter_height * filter_width;
-  const int output_channel_offset = output_height * output_width;
-  const int input_channel_offset = input_height * input_width;
-  #pragma omp parallel for collapse(2) private(channel_offset, pack_index)
-  for (int channel_index = 0; channel_index < channel; ++channel_index) {
-    for (int filter_height_index = 0; filter_height_index < filter_height;
-        ++filter_height_index) {
-      channel_offset = channel_index * input_channel_offset;
-      pack_index = (channel_index * filter_channel_offset +
-        filter_height_index * filter_width) * output_channel_offset;
-      DType* input_slice = input + channel_offset;
-      for (int filter_width_index = 0; filter_width_index < filter_width;
-          ++filter_width_index) {
-        int filter_height_offset = -padding_height + filter_height_index;
-        for (int output_height_index = 0; output_height_index < output_height;
-            ++output_height_index) {
-          if (filter_height_offset < 0 || filter_height_offset >= input_height) {
-            pack_index += output_width;
-          } else {
-            int filter_width_offset = -padding_width + filter_width_index;
-            for (int output_width_index = 0; output_width_index < output_width;
-                ++output_width_index) {
-              if (filter_width_offset >= 0 && filter_width_offset < input_width) {
-                #pragma omp atomic
-                input_slice[filter_height_offset * input_width +
-                  filter_width_offset] += pack[pack_index];
-              }
-              pack_index++;
-              filter_width_offset += stride_width;
-            }
-          }
-          filter_height_offset += stride_height;
-        }
-      }
-    }
-  }
+  CPUPack2DKernel<DType> kernel(pack, channel,
+    input_height, input_width, filter_height, filter_width,
+    output_height, output_width, padding_height, padding_width,
+    stride_height, stride_width, input);
+  BlitzParallelFor(0, channel, kernel, CPURowGrain(filter_height *
+    filter_width * output_height * output_width));
 }
 
 template<typename DType>
@@ -1,6 +1,102 @@
 #ifndef SRC_BACKEND_CPU_BACKEND_POOL_INL_H_
 #define SRC_BACKEND_CPU_BACKEND_POOL_INL_H_
 
+// [begin, end) in (batch * channel) planes
+template<typename DType>
+class CPUMaxPooling2DForwardKernel {
+ public:
+  CPUMaxPooling2DForwardKernel(const DType* input,
+    const int input_height, const int input_width,
+    const int filter_height, const int filter_width,
+    const int stride_height, const int stride_width,
+    const int output_height, const int output_width,
+    int* max_index, DType* output) :
+    input_(input), input_height_(input_height), input_width_(input_width),
+    filter_height_(filter_height), filter_width_(filter_width),
+    stride_height_(stride_height), stride_width_(stride_width),
+    output_height_(output_height), output_width_(output_width),
+    max_index_(max_index), output_(output) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    const int input_channel_offset = input_height_ * input_width_;
+    const int output_channel_offset = output_height_ * output_width_;
+    for (size_t plane = begin; plane < end; ++plane) {
+      const DType* input_slice = input_ + plane * input_channel_offset;
+      DType* output_slice = output_ + plane * output_channel_offset;
+      int* max_index_slice = max_index_ + plane * output_channel_offset;
+      for (int output_height_index = 0; output_height_index < output_height_;
+        ++output_height_index) {
+        for (int output_width_index = 0; output_width_index < output_width_;
+          ++output_width_index) {
+          const int height_start = output_height_index * stride_height_;
+          const int width_start = output_width_index * stride_width_;
+          const int height_end = height_start + filter_height_;
+          const int width_end = width_start + filter_width_;
+          const int pool_index = output_height_index * output_width_ +
+            output_width_index;
+          for (int h = height_start; h < height_end; ++h) {
+            for (int w = width_start; w < width_end; ++w) {
+              const int index = h * input_width_ + w;
+              if (input_slice[index] > output_slice[pool_index]) {
+                output_slice[pool_index] = input_slice[index];
+                max_index_slice[pool_index] = index;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+ private:
+  const DType* input_;
+  const int input_height_;
+  const int input_width_;
+  const int filter_height_;
+  const int filter_width_;
+  const int stride_height_;
+  const int stride_width_;
+  const int output_height_;
+  const int output_width_;
+  int* max_index_;
+  DType* output_;
+};
+
+// [begin, end) in (batch * channel) planes
+template<typename DType>
+class CPUMaxPooling2DBackwardKernel {
+ public:
+  CPUMaxPooling2DBackwardKernel(const DType* output, const int* max_index,
+    const int input_height, const int input_width,
+    const int output_height, const int output_width,
+    DType* input) :
+    output_(output), max_index_(max_index),
+    input_height_(input_height), input_width_(input_width),
+    output_height_(output_height), output_width_(output_width),
+    input_(input) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    const int input_channel_offset = input_height_ * input_width_;
+    const int output_channel_offset = output_height_ * output_width_;
+    for (size_t plane = begin; plane < end; ++plane) {
+      DType* input_slice = input_ + plane * input_channel_offset;
+      const DType* output_slice = output_ + plane * output_channel_offset;
+      const int* max_index_slice = max_index_ + plane * output_channel_offset;
+      for (int index = 0; index < output_channel_offset; ++index) {
+        input_slice[max_index_slice[index]] = output_slice[index];
+      }
+    }
+  }
+
+ private:
+  const DType* output_;
+  const int* max_index_;
+  const int input_height_;
+  const int input_width_;
+  const int output_height_;
+  const int output_width_;
+  DType* input_;
+};
 
 template<typename DType>
 void Backend<CPUTensor, DType>::MaxPooling2DForwardFunc(
@@ -23,54 +119,15 @@ void Backend<CPUTensor, DType>::MaxPooling2DForwardFunc(
 
   CHECK_EQ(input_channel, output_channel);
 
-  const int input_single_offset = input_channel * input_height * input_width;
-  const int input_channel_offset = input_height * input_width;
-  const int output_single_offset = output_channel * output_height * output_width;
-  const int output_channel_offset = output_height * output_width;
-  int channel_input_offset;
-  int channel_output_offset;
-  int batch_input_offset;
-  int batch_output_offset;
-  output->Fill(std::numeric_limits<DType>::min());
+  output->Fill(-std::numeric_limits<DType>::max());
 
   // no padding
-  #pragma omp parallel for private(batch_input_offset, batch_output_offset,\
-    channel_input_offset, channel_output_offset)
-  for (int batch_index = 0; batch_index < batch_size; ++batch_index) {
-    batch_input_offset = batch_index * input_single_offset;
-    batch_output_offset = batch_index * output_single_offset;
-    for (int channel_index = 0; channel_index < input_channel; ++channel_index) {
-      channel_input_offset = channel_index * input_channel_offset;
-      channel_output_offset = channel_index * output_channel_offset;
-      const DType* input_slice = input->Slice(batch_input_offset +
-        channel_input_offset);
-      DType* output_slice = output->Slice(batch_output_offset +
-        channel_output_offset);
-      int* max_index_slice = max_index->Slice(batch_output_offset +
-        channel_output_offset);
-      for (int output_height_index = 0; output_height_index < output_height;
-        ++output_height_index) {
-        for (int output_width_index = 0; output_width_index < output_width;
-          ++output_width_index) {
-          const int height_start = output_height_index * stride_height;
-          const int width_start = output_width_index * stride_width;
-          const int height_end = height_start + filter_height;
-          const int width_end = width_start + filter_width;
-          const int pool_index = output_height_index * output_width +
-            output_width_index;
-          for (int h = height_start; h < height_end; ++h) {
-            for (int w = width_start; w < width_end; ++w) {
-              const int index = h * input_width + w;
-              if (input_slice[index] > output_slice[pool_index]) {
-                output_slice[pool_index] = input_slice[index];
-                max_index_slice[pool_index] = index;
-              }
-            }
-          }
-        }
-      }
-    }
-  }
+  CPUMaxPooling2DForwardKernel<DType> kernel(input->data(),
+    input_height, input_width, filter_height, filter_width,
+    stride_height, stride_width, output_height, output_width,
+    max_index->data(), output->data());
+  BlitzParallelFor(0, batch_size * input_channel, kernel,
+    CPURowGrain(input_height * input_width));
 }
 
 template<typename DType>
@@ -91,42 +148,14 @@ void Backend<CPUTensor, DType>::MaxPooling2DBackwardFunc(
   int output_height = output_shape[2];
   int output_width = output_shape[3];
 
-  const int input_single_offset = channel * input_height * input_width;
-  const int input_channel_offset = input_height * input_width;
-  const int output_single_offset = channel * output_height * output_width;
-  const int output_channel_offset = output_height * output_width;
-  int batch_input_offset;
-  int batch_output_offset;
-  int channel_input_offset;
-  int channel_output_offset;
   // set zero
   input->Fill(0);
   // no padding
-  #pragma omp parallel for private(batch_input_offset, batch_output_offset,\
-    channel_input_offset, channel_output_offset)
-  for (int batch_index = 0; batch_index < batch_size; ++batch_index) {
-    batch_input_offset = batch_index * input_single_offset;
-    batch_output_offset = batch_index * output_single_offset;
-    for (int channel_index = 0; channel_index < channel; ++channel_index) {
-      channel_input_offset = channel_index * input_channel_offset;
-      channel_output_offset = channel_index * output_channel_offset;
-      DType* input_slice = input->Slice(batch_input_offset +
-        channel_input_offset);
-      const DType* output_slice = output->Slice(batch_output_offset +
-        channel_output_offset);
-      const int* max_index_slice = max_index->Slice(batch_output_offset +
-        channel_output_offset);
-      for (int output_height_index = 0; output_height_index < output_height;
-        ++output_height_index) {
-        for (int output_width_index = 0; output_width_index < output_width;
-          ++output_width_index) {
-          const int index = output_height_index * output_width +
-            output_width_index;
-          input_slice[max_index_slice[index]] = output_slice[index];
-        }
-      }
-    }
-  }
+  CPUMaxPooling2DBackwardKernel<DType> kernel(output->data(),
+    max_index->data(), input_height, input_width,
+    output_height, output_width, input->data());
+  BlitzParallelFor(0, batch_size * channel, kernel,
+    CPURowGrain(output_height * output_width));
 }
 
 #endif  // SRC_BACKEND_CPU_BACKEND_POOL_INL_H_
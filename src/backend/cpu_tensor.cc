@@ -1,10 +1,39 @@
 #include "backend/cpu_tensor.h"
 
+#include <algorithm>
+
+#include "util/blitz_thread_pool.h"
+
 namespace blitz {
 
+template<typename DType>
+class CPUFillKernel {
+ public:
+  CPUFillKernel(DType* data, DType value) : data_(data), value_(value) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    std::fill(data_ + begin, data_ + end, value_);
+  }
+
+ private:
+  DType* data_;
+  const DType value_;
+};
+
 template<typename DType>
 CPUTensor<DType>::~CPUTensor() {
-  free(this->data_);
+  if (this->own_data_) {
+    free(this->data_);
+  }
+}
+
+template<typename DType>
+void CPUTensor<DType>::View(DType* data) {
+  if (this->own_data_) {
+    free(this->data_);
+  }
+  this->data_ = data;
+  this->own_data_ = false;
 }
 
 template<typename DType>
@@ -13,17 +42,11 @@ inline void CPUTensor<DType>::Fill(DType value) {
   if (value == 0) {
     memset(this->data_, 0, sizeof(DType) * size);
   } else {
-    #pragma omp parallel for
-    for (size_t i = 0; i < size; ++i) {
-      *(this->data_ + i) = value;
-    }
+    CPUFillKernel<DType> kernel(this->data_, value);
+    BlitzParallelFor(0, size, kernel, 8192);
   }
 }
 
-template<typename DType>
-inline void CPUTensor<DType>::Reshape() {
-}
-
 template<typename DType>
 inline DType* CPUTensor<DType>::Slice(size_t index) {
 #ifdef BLITZ_DEVELOP
@@ -12,13 +12,16 @@ class CPUTensor : public Tensor<DType> {
     this->Allocate();
   }
 
-  explicit CPUTensor(DType* data, const Shape& shape) :
-    Tensor<DType>(data, shape) {}
+  explicit CPUTensor(DType* data, const Shape& shape,
+    const bool own_data = true) :
+    Tensor<DType>(data, shape, own_data) {}
 
   ~CPUTensor();
 
+  // drops the data, the tensor becomes a view of data that outlives it
+  void View(DType* data);
+
   virtual void Fill(DType value);
-  virtual void Reshape();
   virtual DType* Slice(size_t index);
   virtual const DType* Slice(size_t index) const;
   virtual void OutputCSV(ofstream& ofs) const;
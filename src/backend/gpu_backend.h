@@ -68,6 +68,14 @@ class Backend<GPUTensor, DType> {
     const GPUTensor<DType>* input, const GPUTensor<DType>* target,
     GPUTensor<DType>* output);
 
+  // target holds one class index per sample
+  static DType CrossEntropyMultiSparseApplyFunc(
+    const GPUTensor<DType>* input, const GPUTensor<DType>* target);
+
+  static void CrossEntropyMultiSparseDerivativeFunc(
+    const GPUTensor<DType>* input, const GPUTensor<DType>* target,
+    GPUTensor<DType>* output);
+
   static void BiasForwardFunc(
     const GPUTensor<DType>* input, const GPUTensor<DType>* bias,
     GPUTensor<DType>* output);
@@ -89,6 +97,17 @@ class Backend<GPUTensor, DType> {
     GPUTensor<DType>* gamma_update, GPUTensor<DType>* beta_update,
     GPUTensor<DType>* output);
 
+  // output[i, j] = weight[input[i, j]], ids index rows of weight
+  static void EmbeddingForwardFunc(
+    const GPUTensor<DType>* input, const GPUTensor<DType>* weight,
+    GPUTensor<DType>* output);
+
+  // update[id] = sum of the backward_input rows of id, for the sorted
+  // distinct ids of input in rows; other rows of update are left as they are
+  static void EmbeddingBackwardUpdateFunc(
+    const GPUTensor<DType>* input, const GPUTensor<DType>* backward_input,
+    GPUTensor<DType>* update, vector<int>* rows);
+
   static void GradientdescentFunc(
     const DType momentum_coef, const DType learning_rate,
     const DType decay, const int batch_size,
@@ -96,12 +115,34 @@ class Backend<GPUTensor, DType> {
     GPUTensor<DType>* gradient,
     GPUTensor<DType>* velocity);
 
+  // GradientdescentFunc on rows of weight only, velocity of other rows
+  // is not decayed (lazy momentum)
+  static void SparseGradientdescentFunc(
+    const int* rows, const size_t num_rows,
+    const DType momentum_coef, const DType learning_rate,
+    const DType decay, const int batch_size,
+    GPUTensor<DType>* weight,
+    GPUTensor<DType>* gradient,
+    GPUTensor<DType>* velocity);
+
   static void MatrixDotFunc(
     const GPUTensor<DType>* left, const GPUTensor<DType>* right,
     const bool transa, const bool transb,
     const DType alpha, const DType beta,
     GPUTensor<DType>* output, const string& kernel = "blas");
 
+  // output = left * right, left in compressed sparse rows
+  static void SparseMatrixDotFunc(
+    const size_t* row_offset, const int* column, const DType* value,
+    const GPUTensor<DType>* right, GPUTensor<DType>* output);
+
+  // output += left^T * right, only rows of output that left touches
+  // output rows of the columns of the batch, listed ascending in rows,
+  // are cleared and written, the other rows are left as they are
+  static void SparseMatrixTransposeDotFunc(
+    const size_t* row_offset, const int* column, const DType* value,
+    const GPUTensor<DType>* right, GPUTensor<DType>* output, vector<int>* rows);
+
   static void MaximumFunc(
     const GPUTensor<DType>* left, const GPUTensor<DType>* right,
     GPUTensor<DType>* output);
@@ -179,9 +220,23 @@ class Backend<GPUTensor, DType> {
     vector<shared_ptr<GPUTensor<DType> > >* update_batch,
     GPUTensor<DType>* update);
 
+  // chunk parallel, several samples side by side in one gemm
+  static void Convolution2DForwardFunc(
+    const GPUTensor<DType>* input, const GPUTensor<DType>* weight,
+    const int padding_height, const int padding_width,
+    const int stride_height, const int stride_width,
+    GPUTensor<DType>* unpack, GPUTensor<DType>* chunk, GPUTensor<DType>* output);
+
+  static void Convolution2DUpdateFunc(
+    const GPUTensor<DType>* input, const GPUTensor<DType>* output,
+    const int padding_height, const int padding_width,
+    const int stride_height, const int stride_width,
+    GPUTensor<DType>* unpack, GPUTensor<DType>* chunk, GPUTensor<DType>* update);
+
   // naive parallel
   static void Convolution2DForwardFunc(
     const GPUTensor<DType>* input, const GPUTensor<DType>* weight,
+    const int padding_height, const int padding_width,
     const int stride_height, const int stride_width,
     GPUTensor<DType>* output);
 
@@ -214,9 +269,15 @@ class Backend<GPUTensor, DType> {
   static void HostCopyToFunc(const DType* source, const size_t size,
     DType* target);
 
+  static void HostCopyFromFunc(const DType* source, const size_t size,
+    DType* target);
+
   static float EvaluateClassifyFunc(
     const GPUTensor<DType>* output, const GPUTensor<DType>* target);
 
+  static float EvaluateClassifySparseFunc(
+    const GPUTensor<DType>* output, const GPUTensor<DType>* target);
+
   static float EvaluateRegressFunc(
     const GPUTensor<DType>* output, const GPUTensor<DType>* target);
 
@@ -155,6 +155,18 @@ void Backend<GPUTensor, DType>::CrossEntropyMultiDerivativeFunc(
   GPUTensor<DType>* output) {
 }
 
+template<typename DType>
+DType Backend<GPUTensor, DType>::CrossEntropyMultiSparseApplyFunc(
+  const GPUTensor<DType>* input, const GPUTensor<DType>* target) {
+  return 0;
+}
+
+template<typename DType>
+void Backend<GPUTensor, DType>::CrossEntropyMultiSparseDerivativeFunc(
+  const GPUTensor<DType>* input, const GPUTensor<DType>* target,
+  GPUTensor<DType>* output) {
+}
+
 template<typename DType>
 void Backend<GPUTensor, DType>::BiasForwardFunc(
   const GPUTensor<DType>* input, const GPUTensor<DType>* bias,
@@ -241,6 +253,42 @@ void Backend<GPUTensor, DType>::MatrixDotFunc(
   }
 }
 
+template<typename DType>
+void Backend<GPUTensor, DType>::EmbeddingForwardFunc(
+  const GPUTensor<DType>* input, const GPUTensor<DType>* weight,
+  GPUTensor<DType>* output) {
+  LOG(FATAL) << "Embedding on CPU only";
+}
+
+template<typename DType>
+void Backend<GPUTensor, DType>::EmbeddingBackwardUpdateFunc(
+  const GPUTensor<DType>* input, const GPUTensor<DType>* backward_input,
+  GPUTensor<DType>* update, vector<int>* rows) {
+}
+
+template<typename DType>
+void Backend<GPUTensor, DType>::SparseGradientdescentFunc(
+  const int* rows, const size_t num_rows,
+  const DType momentum_coef, const DType learning_rate,
+  const DType decay, const int batch_size,
+  GPUTensor<DType>* weight,
+  GPUTensor<DType>* gradient,
+  GPUTensor<DType>* velocity) {
+}
+
+template<typename DType>
+void Backend<GPUTensor, DType>::SparseMatrixDotFunc(
+  const size_t* row_offset, const int* column, const DType* value,
+  const GPUTensor<DType>* right, GPUTensor<DType>* output) {
+}
+
+template<typename DType>
+void Backend<GPUTensor, DType>::SparseMatrixTransposeDotFunc(
+  const size_t* row_offset, const int* column, const DType* value,
+  const GPUTensor<DType>* right, GPUTensor<DType>* output,
+  vector<int>* rows) {
+}
+
 template<typename DType>
 void Backend<GPUTensor, DType>::MaximumFunc(
   const GPUTensor<DType>* left, const GPUTensor<DType>* right,
@@ -346,6 +394,12 @@ void Backend<GPUTensor, DType>::HostCopyToFunc(
   cudaMemcpy(target, source, size * sizeof(DType), cudaMemcpyHostToDevice);
 }
 
+template<typename DType>
+void Backend<GPUTensor, DType>::HostCopyFromFunc(
+  const DType* source, const size_t size, DType* target) {
+  cudaMemcpy(target, source, size * sizeof(DType), cudaMemcpyDeviceToHost);
+}
+
 template<typename DType>
 __global__ void GPUEvaluate(const DType* output, const DType* target,
   const int dim, const int size, DType* correct) {
@@ -387,4 +441,10 @@ float Backend<GPUTensor, DType>::EvaluateClassifyFunc(
   return thrust::reduce(rptr, rptr + correct.size()) / batch_size;
 }
 
+template<typename DType>
+float Backend<GPUTensor, DType>::EvaluateClassifySparseFunc(
+  const GPUTensor<DType>* output, const GPUTensor<DType>* target) {
+  return 0;
+}
+
 #endif  // SRC_BACKEND_GPU_BACKEND_COMMON_INL_H_
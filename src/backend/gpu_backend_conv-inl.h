@@ -287,10 +287,28 @@ void Backend<GPUTensor, DType>::Convolution2DUpdateFunc(
   vector<shared_ptr<GPUTensor<DType> > >* update_batch,
   GPUTensor<DType>* update) {}
 
+// chunk parallel
+template<typename DType>
+void Backend<GPUTensor, DType>::Convolution2DForwardFunc(
+  const GPUTensor<DType>* input, const GPUTensor<DType>* weight,
+  const int padding_height, const int padding_width,
+  const int stride_height, const int stride_width,
+  GPUTensor<DType>* unpack, GPUTensor<DType>* chunk,
+  GPUTensor<DType>* output) {}
+
+template<typename DType>
+void Backend<GPUTensor, DType>::Convolution2DUpdateFunc(
+  const GPUTensor<DType>* input, const GPUTensor<DType>* output,
+  const int padding_height, const int padding_width,
+  const int stride_height, const int stride_width,
+  GPUTensor<DType>* unpack, GPUTensor<DType>* chunk,
+  GPUTensor<DType>* update) {}
+
 // naive parallel
 template<typename DType>
 void Backend<GPUTensor, DType>::Convolution2DForwardFunc(
   const GPUTensor<DType>* input, const GPUTensor<DType>* weight,
+  const int padding_height, const int padding_width,
   const int stride_height, const int stride_width,
   GPUTensor<DType>* output) {}
 
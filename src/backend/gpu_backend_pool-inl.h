@@ -57,7 +57,7 @@ void Backend<GPUTensor, DType>::MaxPooling2DForwardFunc(
 
   CHECK_EQ(channel, output_channel);
 
-  output->Fill(std::numeric_limits<DType>::min());
+  output->Fill(-std::numeric_limits<DType>::max());
 
   GPUMaxPoolingForward<DType><<<BlitzGPUGetBlocks(output->size()),
     BLITZ_NUM_GPU_THREADS>>>(input->data(), output->size(),
@@ -9,7 +9,9 @@ namespace blitz {
 
 template<typename DType>
 GPUTensor<DType>::~GPUTensor() {
-  cudaFree(this->data_);
+  if (this->own_data_) {
+    cudaFree(this->data_);
+  }
 }
 
 template<typename DType>
@@ -24,10 +26,6 @@ inline void GPUTensor<DType>::Fill(DType value) {
   }
 }
 
-template<typename DType>
-inline void GPUTensor<DType>::Reshape() {
-}
-
 template<typename DType>
 inline DType* GPUTensor<DType>::Slice(size_t index) {
   // TODO(keren) error
@@ -13,16 +13,15 @@ class GPUTensor : public Tensor<DType> {
     this->Allocate();
   }
 
-  explicit GPUTensor(DType* data, const Shape& shape) :
-    Tensor<DType>(data, shape) {
+  explicit GPUTensor(DType* data, const Shape& shape,
+    const bool own_data = true) :
+    Tensor<DType>(data, shape, own_data) {
   }
 
   ~GPUTensor();
 
   virtual void Fill(const DType value);
 
-  virtual void Reshape();
-
   virtual DType* Slice(const size_t index);
 
   virtual const DType* Slice(size_t index) const;
@@ -32,27 +32,35 @@ class Shape {
 
   size_t& operator[](size_t index) {
     // TODO(keren) index range check
+    size_ = 0;
     return shape_[index];
   }
 
+  // cached, assigning a shape or its dimensions resets it
   size_t size() const {
     if (size_ == 0) {
-      size_ = new size_t();
-
-      (*size_) = 1;
+      size_ = 1;
       for (size_t i = 0; i < dimension_; ++i) {
         if (shape_[i] != 0) {
-          (*size_) *= shape_[i];
+          size_ *= shape_[i];
         }
       }
     }
 
-    return *(size_);
+    return size_;
+  }
+
+  bool operator==(const Shape& other) const {
+    return shape_ == other.shape_;
+  }
+
+  bool operator!=(const Shape& other) const {
+    return shape_ != other.shape_;
   }
 
  private:
-  mutable size_t* size_;
-  const size_t dimension_;
+  mutable size_t size_;
+  size_t dimension_;
   std::vector<size_t> shape_;
 };
 
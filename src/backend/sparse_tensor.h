@@ -0,0 +1,92 @@
+#ifndef SRC_BACKEND_SPARSE_TENSOR_H_
+#define SRC_BACKEND_SPARSE_TENSOR_H_
+
+#include <vector>
+
+#include "util/common.h"
+#include "backend/shape.h"
+
+namespace blitz {
+
+// A batch in compressed sparse rows: row i holds value[j] at column[j]
+// for j in [row_offset[i], row_offset[i + 1]).
+// The shape is the dense [batch, ...] one, so that layers size themselves
+// as for dense input, but there is no dense data: only layers that check
+// for a sparse input (Affine) may receive one.
+// The rows stay in host memory.
+template<template <typename> class TensorType, typename DType>
+class SparseTensor : public TensorType<DType> {
+ public:
+  explicit SparseTensor(const Shape& shape) :
+    TensorType<DType>(NULL, shape, false), row_offset_(1, 0) {}
+
+  // appends a row of count entries
+  void AddRow(const int* column, const DType* value, const size_t count) {
+    column_.insert(column_.end(), column, column + count);
+    value_.insert(value_.end(), value, value + count);
+    row_offset_.push_back(column_.size());
+  }
+
+  // getters
+  size_t rows() const {
+    return row_offset_.size() - 1;
+  }
+
+  size_t nnz() const {
+    return column_.size();
+  }
+
+  const size_t* row_offset() const {
+    return &row_offset_[0];
+  }
+
+  const int* column() const {
+    return column_.empty() ? NULL : &column_[0];
+  }
+
+  const DType* value() const {
+    return value_.empty() ? NULL : &value_[0];
+  }
+
+ private:
+  vector<size_t> row_offset_;
+  vector<int> column_;
+  vector<DType> value_;
+};
+
+// A dense tensor of which only the rows listed are valid, the gradient
+// of an embedding table or of an Affine layer fed sparse rows: optimizers
+// update those rows of the weight and leave the others, momentum
+// included, as they are. While dense, every row is valid.
+template<template <typename> class TensorType, typename DType>
+class RowSparseTensor : public TensorType<DType> {
+ public:
+  explicit RowSparseTensor(const Shape& shape) :
+    TensorType<DType>(shape), dense_(false) {}
+
+  // getters
+  const vector<int>& rows() const {
+    return rows_;
+  }
+
+  vector<int>* mutable_rows() {
+    return &rows_;
+  }
+
+  bool dense() const {
+    return dense_;
+  }
+
+  // setters
+  void set_dense(const bool dense) {
+    dense_ = dense;
+  }
+
+ private:
+  vector<int> rows_;
+  bool dense_;
+};
+
+}  // namespace blitz
+
+#endif  // SRC_BACKEND_SPARSE_TENSOR_H_
@@ -11,10 +11,14 @@ template<typename DType = float>
 class Tensor {
  public:
   explicit Tensor(const Shape& shape) :
-    shape_(shape), row_major_(true) {}
+    shape_(shape), capacity_(shape.size()), row_major_(true),
+    own_data_(true) {}
 
-  explicit Tensor(DType* data, const Shape& shape) :
-    data_(data), shape_(shape), row_major_(true) {}
+  // a tensor that does not own data is a view, data outlives it
+  explicit Tensor(DType* data, const Shape& shape,
+    const bool own_data = true) :
+    data_(data), shape_(shape), capacity_(shape.size()), row_major_(true),
+    own_data_(own_data) {}
 
   virtual ~Tensor() {}
 
@@ -27,10 +31,26 @@ class Tensor {
     return this->shape_.size();
   }
 
+  // values of the shape the tensor was made with
+  size_t capacity() const {
+    return capacity_;
+  }
+
+  // the first shape.size() values of the data take the new shape,
+  // nothing is allocated or moved
+  void Reshape(const Shape& shape) {
+    CHECK_LE(shape.size(), capacity_) << "Reshape beyond capacity";
+    shape_ = shape;
+  }
+
   bool row_major() const {
     return row_major_;
   }
 
+  bool own_data() const {
+    return own_data_;
+  }
+
   // operator
   DType& operator[](size_t index) const {
 #ifdef BLITZ_DEVELOP
@@ -63,7 +83,6 @@ class Tensor {
   }
 
   virtual void Fill(const DType value) = 0;
-  virtual void Reshape() = 0;
   virtual DType* Slice(const size_t index) = 0;
   virtual const DType* Slice(const size_t index) const = 0;
   virtual void OutputCSV(ofstream& ofs) const = 0;
@@ -72,8 +91,10 @@ class Tensor {
   virtual void Allocate() = 0;
 
   DType* data_;
-  const Shape shape_;
+  Shape shape_;
+  const size_t capacity_;
   bool row_major_;
+  bool own_data_;
 };
 
 #define INSTANTIATE_TENSOR(tensor) \
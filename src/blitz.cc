@@ -5,17 +5,29 @@
 
 #include "initializer/initializer.h"
 #include "initializer/parser.h"
+#include "util/blitz_thread_pool.h"
 #include "util/common.h"
 
-void InitThreads() {
-#ifdef BLITZ_NUM_THREADS
-  omp_set_num_threads(BLITZ_NUM_THREADS);
-  LOG(INFO) << "Number of threads: " << BLITZ_NUM_THREADS;
-#else
-  omp_set_num_threads(1);
-  LOG(INFO) << "Number of threads: 1";
-#endif
-  // mkl_domain_set_num_threads(1, MKL_DOMAIN_BLAS);
+// command line, then BLITZ_NUM_THREADS, then the model, then all
+// cores in the affinity mask
+void InitThreads(int argc, char** argv, const blitz::Parser& parser) {
+  int num_threads = 0;
+  const char* env_threads = getenv("BLITZ_NUM_THREADS");
+  if (argc > 2) {
+    num_threads = atoi(argv[2]);
+  } else if (env_threads != NULL) {
+    num_threads = atoi(env_threads);
+  } else {
+    num_threads = parser.num_threads();
+  }
+  if (num_threads <= 0) {
+    num_threads = blitz::ThreadPool::DefaultNumThreads();
+  }
+  // kernels run on the pool, BLAS keeps the threads for calls
+  // made outside of a parallel section
+  blitz::ThreadPool::Init(num_threads);
+  omp_set_num_threads(num_threads);
+  LOG(INFO) << "Number of threads: " << num_threads;
 }
 
 void InitGlog(char** argv) {
@@ -26,11 +38,9 @@ void InitGlog(char** argv) {
 int main(int argc, char** argv) {
   // glog init
   InitGlog(argv);
-  // thread init
-  InitThreads();
 
-  if (argc != 2) {
-    LOG(INFO) << "blitz <model_path>";
+  if (argc != 2 && argc != 3) {
+    LOG(INFO) << "blitz <model_path> [num_threads]";
     LOG(FATAL) << "Check arguments, you must pass a model to blitz";
   }
 
@@ -42,6 +52,9 @@ int main(int argc, char** argv) {
   blitz::Parser parser(config);
   parser.SetDefaultArgs();
 
+  // thread init
+  InitThreads(argc, argv, parser);
+
   // model init
   const blitz::string& data_type = parser.data_type();
   const blitz::string& backend_type = parser.backend_type();
@@ -1,181 +1,1565 @@
 #include "data/data_iterator.h"
 
+#include <fcntl.h>
 #include <hdf5.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/random_number_generator.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <map>
 
-#include "util/blitz_cpu_function.h"
 #include "backend/backends.h"
+#include "backend/sparse_tensor.h"
+#include "data/record.h"
+#include "data/uring_reader.h"
+#include "util/blitz_cpu_function.h"
+#include "util/blitz_thread_pool.h"
 
 namespace blitz {
 
+boost::mutex hdf5_mutex;
+
+namespace {
+
+template<typename DType>
+struct Hdf5Type;
+
+template<>
+struct Hdf5Type<float> {
+  static hid_t Get() {
+    return H5T_NATIVE_FLOAT;
+  }
+};
+
+template<>
+struct Hdf5Type<double> {
+  static hid_t Get() {
+    return H5T_NATIVE_DOUBLE;
+  }
+};
+
+// tensors whose memory hdf5 can write into
+template<template <typename> class TensorType>
+struct HostTensor {
+  static const bool value = false;
+};
+
+template<>
+struct HostTensor<CPUTensor> {
+  static const bool value = true;
+};
+
+// record element type that matches DType, -1 if none does
+template<typename DType>
+struct RecordTypeOf {
+  static const int value = -1;
+};
+
+template<>
+struct RecordTypeOf<float> {
+  static const int value = kRecordFloat32;
+};
+
+size_t RecordTypeSize(const int type) {
+  switch (type) {
+    case kRecordFloat32:
+      return sizeof(float);
+    case kRecordUInt8:
+      return sizeof(uint8_t);
+    case kRecordFloat16:
+      return sizeof(uint16_t);
+    case kRecordInt32:
+      return sizeof(int32_t);
+    default:
+      LOG(FATAL) << "Unknown record type: " << type;
+  }
+  return 0;
+}
+
+// target = (source - mean) * scale over a range of elements
+template<typename DType>
+class NormalizeKernel {
+ public:
+  NormalizeKernel(const char* source, const int type, const DType mean,
+    const DType scale, DType* target) :
+    source_(source), type_(type), mean_(mean), scale_(scale),
+    target_(target) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    switch (type_) {
+      case kRecordFloat32:
+        BlitzCPUNormalize(reinterpret_cast<const float*>(source_) + begin,
+          end - begin, mean_, scale_, target_ + begin);
+        break;
+      case kRecordUInt8:
+        BlitzCPUNormalize(reinterpret_cast<const uint8_t*>(source_) + begin,
+          end - begin, mean_, scale_, target_ + begin);
+        break;
+      case kRecordFloat16:
+        BlitzCPUNormalizeHalf(
+          reinterpret_cast<const uint16_t*>(source_) + begin,
+          end - begin, mean_, scale_, target_ + begin);
+        break;
+      case kRecordInt32: {
+        // class indices, exact in DType up to its mantissa
+        const int32_t* source = reinterpret_cast<const int32_t*>(source_);
+        for (size_t i = begin; i < end; ++i) {
+          target_[i] = (source[i] - mean_) * scale_;
+        }
+        break;
+      }
+      default:
+        LOG(FATAL) << "Unknown record type: " << type_;
+    }
+  }
+
+ private:
+  const char* source_;
+  const int type_;
+  const DType mean_;
+  const DType scale_;
+  DType* target_;
+};
+
+// elements converted by one task
+const size_t kNormalizeGrain = 1 << 15;
+
+template<typename DType>
+void Normalize(const char* source, const int type, const size_t count,
+  const DType mean, const DType scale, DType* target) {
+  NormalizeKernel<DType> kernel(source, type, mean, scale, target);
+  BlitzParallelFor(0, count, kernel, kNormalizeGrain);
+}
+
+// rows scattered over memory copied into one compact batch
+class GatherKernel {
+ public:
+  GatherKernel(const char* const* rows, const size_t row_bytes,
+    char* target) : rows_(rows), row_bytes_(row_bytes), target_(target) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    for (size_t i = begin; i < end; ++i) {
+      memcpy(target_ + i * row_bytes_, rows_[i], row_bytes_);
+    }
+  }
+
+ private:
+  const char* const* rows_;
+  const size_t row_bytes_;
+  char* target_;
+};
+
+// bytes copied by one task
+const size_t kGatherGrain = 1 << 16;
+
+void Gather(const vector<const char*>& rows, const size_t row_bytes,
+  char* target) {
+  GatherKernel kernel(&rows[0], row_bytes, target);
+  BlitzParallelFor(0, rows.size(), kernel,
+    std::max(static_cast<size_t>(1), kGatherGrain / row_bytes));
+}
+
+// bytes at the head of a hdf5 file read ahead of its metadata
+const size_t kMetadataBytes = 1 << 16;
+
+// sample_num of files worker, worker + workers, ...
+// Under the hdf5 lock only the metadata read ahead is parsed, a
+// contiguous native int sample_num is then read with pread like the rows
+// of raw sets; it is written after the samples, at the end of the file.
+void ReadSampleNums(const vector<string>* files, const int worker,
+  const int workers, vector<int>* counts) {
+  vector<char> head(kMetadataBytes);
+  for (size_t i = worker; i < files->size(); i += workers) {
+    const string& file = (*files)[i];
+    // the superblock and object headers come in without the hdf5 lock
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+      LOG(FATAL) << "Hdf5 file open error: " << file;
+    }
+    if (pread(fd, &head[0], head.size(), 0) < 0) {
+      LOG(FATAL) << "Hdf5 file read error: " << file;
+    }
+
+    haddr_t offset = HADDR_UNDEF;
+    {
+      boost::lock_guard<boost::mutex> hdf5_lock(hdf5_mutex);
+      hid_t file_id = H5Fopen(file.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+      if (file_id < 0) {
+        LOG(FATAL) << "Hdf5 file open error: " << file;
+      }
+      hid_t sample_id = H5Dopen2(file_id, "sample_num", H5P_DEFAULT);
+      CHECK_GE(sample_id, 0) << "Hdf5 set open error: " << file;
+
+      hid_t type_id = H5Dget_type(sample_id);
+      CHECK_GE(type_id, 0);
+      // compact or converted sets have no plain int at one offset
+      if (H5Tequal(type_id, H5T_NATIVE_INT) > 0) {
+        offset = H5Dget_offset(sample_id);
+      }
+      herr_t status = H5Tclose(type_id);
+      CHECK_GE(status, 0);
+
+      if (offset == HADDR_UNDEF) {
+        status = H5Dread(sample_id, H5T_NATIVE_INT, H5S_ALL, H5S_ALL,
+          H5P_DEFAULT, &(*counts)[i]);
+        CHECK_GE(status, 0);
+      }
+
+      status = H5Dclose(sample_id);
+      CHECK_GE(status, 0);
+
+      status = H5Fclose(file_id);
+      CHECK_GE(status, 0);
+    }
+
+    if (offset != HADDR_UNDEF && pread(fd, &(*counts)[i], sizeof(int),
+      offset) != static_cast<ssize_t>(sizeof(int))) {
+      LOG(FATAL) << "Hdf5 file read error: " << file;
+    }
+    close(fd);
+  }
+}
+
+// sample counts of the files of a list are cached in list_path.index,
+// one "file size mtime mtime_nsec sample_num" line per file after the
+// header; seconds alone miss a shard rewritten at the same size within
+// the second its count was taken
+const char kIndexMagic[] = "BLITZIDX";
+const int kIndexVersion = 2;
+
+struct ShardIndex {
+  ShardIndex() : size(0), mtime(0), mtime_nsec(0), count(0) {}
+
+  int64_t size;
+  int64_t mtime;
+  int64_t mtime_nsec;
+  int count;
+};
+
+// entries of an index, none if it is missing or of another version
+void ReadIndex(const string& index_path, std::map<string, ShardIndex>* index) {
+  std::ifstream index_file(index_path.c_str());
+  string magic;
+  int version = 0;
+  if (!(index_file >> magic >> version) || magic != kIndexMagic ||
+    version != kIndexVersion) {
+    return;
+  }
+  string file;
+  ShardIndex shard;
+  while (index_file >> file >> shard.size >> shard.mtime >>
+    shard.mtime_nsec >> shard.count) {
+    (*index)[file] = shard;
+  }
+}
+
+// replaces the index at once, a read only data directory is not an error
+void WriteIndex(const string& index_path, const vector<string>& files,
+  const vector<ShardIndex>& shards) {
+  const string temp_path = index_path + ".tmp";
+  std::ofstream index_file(temp_path.c_str());
+  index_file << kIndexMagic << " " << kIndexVersion << "\n";
+  for (size_t i = 0; i < files.size(); ++i) {
+    index_file << files[i] << " " << shards[i].size << " " <<
+      shards[i].mtime << " " << shards[i].mtime_nsec << " " <<
+      shards[i].count << "\n";
+  }
+  index_file.close();
+  if (!index_file || rename(temp_path.c_str(), index_path.c_str()) != 0) {
+    unlink(temp_path.c_str());
+    LOG(WARNING) << "Index write error: " << index_path;
+  }
+}
+
+// epochs and windows draw reproducible orders
+const uint32_t kShuffleSeed = 1;
+
+// keeps one file open across consecutive reads,
+// reads hyperslabs of whole rows of its sets.
+// Rows of contiguous sets stored as they are read are taken with pread
+// at the offset of the set instead, without the hdf5 lock, so that
+// readers of several threads proceed in parallel.
+class Hdf5Reader {
+ public:
+  Hdf5Reader() : file_id_(-1), fd_(-1) {}
+
+  ~Hdf5Reader() {
+    Close();
+  }
+
+  void Open(const string& file) {
+    if (file == file_) {
+      return;
+    }
+    Close();
+    boost::lock_guard<boost::mutex> hdf5_lock(hdf5_mutex);
+    file_id_ = H5Fopen(file.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    fd_ = open(file.c_str(), O_RDONLY);
+    if (file_id_ < 0 || fd_ < 0) {
+      LOG(FATAL) << "Hdf5 file open error: " << file;
+    }
+    file_ = file;
+  }
+
+  bool Has(const string& name) {
+    boost::lock_guard<boost::mutex> hdf5_lock(hdf5_mutex);
+    return H5Lexists(file_id_, name.c_str(), H5P_DEFAULT) > 0;
+  }
+
+  // a set of the open file, opened on first use
+  int Dataset(const string& name, const size_t sample_size) {
+    for (size_t i = 0; i < sets_.size(); ++i) {
+      if (sets_[i].name == name) {
+        return i;
+      }
+    }
+    boost::lock_guard<boost::mutex> hdf5_lock(hdf5_mutex);
+    Set set;
+    set.name = name;
+    set.data_id = H5Dopen2(file_id_, name.c_str(), H5P_DEFAULT);
+    CHECK_GE(set.data_id, 0) << "Hdf5 set open error: " << file_ << " " <<
+      name;
+    set.space_id = H5Dget_space(set.data_id);
+    CHECK_GE(set.space_id, 0);
+    set.type_id = H5Dget_type(set.data_id);
+    CHECK_GE(set.type_id, 0);
+    // samples stay compact until they are normalized
+    const H5T_class_t type_class = H5Tget_class(set.type_id);
+    const size_t type_size = H5Tget_size(set.type_id);
+    if (type_class == H5T_INTEGER && type_size == 1 &&
+      H5Tget_sign(set.type_id) == H5T_SGN_NONE) {
+      set.type = kRecordUInt8;
+    } else if (type_class == H5T_FLOAT && type_size == 2) {
+      set.type = kRecordFloat16;
+    } else if (type_class == H5T_INTEGER && type_size == 4) {
+      set.type = kRecordInt32;
+    } else {
+      set.type = kRecordFloat32;
+    }
+    set.rank = H5Sget_simple_extent_ndims(set.space_id);
+    CHECK_GT(set.rank, 0);
+    CHECK_LE(set.rank, kMaxRank);
+    H5Sget_simple_extent_dims(set.space_id, set.dims, NULL);
+    size_t row_size = 1;
+    for (int i = 1; i < set.rank; ++i) {
+      row_size *= set.dims[i];
+    }
+    CHECK_EQ(row_size, sample_size) << "Sample size mismatch: " << file_ <<
+      " " << name;
+    // chunked or unallocated sets have no single offset
+    set.offset = H5Dget_offset(set.data_id);
+    set.row_bytes = row_size * type_size;
+    sets_.push_back(set);
+    Set& back = sets_.back();
+    back.raw = back.offset != HADDR_UNDEF &&
+      H5Tequal(back.type_id, type_id(sets_.size() - 1)) > 0;
+    return sets_.size() - 1;
+  }
+
+  // record type the rows are read as when they are not read as DType
+  int type(const int set) const {
+    return sets_[set].type;
+  }
+
+  // memory type of rows read as type()
+  hid_t type_id(const int set) const {
+    switch (sets_[set].type) {
+      case kRecordUInt8:
+        return H5T_NATIVE_UCHAR;
+      case kRecordFloat16:
+        // half floats are copied bit by bit
+        return sets_[set].type_id;
+      case kRecordInt32:
+        return H5T_NATIVE_INT32;
+      default:
+        return H5T_NATIVE_FLOAT;
+    }
+  }
+
+  // rows of the set are stored as type_id() at one offset of the file
+  bool raw(const int set) const {
+    return sets_[set].raw;
+  }
+
+  // file offset of row of a raw set
+  off_t RowOffset(const int set, const int row) const {
+    return sets_[set].offset + row * sets_[set].row_bytes;
+  }
+
+  size_t row_bytes(const int set) const {
+    return sets_[set].row_bytes;
+  }
+
+  // rows [offset, offset + rows) straight into buffer
+  void Read(const int set, const int offset, const int rows, hid_t mem_type,
+    void* buffer) {
+    const Set& data_set = sets_[set];
+    if (data_set.raw && mem_type == type_id(set)) {
+      ReadRaw(data_set, offset, rows, buffer);
+      return;
+    }
+    boost::lock_guard<boost::mutex> hdf5_lock(hdf5_mutex);
+    hsize_t start[kMaxRank] = {0};
+    hsize_t count[kMaxRank];
+    start[0] = offset;
+    count[0] = rows;
+    hsize_t mem_size = rows;
+    for (int i = 1; i < data_set.rank; ++i) {
+      count[i] = data_set.dims[i];
+      mem_size *= data_set.dims[i];
+    }
+    herr_t status = H5Sselect_hyperslab(data_set.space_id, H5S_SELECT_SET,
+      start, NULL, count, NULL);
+    CHECK_GE(status, 0);
+    hid_t mem_id = H5Screate_simple(1, &mem_size, NULL);
+    status = H5Dread(data_set.data_id, mem_type, mem_id, data_set.space_id,
+      H5P_DEFAULT, buffer);
+    CHECK_GE(status, 0);
+    status = H5Sclose(mem_id);
+    CHECK_GE(status, 0);
+  }
+
+  void Close() {
+    if (file_id_ < 0) {
+      return;
+    }
+    boost::lock_guard<boost::mutex> hdf5_lock(hdf5_mutex);
+    for (size_t i = 0; i < sets_.size(); ++i) {
+      CHECK_GE(H5Tclose(sets_[i].type_id), 0);
+      CHECK_GE(H5Sclose(sets_[i].space_id), 0);
+      CHECK_GE(H5Dclose(sets_[i].data_id), 0);
+    }
+    sets_.clear();
+    CHECK_GE(H5Fclose(file_id_), 0);
+    file_id_ = -1;
+    close(fd_);
+    fd_ = -1;
+    file_.clear();
+  }
+
+ private:
+  static const int kMaxRank = 8;
+
+  struct Set {
+    string name;
+    hid_t data_id;
+    hid_t space_id;
+    hid_t type_id;
+    int rank;
+    int type;
+    hsize_t dims[kMaxRank];
+    haddr_t offset;
+    size_t row_bytes;
+    // rows are stored as type_id() and can be read directly
+    bool raw;
+  };
+
+  void ReadRaw(const Set& data_set, const int offset, const int rows,
+    void* buffer) {
+    char* target = static_cast<char*>(buffer);
+    size_t bytes = rows * data_set.row_bytes;
+    off_t position = data_set.offset + offset * data_set.row_bytes;
+    while (bytes > 0) {
+      const ssize_t read_bytes = pread(fd_, target, bytes, position);
+      CHECK_GT(read_bytes, 0) << "Hdf5 file read error: " << file_ << " " <<
+        data_set.name;
+      target += read_bytes;
+      position += read_bytes;
+      bytes -= read_bytes;
+    }
+  }
+
+  string file_;
+  hid_t file_id_;
+  int fd_;
+  vector<Set> sets_;
+};
+
+// the set a stream reads from file, labels next to the samples are kept
+// in a "label" set
+int OpenSet(const string& file, const bool label, const size_t sample_size,
+  Hdf5Reader* reader) {
+  reader->Open(file);
+  return reader->Dataset(label && reader->Has("label") ? "label" : "data",
+    sample_size);
+}
+
+// begins of the runs of segments in one file, and their end
+template<typename Segment>
+void FileGroups(const vector<Segment>& segments, vector<size_t>* groups) {
+  groups->clear();
+  for (size_t i = 0; i < segments.size(); ++i) {
+    if (i == 0 || segments[i - 1] < segments[i]) {
+      groups->push_back(i);
+    }
+  }
+  groups->push_back(segments.size());
+}
+
+// direct reads need block aligned offsets, lengths and buffers
+const size_t kDirectAlignment = 4096;
+// bytes read on the ring before they are scattered into batches
+const size_t kUringRoundBytes = 64 << 20;
+
+// rows of a stream in one file, read in one piece
+struct DirectSpan {
+  size_t begin;
+  size_t end;
+  int type;
+  int fd;
+  shared_ptr<vector<char> > storage;
+  // first row in storage
+  const char* data;
+};
+
+// O_DIRECT where the file system supports it
+int OpenDirect(const string& file) {
+  int fd = open(file.c_str(), O_RDONLY | O_DIRECT);
+  if (fd < 0 && errno == EINVAL) {
+    fd = open(file.c_str(), O_RDONLY);
+  }
+  if (fd < 0) {
+    LOG(FATAL) << "Hdf5 file open error: " << file;
+  }
+  return fd;
+}
+
+}  // namespace
+
 template<template <typename> class TensorType, typename DType>
 void DataIterator<TensorType, DType>::Init() {
-  std::ifstream hdf5_files(data_path_.c_str());
+  for (size_t i = 0; i < streams_.size(); ++i) {
+    Stream* stream = streams_[i].get();
+    if (!MapRecord(stream) && !ReadLibsvm(i)) {
+      ListFiles(i);
+      if (!ReadSparseHdf5(i)) {
+        hdf5_ = true;
+      }
+    }
+    CHECK(!stream->sparse || HostTensor<TensorType>::value) <<
+      "Sparse data on CPU only: " << stream->path;
+    if (i == 0) {
+      total_ = stream->total;
+    } else {
+      CHECK_EQ(stream->total, total_) << "Sample number mismatch: " <<
+        stream->path;
+    }
+  }
+
+  if (io_engine_ == "io_uring") {
+    if (!UringReader().Available()) {
+      LOG(WARNING) << "io_uring not available, reading with pread";
+      io_engine_ = "pread";
+    }
+  } else if (io_engine_ != "pread") {
+    LOG(FATAL) << "Unknown io engine: " << io_engine_;
+  }
+
+  int first_index = 0;
+  int next_index = pool_size_;
+  if (shuffle_) {
+    // hdf5 device windows are not gathered from, their batches are
+    // only visited in a new order
+    shuffle_samples_ = HostTensor<TensorType>::value || !hdf5_;
+    if (!shuffle_samples_) {
+      LOG(WARNING) << "Shuffle windows only: " << data_path();
+    }
+    WindowOrder(epoch_, &window_order_);
+    vector<int> next_order;
+    WindowOrder(epoch_ + 1, &next_order);
+    next_epoch_window_ = next_order[0];
+    first_index = window_order_[0] * pool_size_;
+    next_index = (window_order_.size() > 1 ? window_order_[1] :
+      next_epoch_window_) * pool_size_;
+  }
+
+  if (!hdf5_) {
+    return;
+  }
+
+  CopyFileBuffer(first_index * batch_size_, &window_);
+  current_begin_index_ = first_index;
+
+  // nothing to prefetch if the whole set fits in one window
+  if (total_ / batch_size_ > pool_size_) {
+    loader_.reset(new boost::thread(
+      &DataIterator<TensorType, DType>::LoaderLoop, this));
+    Prefetch(next_index);
+  }
+}
+
+template<template <typename> class TensorType, typename DType>
+void DataIterator<TensorType, DType>::Shuffle(const int epoch) {
+  if (!shuffle_ || epoch == epoch_) {
+    return;
+  }
+  epoch_ = epoch;
+  WindowOrder(epoch_, &window_order_);
+  vector<int> next_order;
+  WindowOrder(epoch_ + 1, &next_order);
+  next_epoch_window_ = next_order[0];
+  // permutations depend on the epoch
+  sample_window_ = -1;
+}
+
+template<template <typename> class TensorType, typename DType>
+void DataIterator<TensorType, DType>::WindowOrder(const int epoch,
+  vector<int>* order) const {
+  const int num_batch = total_ / batch_size_;
+  const int num_full = num_batch / pool_size_;
+  const int window_samples = pool_size_ * batch_size_;
+
+  // shards are the files of the first hdf5 stream, a record file is one
+  vector<int> mapping(1, 0);
+  for (size_t i = 0; i < streams_.size(); ++i) {
+    if (streams_[i]->windowed()) {
+      mapping = streams_[i]->file_row_mapping;
+      mapping.pop_back();
+      break;
+    }
+  }
+  // a window belongs to the shard of its first sample
+  vector<vector<int> > shards(mapping.size());
+  for (int i = 0; i < num_full; ++i) {
+    const int shard = std::upper_bound(mapping.begin(), mapping.end(),
+      i * window_samples) - mapping.begin() - 1;
+    shards[shard].push_back(i);
+  }
+
+  boost::mt19937 rng(kShuffleSeed + epoch);
+  boost::random_number_generator<boost::mt19937> generator(rng);
+  vector<int> shard_order(shards.size());
+  for (size_t i = 0; i < shard_order.size(); ++i) {
+    shard_order[i] = i;
+  }
+  std::random_shuffle(shard_order.begin(), shard_order.end(), generator);
+
+  order->clear();
+  for (size_t i = 0; i < shard_order.size(); ++i) {
+    vector<int>& windows = shards[shard_order[i]];
+    std::random_shuffle(windows.begin(), windows.end(), generator);
+    order->insert(order->end(), windows.begin(), windows.end());
+  }
+  // the short window stays last
+  if (num_full * pool_size_ < num_batch) {
+    order->push_back(num_full);
+  }
+}
+
+template<template <typename> class TensorType, typename DType>
+DataIterator<TensorType, DType>::~DataIterator() {
+  if (loader_) {
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      stop_ = true;
+      cond_.notify_all();
+    }
+    loader_->join();
+  }
+  for (size_t i = 0; i < streams_.size(); ++i) {
+    if (streams_[i]->record_map != NULL) {
+      munmap(streams_[i]->record_map, streams_[i]->record_map_size);
+    }
+  }
+}
+
+template<template <typename> class TensorType, typename DType>
+void DataIterator<TensorType, DType>::ListFiles(const int stream_index) {
+  Stream* stream = streams_[stream_index].get();
+  std::ifstream hdf5_files(stream->path.c_str());
 
   if (hdf5_files.is_open()) {
     string file;
     while (hdf5_files >> file) {
-      files_.push_back(file);
+      stream->files.push_back(file);
     }
   } else {
-    LOG(FATAL) << "Hdf5 file open error: " << data_path_;
+    LOG(FATAL) << "Hdf5 file open error: " << stream->path;
   }
   hdf5_files.close();
 
-  int num_sample;
-  herr_t status;
-  for (size_t i = 0; i < files_.size(); ++i) {
-    int file_id = H5Fopen(files_[i].c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
-    int sample_id = H5Dopen2(file_id, "sample_num", H5P_DEFAULT);
+  // samples and labels in the same files, counts are read once
+  for (int i = 0; i < stream_index; ++i) {
+    if (streams_[i]->record_map == NULL &&
+      streams_[i]->files == stream->files) {
+      stream->shared = i;
+      stream->file_row_mapping = streams_[i]->file_row_mapping;
+      stream->total = streams_[i]->total;
+      return;
+    }
+  }
 
-    status = H5Dread(sample_id, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-        &num_sample);
-    CHECK_GE(status, 0);
+  // only files changed since the index was written are opened
+  const string index_path = stream->path + ".index";
+  std::map<string, ShardIndex> index;
+  ReadIndex(index_path, &index);
+  vector<ShardIndex> shards(stream->files.size());
+  vector<int> stale;
+  vector<string> stale_files;
+  for (size_t i = 0; i < stream->files.size(); ++i) {
+    const string& file = stream->files[i];
+    struct stat file_stat;
+    if (stat(file.c_str(), &file_stat) != 0) {
+      LOG(FATAL) << "Hdf5 file open error: " << file;
+    }
+    shards[i].size = file_stat.st_size;
+    shards[i].mtime = file_stat.st_mtim.tv_sec;
+    shards[i].mtime_nsec = file_stat.st_mtim.tv_nsec;
+    std::map<string, ShardIndex>::const_iterator it = index.find(file);
+    if (it != index.end() && it->second.size == shards[i].size &&
+      it->second.mtime == shards[i].mtime &&
+      it->second.mtime_nsec == shards[i].mtime_nsec) {
+      shards[i].count = it->second.count;
+    } else {
+      stale.push_back(i);
+      stale_files.push_back(file);
+    }
+  }
 
-    status = H5Dclose(sample_id);
-    CHECK_GE(status, 0);
+  if (!stale.empty()) {
+    // files are scanned in parallel and counted in list order
+    vector<int> counts(stale_files.size());
+    const int workers = std::min(static_cast<size_t>(io_threads_),
+      stale_files.size());
+    boost::thread_group group;
+    for (int i = 1; i < workers; ++i) {
+      group.add_thread(new boost::thread(&ReadSampleNums, &stale_files, i,
+        workers, &counts));
+    }
+    ReadSampleNums(&stale_files, 0, workers, &counts);
+    group.join_all();
+    for (size_t i = 0; i < stale.size(); ++i) {
+      shards[stale[i]].count = counts[i];
+    }
+  }
+  if (!stale.empty() || index.size() != stream->files.size()) {
+    WriteIndex(index_path, stream->files, shards);
+  }
+  LOG(INFO) << "Index " << index_path << ": " << stream->files.size() -
+    stale.size() << " of " << stream->files.size() << " files cached";
 
-    status = H5Fclose(file_id);
-    CHECK_GE(status, 0);
+  for (size_t i = 0; i < shards.size(); ++i) {
+    stream->file_row_mapping.push_back(stream->total);
+    stream->total += shards[i].count;
+  }
+  stream->file_row_mapping.push_back(stream->total);
+}
 
-    file_row_mapping_.push_back(total_);
-    total_ += num_sample;
-  }
-  file_row_mapping_.push_back(total_);
-
-  tensor_pool_.resize(pool_size_);
-  CopyFileBuffer(0);
-}
-
-template<template <typename> class TensorType, typename DType>
-void DataIterator<TensorType, DType>::CopyFileBuffer(int begin_offset) {
-  vector<string> current_files;
-  vector<int> current_files_row_mapping;
-  int end_offset = begin_offset + pool_size_ * batch_size_;
-  int begin_file_offset = 0;
-  int end_file_offset = 0;
-  int cur_file_offset = 0;
-  int accumulate = 0;
-
-  bool find_begin = false, find_end = false;
-  int exit_index = 0;
-  // find all files in the interval [begin_offset, end_offset]
-  // end_offset maybe greater than total_
-  // otherwise record the last file
-  // TODO(keren): binary search optimization
-  for (size_t i = 0; i < file_row_mapping_.size() - 1; ++i) {
-    if (begin_offset >= file_row_mapping_[i] &&
-        begin_offset < file_row_mapping_[i + 1] && !find_begin) {
-      find_begin = true;
-      begin_file_offset = begin_offset - file_row_mapping_[i];
-      cur_file_offset = begin_file_offset;
-    } else {
-      cur_file_offset = 0;
+template<template <typename> class TensorType, typename DType>
+bool DataIterator<TensorType, DType>::MapRecord(Stream* stream) {
+  int fd = open(stream->path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    LOG(FATAL) << "Data file open error: " << stream->path;
+  }
+  RecordHeader header;
+  ssize_t bytes = pread(fd, &header, sizeof(header), 0);
+  if (bytes != static_cast<ssize_t>(sizeof(header)) ||
+    memcmp(header.magic, kRecordMagic, sizeof(kRecordMagic)) != 0) {
+    // a list of hdf5 files
+    close(fd);
+    return false;
+  }
+  CHECK_EQ(header.version, kRecordVersion) << "Record version mismatch: " <<
+    stream->path;
+  CHECK_EQ(header.data_offset % kRecordAlignment, 0);
+
+  const size_t sample_size = stream->shape.size() / stream->shape[0];
+  CHECK_EQ(header.sample_size, sample_size) << "Sample size mismatch: " <<
+    stream->path;
+  struct stat file_stat;
+  CHECK_EQ(fstat(fd, &file_stat), 0);
+  stream->record_map_size = file_stat.st_size;
+  CHECK_GE(stream->record_map_size, header.data_offset + header.num_sample *
+    sample_size * RecordTypeSize(header.type)) << "Record file truncated: " <<
+    stream->path;
+
+  // private pages are shared with the page cache until written
+  stream->record_map = mmap(NULL, stream->record_map_size,
+    PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (stream->record_map == MAP_FAILED) {
+    stream->record_map = NULL;
+    LOG(FATAL) << "Data file map error: " << stream->path;
+  }
+  madvise(stream->record_map, stream->record_map_size, MADV_SEQUENTIAL);
+
+  stream->record_data = static_cast<const char*>(stream->record_map) +
+    header.data_offset;
+  stream->record_type = header.type;
+  stream->total = header.num_sample;
+
+  // batches are views only if kernels can use them in place
+  const size_t batch_bytes = stream->shape.size() * sizeof(DType);
+  stream->record_view = HostTensor<TensorType>::value &&
+    RecordTypeOf<DType>::value == stream->record_type &&
+    stream->mean == 0 && stream->scale == 1;
+#ifdef BLITZ_ALIGNMENT_SIZE
+  stream->record_view = stream->record_view &&
+    batch_bytes % BLITZ_ALIGNMENT_SIZE == 0;
+#endif
+  LOG(INFO) << "Map record file: " << stream->path << " samples " <<
+    stream->total << (stream->record_view ? " zero copy" : " copy") <<
+    " batch " << batch_bytes;
+  return true;
+}
+
+template<template <typename> class TensorType, typename DType>
+bool DataIterator<TensorType, DType>::ReadLibsvm(const int stream_index) {
+  Stream* stream = streams_[stream_index].get();
+  std::ifstream file(stream->path.c_str());
+  if (!file.is_open()) {
+    LOG(FATAL) << "Data file open error: " << stream->path;
+  }
+  // a libsvm line starts with a number, a list names hdf5 files
+  string line;
+  while (std::getline(file, line) &&
+    line.find_first_not_of(" \t\r") == string::npos) {}
+  const char* begin = line.c_str();
+  char* end;
+  strtod(begin, &end);
+  if (end == begin || (*end != '\0' && !isspace(*end))) {
+    return false;
+  }
+
+  // labels of the file the samples are read from
+  struct stat path_stat;
+  CHECK_EQ(stat(stream->path.c_str(), &path_stat), 0);
+  for (int i = 0; i < stream_index; ++i) {
+    struct stat other_stat;
+    if (streams_[i]->sparse && stat(streams_[i]->path.c_str(),
+      &other_stat) == 0 && other_stat.st_dev == path_stat.st_dev &&
+      other_stat.st_ino == path_stat.st_ino) {
+      stream->sparse = streams_[i]->sparse;
+      stream->total = streams_[i]->total;
+      stream->sparse_target = true;
+      return true;
     }
+  }
 
-    if (find_begin) {
-      current_files_row_mapping.push_back(file_row_mapping_[i + 1] -
-          file_row_mapping_[i]);
-      accumulate += *(current_files_row_mapping.rbegin()) -
-        cur_file_offset;
-      current_files.push_back(files_[i]);
+  shared_ptr<SparseRows> rows = make_shared<SparseRows>();
+  rows->row_offset.push_back(0);
+  file.clear();
+  file.seekg(0);
+  int line_number = 0;
+  while (std::getline(file, line)) {
+    ++line_number;
+    const char* cursor = line.c_str();
+    const double target = strtod(cursor, &end);
+    if (end == cursor) {
+      continue;
+    }
+    rows->target.push_back(target);
+    cursor = end;
+    // one based index:value pairs up to the end or a comment
+    while (true) {
+      const long index = strtol(cursor, &end, 10);
+      if (end == cursor) {
+        break;
+      }
+      CHECK_EQ(*end, ':') << "Libsvm format error: " << stream->path <<
+        " line " << line_number;
+      cursor = end + 1;
+      const double value = strtod(cursor, &end);
+      CHECK(end != cursor) << "Libsvm format error: " << stream->path <<
+        " line " << line_number;
+      cursor = end;
+      CHECK_GE(index, 1) << "Libsvm index error: " << stream->path <<
+        " line " << line_number;
+      rows->column.push_back(index - 1);
+      rows->value.push_back(value);
     }
+    rows->row_offset.push_back(rows->column.size());
+  }
+  stream->total = rows->target.size();
 
-    if (end_offset >= file_row_mapping_[i] &&
-      end_offset < file_row_mapping_[i + 1] && !find_end) {
-      find_end = true;
-      end_file_offset = end_offset - file_row_mapping_[i];
+  if (stream_index > 0) {
+    CHECK_EQ(stream->shape.size() / stream->shape[0], 1) <<
+      "Libsvm labels are one value per sample: " << stream->path;
+    stream->sparse_target = true;
+  } else {
+    CHECK_EQ(stream->mean, 0) << "Sparse samples are only scaled: " <<
+      stream->path;
+    const int sample_size = stream->shape.size() / stream->shape[0];
+    for (size_t i = 0; i < rows->column.size(); ++i) {
+      CHECK_LT(rows->column[i], sample_size) << "Libsvm index error: " <<
+        stream->path;
+      rows->value[i] *= stream->scale;
     }
+  }
+  stream->sparse = rows;
+  LOG(INFO) << "Read libsvm file: " << stream->path << " samples " <<
+    stream->total << " non zeros " << rows->column.size();
+  return true;
+}
 
-    if (find_begin && find_end) {
-      exit_index = i;
-      break;
+template<template <typename> class TensorType, typename DType>
+bool DataIterator<TensorType, DType>::ReadSparseHdf5(const int stream_index) {
+  // labels are dense, next to the samples or in files of their own
+  Stream* stream = streams_[stream_index].get();
+  if (stream_index > 0 || stream->files.empty()) {
+    return false;
+  }
+  Hdf5Reader reader;
+  reader.Open(stream->files[0]);
+  if (!reader.Has("indptr")) {
+    return false;
+  }
+  CHECK_EQ(stream->mean, 0) << "Sparse samples are only scaled: " <<
+    stream->path;
+
+  const int sample_size = stream->shape.size() / stream->shape[0];
+  shared_ptr<SparseRows> rows = make_shared<SparseRows>();
+  rows->row_offset.push_back(0);
+  vector<int64_t> indptr;
+  for (size_t i = 0; i < stream->files.size(); ++i) {
+    const int num_sample = stream->file_row_mapping[i + 1] -
+      stream->file_row_mapping[i];
+    reader.Open(stream->files[i]);
+    indptr.resize(num_sample + 1);
+    reader.Read(reader.Dataset("indptr", 1), 0, num_sample + 1,
+      H5T_NATIVE_INT64, &indptr[0]);
+    const size_t first = rows->column.size();
+    const size_t nnz = indptr[num_sample] - indptr[0];
+    rows->column.resize(first + nnz);
+    rows->value.resize(first + nnz);
+    if (nnz > 0) {
+      reader.Read(reader.Dataset("indices", 1), indptr[0], nnz,
+        H5T_NATIVE_INT32, &rows->column[first]);
+      reader.Read(reader.Dataset("values", 1), indptr[0], nnz,
+        Hdf5Type<DType>::Get(), &rows->value[first]);
+    }
+    for (int j = 1; j <= num_sample; ++j) {
+      rows->row_offset.push_back(first + indptr[j] - indptr[0]);
+    }
+  }
+  for (size_t i = 0; i < rows->column.size(); ++i) {
+    CHECK_LT(rows->column[i], sample_size) << "Sparse index error: " <<
+      stream->path;
+    rows->value[i] *= stream->scale;
+  }
+  stream->sparse = rows;
+  LOG(INFO) << "Read sparse hdf5 files: " << stream->path << " samples " <<
+    stream->total << " non zeros " << rows->column.size();
+  return true;
+}
+
+template<template <typename> class TensorType, typename DType>
+shared_ptr<TensorType<DType> > DataIterator<TensorType, DType>::SparseBatch(
+  const Stream& stream, const vector<int>& samples) const {
+  const SparseRows& rows = *stream.sparse;
+  Shape shape(stream.shape);
+  shape[0] = samples.size();
+  if (stream.sparse_target) {
+    shared_ptr<TensorType<DType> > tensor =
+      make_shared<TensorType<DType> >(shape);
+    for (size_t i = 0; i < samples.size(); ++i) {
+      (*tensor)[i] = rows.target[samples[i]];
+    }
+    return tensor;
+  }
+  shared_ptr<SparseTensor<TensorType, DType> > tensor =
+    make_shared<SparseTensor<TensorType, DType> >(shape);
+  for (size_t i = 0; i < samples.size(); ++i) {
+    const size_t begin = rows.row_offset[samples[i]];
+    const size_t count = rows.row_offset[samples[i] + 1] - begin;
+    if (count > 0) {
+      tensor->AddRow(&rows.column[begin], &rows.value[begin], count);
+    } else {
+      tensor->AddRow(NULL, NULL, 0);
     }
   }
-  // there are at least two indice in file_row_mapping:
-  // the first file and its index
-  if (find_end) {
-    accumulate -= file_row_mapping_[exit_index + 1] - end_offset;
+  return tensor;
+}
+
+template<template <typename> class TensorType, typename DType>
+shared_ptr<TensorType<DType> > DataIterator<TensorType, DType>::RecordTensor(
+  const Stream& stream, const int index) const {
+  const size_t batch_size = stream.shape.size();
+  const size_t batch_bytes = batch_size * RecordTypeSize(stream.record_type);
+  const char* batch = stream.record_data + index * batch_bytes;
+
+  // hint the kernel to read the next batch while this one is consumed
+  const size_t page_size = kRecordAlignment;
+  const char* begin = static_cast<const char*>(stream.record_map);
+  const char* next = batch + batch_bytes;
+  const char* end = begin + stream.record_map_size;
+  if (next < end) {
+    const size_t page = (next - begin) / page_size * page_size;
+    const size_t length = std::min(batch_bytes + page_size,
+      static_cast<size_t>(end - next));
+    madvise(static_cast<char*>(stream.record_map) + page, length,
+      MADV_WILLNEED);
+  }
+
+  if (stream.record_view) {
+    return make_shared<TensorType<DType> >(
+      reinterpret_cast<DType*>(const_cast<char*>(batch)), stream.shape,
+      false);
+  }
+  shared_ptr<TensorType<DType> > tensor =
+    make_shared<TensorType<DType> >(stream.shape);
+  if (HostTensor<TensorType>::value) {
+    Normalize(batch, stream.record_type, batch_size, stream.mean,
+      stream.scale, tensor->data());
   } else {
-    end_file_offset = total_ - file_row_mapping_[file_row_mapping_.size() - 2];
-  }
-
-  // create a temporary buffer to copy into memory
-  size_t input_size = input_shape_.size() / input_shape_[0];
-  DType* file_data = new DType[accumulate * input_size];
-  int file_data_offset_size = 0;
-  for (size_t i = 0; i < current_files.size(); ++i) {
-    int file_id = H5Fopen(current_files[i].c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
-    int data_id = H5Dopen2(file_id, "data", H5P_DEFAULT);
-    int file_size = current_files_row_mapping[i] * input_size;
-    DType* current_files_data = new DType[file_size];
-
-    herr_t status;
-    status = H5Dread(data_id, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-      current_files_data);
-    CHECK_GE(status, 0);
+    vector<DType> host_buffer(batch_size);
+    Normalize(batch, stream.record_type, batch_size, stream.mean,
+      stream.scale, &host_buffer[0]);
+    Backend<TensorType, DType>::HostCopyToFunc(&host_buffer[0],
+      batch_size, tensor->data());
+  }
+  return tensor;
+}
 
-    status = H5Dclose(data_id);
-    CHECK_GE(status, 0);
+template<template <typename> class TensorType, typename DType>
+void DataIterator<TensorType, DType>::Prefetch(int index) {
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  request_index_ = index;
+  loading_ = true;
+  cond_.notify_all();
+}
 
-    status = H5Fclose(file_id);
-    CHECK_GE(status, 0);
+template<template <typename> class TensorType, typename DType>
+void DataIterator<TensorType, DType>::LoaderLoop() {
+  while (true) {
+    int index;
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      while (request_index_ < 0 && !stop_) {
+        cond_.wait(lock);
+      }
+      if (stop_) {
+        return;
+      }
+      index = request_index_;
+      request_index_ = -1;
+      // drop the stale window before reading the next one
+      next_window_.clear();
+    }
 
-    int copy_size = 0;
-    int current_files_data_offset = 0;
-    // calculate copy_size
-    if (i == 0) {
-      current_files_data_offset = begin_file_offset;
-      if (current_files.size() == 1) {
-        copy_size = (end_file_offset - begin_file_offset) * input_size;
+    Window window;
+    CopyFileBuffer(index * batch_size_, &window);
+
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      next_window_.swap(window);
+      next_begin_index_ = index;
+      loading_ = false;
+      cond_.notify_all();
+    }
+  }
+}
+
+template<template <typename> class TensorType, typename DType>
+int DataIterator<TensorType, DType>::WindowSize(const int index) const {
+  // only whole batches, remaining samples of the last window are ignored
+  return std::max(0, std::min(pool_size_, total_ / batch_size_ - index));
+}
+
+template<template <typename> class TensorType, typename DType>
+void DataIterator<TensorType, DType>::CopyFileBuffer(int begin_offset,
+  Window* window) const {
+  const int num_tensor = WindowSize(begin_offset / batch_size_);
+  const int end_offset = begin_offset + num_tensor * batch_size_;
+
+  // batches are allocated up front and filled in place, device tensors
+  // are staged through host memory
+  vector<vector<DType*> > targets(streams_.size());
+  vector<vector<DType> > host_buffers(streams_.size());
+  vector<Segment> segments;
+  window->resize(streams_.size());
+  for (size_t s = 0; s < streams_.size(); ++s) {
+    const Stream& stream = *streams_[s];
+    if (!stream.windowed()) {
+      continue;
+    }
+    const size_t batch_size = stream.shape.size();
+    if (!HostTensor<TensorType>::value) {
+      host_buffers[s].resize(num_tensor * batch_size);
+    }
+    (*window)[s].resize(num_tensor);
+    targets[s].resize(num_tensor);
+    for (int j = 0; j < num_tensor; ++j) {
+      (*window)[s][j] = make_shared<TensorType<DType> >(stream.shape);
+      targets[s][j] = HostTensor<TensorType>::value ?
+        (*window)[s][j]->data() : &host_buffers[s][j * batch_size];
+    }
+
+    // a batch may span several files, streams over the same files share
+    // a reader so that each file is opened once
+    const vector<int>& mapping = stream.file_row_mapping;
+    const int owner = stream.shared >= 0 ? stream.shared : s;
+    int file = std::upper_bound(mapping.begin(), mapping.end() - 1,
+      begin_offset) - mapping.begin() - 1;
+    int row = begin_offset;
+    while (row < end_offset) {
+      while (row >= mapping[file + 1]) {
+        ++file;
+      }
+      const int batch_end = row + batch_size_ -
+        (row - begin_offset) % batch_size_;
+      const int rows = std::min(batch_end, mapping[file + 1]) - row;
+      segments.push_back(Segment(s, owner, file, row - mapping[file], rows,
+        row - begin_offset));
+      row += rows;
+    }
+  }
+
+  // segments of a file together, files in list order
+  std::stable_sort(segments.begin(), segments.end());
+  vector<size_t> groups;
+  FileGroups(segments, &groups);
+
+  if (io_engine_ == "io_uring") {
+    ReadSegmentsUring(segments, targets);
+  } else {
+    const int workers = std::max(1, std::min(io_threads_,
+      static_cast<int>(groups.size()) - 1));
+    boost::thread_group group;
+    for (int i = 1; i < workers; ++i) {
+      group.add_thread(new boost::thread(
+        &DataIterator<TensorType, DType>::ReadSegments, this, &segments,
+        &groups, &targets, i, workers));
+    }
+    ReadSegments(&segments, &groups, &targets, 0, workers);
+    group.join_all();
+  }
+
+  if (!HostTensor<TensorType>::value) {
+    for (size_t s = 0; s < streams_.size(); ++s) {
+      for (size_t j = 0; j < targets[s].size(); ++j) {
+        Backend<TensorType, DType>::HostCopyToFunc(targets[s][j],
+          streams_[s]->shape.size(), (*window)[s][j]->data());
+      }
+    }
+  }
+}
+
+template<template <typename> class TensorType, typename DType>
+void DataIterator<TensorType, DType>::ReadSegments(
+  const vector<Segment>* segments, const vector<size_t>* groups,
+  const vector<vector<DType*> >* targets, const int worker,
+  const int workers) const {
+  // compact or normalized rows are read here first
+  vector<char> compact_buffer;
+  vector<shared_ptr<Hdf5Reader> > readers(streams_.size());
+  for (size_t g = worker; g + 1 < groups->size(); g += workers) {
+    for (size_t i = (*groups)[g]; i < (*groups)[g + 1]; ++i) {
+      const Segment& segment = (*segments)[i];
+      const Stream& stream = *streams_[segment.stream];
+      const size_t sample_size = stream.shape.size() / stream.shape[0];
+      if (!readers[segment.owner]) {
+        readers[segment.owner] = make_shared<Hdf5Reader>();
+      }
+      Hdf5Reader& reader = *readers[segment.owner];
+      const int set = OpenSet(stream.files[segment.file], segment.stream > 0,
+        sample_size, &reader);
+      DType* target = (*targets)[segment.stream][
+        segment.window_row / batch_size_] +
+        segment.window_row % batch_size_ * sample_size;
+      if (reader.type(set) == kRecordFloat32 && stream.mean == 0 &&
+        stream.scale == 1) {
+        reader.Read(set, segment.file_row, segment.rows,
+          Hdf5Type<DType>::Get(), target);
       } else {
-        copy_size = (current_files_row_mapping[i] -
-          begin_file_offset) * input_size;
+        compact_buffer.resize(segment.rows * sample_size *
+          RecordTypeSize(reader.type(set)));
+        reader.Read(set, segment.file_row, segment.rows, reader.type_id(set),
+          &compact_buffer[0]);
+        Normalize(&compact_buffer[0], reader.type(set),
+          segment.rows * sample_size, stream.mean, stream.scale, target);
       }
-    } else if (current_files.size() - 1 == i) {
-      copy_size = end_file_offset * input_size;
     }
+  }
+}
 
-    BlitzCPUCopy(current_files_data + current_files_data_offset, copy_size,
-      file_data + file_data_offset_size);
-    file_data_offset_size += copy_size;
+template<template <typename> class TensorType, typename DType>
+void DataIterator<TensorType, DType>::ReadSegmentsUring(
+  const vector<Segment>& segments,
+  const vector<vector<DType*> >& targets) const {
+  UringReader uring;
+  vector<shared_ptr<Hdf5Reader> > readers(streams_.size());
+  // sets that are not raw are read as usual
+  vector<Segment> fallback;
+  vector<DirectSpan> spans;
+  size_t round_bytes = 0;
+  // cleared once the kernel rejects a read, the rest is read with pread
+  bool uring_reads = true;
+  size_t i = 0;
+  while (i < segments.size()) {
+    const Segment& first = segments[i];
+    const Stream& stream = *streams_[first.stream];
+    const size_t sample_size = stream.shape.size() / stream.shape[0];
+    if (!readers[first.owner]) {
+      readers[first.owner] = make_shared<Hdf5Reader>();
+    }
+    Hdf5Reader& reader = *readers[first.owner];
+    const string& file = stream.files[first.file];
+    const int set = OpenSet(file, first.stream > 0, sample_size, &reader);
+    // consecutive rows of the stream in this file
+    size_t end = i + 1;
+    while (end < segments.size() && segments[end].stream == first.stream &&
+      segments[end].file == first.file) {
+      ++end;
+    }
+    if (!reader.raw(set) || !uring_reads) {
+      fallback.insert(fallback.end(), segments.begin() + i,
+        segments.begin() + end);
+    } else {
+      // the rows and the blocks around them into an aligned buffer
+      const Segment& last = segments[end - 1];
+      const off_t begin_byte = reader.RowOffset(set, first.file_row);
+      const off_t end_byte = reader.RowOffset(set, last.file_row + last.rows);
+      const off_t aligned_begin = begin_byte / kDirectAlignment *
+        kDirectAlignment;
+      const off_t aligned_end = (end_byte + kDirectAlignment - 1) /
+        kDirectAlignment * kDirectAlignment;
+      const size_t length = aligned_end - aligned_begin;
+      DirectSpan span;
+      span.begin = i;
+      span.end = end;
+      span.type = reader.type(set);
+      span.fd = OpenDirect(file);
+      span.storage = make_shared<vector<char> >(length + kDirectAlignment);
+      char* buffer = &(*span.storage)[0];
+      buffer += (kDirectAlignment - reinterpret_cast<size_t>(buffer) %
+        kDirectAlignment) % kDirectAlignment;
+      span.data = buffer + (begin_byte - aligned_begin);
+      uring.Add(span.fd, aligned_begin, length, buffer);
+      spans.push_back(span);
+      round_bytes += length;
+    }
+    i = end;
 
-    delete [] current_files_data;
+    if (!spans.empty() && (round_bytes >= kUringRoundBytes ||
+      i == segments.size())) {
+      uring_reads = uring.Submit();
+      for (size_t k = 0; k < spans.size(); ++k) {
+        const DirectSpan& span = spans[k];
+        if (!uring_reads) {
+          fallback.insert(fallback.end(), segments.begin() + span.begin,
+            segments.begin() + span.end);
+          close(span.fd);
+          continue;
+        }
+        const size_t type_size = RecordTypeSize(span.type);
+        for (size_t j = span.begin; j < span.end; ++j) {
+          const Segment& segment = segments[j];
+          const Stream& target_stream = *streams_[segment.stream];
+          const size_t target_sample_size = target_stream.shape.size() /
+            target_stream.shape[0];
+          DType* target = targets[segment.stream][
+            segment.window_row / batch_size_] +
+            segment.window_row % batch_size_ * target_sample_size;
+          Normalize(span.data + (segment.file_row -
+            segments[span.begin].file_row) * target_sample_size * type_size,
+            span.type, segment.rows * target_sample_size, target_stream.mean,
+            target_stream.scale, target);
+        }
+        close(span.fd);
+      }
+      spans.clear();
+      round_bytes = 0;
+    }
   }
 
-  // construct tensor
-  int tensor_offset_size = 0;
-  // only in the last pool_size_, remaining samples are ignored
-  for (int j = 0; j < accumulate / batch_size_; ++j) {
-    shared_ptr<TensorType<DType> > tensor =
-      make_shared<TensorType<DType> >(input_shape_);
-    Backend<TensorType, DType>::HostCopyToFunc(file_data + tensor_offset_size,
-      input_shape_.size(), tensor->data());
-    tensor_pool_[j] = tensor;
-    tensor_offset_size += input_shape_.size();
+  if (!fallback.empty()) {
+    // spans given up on the ring come after later sets
+    std::stable_sort(fallback.begin(), fallback.end());
+    vector<size_t> groups;
+    FileGroups(fallback, &groups);
+    ReadSegments(&fallback, &groups, &targets, 0, 1);
   }
+}
 
-  delete [] file_data;
+template<template <typename> class TensorType, typename DType>
+void DataIterator<TensorType, DType>::LoadWindow(const int index,
+  const int next_index) {
+  bool hit = false;
+  if (loader_) {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (loading_) {
+      cond_.wait(lock);
+    }
+    if (next_begin_index_ == index) {
+      window_.swap(next_window_);
+      next_window_.clear();
+      next_begin_index_ = -1;
+      hit = true;
+    }
+  }
+  if (!hit) {
+    // random access, release the old window first to bound memory
+    window_.clear();
+    CopyFileBuffer(index * batch_size_, &window_);
+  }
+  // udpate current_begin_index_;
+  current_begin_index_ = index;
+  LOG(INFO) << "Update tensor index to: " << index;
+
+  if (loader_) {
+    Prefetch(next_index);
+  }
 }
 
 template<template <typename> class TensorType, typename DType>
-shared_ptr<TensorType<DType> > DataIterator<TensorType, DType>
-  ::GenerateTensor(int index) {
-  if (index >= total_) {
-    LOG(FATAL) << "Index out of range: " <<
-      "index " << index << " total " << total_;
-  } else if (index >= current_begin_index_ &&
-      index < current_begin_index_ + pool_size_) {
-  } else if (index >= 0) {
-    // udpate current_begin_index_;
-    CopyFileBuffer(index * batch_size_);
-    current_begin_index_ = index;
-    LOG(INFO) << "Update tensor index to: " << index;
+shared_ptr<TensorType<DType> > DataIterator<TensorType, DType>::GatherTensor(
+  const int stream_index, const int window, const int offset) const {
+  const Stream& stream = *streams_[stream_index];
+  if (stream.sparse) {
+    // sparse streams live on the host, their samples are always shuffled
+    const int first = window * pool_size_ * batch_size_;
+    vector<int> samples(batch_size_);
+    for (int i = 0; i < batch_size_; ++i) {
+      samples[i] = first + sample_order_[offset * batch_size_ + i];
+    }
+    return SparseBatch(stream, samples);
+  }
+  if (!shuffle_samples_) {
+    return stream.record_map == NULL ? window_[stream_index][offset] :
+      RecordTensor(stream, window * pool_size_ + offset);
+  }
+
+  const size_t batch_size = stream.shape.size();
+  const size_t sample_size = batch_size / stream.shape[0];
+  const int* samples = &sample_order_[offset * batch_size_];
+  vector<const char*> rows(batch_size_);
+  size_t row_bytes;
+  if (stream.record_map == NULL) {
+    // rows of the resident window
+    const TensorPool& pool = window_[stream_index];
+    row_bytes = sample_size * sizeof(DType);
+    for (int i = 0; i < batch_size_; ++i) {
+      rows[i] = reinterpret_cast<const char*>(
+        pool[samples[i] / batch_size_]->data() +
+        samples[i] % batch_size_ * sample_size);
+    }
+  } else {
+    row_bytes = sample_size * RecordTypeSize(stream.record_type);
+    const char* first = stream.record_data +
+      static_cast<size_t>(window) * pool_size_ * batch_size_ * row_bytes;
+    for (int i = 0; i < batch_size_; ++i) {
+      rows[i] = first + samples[i] * row_bytes;
+    }
+  }
+
+  shared_ptr<TensorType<DType> > tensor =
+    make_shared<TensorType<DType> >(stream.shape);
+  if (stream.record_map == NULL || stream.record_view) {
+    // rows hold DType already
+    Gather(rows, row_bytes, reinterpret_cast<char*>(tensor->data()));
+    return tensor;
+  }
+  vector<char> compact_buffer(batch_size_ * row_bytes);
+  Gather(rows, row_bytes, &compact_buffer[0]);
+  if (HostTensor<TensorType>::value) {
+    Normalize(&compact_buffer[0], stream.record_type, batch_size,
+      stream.mean, stream.scale, tensor->data());
+  } else {
+    vector<DType> host_buffer(batch_size);
+    Normalize(&compact_buffer[0], stream.record_type, batch_size,
+      stream.mean, stream.scale, &host_buffer[0]);
+    Backend<TensorType, DType>::HostCopyToFunc(&host_buffer[0],
+      batch_size, tensor->data());
+  }
+  return tensor;
+}
+
+template<template <typename> class TensorType, typename DType>
+shared_ptr<TensorType<DType> > DataIterator<TensorType, DType>::StreamTensor(
+  const int stream_index, const int index) const {
+  const Stream& stream = *streams_[stream_index];
+  if (stream.record_map != NULL) {
+    return RecordTensor(stream, index);
+  }
+  if (stream.sparse) {
+    vector<int> samples(batch_size_);
+    for (int i = 0; i < batch_size_; ++i) {
+      samples[i] = index * batch_size_ + i;
+    }
+    return SparseBatch(stream, samples);
+  }
+  return window_[stream_index][index - current_begin_index_];
+}
+
+template<template <typename> class TensorType, typename DType>
+shared_ptr<TensorType<DType> > DataIterator<TensorType, DType>::TailTensor(
+  const int stream_index) const {
+  const Stream& stream = *streams_[stream_index];
+  const int begin = total_ / batch_size_ * batch_size_;
+  Shape shape(stream.shape);
+  shape[0] = total_ - begin;
+  if (stream.sparse) {
+    vector<int> samples(shape[0]);
+    for (size_t i = 0; i < samples.size(); ++i) {
+      samples[i] = begin + i;
+    }
+    return SparseBatch(stream, samples);
+  }
+
+  const size_t size = shape.size();
+  const size_t sample_size = size / shape[0];
+  shared_ptr<TensorType<DType> > tensor;
+  if (stream.record_map != NULL) {
+    const char* data = stream.record_data +
+      static_cast<size_t>(begin) * sample_size *
+      RecordTypeSize(stream.record_type);
+    if (stream.record_view) {
+      return make_shared<TensorType<DType> >(
+        reinterpret_cast<DType*>(const_cast<char*>(data)), shape, false);
+    }
+    tensor = make_shared<TensorType<DType> >(shape);
+    if (HostTensor<TensorType>::value) {
+      Normalize(data, stream.record_type, size, stream.mean, stream.scale,
+        tensor->data());
+    } else {
+      vector<DType> host_buffer(size);
+      Normalize(data, stream.record_type, size, stream.mean, stream.scale,
+        &host_buffer[0]);
+      Backend<TensorType, DType>::HostCopyToFunc(&host_buffer[0], size,
+        tensor->data());
+    }
+    return tensor;
+  }
+
+  // hdf5 rows, read here as one batch of the segments of their files
+  tensor = make_shared<TensorType<DType> >(shape);
+  vector<DType> host_buffer;
+  vector<vector<DType*> > targets(streams_.size());
+  if (HostTensor<TensorType>::value) {
+    targets[stream_index].push_back(tensor->data());
   } else {
+    host_buffer.resize(size);
+    targets[stream_index].push_back(&host_buffer[0]);
+  }
+  const vector<int>& mapping = stream.file_row_mapping;
+  const int owner = stream.shared >= 0 ? stream.shared : stream_index;
+  vector<Segment> segments;
+  int file = std::upper_bound(mapping.begin(), mapping.end() - 1, begin) -
+    mapping.begin() - 1;
+  for (int row = begin; row < total_; ) {
+    while (row >= mapping[file + 1]) {
+      ++file;
+    }
+    const int rows = std::min(total_, mapping[file + 1]) - row;
+    segments.push_back(Segment(stream_index, owner, file, row - mapping[file],
+      rows, row - begin));
+    row += rows;
+  }
+  vector<size_t> groups;
+  FileGroups(segments, &groups);
+  ReadSegments(&segments, &groups, &targets, 0, 1);
+  if (!HostTensor<TensorType>::value) {
+    Backend<TensorType, DType>::HostCopyToFunc(&host_buffer[0], size,
+      tensor->data());
+  }
+  return tensor;
+}
+
+template<template <typename> class TensorType, typename DType>
+void DataIterator<TensorType, DType>::GenerateTail(
+  shared_ptr<TensorType<DType> >* input,
+  shared_ptr<TensorType<DType> >* target) {
+  CHECK_GT(tail_size(), 0) << "No tail: " << data_path();
+  *input = TailTensor(0);
+  if (target != NULL) {
+    CHECK(has_label()) << "No labels: " << data_path();
+    *target = TailTensor(1);
+  }
+}
+
+template<template <typename> class TensorType, typename DType>
+void DataIterator<TensorType, DType>::GenerateBatch(const int index,
+  shared_ptr<TensorType<DType> >* input,
+  shared_ptr<TensorType<DType> >* target) {
+  if (index < 0) {
     LOG(FATAL) << "Index negative: " << "index " << index;
+  } else if (index >= total_ / batch_size_) {
+    LOG(FATAL) << "Index out of range: " <<
+      "index " << index << " total " << total_;
   }
 
-  return tensor_pool_[index - current_begin_index_];
+  if (shuffle_) {
+    // offset of a window in this epoch's order
+    const size_t position = index / pool_size_;
+    const int window = window_order_[position];
+    const int offset = index % pool_size_;
+    const int begin = window * pool_size_;
+    if (hdf5_ && current_begin_index_ != begin) {
+      // the next in order, or the first of the next epoch
+      const int next = position + 1 < window_order_.size() ?
+        window_order_[position + 1] : next_epoch_window_;
+      LoadWindow(begin, next * pool_size_);
+    }
+    if (sample_window_ != window) {
+      // one permutation for all streams keeps them aligned
+      sample_order_.resize(WindowSize(begin) * batch_size_);
+      for (size_t i = 0; i < sample_order_.size(); ++i) {
+        sample_order_[i] = i;
+      }
+      boost::mt19937 rng(kShuffleSeed + epoch_ * window_order_.size() +
+        window);
+      boost::random_number_generator<boost::mt19937> generator(rng);
+      std::random_shuffle(sample_order_.begin(), sample_order_.end(),
+        generator);
+      sample_window_ = window;
+      // mapped windows are read at random, fault them in at once
+      for (size_t i = 0; i < streams_.size(); ++i) {
+        const Stream& stream = *streams_[i];
+        if (stream.record_map == NULL) {
+          continue;
+        }
+        const size_t batch_bytes = stream.shape.size() *
+          RecordTypeSize(stream.record_type);
+        const size_t first = stream.record_data - static_cast<const char*>(
+          stream.record_map) + begin * batch_bytes;
+        const size_t page = first / kRecordAlignment * kRecordAlignment;
+        madvise(static_cast<char*>(stream.record_map) + page,
+          first - page + sample_order_.size() / batch_size_ * batch_bytes,
+          MADV_WILLNEED);
+      }
+    }
+    *input = GatherTensor(0, window, offset);
+    if (target != NULL) {
+      CHECK(has_label()) << "No labels: " << data_path();
+      *target = GatherTensor(1, window, offset);
+    }
+    return;
+  }
+
+  if (hdf5_ && (index < current_begin_index_ ||
+    index >= current_begin_index_ + WindowSize(current_begin_index_))) {
+    // the window after this one, or the first for the next epoch
+    int next_index = index + pool_size_;
+    if (next_index >= total_ / batch_size_) {
+      next_index = 0;
+    }
+    LoadWindow(index, next_index);
+  }
+
+  *input = StreamTensor(0, index);
+  if (target != NULL) {
+    CHECK(has_label()) << "No labels: " << data_path();
+    *target = StreamTensor(1, index);
+  }
+}
+
+template<template <typename> class TensorType, typename DType>
+shared_ptr<TensorType<DType> > DataIterator<TensorType, DType>
+  ::GenerateTensor(const int index) {
+  shared_ptr<TensorType<DType> > input;
+  GenerateBatch(index, &input, NULL);
+  return input;
 }
 
 INSTANTIATE_CLASS(DataIterator);
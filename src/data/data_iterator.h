@@ -1,6 +1,11 @@
 #ifndef SRC_DATA_DATA_ITERATOR_H_
 #define SRC_DATA_DATA_ITERATOR_H_
 
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -9,25 +14,109 @@
 
 namespace blitz {
 
+// hdf5 is not built thread safe, every thread of blitz that calls it,
+// loaders of all iterators and the output writer, holds this lock
+extern boost::mutex hdf5_mutex;
+
+// A background loader fills the next pool window while the current one
+// is consumed, at most two windows are resident.
+// With a label path, samples and labels are two streams of one iterator:
+// a window holds both, so batches come in aligned (input, target) pairs.
+// Hdf5 files listed for both streams are opened once, labels are then
+// read from their "label" set.
+// A path that names a record file (data/record.h) is mapped instead,
+// CPU batches are then views of the mapping and nothing is copied.
+// uint8 and fp16 samples, in hdf5 or record files, are converted to DType
+// and normalized by (x - mean) * scale while batches are filled.
+// Sparse samples, a libsvm file or hdf5 files of "indptr", "indices" and
+// "values" sets (scipy csr, zero based), are held in memory and come in
+// as SparseTensor batches, only scaled. A label path that names the same
+// libsvm file reads the leading values of its lines.
+// With shuffle, every epoch visits shards and the windows within them in
+// a new order and gathers batches from a permutation of the samples of
+// the resident window, reads stay sequential.
 template<template <typename> class TensorType, typename DType>
 class DataIterator {
  public:
+  typedef vector<shared_ptr<TensorType<DType> > > TensorPool;
+
+  explicit DataIterator(const string& data_path, const Shape& input_shape,
+    const int batch_size, const int pool_size = 3000) :
+    batch_size_(batch_size), pool_size_(pool_size), current_begin_index_(0),
+    total_(0), next_begin_index_(-1), request_index_(-1), loading_(false),
+    stop_(false), hdf5_(false), io_threads_(1), io_engine_("pread"),
+    shuffle_(false), shuffle_samples_(false), epoch_(0),
+    next_epoch_window_(0), sample_window_(-1) {
+    streams_.push_back(make_shared<Stream>(data_path, input_shape));
+  }
+
   explicit DataIterator(const string& data_path, const Shape& input_shape,
+    const string& label_path, const Shape& label_shape,
     const int batch_size, const int pool_size = 3000) :
-    data_path_(data_path), input_shape_(input_shape), batch_size_(batch_size),
-    pool_size_(pool_size), current_begin_index_(0), total_(0) {}
+    batch_size_(batch_size), pool_size_(pool_size), current_begin_index_(0),
+    total_(0), next_begin_index_(-1), request_index_(-1), loading_(false),
+    stop_(false), hdf5_(false), io_threads_(1), io_engine_("pread"),
+    shuffle_(false), shuffle_samples_(false), epoch_(0),
+    next_epoch_window_(0), sample_window_(-1) {
+    streams_.push_back(make_shared<Stream>(data_path, input_shape));
+    streams_.push_back(make_shared<Stream>(label_path, label_shape));
+  }
+
+  ~DataIterator();
 
   void Init();
 
+  // samples of batch index
   shared_ptr<TensorType<DType> > GenerateTensor(const int index);
 
+  // samples and labels of batch index
+  void GenerateBatch(const int index, shared_ptr<TensorType<DType> >* input,
+    shared_ptr<TensorType<DType> >* target);
+
+  // samples and labels after the last whole batch, a batch of tail_size()
+  // samples read at once, in file order
+  void GenerateTail(shared_ptr<TensorType<DType> >* input,
+    shared_ptr<TensorType<DType> >* target);
+
+  // before Init, only for training sets
+  void set_shuffle(const bool shuffle) {
+    shuffle_ = shuffle;
+  }
+
+  // batch order of epoch, nothing to do without shuffle
+  void Shuffle(const int epoch);
+
+  // before Init, threads that read hdf5 shards in parallel
+  void set_io_threads(const int io_threads) {
+    io_threads_ = std::max(1, io_threads);
+  }
+
+  // before Init, "pread" on io_threads or "io_uring" with direct reads
+  void set_io_engine(const string& io_engine) {
+    io_engine_ = io_engine;
+  }
+
+  // before Init, labels are left as they are stored
+  void set_normalization(const DType mean, const DType scale) {
+    streams_[0]->mean = mean;
+    streams_[0]->scale = scale;
+  }
+
   // getters
   const Shape& input_shape() const {
-    return this->input_shape_;
+    return streams_[0]->shape;
   }
 
   const string& data_path() const {
-    return this->data_path_;
+    return streams_[0]->path;
+  }
+
+  bool has_label() const {
+    return streams_.size() > 1;
+  }
+
+  const Shape& label_shape() const {
+    return streams_[1]->shape;
   }
 
   int batch_size() const {
@@ -38,12 +127,143 @@ class DataIterator {
     return this->total_;
   }
 
+  // samples no whole batch covers
+  int tail_size() const {
+    return this->total_ % this->batch_size_;
+  }
+
  private:
-  void CopyFileBuffer(int begin_offset);
+  // compressed sparse rows of a whole stream
+  struct SparseRows {
+    vector<size_t> row_offset;
+    vector<int> column;
+    vector<DType> value;
+    // leading values of libsvm lines
+    vector<DType> target;
+  };
+
+  // samples or labels, backed by a list of hdf5 files, a record file or
+  // sparse rows
+  struct Stream {
+    Stream(const string& path, const Shape& shape) :
+      path(path), shape(shape), mean(0), scale(1), total(0), shared(-1),
+      record_map(NULL), record_map_size(0), record_data(NULL),
+      record_type(0), record_view(false), sparse_target(false) {}
+
+    // read from hdf5 through windows
+    bool windowed() const {
+      return record_map == NULL && !sparse;
+    }
+
+    const string path;
+    const Shape shape;
+    DType mean;
+    DType scale;
+    int total;
 
-  const string data_path_;
+    vector<string> files;
+    vector<int> file_row_mapping;
+    // an earlier stream over the same files, -1 if none
+    int shared;
 
-  const Shape input_shape_;
+    // record file state, record_map is NULL for hdf5 streams
+    void* record_map;
+    size_t record_map_size;
+    const char* record_data;
+    int record_type;
+    bool record_view;
+
+    // sparse rows, labels read their targets
+    shared_ptr<SparseRows> sparse;
+    bool sparse_target;
+  };
+
+  // one pool per stream, record streams keep theirs empty
+  typedef vector<TensorPool> Window;
+
+  // rows of one batch of a stream that lie in one file
+  struct Segment {
+    Segment(const int stream, const int owner, const int file,
+      const int file_row, const int rows, const int window_row) :
+      stream(stream), owner(owner), file(file), file_row(file_row),
+      rows(rows), window_row(window_row) {}
+
+    bool operator<(const Segment& other) const {
+      return owner < other.owner ||
+        (owner == other.owner && file < other.file);
+    }
+
+    int stream;
+    // the stream whose reader opens the file
+    int owner;
+    int file;
+    int file_row;
+    int rows;
+    int window_row;
+  };
+
+  // batches in the window starting at batch index
+  int WindowSize(const int index) const;
+
+  // reads the window starting at sample begin_offset,
+  // files are spread over io_threads_
+  void CopyFileBuffer(int begin_offset, Window* window) const;
+
+  // segments of the files [groups[worker], groups[worker + 1]),
+  // [groups[worker + workers], ...) into their batch targets
+  void ReadSegments(const vector<Segment>* segments,
+    const vector<size_t>* groups, const vector<vector<DType*> >* targets,
+    const int worker, const int workers) const;
+
+  // segments of contiguous sets on one io_uring, read with O_DIRECT in
+  // one piece per file and stream, the others as in ReadSegments
+  void ReadSegmentsUring(const vector<Segment>& segments,
+    const vector<vector<DType*> >& targets) const;
+
+  // makes the window starting at batch index current,
+  // the loader reads the one at next_index meanwhile
+  void LoadWindow(const int index, const int next_index);
+
+  // windows of epoch in visiting order, a window starts at batch
+  // window * pool_size_
+  void WindowOrder(const int epoch, vector<int>* order) const;
+
+  // batch offset of a shuffled window, gathered from its samples
+  shared_ptr<TensorType<DType> > GatherTensor(const int stream_index,
+    const int window, const int offset) const;
+
+  // asks the loader for the window starting at batch index
+  void Prefetch(int index);
+
+  void LoaderLoop();
+
+  // reads the file list and sample counts of a hdf5 stream,
+  // counts of unchanged files come from the index next to the list
+  void ListFiles(const int stream_index);
+
+  // maps the stream path if it is a record file
+  bool MapRecord(Stream* stream);
+
+  // reads the stream path if it is a libsvm file
+  bool ReadLibsvm(const int stream_index);
+
+  // reads the listed files if they hold sparse samples
+  bool ReadSparseHdf5(const int stream_index);
+
+  // samples of a sparse stream, dense targets for labels, in a batch of
+  // as many
+  shared_ptr<TensorType<DType> > SparseBatch(const Stream& stream,
+    const vector<int>& samples) const;
+
+  // batch index of a mapped record file
+  shared_ptr<TensorType<DType> > RecordTensor(const Stream& stream,
+    const int index) const;
+
+  shared_ptr<TensorType<DType> > StreamTensor(const int stream_index,
+    const int index) const;
+
+  // the tail of a stream
+  shared_ptr<TensorType<DType> > TailTensor(const int stream_index) const;
 
   const int batch_size_;
 
@@ -51,13 +271,40 @@ class DataIterator {
   int current_begin_index_;
   int total_;
 
-  vector<string> files_;
-  vector<int> file_row_mapping_;
-  vector<shared_ptr<TensorType<DType> > > tensor_pool_;
+  vector<shared_ptr<Stream> > streams_;
+  Window window_;
+
+  // loader state, guarded by mutex_
+  Window next_window_;
+  int next_begin_index_;
+  int request_index_;
+  bool loading_;
+  bool stop_;
+
+  // some stream is read from hdf5 through windows
+  bool hdf5_;
+  int io_threads_;
+  string io_engine_;
+
+  bool shuffle_;
+  // device windows are shuffled as a whole
+  bool shuffle_samples_;
+  int epoch_;
+  vector<int> window_order_;
+  int next_epoch_window_;
+  // permutation of the samples of sample_window_
+  int sample_window_;
+  vector<int> sample_order_;
+
+  boost::mutex mutex_;
+  boost::condition_variable cond_;
+  scoped_ptr<boost::thread> loader_;
+
+  // disable copy
+  DataIterator(const DataIterator&);
+  DataIterator& operator=(const DataIterator&);
 };
 
 }  // namespace blitz
 
 #endif  // SRC_DATA_DATA_ITERATOR_H_
-
-
@@ -0,0 +1,37 @@
+#ifndef SRC_DATA_RECORD_H_
+#define SRC_DATA_RECORD_H_
+
+#include <stdint.h>
+
+namespace blitz {
+
+// Uncompressed record file written by script/data/HDF5ToRecord.py.
+// A fixed header is followed at data_offset by num_sample rows of
+// sample_size elements, little endian and contiguous, so that a batch
+// is a plain slice of the mapped file.
+const char kRecordMagic[8] = {'B', 'L', 'I', 'T', 'Z', 'R', 'E', 'C'};
+const uint32_t kRecordVersion = 1;
+// data_offset is a multiple of the page size
+const uint64_t kRecordAlignment = 4096;
+
+// compact types are normalized while batches are filled,
+// int32 holds sparse class labels
+enum RecordType {
+  kRecordFloat32 = 0,
+  kRecordUInt8 = 1,
+  kRecordFloat16 = 2,
+  kRecordInt32 = 3
+};
+
+struct RecordHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t type;
+  uint64_t num_sample;
+  uint64_t sample_size;
+  uint64_t data_offset;
+};
+
+}  // namespace blitz
+
+#endif  // SRC_DATA_RECORD_H_
@@ -0,0 +1,217 @@
+#include "data/uring_reader.h"
+
+#ifdef BLITZ_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace blitz {
+
+#ifdef BLITZ_IO_URING
+
+namespace {
+
+// bytes of one request, a large read becomes several in flight at once
+const size_t kMaxRequestBytes = 1 << 20;
+// opcodes asked for in the probe
+const unsigned int kProbeOps = 256;
+
+}  // namespace
+
+UringReader::UringReader(const unsigned int depth) :
+  ring_fd_(-1), depth_(depth), sq_ring_(MAP_FAILED), sq_ring_size_(0),
+  sqes_(MAP_FAILED), sqes_size_(0), cq_ring_(MAP_FAILED),
+  cq_ring_size_(0) {
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  ring_fd_ = syscall(__NR_io_uring_setup, depth, &params);
+  if (ring_fd_ < 0) {
+    LOG(WARNING) << "io_uring setup error: " << strerror(errno);
+    return;
+  }
+  // kernels before 5.6 set up a ring but reject IORING_OP_READ
+  vector<char> probe_buffer(sizeof(io_uring_probe) +
+    kProbeOps * sizeof(io_uring_probe_op), 0);
+  io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(
+    &probe_buffer[0]);
+  if (syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PROBE, probe,
+    kProbeOps) < 0 || probe->last_op < IORING_OP_READ ||
+    !(probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED)) {
+    LOG(WARNING) << "io_uring without IORING_OP_READ";
+    close(ring_fd_);
+    ring_fd_ = -1;
+    return;
+  }
+  depth_ = params.sq_entries;
+
+  sq_ring_size_ = params.sq_off.array +
+    params.sq_entries * sizeof(unsigned int);
+  cq_ring_size_ = params.cq_off.cqes +
+    params.cq_entries * sizeof(io_uring_cqe);
+  // both rings live in one mapping on newer kernels
+  const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) {
+    sq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+  }
+  sq_ring_ = mmap(NULL, sq_ring_size_, PROT_READ | PROT_WRITE,
+    MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+  CHECK(sq_ring_ != MAP_FAILED) << "io_uring map error";
+  if (single_mmap) {
+    cq_ring_ = sq_ring_;
+    cq_ring_size_ = 0;
+  } else {
+    cq_ring_ = mmap(NULL, cq_ring_size_, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+    CHECK(cq_ring_ != MAP_FAILED) << "io_uring map error";
+  }
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  sqes_ = mmap(NULL, sqes_size_, PROT_READ | PROT_WRITE,
+    MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+  CHECK(sqes_ != MAP_FAILED) << "io_uring map error";
+
+  char* sq = static_cast<char*>(sq_ring_);
+  sq_head_ = reinterpret_cast<unsigned int*>(sq + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+  sq_mask_ = reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+  sq_array_ = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+  char* cq = static_cast<char*>(cq_ring_);
+  cq_head_ = reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned int*>(cq + params.cq_off.tail);
+  cq_mask_ = reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+  cqes_ = cq + params.cq_off.cqes;
+}
+
+UringReader::~UringReader() {
+  if (sqes_ != MAP_FAILED) {
+    munmap(sqes_, sqes_size_);
+  }
+  if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+    munmap(cq_ring_, cq_ring_size_);
+  }
+  if (sq_ring_ != MAP_FAILED) {
+    munmap(sq_ring_, sq_ring_size_);
+  }
+  if (ring_fd_ >= 0) {
+    close(ring_fd_);
+  }
+}
+
+void UringReader::Add(const int fd, const off_t offset, const size_t length,
+  void* buffer) {
+  char* target = static_cast<char*>(buffer);
+  for (size_t done = 0; done < length; done += kMaxRequestBytes) {
+    Request request;
+    request.fd = fd;
+    request.offset = offset + done;
+    request.length = std::min(kMaxRequestBytes, length - done);
+    request.buffer = target + done;
+    requests_.push_back(request);
+  }
+}
+
+bool UringReader::Submit() {
+  CHECK(Available()) << "io_uring not available";
+  io_uring_sqe* sqes = static_cast<io_uring_sqe*>(sqes_);
+  io_uring_cqe* cqes = static_cast<io_uring_cqe*>(cqes_);
+
+  // requests to issue, short reads come back for their remainder
+  vector<size_t> pending(requests_.size());
+  for (size_t i = 0; i < pending.size(); ++i) {
+    pending[i] = requests_.size() - 1 - i;
+  }
+  // in_flight counts the entries in the ring the kernel has not taken
+  // yet, they are submitted with the next call
+  unsigned int in_flight = 0;
+  unsigned int unsubmitted = 0;
+  bool failed = false;
+  while (!pending.empty() || in_flight > 0) {
+    unsigned int tail = *sq_tail_;
+    while (!pending.empty() && in_flight < depth_) {
+      const Request& request = requests_[pending.back()];
+      const unsigned int index = tail & *sq_mask_;
+      io_uring_sqe* sqe = &sqes[index];
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode = IORING_OP_READ;
+      sqe->fd = request.fd;
+      sqe->off = request.offset;
+      sqe->addr = reinterpret_cast<uint64_t>(request.buffer);
+      sqe->len = request.length;
+      sqe->user_data = pending.back();
+      sq_array_[index] = index;
+      pending.pop_back();
+      ++tail;
+      ++unsubmitted;
+      ++in_flight;
+    }
+    // the kernel sees the entries once the tail moves
+    __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+
+    const int submitted = syscall(__NR_io_uring_enter, ring_fd_, unsubmitted,
+      1, IORING_ENTER_GETEVENTS, NULL, 0);
+    if (submitted >= 0) {
+      unsubmitted -= submitted;
+    } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+      // EAGAIN and EBUSY ask to reap completions before trying again
+      LOG(FATAL) << "io_uring enter error: " << strerror(errno);
+    }
+
+    unsigned int head = *cq_head_;
+    const unsigned int cq_tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    while (head != cq_tail) {
+      const io_uring_cqe& cqe = cqes[head & *cq_mask_];
+      Request& request = requests_[cqe.user_data];
+      if (cqe.res == -EINVAL || cqe.res == -EOPNOTSUPP) {
+        // e.g. O_DIRECT on a file system that wants other alignment,
+        // the rest is not issued and the caller reads with pread
+        if (!failed) {
+          LOG(WARNING) << "io_uring read error: " << strerror(-cqe.res);
+        }
+        failed = true;
+        pending.clear();
+      } else if (cqe.res < 0) {
+        LOG(FATAL) << "io_uring read error: " << strerror(-cqe.res);
+      }
+      const size_t bytes = failed ? 0 : cqe.res;
+      // zero bytes at the end of the file
+      if (bytes > 0 && bytes < request.length) {
+        request.offset += bytes;
+        request.buffer += bytes;
+        request.length -= bytes;
+        pending.push_back(cqe.user_data);
+      }
+      --in_flight;
+      ++head;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+  }
+  requests_.clear();
+  return !failed;
+}
+
+#else
+
+UringReader::UringReader(const unsigned int depth) :
+  ring_fd_(-1), depth_(depth), sq_ring_(NULL), sq_ring_size_(0),
+  sqes_(NULL), sqes_size_(0), cq_ring_(NULL), cq_ring_size_(0) {}
+
+UringReader::~UringReader() {}
+
+void UringReader::Add(const int fd, const off_t offset, const size_t length,
+  void* buffer) {
+  LOG(FATAL) << "Built without BLITZ_IO_URING";
+}
+
+bool UringReader::Submit() {
+  LOG(FATAL) << "Built without BLITZ_IO_URING";
+  return false;
+}
+
+#endif  // BLITZ_IO_URING
+
+}  // namespace blitz
@@ -0,0 +1,73 @@
+#ifndef SRC_DATA_URING_READER_H_
+#define SRC_DATA_URING_READER_H_
+
+#include <sys/types.h>
+
+#include <vector>
+
+#include "util/common.h"
+
+namespace blitz {
+
+// Reads queued by Add are issued together on an io_uring, up to depth of
+// them stay in flight without a thread per request.
+// The ring is set up with the raw system calls, only built with
+// BLITZ_IO_URING; Available() is false otherwise, if the kernel refuses or
+// if it does not support IORING_OP_READ.
+class UringReader {
+ public:
+  explicit UringReader(const unsigned int depth = 64);
+
+  ~UringReader();
+
+  bool Available() const {
+    return ring_fd_ >= 0;
+  }
+
+  // length bytes at offset of fd into buffer, large reads are split;
+  // a read past the end of the file stops there
+  void Add(const int fd, const off_t offset, const size_t length,
+    void* buffer);
+
+  // issues the queued reads and waits until all of them are done;
+  // false if the kernel rejected a read with EINVAL or EOPNOTSUPP, the
+  // buffers are then incomplete and should be read another way
+  bool Submit();
+
+ private:
+  struct Request {
+    int fd;
+    off_t offset;
+    size_t length;
+    char* buffer;
+  };
+
+  int ring_fd_;
+  unsigned int depth_;
+
+  // submission ring, entries and completion ring mapped from the kernel
+  void* sq_ring_;
+  size_t sq_ring_size_;
+  void* sqes_;
+  size_t sqes_size_;
+  void* cq_ring_;
+  size_t cq_ring_size_;
+  unsigned int* sq_head_;
+  unsigned int* sq_tail_;
+  unsigned int* sq_mask_;
+  unsigned int* sq_array_;
+  unsigned int* cq_head_;
+  unsigned int* cq_tail_;
+  unsigned int* cq_mask_;
+  void* cqes_;
+
+  vector<Request> requests_;
+
+  // disable copy
+  UringReader(const UringReader&);
+  UringReader& operator=(const UringReader&);
+};
+
+}  // namespace blitz
+
+#endif  // SRC_DATA_URING_READER_H_
@@ -0,0 +1,459 @@
+#include "infer/blitz_infer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "backend/backends.h"
+#include "filler/constant.h"
+#include "filler/filler_wrapper.h"
+#include "layer/affine.h"
+#include "layer/conv.h"
+#include "layer/dropout_layer.h"
+#include "layer/embedding.h"
+#include "layer/layer_wrapper.h"
+#include "layer/param_layer.h"
+#include "layer/pooling_layer.h"
+#include "model/seralize.h"
+#include "scheduler/gradientdescent.h"
+#include "scheduler/scheduler.h"
+#include "transform/logistic.h"
+#include "transform/rectlin.h"
+#include "transform/softmax.h"
+#include "util/blitz_cpu_function.h"
+#include "util/blitz_thread_pool.h"
+
+namespace blitz {
+
+using std::set;
+
+namespace {
+
+typedef Layer<CPUTensor, float> InferLayer;
+typedef ParamLayer<CPUTensor, float> InferParamLayer;
+typedef Activation<CPUTensor, float> InferActivation;
+
+__thread char last_error[256];
+
+void SetError(const string& error) {
+  snprintf(last_error, sizeof(last_error), "%s", error.c_str());
+}
+
+// "key value" lines of a model description, see Parser::model_description
+class Description {
+ public:
+  explicit Description(const string& text) {
+    stringstream lines(text);
+    string line;
+    while (std::getline(lines, line)) {
+      const size_t space = line.find(' ');
+      if (space != string::npos) {
+        values_[line.substr(0, space)] = line.substr(space + 1);
+      }
+    }
+  }
+
+  bool Has(const string& key) const {
+    return values_.find(key) != values_.end();
+  }
+
+  // the first key asked for that is missing is kept
+  string Get(const string& key) {
+    map<string, string>::const_iterator it = values_.find(key);
+    if (it == values_.end()) {
+      if (missing_.empty()) {
+        missing_ = key;
+      }
+      return "0";
+    }
+    return it->second;
+  }
+
+  string Get(const string& key, const string& value) const {
+    map<string, string>::const_iterator it = values_.find(key);
+    return it == values_.end() ? value : it->second;
+  }
+
+  int GetInt(const string& key) {
+    return atoi(Get(key).c_str());
+  }
+
+  vector<size_t> GetSizes(const string& key) {
+    stringstream values(Get(key));
+    vector<size_t> sizes;
+    size_t size;
+    while (values >> size) {
+      sizes.push_back(size);
+    }
+    return sizes;
+  }
+
+  const string& missing() const {
+    return missing_;
+  }
+
+ private:
+  map<string, string> values_;
+  string missing_;
+};
+
+bool Boolean(const string& value) {
+  return value == "true" || value == "True" || value == "yes" ||
+    value == "1";
+}
+
+// as Parser::SetActivation
+shared_ptr<InferActivation> MakeActivation(Description* description,
+  const string& prefix, string* error) {
+  const string type = description->Get(prefix + ".type");
+  const bool short_cut = Boolean(description->Get(prefix + ".short_cut",
+    "false"));
+  shared_ptr<InferActivation> activation;
+  if (type == "Rectlin") {
+    activation = boost::make_shared<Rectlin<CPUTensor, float> >();
+  } else if (type == "Logistic") {
+    activation = boost::make_shared<Logistic<CPUTensor, float> >(short_cut);
+  } else if (type == "Softmax") {
+    activation = boost::make_shared<Softmax<CPUTensor, float> >(short_cut);
+  } else {
+    *error = "Unknown activation type: " + type;
+  }
+  return activation;
+}
+
+// as Parser::SetLayer, collects the names of fillers and optimizers
+shared_ptr<InferLayer> MakeLayer(Description* description,
+  const string& prefix, set<string>* fillers, set<string>* optimizers,
+  string* error) {
+  const string type = description->Get(prefix + ".type");
+  const string name = description->Get(prefix + ".name");
+  shared_ptr<InferLayer> layer;
+
+  if (type == "Affine" || type == "Conv" || type == "ConvBatch") {
+    const string filler_name = description->Get(prefix + ".filler");
+    const string optimizer_name = description->Get(prefix + ".optimizer");
+    const string kernel = description->Get(prefix + ".kernel", "blas");
+    fillers->insert(filler_name);
+    optimizers->insert(optimizer_name);
+
+    shared_ptr<InferActivation> activation;
+    if (description->Has(prefix + ".activation.type")) {
+      activation = MakeActivation(description, prefix + ".activation",
+        error);
+    }
+
+    shared_ptr<InferParamLayer> param_layer;
+    if (type == "Affine") {
+      param_layer = boost::make_shared<Affine<CPUTensor, float> >(name,
+        filler_name, optimizer_name, activation,
+        description->GetInt(prefix + ".nout"), kernel);
+    } else {
+      const int stride = atoi(description->Get(prefix + ".stride",
+        "1").c_str());
+      const int padding = atoi(description->Get(prefix + ".padding",
+        "0").c_str());
+      // the algorithm training ran, gemm for checkpoints that have none
+      // recorded, a library never tunes on the host it is loaded in
+      string algorithm = description->Get(prefix + ".algorithm",
+        type == "ConvBatch" ? "batch" : "gemm");
+      algorithm = description->Get(prefix + ".forward_algorithm",
+        algorithm == "auto" ? "gemm" : algorithm);
+      param_layer = boost::make_shared<Conv<CPUTensor, float> >(name, filler_name,
+        optimizer_name, activation,
+        Shape(description->GetSizes(prefix + ".fshape")), stride, stride,
+        padding, padding, kernel, algorithm);
+    }
+
+    if (description->Has(prefix + ".bias.name")) {
+      typedef InferParamLayer::Bias Bias;
+      const string bias_prefix = prefix + ".bias";
+      shared_ptr<Bias> bias = boost::make_shared<Bias>(
+        description->Get(bias_prefix + ".name"),
+        description->Get(bias_prefix + ".filler"),
+        description->Get(bias_prefix + ".optimizer"));
+      fillers->insert(bias->filler_name());
+      optimizers->insert(bias->optimizer_name());
+      param_layer->set_bias(bias);
+    }
+
+    if (description->Has(prefix + ".batch_norm.name")) {
+      typedef InferParamLayer::BatchNorm BatchNorm;
+      const string batch_norm_prefix = prefix + ".batch_norm";
+      shared_ptr<BatchNorm> batch_norm = boost::make_shared<BatchNorm>(
+        description->Get(batch_norm_prefix + ".name"),
+        description->Get(batch_norm_prefix + ".gamma_filler"),
+        description->Get(batch_norm_prefix + ".gamma_optimizer"),
+        description->Get(batch_norm_prefix + ".beta_filler"),
+        description->Get(batch_norm_prefix + ".beta_optimizer"));
+      fillers->insert(batch_norm->gamma_filler_name());
+      fillers->insert(batch_norm->beta_filler_name());
+      optimizers->insert(batch_norm->gamma_optimizer_name());
+      optimizers->insert(batch_norm->beta_optimizer_name());
+      param_layer->set_batch_norm(batch_norm);
+    }
+    layer = param_layer;
+  } else if (type == "Embedding") {
+    const string filler_name = description->Get(prefix + ".filler");
+    const string optimizer_name = description->Get(prefix + ".optimizer");
+    fillers->insert(filler_name);
+    optimizers->insert(optimizer_name);
+    layer = boost::make_shared<Embedding<CPUTensor, float> >(name, filler_name,
+      optimizer_name, description->GetInt(prefix + ".vocab"),
+      description->GetInt(prefix + ".nout"));
+  } else if (type == "Pooling") {
+    layer = boost::make_shared<PoolingLayer<CPUTensor, float> >(name,
+      description->GetInt(prefix + ".fshape"),
+      description->GetInt(prefix + ".stride"),
+      description->Get(prefix + ".op"));
+  } else if (type == "Dropout") {
+    layer = boost::make_shared<DropoutLayer<CPUTensor, float> >(name,
+      static_cast<float>(atof(description->Get(prefix + ".keep").c_str())));
+  } else {
+    *error = "Unknown layer type: " + type;
+  }
+
+  if (error->empty() && !description->missing().empty()) {
+    *error = "'" + description->missing() + "' parameter missing";
+  }
+  return error->empty() ? layer : shared_ptr<InferLayer>();
+}
+
+// the sample shape after the layer at prefix, as its OutputShape, for
+// descriptions Init would fail on
+bool NextShape(Description* description, const string& prefix,
+  vector<size_t>* shape, string* error) {
+  const string type = description->Get(prefix + ".type");
+  const string name = description->Get(prefix + ".name");
+  size_t size = 1;
+  for (size_t i = 0; i < shape->size(); ++i) {
+    size *= (*shape)[i];
+  }
+  if (type == "Affine") {
+    const int nout = description->GetInt(prefix + ".nout");
+    if (nout <= 0) {
+      *error = "Invalid nout: " + name;
+    }
+    *shape = vector<size_t>(1, nout);
+  } else if (type == "Embedding") {
+    const int vocab = description->GetInt(prefix + ".vocab");
+    const int nout = description->GetInt(prefix + ".nout");
+    if (vocab <= 0 || nout <= 0) {
+      *error = "Invalid vocab or nout: " + name;
+    }
+    *shape = vector<size_t>(1, size * nout);
+  } else if (type == "Conv" || type == "ConvBatch") {
+    const vector<size_t> filter = description->GetSizes(prefix + ".fshape");
+    const int stride = atoi(description->Get(prefix + ".stride",
+      "1").c_str());
+    const int padding = atoi(description->Get(prefix + ".padding",
+      "0").c_str());
+    const string algorithm = description->Get(prefix + ".algorithm",
+      "auto");
+    if (algorithm != "auto" && algorithm != "gemm" && algorithm != "batch" &&
+      algorithm != "direct" && algorithm != "chunk") {
+      *error = "Unknown convolution algorithm: " + algorithm;
+    } else if (shape->size() != 3 || filter.size() != 4 || filter[0] == 0 ||
+      filter[2] == 0 || filter[3] == 0 || stride <= 0 || padding < 0 ||
+      (*shape)[1] + 2 * padding < filter[2] ||
+      (*shape)[2] + 2 * padding < filter[3]) {
+      *error = "Input or filter shape mismatch: " + name;
+    } else {
+      vector<size_t> output(3);
+      output[0] = filter[0];
+      output[1] = ((*shape)[1] + 2 * padding - filter[2]) / stride + 1;
+      output[2] = ((*shape)[2] + 2 * padding - filter[3]) / stride + 1;
+      *shape = output;
+    }
+  } else if (type == "Pooling") {
+    const int filter = description->GetInt(prefix + ".fshape");
+    const int stride = description->GetInt(prefix + ".stride");
+    if (description->Get(prefix + ".op") != "max") {
+      *error = "Unknown pooling op: " + name;
+    } else if (shape->size() != 3 || filter <= 0 || stride <= 0 ||
+      (*shape)[1] < static_cast<size_t>(filter) ||
+      (*shape)[2] < static_cast<size_t>(filter)) {
+      *error = "Input or filter shape mismatch: " + name;
+    } else {
+      (*shape)[1] = ((*shape)[1] - filter) / stride + 1;
+      (*shape)[2] = ((*shape)[2] - filter) / stride + 1;
+    }
+  }
+  return error->empty();
+}
+
+}  // namespace
+
+}  // namespace blitz
+
+struct blitz_infer_model {
+  // declared first, the mapped weights outlive the layers of every
+  // model that shares them
+  blitz::shared_ptr<blitz::Serializer<blitz::CPUTensor, float> > serializer;
+  blitz::shared_ptr<blitz::Scheduler<blitz::CPUTensor, float> > scheduler;
+  blitz::shared_ptr<blitz::LayerWrapper<blitz::CPUTensor, float> >
+    layer_wrapper;
+  blitz::shared_ptr<blitz::CPUTensor<float> > input;
+  int batch_size;
+  size_t input_size;
+  size_t output_size;
+  float mean;
+  float scale;
+};
+
+blitz_infer_model* blitz_infer_create(const char* checkpoint,
+  int batch_size, int num_threads) {
+  using namespace blitz;  // NOLINT(build/namespaces)
+  if (checkpoint == NULL || batch_size <= 0) {
+    SetError("Invalid checkpoint or batch size");
+    return NULL;
+  }
+  // a broken file or model is reported here, not by Load or Init
+  string error;
+  if (!Serializer<CPUTensor, float>::Check(checkpoint, NULL, &error)) {
+    SetError(error);
+    return NULL;
+  }
+  string text;
+  if (!Serializer<CPUTensor, float>::ReadDescription(checkpoint, &text)) {
+    SetError(string("No model in checkpoint: ") + checkpoint);
+    return NULL;
+  }
+
+  Description description(text);
+  const vector<size_t> data_shape = description.GetSizes("data_shape");
+  vector<size_t> shape(data_shape);
+  if (std::find(shape.begin(), shape.end(), 0) != shape.end()) {
+    error = "Invalid data_shape";
+  }
+  list<shared_ptr<InferLayer> > layers;
+  set<string> filler_names;
+  set<string> optimizer_names;
+  for (int i = 0; error.empty(); ++i) {
+    stringstream prefix;
+    prefix << "layers." << i;
+    if (!description.Has(prefix.str() + ".type")) {
+      break;
+    }
+    shared_ptr<InferLayer> layer = MakeLayer(&description, prefix.str(),
+      &filler_names, &optimizer_names, &error);
+    if (error.empty()) {
+      NextShape(&description, prefix.str(), &shape, &error);
+    }
+    layers.push_back(layer);
+  }
+  if (error.empty() && (layers.empty() || data_shape.empty())) {
+    error = "Model without layers or data_shape";
+  }
+  if (!error.empty()) {
+    SetError(error);
+    return NULL;
+  }
+
+  // the weights come from the checkpoint, fillers and optimizers only
+  // register them under their names
+  map<string, shared_ptr<Filler<CPUTensor, float> > > fillers;
+  for (set<string>::iterator it = filler_names.begin();
+    it != filler_names.end(); ++it) {
+    fillers[*it] = boost::make_shared<Constant<CPUTensor, float> >(*it);
+  }
+  map<string, shared_ptr<Optimizer<CPUTensor, float> > > optimizers;
+  for (set<string>::iterator it = optimizer_names.begin();
+    it != optimizer_names.end(); ++it) {
+    optimizers[*it] = boost::make_shared<Gradientdescent<CPUTensor, float> >(*it,
+      0.0f, 0.0f, 0);
+  }
+
+  ThreadPool::Init(num_threads > 0 ? num_threads :
+    ThreadPool::DefaultNumThreads());
+
+  vector<size_t> input_shape(1, batch_size);
+  input_shape.insert(input_shape.end(), data_shape.begin(),
+    data_shape.end());
+
+  blitz_infer_model* model = new blitz_infer_model();
+  model->serializer.reset(new Serializer<CPUTensor, float>());
+  model->scheduler = boost::make_shared<Scheduler<CPUTensor, float> >(optimizers);
+  model->layer_wrapper = boost::make_shared<LayerWrapper<CPUTensor, float> >(
+    layers, shared_ptr<Cost<CPUTensor, float> >());
+  model->layer_wrapper->InitInference(Shape(input_shape),
+    boost::make_shared<FillerWrapper<CPUTensor, float> >(fillers),
+    model->scheduler);
+  model->layer_wrapper->SetInferenceMode();
+  if (!Serializer<CPUTensor, float>::Check(checkpoint, model->scheduler.get(),
+    &error)) {
+    delete model;
+    SetError(error);
+    return NULL;
+  }
+  model->serializer->Load(checkpoint, model->scheduler.get());
+
+  model->input = boost::make_shared<CPUTensor<float> >(Shape(input_shape));
+  model->batch_size = batch_size;
+  model->input_size = model->input->size() / batch_size;
+  model->output_size = model->layer_wrapper->forward_output()->size() /
+    batch_size;
+  model->mean = static_cast<float>(atof(description.Get("data_mean",
+    "0").c_str()));
+  model->scale = static_cast<float>(atof(description.Get("data_scale",
+    "1").c_str()));
+  return model;
+}
+
+blitz_infer_model* blitz_infer_replicate(const blitz_infer_model* model) {
+  blitz_infer_model* replica = new blitz_infer_model(*model);
+  replica->layer_wrapper = model->layer_wrapper->Replicate();
+  // a full batch, the input of model may be reshaped to fewer rows
+  blitz::Shape input_shape(model->input->shape());
+  input_shape[0] = model->batch_size;
+  replica->input = blitz::make_shared<blitz::CPUTensor<float> >(input_shape);
+  return replica;
+}
+
+size_t blitz_infer_input_size(const blitz_infer_model* model) {
+  return model->input_size;
+}
+
+size_t blitz_infer_output_size(const blitz_infer_model* model) {
+  return model->output_size;
+}
+
+int blitz_infer_predict_batch(blitz_infer_model* model, const float* input,
+  int rows, float* output) {
+  if (rows < 0 || rows > model->batch_size) {
+    blitz::SetError("Rows out of batch size");
+    return -1;
+  }
+  if (rows == 0) {
+    return 0;
+  }
+  // only the samples are forwarded
+  blitz::Shape input_shape(model->input->shape());
+  input_shape[0] = rows;
+  model->input->Reshape(input_shape);
+  float* data = model->input->data();
+  const size_t size = rows * model->input_size;
+  for (size_t i = 0; i < size; ++i) {
+    data[i] = (input[i] - model->mean) * model->scale;
+  }
+
+  // concurrent replicas would each fork a BLAS team over the same cores,
+  // BLAS calls stay on the calling thread as they do in the kernel pool
+  const int blas_threads = blitz::BlitzCPUBlasThreads(1);
+  model->layer_wrapper->ForwardProp(model->input);
+  blitz::BlitzCPUBlasThreads(blas_threads);
+  memcpy(output, model->layer_wrapper->forward_output()->data(),
+    rows * model->output_size * sizeof(float));
+  return 0;
+}
+
+void blitz_infer_destroy(blitz_infer_model* model) {
+  delete model;
+}
+
+const char* blitz_infer_error(void) {
+  return blitz::last_error;
+}
@@ -0,0 +1,50 @@
+#ifndef SRC_INFER_BLITZ_INFER_H_
+#define SRC_INFER_BLITZ_INFER_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// C API of libblitz_infer: scores float models on the CPU backend from
+// the checkpoints bin/blitz saves, which carry the layers of the model.
+// The library links no yaml-cpp, hdf5, glog or boost.thread.
+typedef struct blitz_infer_model blitz_infer_model;
+
+// maps checkpoint and builds an inference plan for at most batch_size
+// samples per call; num_threads, 0 for all cores, sizes the kernel pool
+// of the process on the first create, later creates share that pool.
+// Kernels of any thread that predicts run on the pool.
+// NULL on error, also for a truncated or foreign checkpoint and for
+// layers its weights do not fit, see blitz_infer_error
+blitz_infer_model* blitz_infer_create(const char* checkpoint,
+  int batch_size, int num_threads);
+
+// a model sharing the weights of model, with activations of its own.
+// Models that share weights may predict concurrently, each on one thread
+// at a time, and share the kernel pool. Weights stay mapped until the
+// last one is destroyed
+blitz_infer_model* blitz_infer_replicate(const blitz_infer_model* model);
+
+// values of one sample in and out
+size_t blitz_infer_input_size(const blitz_infer_model* model);
+size_t blitz_infer_output_size(const blitz_infer_model* model);
+
+// rows samples of input_size values from input, normalized as in
+// training, rows * output_size values to output; 0 on success.
+// Any rows up to the batch size are forwarded without padding. BLAS
+// calls of the forward pass run single threaded on the calling thread
+int blitz_infer_predict_batch(blitz_infer_model* model, const float* input,
+  int rows, float* output);
+
+void blitz_infer_destroy(blitz_infer_model* model);
+
+// why the last call of this thread failed
+const char* blitz_infer_error(void);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // SRC_INFER_BLITZ_INFER_H_
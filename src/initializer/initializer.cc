@@ -16,52 +16,83 @@ void Initializer::Initialize(const Parser& parser) {
   LOG(INFO) << "Data path: " << parser.data_path();
   LOG(INFO) << "Data type: " << parser.data_type();
   LOG(INFO) << "Label size: " << parser.label_size();
+  LOG(INFO) << "Label type: " << parser.label_type();
   LOG(INFO) << "Batch size: " << parser.batch_size();
   LOG(INFO) << "Epoches: " << parser.epoches();
 
   const int epoches = parser.epoches();
+  // declared first, mapped weights outlive the layers viewing them
   Model<TensorType, DType> model(epoches);
-  shared_ptr<DataIterator<TensorType, DType> > data_set =
-    parser.data_set<TensorType, DType>();
-  shared_ptr<DataIterator<TensorType, DType> > data_label =
-    parser.data_label<TensorType, DType>();
   shared_ptr<FillerWrapper<TensorType, DType> > filler_wrapper =
     parser.filler_wrapper<TensorType, DType>();
   shared_ptr<LayerWrapper<TensorType, DType> > layer_wrapper =
     parser.layer_wrapper<TensorType, DType>();
-  shared_ptr<CallbackWrapper> callback_wrapper =
-    parser.callback_wrapper();
+
+  // registers the weights and states of the layers
+  shared_ptr<Scheduler<TensorType, DType> > scheduler =
+    parser.scheduler<TensorType, DType>();
+  const string& checkpoint = parser.checkpoint();
 
   if (parser.model_type() == "train") {
     LOG(INFO) << "Training";
-    shared_ptr<Scheduler<TensorType, DType> > scheduler =
-      parser.scheduler<TensorType, DType>();
+    shared_ptr<DataIterator<TensorType, DType> > data_set =
+      parser.data_set<TensorType, DType>();
+    shared_ptr<CallbackWrapper> callback_wrapper =
+      parser.callback_wrapper();
+    if (!checkpoint.empty()) {
+      model.set_checkpoint(checkpoint, parser.checkpoint_batches(),
+        parser.checkpoint_epochs());
+      model.set_description(parser.model_description());
+    }
 
     if (parser.eval() == true) {
       shared_ptr<DataIterator<TensorType, DType> > eval_set =
         parser.eval_set<TensorType, DType>();
-      shared_ptr<DataIterator<TensorType, DType> > eval_label =
-        parser.eval_label<TensorType, DType>();
       const string& eval_type = parser.eval_type();
 
-      model.Fit(data_set, data_label, eval_set, eval_label, filler_wrapper,
+      model.Fit(data_set, eval_set, filler_wrapper,
         layer_wrapper, callback_wrapper, scheduler, eval_type);
     } else {
-      model.Fit(data_set, data_label, filler_wrapper,
+      model.Fit(data_set, filler_wrapper,
         layer_wrapper, callback_wrapper, scheduler);
     }
+
+    if (!checkpoint.empty()) {
+      model.Save(checkpoint, scheduler);
+    }
   }
 
-  if (parser.inference() == true) {
+  if (parser.inference() == true || parser.model_type() == "inference") {
     LOG(INFO) << "Inference";
     shared_ptr<DataIterator<TensorType, DType> > inference_set =
       parser.inference_set<TensorType, DType>();
-    shared_ptr<DataIterator<TensorType, DType> > inference_label =
-      parser.inference_label<TensorType, DType>();
     const string& eval_type = parser.eval_type();
 
-    model.Inference(inference_set, inference_label, layer_wrapper,
-      eval_type);
+    if (parser.model_type() != "train") {
+      if (checkpoint.empty()) {
+        LOG(FATAL) << "'checkpoint' parameter missing";
+      }
+      model.Restore(inference_set->input_shape(), checkpoint,
+        filler_wrapper, layer_wrapper, scheduler);
+    }
+
+    model.Inference(inference_set, layer_wrapper, eval_type,
+      parser.output_format());
+  }
+
+  if (parser.model_type() == "serve") {
+    LOG(INFO) << "Serving";
+    if (checkpoint.empty()) {
+      LOG(FATAL) << "'checkpoint' parameter missing";
+    }
+    // batch_size bounds the batches requests are coalesced into
+    Server<TensorType, DType> server(parser.serve_socket(),
+      parser.input_shape(), parser.serve_latency(),
+      static_cast<DType>(parser.data_mean()),
+      static_cast<DType>(parser.data_scale()));
+    model.Restore(server.input_shape(), checkpoint, filler_wrapper,
+      layer_wrapper, scheduler);
+    model.Serve(&server, layer_wrapper);
   }
 }
 
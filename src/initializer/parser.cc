@@ -7,6 +7,50 @@
 
 namespace blitz {
 
+namespace {
+
+// lines of the scalars under node, prefix is its path
+void DescribeNode(const YAML::Node& node, const string& prefix,
+  stringstream* description) {
+  if (node.IsScalar()) {
+    *description << prefix << " " << node.as<string>() << "\n";
+  } else if (node.IsSequence() && node.size() > 0 && node[0].IsScalar()) {
+    *description << prefix;
+    for (size_t i = 0; i < node.size(); ++i) {
+      *description << " " << node[i].as<string>();
+    }
+    *description << "\n";
+  } else if (node.IsSequence()) {
+    for (size_t i = 0; i < node.size(); ++i) {
+      stringstream path;
+      path << prefix << "." << i;
+      DescribeNode(node[i], path.str(), description);
+    }
+  } else if (node.IsMap()) {
+    for (YAML::const_iterator it = node.begin(); it != node.end(); ++it) {
+      DescribeNode(it->second, prefix + "." + it->first.as<string>(),
+        description);
+    }
+  }
+}
+
+}  // namespace
+
+string Parser::model_description() const {
+  stringstream description;
+  DescribeNode(config_["data_shape"], "data_shape", &description);
+  description << "data_mean " << data_mean() << "\n";
+  description << "data_scale " << data_scale() << "\n";
+  // the cost, last of layers, is of no use to inference
+  const YAML::Node layers = config_["layers"];
+  for (size_t i = 0; i + 1 < layers.size(); ++i) {
+    stringstream path;
+    path << "layers." << i;
+    DescribeNode(layers[i], path.str(), &description);
+  }
+  return description.str();
+}
+
 void Parser::SetDefaultArgs() {
   if (!config_["data_type"]) {
     config_["data_type"] = "float";
@@ -110,6 +110,22 @@ class Parser {
     return *label_size_;
   }
 
+  // dense one-hot rows or sparse class indices
+  const string& label_type() const {
+    if (label_type_ == 0) {
+      if (config_["label_type"]) {
+        label_type_ = make_shared<string>(config_["label_type"].as<string>());
+      } else {
+        label_type_ = make_shared<string>("dense");
+        LOG(WARNING) << "'label_type' parameter missing";
+      }
+      if (*label_type_ != "dense" && *label_type_ != "sparse") {
+        LOG(FATAL) << "Unknown label type: " << *label_type_;
+      }
+    }
+    return *label_type_;
+  }
+
   int epoches() const {
     if (epoches_ == 0) {
       if (config_["epoches"]) {
@@ -144,6 +160,170 @@ class Parser {
     return *pool_size_;
   }
 
+  // threads that read hdf5 shards in parallel
+  int io_threads() const {
+    if (io_threads_ == 0) {
+      if (config_["io_threads"]) {
+        io_threads_ = make_shared<int>(config_["io_threads"].as<int>());
+      } else {
+        io_threads_ = make_shared<int>(1);
+        LOG(WARNING) << "'io_threads' parameter missing";
+      }
+    }
+    return *io_threads_;
+  }
+
+  // "pread" on io_threads, or "io_uring" with direct reads
+  string io_engine() const {
+    if (io_engine_ == 0) {
+      if (config_["io_engine"]) {
+        io_engine_ = make_shared<string>(config_["io_engine"].as<string>());
+      } else {
+        io_engine_ = make_shared<string>("pread");
+        LOG(WARNING) << "'io_engine' parameter missing";
+      }
+    }
+    return *io_engine_;
+  }
+
+  // training batches are drawn in a new order every epoch
+  bool shuffle() const {
+    if (shuffle_ == 0) {
+      if (config_["shuffle"]) {
+        shuffle_ = make_shared<bool>(config_["shuffle"].as<bool>());
+      } else {
+        shuffle_ = make_shared<bool>(false);
+        LOG(WARNING) << "'shuffle' parameter missing";
+      }
+    }
+    return *shuffle_;
+  }
+
+  // samples are normalized to (x - data_mean) * data_scale
+  double data_mean() const {
+    if (data_mean_ == 0) {
+      if (config_["data_mean"]) {
+        data_mean_ = make_shared<double>(config_["data_mean"].as<double>());
+      } else {
+        data_mean_ = make_shared<double>(0);
+        LOG(WARNING) << "'data_mean' parameter missing";
+      }
+    }
+    return *data_mean_;
+  }
+
+  double data_scale() const {
+    if (data_scale_ == 0) {
+      if (config_["data_scale"]) {
+        data_scale_ = make_shared<double>(config_["data_scale"].as<double>());
+      } else {
+        data_scale_ = make_shared<double>(1);
+        LOG(WARNING) << "'data_scale' parameter missing";
+      }
+    }
+    return *data_scale_;
+  }
+
+  // checkpoint file, saved after training and loaded for inference
+  const string& checkpoint() const {
+    if (checkpoint_ == 0) {
+      if (config_["checkpoint"]) {
+        checkpoint_ = make_shared<string>(config_["checkpoint"].as<string>());
+      } else {
+        checkpoint_ = make_shared<string>("");
+        LOG(WARNING) << "'checkpoint' parameter missing";
+      }
+    }
+    return *checkpoint_;
+  }
+
+  // csv, binary or hdf5 file of inference outputs
+  const string& output_format() const {
+    if (output_format_ == 0) {
+      if (config_["output_format"]) {
+        output_format_ = make_shared<string>(
+          config_["output_format"].as<string>());
+      } else {
+        output_format_ = make_shared<string>("csv");
+        LOG(WARNING) << "'output_format' parameter missing";
+      }
+    }
+    return *output_format_;
+  }
+
+  // unix socket of model_type serve, stdin and stdout if empty
+  const string& serve_socket() const {
+    if (serve_socket_ == 0) {
+      if (config_["serve_socket"]) {
+        serve_socket_ = make_shared<string>(
+          config_["serve_socket"].as<string>());
+      } else {
+        serve_socket_ = make_shared<string>("");
+        LOG(WARNING) << "'serve_socket' parameter missing";
+      }
+    }
+    return *serve_socket_;
+  }
+
+  // microseconds a request may wait for others to fill its batch
+  int serve_latency() const {
+    if (serve_latency_ == 0) {
+      if (config_["serve_latency"]) {
+        serve_latency_ = make_shared<int>(config_["serve_latency"].as<int>());
+      } else {
+        serve_latency_ = make_shared<int>(1000);
+        LOG(WARNING) << "'serve_latency' parameter missing";
+      }
+    }
+    return *serve_latency_;
+  }
+
+  // input and layers of the model as "key value" lines, keys are paths
+  // of the configuration like layers.0.activation.type, lists of values
+  // are separated by spaces; libblitz_infer reads it from checkpoints
+  string model_description() const;
+
+  // background snapshots to checkpoint every that many batches or
+  // epochs of training, 0 for none
+  int checkpoint_batches() const {
+    if (checkpoint_batches_ == 0) {
+      if (config_["checkpoint_batches"]) {
+        checkpoint_batches_ = make_shared<int>(
+          config_["checkpoint_batches"].as<int>());
+      } else {
+        checkpoint_batches_ = make_shared<int>(0);
+        LOG(WARNING) << "'checkpoint_batches' parameter missing";
+      }
+    }
+    return *checkpoint_batches_;
+  }
+
+  int checkpoint_epochs() const {
+    if (checkpoint_epochs_ == 0) {
+      if (config_["checkpoint_epochs"]) {
+        checkpoint_epochs_ = make_shared<int>(
+          config_["checkpoint_epochs"].as<int>());
+      } else {
+        checkpoint_epochs_ = make_shared<int>(0);
+        LOG(WARNING) << "'checkpoint_epochs' parameter missing";
+      }
+    }
+    return *checkpoint_epochs_;
+  }
+
+  // 0 lets the runtime pick
+  int num_threads() const {
+    if (num_threads_ == 0) {
+      if (config_["num_threads"]) {
+        num_threads_ = make_shared<int>(config_["num_threads"].as<int>());
+      } else {
+        num_threads_ = make_shared<int>(0);
+        LOG(WARNING) << "'num_threads' parameter missing";
+      }
+    }
+    return *num_threads_;
+  }
+
   bool eval() const {
     if (eval_ == 0) {
       if (config_["eval"]) {
@@ -181,12 +361,13 @@ class Parser {
     return *input_shape_;
   }
 
-  // [batch_size, label_size] = label_shape
+  // [batch_size, label_size] = label_shape, [batch_size, 1] for
+  // sparse labels that hold one class index per sample
   const Shape& label_shape() const {
     if (label_shape_ == 0) {
       label_shape_ = make_shared<Shape>(2);
       (*label_shape_)[0] = batch_size();
-      (*label_shape_)[1] = label_size();
+      (*label_shape_)[1] = label_type() == "sparse" ? 1 : label_size();
     }
     return *label_shape_;
   }
@@ -223,6 +404,7 @@ class Parser {
     shared_ptr<LayerWrapper<TensorType, DType> > layer_wrapper =
       make_shared<LayerWrapper<TensorType, DType> >(layers,
       SetCost<TensorType, DType>(node[node.size() - 1]["cost"]));
+    layer_wrapper->set_sparse_target(label_type() == "sparse");
     return layer_wrapper;
   }
 
@@ -266,81 +448,59 @@ class Parser {
     return filler_wrapper;
   }
 
+  // samples and labels of the training or test set
   template<template <typename> class TensorType, typename DType>
   shared_ptr<DataIterator<TensorType, DType> > data_set() const {
     string path = data_path();
+    bool shuffle = false;
     if (model_type() == "train") {
-      path.append("_train_data.log");
+      path.append("_train");
+      shuffle = this->shuffle();
     } else if (model_type() == "inference") {
-      path.append("_test_data.log");
+      path.append("_test");
     } else {
       LOG(FATAL) << "Unknown model type: " << model_type();
     }
     shared_ptr<DataIterator<TensorType, DType> > data_set =
-      make_shared<DataIterator<TensorType, DType> >(
-      path, input_shape(), batch_size(), pool_size());
+      MakeDataSet<TensorType, DType>(path);
+    data_set->set_shuffle(shuffle);
     return data_set;
   }
 
-  template<template <typename> class TensorType, typename DType>
-  shared_ptr<DataIterator<TensorType, DType> > data_label() const {
-    string path = data_path();
-    if (model_type() == "train") {
-      path.append("_train_label.log");
-    } else if (model_type() == "inference") {
-      path.append("_test_label.log");
-    } else {
-      LOG(FATAL) << "Unknown model type: " << model_type();
-    }
-
-    shared_ptr<DataIterator<TensorType, DType> > data_label =
-      make_shared<DataIterator<TensorType, DType> >(
-      path, label_shape(), batch_size(), pool_size());
-    return data_label;
-  }
-
   template<template <typename> class TensorType, typename DType>
   shared_ptr<DataIterator<TensorType, DType> > eval_set() const {
-    string path = data_path();
-    path.append("_eval_data.log");
-    shared_ptr<DataIterator<TensorType, DType> > eval_set =
-      make_shared<DataIterator<TensorType, DType> >(
-      path, input_shape(), batch_size());
-    return eval_set;
-  }
-
-  template<template <typename> class TensorType, typename DType>
-  shared_ptr<DataIterator<TensorType, DType> > eval_label() const {
-    string path = data_path();
-    path.append("_eval_label.log");
-
-    shared_ptr<DataIterator<TensorType, DType> > eval_label =
-      make_shared<DataIterator<TensorType, DType> >(
-      path, label_shape(), batch_size());
-    return eval_label;
+    return MakeDataSet<TensorType, DType>(data_path() + "_eval");
   }
 
+  // labels are optional, without a label list only outputs are written
   template<template <typename> class TensorType, typename DType>
   shared_ptr<DataIterator<TensorType, DType> > inference_set() const {
-    string path = data_path();
-    path.append("_inference_data.log");
-    shared_ptr<DataIterator<TensorType, DType> > inference_set =
-      make_shared<DataIterator<TensorType, DType> >(
-      path, input_shape(), batch_size());
-    return inference_set;
+    const string prefix = data_path() + "_inference";
+    const bool label = std::ifstream((prefix + "_label.log").c_str()).good();
+    return MakeDataSet<TensorType, DType>(prefix, label);
   }
 
+ private:
+  // prefix_data.log and prefix_label.log read by one iterator
   template<template <typename> class TensorType, typename DType>
-  shared_ptr<DataIterator<TensorType, DType> > inference_label() const {
-    string path = data_path();
-    path.append("_inference_label.log");
-    shared_ptr<DataIterator<TensorType, DType> > inference_label =
-      make_shared<DataIterator<TensorType, DType> >(
-      path, label_shape(), batch_size());
-    return inference_label;
+  shared_ptr<DataIterator<TensorType, DType> > MakeDataSet(
+    const string& prefix, const bool label = true) const {
+    shared_ptr<DataIterator<TensorType, DType> > data_set;
+    if (label) {
+      data_set = make_shared<DataIterator<TensorType, DType> >(
+        prefix + "_data.log", input_shape(), prefix + "_label.log",
+        label_shape(), batch_size(), pool_size());
+    } else {
+      data_set = make_shared<DataIterator<TensorType, DType> >(
+        prefix + "_data.log", input_shape(), batch_size(), pool_size());
+    }
+    data_set->set_normalization(static_cast<DType>(data_mean()),
+      static_cast<DType>(data_scale()));
+    data_set->set_io_threads(io_threads());
+    data_set->set_io_engine(io_engine());
+    return data_set;
   }
 
- private:
   // subsetters
   shared_ptr<Callback> SetCallback(const YAML::Node& node) const;
 
@@ -378,14 +538,28 @@ class Parser {
   mutable shared_ptr<string> model_type_;
   mutable shared_ptr<string> eval_type_;
   mutable shared_ptr<string> backend_type_;
+  mutable shared_ptr<string> label_type_;
+  mutable shared_ptr<string> io_engine_;
+  mutable shared_ptr<string> checkpoint_;
+  mutable shared_ptr<string> output_format_;
+  mutable shared_ptr<string> serve_socket_;
 
   mutable shared_ptr<int> epoches_;
   mutable shared_ptr<int> batch_size_;
   mutable shared_ptr<int> label_size_;
   mutable shared_ptr<int> pool_size_;
+  mutable shared_ptr<int> io_threads_;
+  mutable shared_ptr<int> num_threads_;
+  mutable shared_ptr<int> checkpoint_batches_;
+  mutable shared_ptr<int> checkpoint_epochs_;
+  mutable shared_ptr<int> serve_latency_;
+
+  mutable shared_ptr<double> data_mean_;
+  mutable shared_ptr<double> data_scale_;
 
   mutable shared_ptr<bool> eval_;
   mutable shared_ptr<bool> inference_;
+  mutable shared_ptr<bool> shuffle_;
 };
 
 
@@ -13,13 +13,19 @@ shared_ptr<Cost<TensorType, DType> >
   Parser::SetCost(const YAML::Node& node) const {
   shared_ptr<Cost<TensorType, DType> > cost;
   string type = node["type"].as<string>();
+  const bool sparse_target = label_type() == "sparse";
+
+  if (sparse_target && type != "CrossEntropyMulti") {
+    LOG(FATAL) << "Sparse labels need the CrossEntropyMulti cost: " << type;
+  }
 
   if (type == "CrossEntropyBinary") {
     cost = static_pointer_cast<Cost<TensorType, DType> >(
         make_shared<CrossEntropyBinary<TensorType, DType> >());
   } else if (type == "CrossEntropyMulti") {
     cost = static_pointer_cast<Cost<TensorType, DType> >(
-        make_shared<CrossEntropyMulti<TensorType, DType> >());
+        make_shared<CrossEntropyMulti<TensorType, DType> >(1.0,
+          sparse_target));
   } else if (type == "SquareMean") {
     cost = static_pointer_cast<Cost<TensorType, DType> >(
         make_shared<SquareMean<TensorType, DType> >());
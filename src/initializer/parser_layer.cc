@@ -3,7 +3,7 @@
 #include "backend/backends.h"
 #include "layer/affine.h"
 #include "layer/conv.h"
-#include "layer/conv_batch.h"
+#include "layer/embedding.h"
 #include "layer/pooling_layer.h"
 #include "layer/dropout_layer.h"
 #include "layer/param_layer.h"
@@ -77,19 +77,16 @@ shared_ptr<Layer<TensorType, DType> >
       if (node["activation"])
         activation = SetActivation<TensorType, DType>(node["activation"]);
 
-      if (type == "Conv") {
-        param_layer = shared_ptr<ParamLayer<TensorType, DType> >(
-          static_pointer_cast<ParamLayer<TensorType, DType> >(
-          new Conv<TensorType, DType>(name, filler_name,
-          optimizer_name, activation, shape, stride, stride, padding,
-          padding, kernel)));
-      } else if (type == "ConvBatch") {
-        param_layer = shared_ptr<ParamLayer<TensorType, DType> >(
-          static_pointer_cast<ParamLayer<TensorType, DType> >(
-          new ConvBatch<TensorType, DType>(name, filler_name,
-          optimizer_name, activation, shape, stride, stride, padding,
-          padding, kernel)));
-      }
+      // ConvBatch is kept as a shorthand for the batch algorithm
+      string algorithm = type == "ConvBatch" ? "batch" : "auto";
+      if (node["algorithm"])
+        algorithm = node["algorithm"].as<string>();
+
+      param_layer = shared_ptr<ParamLayer<TensorType, DType> >(
+        static_pointer_cast<ParamLayer<TensorType, DType> >(
+        new Conv<TensorType, DType>(name, filler_name,
+        optimizer_name, activation, shape, stride, stride, padding,
+        padding, kernel, algorithm)));
     }
 
     if (node["bias"]) {
@@ -148,6 +145,27 @@ shared_ptr<Layer<TensorType, DType> >
     }
 
     layer = static_pointer_cast<Layer<TensorType, DType> >(param_layer);
+  } else if (type == "Embedding") {
+    if (!node["vocab"])
+      LOG(FATAL) << "'vocab' parameter missing";
+
+    if (!node["nout"])
+      LOG(FATAL) << "'nout' parameter missing";
+
+    if (!node["filler"])
+      LOG(FATAL) << "'filler' parameter missing";
+
+    if (!node["optimizer"])
+      LOG(FATAL) << "'optimizer' parameter missing";
+
+    int vocab = node["vocab"].as<int>();
+    int nout = node["nout"].as<int>();
+    string filler_name = node["filler"].as<string>();
+    string optimizer_name = node["optimizer"].as<string>();
+
+    layer = static_pointer_cast<Layer<TensorType, DType> >(
+      make_shared<Embedding<TensorType, DType> >(name, filler_name,
+      optimizer_name, vocab, nout));
   } else if (type == "Pooling") {
     if (!node["fshape"])
       LOG(FATAL) << "'fshape' parameter missing";
@@ -1,6 +1,7 @@
 #include "layer/affine.h"
 
 #include "backend/backends.h"
+#include "backend/sparse_tensor.h"
 
 namespace blitz {
 
@@ -10,13 +11,13 @@ void Affine<TensorType, DType>::InitImpl(const Shape& input_shape) {
   int batch_size = input_shape[0];
   int nin = input_shape.size() / batch_size;
 
-  Shape output_shape(2);
-  output_shape[0] = batch_size;
-  output_shape[1] = nout_;
+  Shape output_shape = OutputShape(input_shape);
 
   // forward and backward output
-  this->forward_output_ = make_shared<TensorType<DType> >(output_shape);
-  this->backward_output_ = make_shared<TensorType<DType> >(input_shape);
+  this->forward_output_ = this->MakeOutput(output_shape);
+  if (!this->inference_only_) {
+    this->backward_output_ = make_shared<TensorType<DType> >(input_shape);
+  }
 
   // weight and update
   Shape shape_weight(2);
@@ -24,7 +25,11 @@ void Affine<TensorType, DType>::InitImpl(const Shape& input_shape) {
   shape_weight[1] = nout_;
 
   this->weight_ = make_shared<TensorType<DType> >(shape_weight);
-  this->update_ = make_shared<TensorType<DType> >(shape_weight);
+  if (!this->inference_only_) {
+    // sparse input rows only touch the update rows of their columns
+    this->update_ = make_shared<RowSparseTensor<TensorType, DType> >(
+      shape_weight);
+  }
 
   LOG(INFO) << "Affine Layer: " << this->name_;
   LOG(INFO) << "nin: " << nin;
@@ -32,12 +37,38 @@ void Affine<TensorType, DType>::InitImpl(const Shape& input_shape) {
   LOG(INFO) << "nout: " << nout_;
 }
 
+template<template <typename> class TensorType, typename DType>
+Shape Affine<TensorType, DType>::OutputShape(const Shape& input_shape) const {
+  Shape output_shape(2);
+  output_shape[0] = input_shape[0];
+  output_shape[1] = nout_;
+  return output_shape;
+}
+
+template<template <typename> class TensorType, typename DType>
+void Affine<TensorType, DType>::Reshape(const Shape& input_shape) {
+  CHECK_EQ(input_shape.size() / input_shape[0], (this->weight_)->shape()[0])
+    << "Input size mismatch: " << this->name_;
+  ParamLayer<TensorType, DType>::Reshape(input_shape);
+}
+
 template<template <typename> class TensorType, typename DType>
 void Affine<TensorType, DType>::ForwardPropImpl(
   shared_ptr<TensorType<DType> > forward_input) {
-  Backend<TensorType, DType>::MatrixDotFunc(forward_input.get(),
-    (this->weight_).get(), false, false, 1, 0,
-    (this->forward_output_).get(), kernel_);
+  // sparse input rows only touch the weight rows of their non zeros
+  const SparseTensor<TensorType, DType>* sparse_input =
+    dynamic_cast<const SparseTensor<TensorType, DType>*>(
+    forward_input.get());
+  if (sparse_input != NULL) {
+    Backend<TensorType, DType>::SparseMatrixDotFunc(
+      sparse_input->row_offset(), sparse_input->column(),
+      sparse_input->value(), (this->weight_).get(),
+      (this->forward_output_).get());
+  } else {
+    Backend<TensorType, DType>::MatrixDotFunc(forward_input.get(),
+      (this->weight_).get(), false, false, 1, 0,
+      (this->forward_output_).get(), kernel_);
+  }
 }
 
 template<template <typename> class TensorType, typename DType>
@@ -50,7 +81,12 @@ void Affine<TensorType, DType>::BackwardPropImpl(
     duration<double>::zero();
   start = system_clock::now();
   #endif  // BLITZ_PERFORMANCE
+  const SparseTensor<TensorType, DType>* sparse_input =
+    dynamic_cast<const SparseTensor<TensorType, DType>*>(
+    (this->forward_input_).get());
   if (this->backward_prop_) {
+    CHECK(sparse_input == NULL) << "Sparse input of an inner layer: " <<
+      this->name_;
     Backend<TensorType, DType>::MatrixDotFunc(backward_input.get(),
       (this->weight_).get(), false, true, 1, 0,
       (this->backward_output_).get(), kernel_);
@@ -64,9 +100,20 @@ void Affine<TensorType, DType>::BackwardPropImpl(
   #ifdef BLITZ_PERFORMANCE
   start = system_clock::now();
   #endif  // BLITZ_PERFORMANCE
-  Backend<TensorType, DType>::MatrixDotFunc((this->forward_input_).get(),
-    backward_input.get(), true, false, 1, 0,
-    (this->update_).get(), kernel_);
+  RowSparseTensor<TensorType, DType>* update =
+    static_cast<RowSparseTensor<TensorType, DType>*>((this->update_).get());
+  if (sparse_input != NULL) {
+    // only the weight rows of the columns of the batch are updated
+    Backend<TensorType, DType>::SparseMatrixTransposeDotFunc(
+      sparse_input->row_offset(), sparse_input->column(),
+      sparse_input->value(), backward_input.get(), update,
+      update->mutable_rows());
+    update->set_dense(false);
+  } else {
+    Backend<TensorType, DType>::MatrixDotFunc((this->forward_input_).get(),
+      backward_input.get(), true, false, 1, 0, update, kernel_);
+    update->set_dense(true);
+  }
   #ifdef BLITZ_PERFORMANCE
   end = system_clock::now();
   time = end - start;
@@ -74,6 +121,15 @@ void Affine<TensorType, DType>::BackwardPropImpl(
   #endif  // BLITZ_PERFORMANCE
 }
 
+template<template <typename> class TensorType, typename DType>
+shared_ptr<Layer<TensorType, DType> >
+Affine<TensorType, DType>::Replicate() const {
+  shared_ptr<Affine<TensorType, DType> > replica =
+    make_shared<Affine<TensorType, DType> >(*this);
+  this->ReplicateState(replica.get());
+  return replica;
+}
+
 INSTANTIATE_CLASS(Affine);
 
 }  // namespace blitz
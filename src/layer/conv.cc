@@ -1,13 +1,55 @@
 #include "layer/conv.h"
 
 #include "backend/backends.h"
+#include "layer/conv_tuner.h"
+#include "util/blitz_thread_pool.h"
 
 namespace blitz {
 
+namespace {
+
+// only the CPU backend has more than gemm
+template<template <typename> class TensorType>
+struct ConvTunable {
+  static const bool value = false;
+};
+
+template<>
+struct ConvTunable<CPUTensor> {
+  static const bool value = true;
+};
+
+// benchmark runs per candidate, the fastest one is kept
+const int kTuneRounds = 3;
+
+// target size of the chunk unpack buffer, about a private L2
+const size_t kChunkBytes = 1 << 21;
+
+// bytes between buffers of a shared workspace
+const size_t kWorkspaceAlignment = 64;
+
+// a buffer at offset of a shared workspace, whose size is only counted
+// while it is NULL, or one of its own
+template<template <typename> class TensorType, typename DType>
+shared_ptr<TensorType<DType> > MakeBuffer(const Shape& shape,
+  const bool shared, DType* workspace, size_t* offset) {
+  shared_ptr<TensorType<DType> > buffer;
+  if (!shared) {
+    buffer = make_shared<TensorType<DType> >(shape);
+  } else if (workspace != NULL) {
+    buffer = make_shared<TensorType<DType> >(workspace + *offset, shape,
+      false);
+  }
+  const size_t align = kWorkspaceAlignment / sizeof(DType);
+  *offset += (shape.size() + align - 1) / align * align;
+  return buffer;
+}
+
+}  // namespace
+
 template<template <typename> class TensorType, typename DType>
 void Conv<TensorType, DType>::InitImpl(const Shape& input_shape) {
   // input shape decode
-  int batch_size = input_shape[0];
   int input_channel = input_shape[1];
   int input_height = input_shape[2];
   int input_width = input_shape[3];
@@ -15,21 +57,16 @@ void Conv<TensorType, DType>::InitImpl(const Shape& input_shape) {
   int filter_height = filter_shape_[2];
   int filter_width = filter_shape_[3];
   // output shape encode
-  int output_channel = filter_shape_[0];
-  int output_height = (input_height + 2 * padding_height_ - filter_height) /
-    stride_height_ + 1;
-  int output_width = (input_width + 2 * padding_width_ - filter_width) /
-    stride_width_ + 1;
-
-  Shape output_shape(4);
-  output_shape[0] = batch_size;
-  output_shape[1] = output_channel;
-  output_shape[2] = output_height;
-  output_shape[3] = output_width;
+  Shape output_shape = OutputShape(input_shape);
+  int output_channel = output_shape[1];
+  int output_height = output_shape[2];
+  int output_width = output_shape[3];
 
   // forward and backward output
-  this->forward_output_ = make_shared<TensorType<DType> >(output_shape);
-  this->backward_output_ = make_shared<TensorType<DType> >(input_shape);
+  this->forward_output_ = this->MakeOutput(output_shape);
+  if (!this->inference_only_) {
+    this->backward_output_ = make_shared<TensorType<DType> >(input_shape);
+  }
 
   // weight
   Shape shape_weight(4);
@@ -39,13 +76,46 @@ void Conv<TensorType, DType>::InitImpl(const Shape& input_shape) {
   shape_weight[3] = filter_width;
 
   this->weight_ = make_shared<TensorType<DType> >(shape_weight);
-  this->update_ = make_shared<TensorType<DType> >(shape_weight);
+  if (!this->inference_only_) {
+    this->update_ = make_shared<TensorType<DType> >(shape_weight);
+  }
 
-  // unpack one image in every iteration
-  Shape unpack_shape(2);
-  unpack_shape[0] = input_channel * filter_height * filter_width;
-  unpack_shape[1] = output_height * output_width;
-  this->unpack_ = make_shared<TensorType<DType> >(unpack_shape);
+  if (!ConvTunable<TensorType>::value) {
+    if (algorithm_ != "auto" && algorithm_ != "gemm") {
+      LOG(WARNING) << "Convolution algorithm " << algorithm_ <<
+        " is CPU only, use gemm";
+    }
+    forward_algorithm_ = backward_algorithm_ = update_algorithm_ = "gemm";
+  } else if (algorithm_ == "auto") {
+    Tune(input_shape);
+  } else if (algorithm_ == "gemm" || algorithm_ == "batch") {
+    forward_algorithm_ = backward_algorithm_ = update_algorithm_ = algorithm_;
+  } else if (algorithm_ == "direct" || algorithm_ == "chunk") {
+    // neither has a backward pass of its own
+    forward_algorithm_ = algorithm_;
+    backward_algorithm_ = "gemm";
+    update_algorithm_ = algorithm_ == "chunk" ? algorithm_ : "gemm";
+  } else {
+    LOG(FATAL) << "Unknown convolution algorithm: " << algorithm_;
+  }
+
+  // keep only the buffers of the chosen algorithms
+  unpack_.reset();
+  chunk_.reset();
+  unpack_batch_.clear();
+  update_batch_.clear();
+  bool gemm = forward_algorithm_ == "gemm";
+  bool batch = forward_algorithm_ == "batch";
+  bool chunk = forward_algorithm_ == "chunk";
+  if (!this->inference_only_) {
+    gemm = gemm || backward_algorithm_ == "gemm" ||
+      update_algorithm_ == "gemm";
+    batch = batch || backward_algorithm_ == "batch" ||
+      update_algorithm_ == "batch";
+    chunk = chunk || update_algorithm_ == "chunk";
+  }
+  workspace_size_ = AllocateWorkspace(gemm, batch, chunk,
+    this->inference_only_, NULL);
 
   LOG(INFO) << "Conv Layer: " << this->name_;
   LOG(INFO) << "input shape: " << input_channel << " * " << input_height <<
@@ -54,31 +124,313 @@ void Conv<TensorType, DType>::InitImpl(const Shape& input_shape) {
     " * " << input_height << " * " << input_width;
   LOG(INFO) << "output shape: " << output_channel << " * " << output_height <<
     " * " << output_width;
+  LOG(INFO) << "algorithm: forward " << forward_algorithm_ <<
+    " backward " << backward_algorithm_ << " update " << update_algorithm_;
+}
+
+template<template <typename> class TensorType, typename DType>
+Shape Conv<TensorType, DType>::OutputShape(const Shape& input_shape) const {
+  Shape output_shape(4);
+  output_shape[0] = input_shape[0];
+  output_shape[1] = filter_shape_[0];
+  output_shape[2] = (input_shape[2] + 2 * padding_height_ -
+    filter_shape_[2]) / stride_height_ + 1;
+  output_shape[3] = (input_shape[3] + 2 * padding_width_ -
+    filter_shape_[3]) / stride_width_ + 1;
+  return output_shape;
+}
+
+template<template <typename> class TensorType, typename DType>
+void Conv<TensorType, DType>::Reshape(const Shape& input_shape) {
+  CHECK_EQ(input_shape[1], (this->weight_)->shape()[1]) <<
+    "Input channel mismatch: " << this->name_;
+  ParamLayer<TensorType, DType>::Reshape(input_shape);
+
+  const Shape& output_shape = (this->forward_output_)->shape();
+  Shape unpack_shape(2);
+  unpack_shape[0] = input_shape[1] * filter_shape_[2] * filter_shape_[3];
+  unpack_shape[1] = output_shape[2] * output_shape[3];
+  if (chunk_ != 0) {
+    // as many images as the planned buffers hold
+    Shape chunk_unpack_shape(unpack_shape);
+    chunk_unpack_shape[1] *= std::max(static_cast<size_t>(1),
+      unpack_->capacity() / unpack_shape.size());
+    unpack_->Reshape(chunk_unpack_shape);
+
+    Shape chunk_shape(2);
+    chunk_shape[0] = output_shape[1];
+    chunk_shape[1] = chunk_unpack_shape[1];
+    chunk_->Reshape(chunk_shape);
+  } else if (unpack_ != 0) {
+    unpack_->Reshape(unpack_shape);
+  }
+  for (size_t i = 0; i < unpack_batch_.size(); ++i) {
+    if (unpack_batch_[i] != 0) {
+      unpack_batch_[i]->Reshape(unpack_shape);
+    }
+  }
+}
+
+template<template <typename> class TensorType, typename DType>
+size_t Conv<TensorType, DType>::workspace_size() const {
+  return std::max(ParamLayer<TensorType, DType>::workspace_size(),
+    workspace_size_);
+}
+
+template<template <typename> class TensorType, typename DType>
+void Conv<TensorType, DType>::set_workspace(
+  shared_ptr<TensorType<DType> > workspace) {
+  // batch norm runs after the convolution, both start at the front
+  ParamLayer<TensorType, DType>::set_workspace(workspace);
+  if (this->inference_only_) {
+    AllocateWorkspace(forward_algorithm_ == "gemm",
+      forward_algorithm_ == "batch", forward_algorithm_ == "chunk", true,
+      workspace->data());
+  }
+}
+
+template<template <typename> class TensorType, typename DType>
+size_t Conv<TensorType, DType>::AllocateWorkspace(const bool gemm,
+  const bool batch, const bool chunk, const bool shared, DType* workspace) {
+  const Shape& weight_shape = (this->weight_)->shape();
+  const Shape& output_shape = (this->forward_output_)->shape();
+  size_t offset = 0;
+  // unpack one image in every iteration
+  Shape unpack_shape(2);
+  unpack_shape[0] = weight_shape[1] * filter_shape_[2] * filter_shape_[3];
+  unpack_shape[1] = output_shape[2] * output_shape[3];
+
+  if (chunk) {
+    // as many images as fit in the target size, gemm shares the buffer
+    size_t chunk_size = kChunkBytes /
+      (unpack_shape.size() * sizeof(DType));
+    chunk_size = std::max(static_cast<size_t>(1),
+      std::min(chunk_size, static_cast<size_t>(output_shape[0])));
+    Shape chunk_unpack_shape(2);
+    chunk_unpack_shape[0] = unpack_shape[0];
+    chunk_unpack_shape[1] = unpack_shape[1] * chunk_size;
+    unpack_ = MakeBuffer<TensorType, DType>(chunk_unpack_shape, shared,
+      workspace, &offset);
+
+    Shape chunk_shape(2);
+    chunk_shape[0] = output_shape[1];
+    chunk_shape[1] = unpack_shape[1] * chunk_size;
+    chunk_ = MakeBuffer<TensorType, DType>(chunk_shape, shared, workspace,
+      &offset);
+  } else if (gemm) {
+    unpack_ = MakeBuffer<TensorType, DType>(unpack_shape, shared, workspace,
+      &offset);
+  }
+
+  if (batch) {
+    // batch parallel buffer, one per pool thread
+    const int num_threads = ThreadPool::GetInstance().num_threads();
+    if (!this->inference_only_) {
+      update_batch_.resize(num_threads);
+      for (size_t i = 0; i < update_batch_.size(); ++i) {
+        update_batch_[i] = make_shared<TensorType<DType> >(weight_shape);
+      }
+    }
+
+    unpack_batch_.resize(num_threads);
+    for (size_t i = 0; i < unpack_batch_.size(); ++i) {
+      unpack_batch_[i] = MakeBuffer<TensorType, DType>(unpack_shape, shared,
+        workspace, &offset);
+    }
+  }
+  return offset;
+}
+
+template<template <typename> class TensorType, typename DType>
+void Conv<TensorType, DType>::Tune(const Shape& input_shape) {
+  ConvTuner& tuner = ConvTuner::GetInstance();
+  const string key = ConvTuner::Key(input_shape, filter_shape_,
+    stride_height_, stride_width_, padding_height_, padding_width_,
+    sizeof(DType), ThreadPool::GetInstance().num_threads());
+
+  ConvTuner::Choice choice;
+  if (tuner.Find(key, &choice)) {
+    forward_algorithm_ = choice.forward;
+    backward_algorithm_ = choice.backward;
+    update_algorithm_ = choice.update;
+    LOG(INFO) << "Tuned convolution from cache: " << key;
+    return;
+  }
+
+  // inference only layers time the forward pass alone, on buffers of
+  // their own, and leave the cache to training
+  const bool inference_only = this->inference_only_;
+  shared_ptr<TensorType<DType> > output = this->forward_output_;
+  if (inference_only) {
+    this->forward_output_ = make_shared<TensorType<DType> >(output->shape());
+  }
+  AllocateWorkspace(true, true, true, false, NULL);
+  // any values do, the weight is filled later
+  TensorType<DType> input(input_shape);
+  input.Fill(1);
+  (this->weight_)->Fill(1);
+  (this->forward_output_)->Fill(1);
+
+  const char* forward_candidates[] = {"gemm", "batch", "direct", "chunk"};
+  const char* backward_candidates[] = {"gemm", "batch"};
+  const char* update_candidates[] = {"gemm", "batch", "chunk"};
+
+  double best = 0.0;
+  for (size_t i = 0; i < 4; ++i) {
+    double elapsed = Benchmark("forward", forward_candidates[i], &input);
+    if (i == 0 || elapsed < best) {
+      best = elapsed;
+      choice.forward = forward_candidates[i];
+    }
+  }
+  if (inference_only) {
+    this->forward_output_ = output;
+    forward_algorithm_ = choice.forward;
+    backward_algorithm_ = update_algorithm_ = "gemm";
+    LOG(INFO) << "Tuned convolution forward: " << key;
+    return;
+  }
+  for (size_t i = 0; i < 2; ++i) {
+    double elapsed = Benchmark("backward", backward_candidates[i], &input);
+    if (i == 0 || elapsed < best) {
+      best = elapsed;
+      choice.backward = backward_candidates[i];
+    }
+  }
+  for (size_t i = 0; i < 3; ++i) {
+    double elapsed = Benchmark("update", update_candidates[i], &input);
+    if (i == 0 || elapsed < best) {
+      best = elapsed;
+      choice.update = update_candidates[i];
+    }
+  }
+
+  forward_algorithm_ = choice.forward;
+  backward_algorithm_ = choice.backward;
+  update_algorithm_ = choice.update;
+  tuner.Insert(key, choice);
+  LOG(INFO) << "Tuned convolution: " << key;
+}
+
+template<template <typename> class TensorType, typename DType>
+double Conv<TensorType, DType>::Benchmark(const string& phase,
+  const string& algorithm, const TensorType<DType>* input) {
+  double best = 0.0;
+  // the first round warms up caches and pages
+  for (int i = 0; i <= kTuneRounds; ++i) {
+    time_point<system_clock> start = system_clock::now();
+    if (phase == "forward") {
+      Forward(algorithm, input);
+    } else if (phase == "backward") {
+      Backward(algorithm, (this->forward_output_).get());
+    } else {
+      Update(algorithm, input, (this->forward_output_).get());
+    }
+    duration<double> elapsed = system_clock::now() - start;
+    if (i == 1 || (i > 1 && elapsed.count() < best)) {
+      best = elapsed.count();
+    }
+  }
+  LOG(INFO) << "Tune " << phase << " " << algorithm << ": " << best;
+  return best;
+}
+
+template<template <typename> class TensorType, typename DType>
+void Conv<TensorType, DType>::Forward(const string& algorithm,
+  const TensorType<DType>* input) {
+  if (algorithm == "batch") {
+    Backend<TensorType, DType>::Convolution2DForwardFunc(
+      input, (this->weight_).get(),
+      padding_height_, padding_width_, stride_height_, stride_width_,
+      &unpack_batch_, (this->forward_output_).get());
+  } else if (algorithm == "chunk") {
+    Backend<TensorType, DType>::Convolution2DForwardFunc(
+      input, (this->weight_).get(),
+      padding_height_, padding_width_, stride_height_, stride_width_,
+      unpack_.get(), chunk_.get(), (this->forward_output_).get());
+  } else if (algorithm == "direct") {
+    Backend<TensorType, DType>::Convolution2DForwardFunc(
+      input, (this->weight_).get(),
+      padding_height_, padding_width_, stride_height_, stride_width_,
+      (this->forward_output_).get());
+  } else {
+    Backend<TensorType, DType>::Convolution2DForwardFunc(
+      input, (this->weight_).get(),
+      padding_height_, padding_width_, stride_height_, stride_width_,
+      unpack_.get(), (this->forward_output_).get());
+  }
+}
+
+template<template <typename> class TensorType, typename DType>
+void Conv<TensorType, DType>::Backward(const string& algorithm,
+  const TensorType<DType>* backward_input) {
+  if (algorithm == "batch") {
+    Backend<TensorType, DType>::Convolution2DBackwardFunc(
+      backward_input, (this->weight_).get(),
+      padding_height_, padding_width_, stride_height_, stride_width_,
+      &unpack_batch_, (this->backward_output_).get());
+  } else {
+    Backend<TensorType, DType>::Convolution2DBackwardFunc(
+      backward_input, (this->weight_).get(),
+      padding_height_, padding_width_, stride_height_, stride_width_,
+      unpack_.get(), (this->backward_output_).get());
+  }
+}
+
+template<template <typename> class TensorType, typename DType>
+void Conv<TensorType, DType>::Update(const string& algorithm,
+  const TensorType<DType>* input, const TensorType<DType>* backward_input) {
+  if (algorithm == "batch") {
+    for (size_t i = 0; i < update_batch_.size(); ++i) {
+      update_batch_[i]->Fill(0);
+    }
+    Backend<TensorType, DType>::Convolution2DUpdateFunc(
+      input, backward_input,
+      padding_height_, padding_width_, stride_height_, stride_width_,
+      &unpack_batch_, &update_batch_, (this->update_).get());
+  } else if (algorithm == "chunk") {
+    Backend<TensorType, DType>::Convolution2DUpdateFunc(
+      input, backward_input,
+      padding_height_, padding_width_, stride_height_, stride_width_,
+      unpack_.get(), chunk_.get(), (this->update_).get());
+  } else {
+    Backend<TensorType, DType>::Convolution2DUpdateFunc(
+      input, backward_input,
+      padding_height_, padding_width_, stride_height_, stride_width_,
+      unpack_.get(), (this->update_).get());
+  }
 }
 
 template<template <typename> class TensorType, typename DType>
 void Conv<TensorType, DType>::ForwardPropImpl(
   shared_ptr<TensorType<DType> > forward_input) {
   // TODO(keren) fusing
-  Backend<TensorType, DType>::Convolution2DForwardFunc(
-    forward_input.get(), (this->weight_).get(),
-    padding_height_, padding_width_, stride_height_, stride_width_,
-    (this->unpack_).get(), (this->forward_output_).get());
+  Forward(forward_algorithm_, forward_input.get());
 }
 
 template<template <typename> class TensorType, typename DType>
 void Conv<TensorType, DType>::BackwardPropImpl(
   shared_ptr<TensorType<DType> > backward_input) {
   if (this->backward_prop_) {
-    Backend<TensorType, DType>::Convolution2DBackwardFunc(
-    backward_input.get(), (this->weight_).get(),
-    padding_height_, padding_width_, stride_height_, stride_width_,
-    (this->unpack_).get(), (this->backward_output_).get());
-  }
-  Backend<TensorType, DType>::Convolution2DUpdateFunc(
-    (this->forward_input_).get(), backward_input.get(),
-    padding_height_, padding_width_, stride_height_, stride_width_,
-    (this->unpack_).get(), (this->update_).get());
+    Backward(backward_algorithm_, backward_input.get());
+  }
+  Update(update_algorithm_, (this->forward_input_).get(),
+    backward_input.get());
+}
+
+template<template <typename> class TensorType, typename DType>
+shared_ptr<Layer<TensorType, DType> >
+Conv<TensorType, DType>::Replicate() const {
+  shared_ptr<Conv<TensorType, DType> > replica =
+    make_shared<Conv<TensorType, DType> >(*this);
+  this->ReplicateState(replica.get());
+  // unpack buffers are views of the workspace, set_workspace binds new
+  // ones to the workspace of the replica
+  replica->unpack_.reset();
+  replica->chunk_.reset();
+  replica->unpack_batch_.assign(unpack_batch_.size(),
+    shared_ptr<TensorType<DType> >());
+  return replica;
 }
 
 INSTANTIATE_CLASS(Conv);
@@ -2,6 +2,7 @@
 #define SRC_LAYER_CONV_H_
 
 #include <string>
+#include <vector>
 
 #include "layer/param_layer.h"
 #include "util/common.h"
@@ -9,6 +10,14 @@
 
 namespace blitz {
 
+// algorithm:
+// gemm: unpack one image at a time, parallel inside unpack and gemm
+// batch: one image per thread, every thread owns its buffers
+// direct: forward only, no unpack buffer
+// chunk: forward and update unpack several images side by side for one gemm
+// auto: time all of them for this shape and keep the fastest per phase
+// Inference only layers keep the buffers of their forward algorithm in
+// the workspace of the plan.
 template<template <typename> class TensorType, typename DType>
 class Conv : public ParamLayer<TensorType, DType> {
  public:
@@ -19,23 +28,56 @@ class Conv : public ParamLayer<TensorType, DType> {
     const Shape& filter_shape,
     const int stride_height = 1, const int stride_width = 1,
     const int padding_height = 0, const int padding_width = 0,
-    const string& kernel = "blas") :
+    const string& kernel = "blas", const string& algorithm = "gemm") :
     ParamLayer<TensorType, DType>(name, filler_name,
     optimizer_name, activation), filter_shape_(filter_shape),
     stride_height_(stride_height), stride_width_(stride_width),
     padding_height_(padding_height), padding_width_(padding_width),
-    kernel_(kernel) {}
+    kernel_(kernel), algorithm_(algorithm), workspace_size_(0) {}
   ~Conv() {}
 
   virtual void InitImpl(const Shape& input_shape);
+  virtual size_t workspace_size() const;
+  virtual void set_workspace(shared_ptr<TensorType<DType> > workspace);
   virtual void ForwardPropImpl(shared_ptr<TensorType<DType> > forward_input);
   virtual void BackwardPropImpl(shared_ptr<TensorType<DType> > backward_input);
+  virtual shared_ptr<Layer<TensorType, DType> > Replicate() const;
+  // the forward algorithm, tuned or not, for inference to use as it is
+  virtual string description() const {
+    return "forward_algorithm " + forward_algorithm_ + "\n";
+  }
+  // images may be smaller, the chunk algorithm then unpacks more at once
+  virtual void Reshape(const Shape& input_shape);
+
+ protected:
+  virtual Shape OutputShape(const Shape& input_shape) const;
 
  private:
+  void Tune(const Shape& input_shape);
+
+  // the buffers of the algorithms, views of workspace if shared, which
+  // are only counted while it is NULL, returns their size
+  size_t AllocateWorkspace(const bool gemm, const bool batch,
+    const bool chunk, const bool shared, DType* workspace);
+
+  double Benchmark(const string& phase, const string& algorithm,
+    const TensorType<DType>* input);
+
+  void Forward(const string& algorithm, const TensorType<DType>* input);
+
+  void Backward(const string& algorithm,
+    const TensorType<DType>* backward_input);
+
+  void Update(const string& algorithm, const TensorType<DType>* input,
+    const TensorType<DType>* backward_input);
+
   // TODO(keren) bias
   const Shape filter_shape_;
 
   shared_ptr<TensorType<DType> > unpack_;
+  shared_ptr<TensorType<DType> > chunk_;
+  vector<shared_ptr<TensorType<DType> > > unpack_batch_;
+  vector<shared_ptr<TensorType<DType> > > update_batch_;
 
   const int stride_height_;
   const int stride_width_;
@@ -43,6 +85,13 @@ class Conv : public ParamLayer<TensorType, DType> {
   const int padding_width_;
 
   const string kernel_;
+  const string algorithm_;
+
+  string forward_algorithm_;
+  string backward_algorithm_;
+  string update_algorithm_;
+
+  size_t workspace_size_;
 };
 
 }  // namespace blitz
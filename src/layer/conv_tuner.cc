@@ -0,0 +1,114 @@
+#include "layer/conv_tuner.h"
+
+#include <pthread.h>
+
+#include <algorithm>
+
+namespace blitz {
+
+ConvTuner* ConvTuner::instance_ = NULL;
+
+namespace {
+
+pthread_once_t tuner_once = PTHREAD_ONCE_INIT;
+
+}  // namespace
+
+void ConvTuner::Create() {
+  ConvTuner::instance_ = new ConvTuner();
+}
+
+ConvTuner& ConvTuner::GetInstance() {
+  pthread_once(&tuner_once, ConvTuner::Create);
+  return *instance_;
+}
+
+ConvTuner::ConvTuner() {
+  const char* path = getenv("BLITZ_TUNE_CACHE");
+  path_ = path != NULL ? string(path) : string(".blitz_conv_tune");
+
+  std::ifstream ifs(path_.c_str());
+  string line;
+  // later lines win, stale entries are simply shadowed
+  while (std::getline(ifs, line)) {
+    stringstream fields(line);
+    string key;
+    Choice choice;
+    if (!(fields >> key >> choice.forward >> choice.backward >>
+      choice.update) || !Valid(choice)) {
+      if (!line.empty()) {
+        LOG(WARNING) << "Skip tuning cache line: " << line;
+      }
+      continue;
+    }
+    cache_[key] = choice;
+  }
+  if (!cache_.empty()) {
+    LOG(INFO) << "Load " << cache_.size() << " tuned convolutions from: " <<
+      path_;
+  }
+}
+
+string ConvTuner::CPUModel() {
+  std::ifstream ifs("/proc/cpuinfo");
+  string line;
+  while (std::getline(ifs, line)) {
+    if (line.compare(0, 10, "model name") == 0) {
+      string model = line.substr(line.find(':') + 1);
+      boost::algorithm::trim(model);
+      std::replace(model.begin(), model.end(), ' ', '_');
+      return model;
+    }
+  }
+  return "unknown";
+}
+
+string ConvTuner::Key(const Shape& input_shape, const Shape& filter_shape,
+  const int stride_height, const int stride_width,
+  const int padding_height, const int padding_width,
+  const size_t dtype_size, const int num_threads) {
+  static const string cpu_model = CPUModel();
+  stringstream ss;
+  ss << cpu_model << "|t" << num_threads << "|d" << dtype_size << "|i";
+  for (size_t i = 0; i < input_shape.dimension(); ++i) {
+    ss << input_shape[i] << (i + 1 < input_shape.dimension() ? "x" : "");
+  }
+  ss << "|f";
+  for (size_t i = 0; i < filter_shape.dimension(); ++i) {
+    ss << filter_shape[i] << (i + 1 < filter_shape.dimension() ? "x" : "");
+  }
+  ss << "|s" << stride_height << "x" << stride_width <<
+    "|p" << padding_height << "x" << padding_width;
+  return ss.str();
+}
+
+bool ConvTuner::Valid(const Choice& choice) {
+  const string& forward = choice.forward;
+  const string& backward = choice.backward;
+  const string& update = choice.update;
+  return (forward == "gemm" || forward == "batch" || forward == "direct" ||
+    forward == "chunk") && (backward == "gemm" || backward == "batch") &&
+    (update == "gemm" || update == "batch" || update == "chunk");
+}
+
+bool ConvTuner::Find(const string& key, Choice* choice) const {
+  map<string, Choice>::const_iterator it = cache_.find(key);
+  if (it == cache_.end() || !Valid(it->second)) {
+    return false;
+  }
+  *choice = it->second;
+  return true;
+}
+
+void ConvTuner::Insert(const string& key, const Choice& choice) {
+  cache_[key] = choice;
+  ofstream ofs(path_.c_str(), std::ofstream::out | std::ofstream::app);
+  if (!ofs) {
+    LOG(WARNING) << "Can not write tuning cache: " << path_;
+    return;
+  }
+  ofs << key << " " << choice.forward << " " << choice.backward << " " <<
+    choice.update << std::endl;
+}
+
+}  // namespace blitz
@@ -0,0 +1,60 @@
+#ifndef SRC_LAYER_CONV_TUNER_H_
+#define SRC_LAYER_CONV_TUNER_H_
+
+#include <map>
+#include <string>
+
+#include "backend/shape.h"
+#include "util/common.h"
+
+namespace blitz {
+
+// Persistent cache of the fastest convolution algorithms.
+// One line per layer configuration: key forward backward update.
+// The file is BLITZ_TUNE_CACHE or .blitz_conv_tune in the working directory.
+class ConvTuner {
+ public:
+  struct Choice {
+    string forward;
+    string backward;
+    string update;
+  };
+
+  static ConvTuner& GetInstance();
+
+  // shape, stride, padding, data type, threads and cpu model
+  static string Key(const Shape& input_shape, const Shape& filter_shape,
+    const int stride_height, const int stride_width,
+    const int padding_height, const int padding_width,
+    const size_t dtype_size, const int num_threads);
+
+  // false for a missing key or one whose algorithms a phase can not run,
+  // which is tuned again
+  bool Find(const string& key, Choice* choice) const;
+
+  void Insert(const string& key, const Choice& choice);
+
+ private:
+  ConvTuner();
+
+  static void Create();
+
+  static string CPUModel();
+
+  // forward gemm, batch, direct or chunk, backward gemm or batch, update
+  // gemm, batch or chunk, as Conv runs them
+  static bool Valid(const Choice& choice);
+
+  string path_;
+  map<string, Choice> cache_;
+
+  static ConvTuner* instance_;
+
+  // disable copy
+  ConvTuner(const ConvTuner&);
+  ConvTuner& operator=(const ConvTuner&);
+};
+
+}  // namespace blitz
+
+#endif  // SRC_LAYER_CONV_TUNER_H_
@@ -7,16 +7,25 @@ namespace blitz {
 template<template <typename> class TensorType, typename DType>
 void DropoutLayer<TensorType, DType>::InitImpl(const Shape& input_shape) {
   // forward and backward output
-  this->forward_output_ = make_shared<TensorType<DType> >(input_shape);
-  this->backward_output_ = make_shared<TensorType<DType> >(input_shape);
-
-  // mask
-  mask_ = make_shared<TensorType<DType> >(input_shape);
+  this->forward_output_ = this->MakeOutput(input_shape);
+  if (!this->inference_only_) {
+    this->backward_output_ = make_shared<TensorType<DType> >(input_shape);
+    // mask
+    mask_ = make_shared<TensorType<DType> >(input_shape);
+  }
 
   LOG(INFO) << "Dropout Layer: " << this->name_;
   LOG(INFO) << "Keep: " << keep_;
 }
 
+template<template <typename> class TensorType, typename DType>
+void DropoutLayer<TensorType, DType>::Reshape(const Shape& input_shape) {
+  Layer<TensorType, DType>::Reshape(input_shape);
+  if (mask_ != 0) {
+    mask_->Reshape(input_shape);
+  }
+}
+
 template<template <typename> class TensorType, typename DType>
 void DropoutLayer<TensorType, DType>::ForwardPropImpl(
   shared_ptr<TensorType<DType> > forward_input) {
@@ -38,6 +47,15 @@ void DropoutLayer<TensorType, DType>::BackwardPropImpl(
     mask_.get(), (this->backward_output_).get());
 }
 
+template<template <typename> class TensorType, typename DType>
+shared_ptr<Layer<TensorType, DType> >
+DropoutLayer<TensorType, DType>::Replicate() const {
+  shared_ptr<DropoutLayer<TensorType, DType> > replica =
+    make_shared<DropoutLayer<TensorType, DType> >(*this);
+  this->ReplicateState(replica.get());
+  return replica;
+}
+
 INSTANTIATE_CLASS(DropoutLayer);
 
 }  // namespace blitz
@@ -19,6 +19,13 @@ class DropoutLayer : public Layer<TensorType, DType> {
   virtual void InitImpl(const Shape& input_shape);
   virtual void ForwardPropImpl(shared_ptr<TensorType<DType> > forward_input);
   virtual void BackwardPropImpl(shared_ptr<TensorType<DType> > backward_input);
+  virtual shared_ptr<Layer<TensorType, DType> > Replicate() const;
+  virtual void Reshape(const Shape& input_shape);
+
+ protected:
+  virtual Shape OutputShape(const Shape& input_shape) const {
+    return input_shape;
+  }
 
  private:
   const DType keep_;
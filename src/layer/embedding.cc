@@ -0,0 +1,88 @@
+#include "layer/embedding.h"
+
+#include "backend/backends.h"
+
+namespace blitz {
+
+template<template <typename> class TensorType, typename DType>
+void Embedding<TensorType, DType>::Init(const Shape& input_shape,
+  shared_ptr<FillerWrapper<TensorType, DType> > filler_wrapper,
+  shared_ptr<Scheduler<TensorType, DType> > scheduler) {
+  Layer<TensorType, DType>::Init(input_shape, filler_wrapper, scheduler);
+  // set filler
+  filler_wrapper->AddLayer(this->filler_name_, this->name_, this->weight_);
+  // set update state
+  scheduler->AddLayer(this->optimizer_name_, this->name_, this->weight_,
+    this->update_);
+}
+
+template<template <typename> class TensorType, typename DType>
+void Embedding<TensorType, DType>::InitImpl(const Shape& input_shape) {
+  // input ids and output
+  int batch_size = input_shape[0];
+  int fields = input_shape.size() / batch_size;
+
+  Shape output_shape = OutputShape(input_shape);
+
+  // forward and backward output, ids have no gradient
+  this->forward_output_ = this->MakeOutput(output_shape);
+  if (!this->inference_only_) {
+    this->backward_output_ = make_shared<TensorType<DType> >(input_shape);
+    (this->backward_output_)->Fill(0);
+  }
+
+  // weight and update
+  Shape shape_weight(2);
+  shape_weight[0] = vocab_;
+  shape_weight[1] = nout_;
+
+  this->weight_ = make_shared<TensorType<DType> >(shape_weight);
+  if (!this->inference_only_) {
+    this->update_ = make_shared<RowSparseTensor<TensorType, DType> >(
+      shape_weight);
+  }
+
+  LOG(INFO) << "Embedding Layer: " << this->name_;
+  LOG(INFO) << "fields: " << fields;
+  LOG(INFO) << "weight shape: " << vocab_ << " * " << nout_;
+  LOG(INFO) << "nout: " << fields * nout_;
+}
+
+template<template <typename> class TensorType, typename DType>
+Shape Embedding<TensorType, DType>::OutputShape(
+  const Shape& input_shape) const {
+  Shape output_shape(2);
+  output_shape[0] = input_shape[0];
+  output_shape[1] = input_shape.size() / input_shape[0] * nout_;
+  return output_shape;
+}
+
+template<template <typename> class TensorType, typename DType>
+void Embedding<TensorType, DType>::ForwardPropImpl(
+  shared_ptr<TensorType<DType> > forward_input) {
+  Backend<TensorType, DType>::EmbeddingForwardFunc(forward_input.get(),
+    (this->weight_).get(), (this->forward_output_).get());
+  this->forward_input_ = forward_input;
+}
+
+template<template <typename> class TensorType, typename DType>
+void Embedding<TensorType, DType>::BackwardPropImpl(
+  shared_ptr<TensorType<DType> > backward_input) {
+  // only rows of the ids of this batch are written and listed
+  Backend<TensorType, DType>::EmbeddingBackwardUpdateFunc(
+    (this->forward_input_).get(), backward_input.get(),
+    (this->update_).get(), (this->update_)->mutable_rows());
+}
+
+template<template <typename> class TensorType, typename DType>
+shared_ptr<Layer<TensorType, DType> >
+Embedding<TensorType, DType>::Replicate() const {
+  shared_ptr<Embedding<TensorType, DType> > replica =
+    make_shared<Embedding<TensorType, DType> >(*this);
+  this->ReplicateState(replica.get());
+  return replica;
+}
+
+INSTANTIATE_CLASS(Embedding);
+
+}  // namespace blitz
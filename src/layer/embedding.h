@@ -0,0 +1,49 @@
+#ifndef SRC_LAYER_EMBEDDING_H_
+#define SRC_LAYER_EMBEDDING_H_
+
+#include <string>
+
+#include "backend/sparse_tensor.h"
+#include "layer/layer.h"
+#include "util/common.h"
+
+namespace blitz {
+
+// Looks up a row of nout values for every categorical id of the input,
+// [batch, fields] ids become [batch, fields * nout] outputs.
+// The update only holds the rows of the ids of the batch, an optimizer
+// changes those rows of the table and no others.
+template<template <typename> class TensorType, typename DType>
+class Embedding : public Layer<TensorType, DType> {
+ public:
+  explicit Embedding(
+    const string& name, const string& filler_name,
+    const string& optimizer_name, const int vocab, const int nout) :
+    Layer<TensorType, DType>(name), filler_name_(filler_name),
+    optimizer_name_(optimizer_name), vocab_(vocab), nout_(nout) {}
+  ~Embedding() {}
+
+  virtual void Init(const Shape& input_shape,
+    shared_ptr<FillerWrapper<TensorType, DType> > filler_wrapper,
+    shared_ptr<Scheduler<TensorType, DType> > scheduler);
+  virtual void InitImpl(const Shape& input_shape);
+  virtual void ForwardPropImpl(shared_ptr<TensorType<DType> > forward_input);
+  virtual void BackwardPropImpl(shared_ptr<TensorType<DType> > backward_input);
+  virtual shared_ptr<Layer<TensorType, DType> > Replicate() const;
+
+ protected:
+  virtual Shape OutputShape(const Shape& input_shape) const;
+
+ private:
+  const string filler_name_;
+  const string optimizer_name_;
+  const int vocab_;
+  const int nout_;
+
+  shared_ptr<TensorType<DType> > weight_;
+  shared_ptr<RowSparseTensor<TensorType, DType> > update_;
+};
+
+}  // namespace blitz
+
+#endif  // SRC_LAYER_EMBEDDING_H_
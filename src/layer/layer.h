@@ -14,7 +14,8 @@ template<template <typename> class TensorType, typename DType>
 class Layer {
  public:
   explicit Layer(const string& name) :
-    name_(name), train_(true), backward_prop_(true) {}  // indicate pure virtual
+    name_(name), train_(true), backward_prop_(true),
+    inference_only_(false) {}  // indicate pure virtual
   virtual ~Layer() {}  // ensure pure virtual
 
   virtual void Init(const Shape& input_shape,
@@ -100,6 +101,44 @@ class Layer {
     this->backward_prop_ = backward_prop;
   }
 
+  // before Init, the layer keeps no backward state and its forward output
+  // has no data until an inference plan binds one
+  void set_inference_only(const bool inference_only) {
+    this->inference_only_ = inference_only;
+  }
+
+  bool inference_only() const {
+    return this->inference_only_;
+  }
+
+  // forward scratch of inference only layers, one workspace of the largest
+  // size is shared by all layers of a plan
+  virtual size_t workspace_size() const {
+    return 0;
+  }
+
+  virtual void set_workspace(shared_ptr<TensorType<DType> > workspace) {}
+
+  // after Init, "key value" lines of what the layer chose by itself, which
+  // a checkpoint description records under the layer
+  virtual string description() const {
+    return "";
+  }
+
+  // an inference only layer sharing the weights of this one, with forward
+  // state of its own, its output and workspace are bound by a plan
+  virtual shared_ptr<Layer<TensorType, DType> > Replicate() const = 0;
+
+  // after Init, adapts the layer to an input of at most the size it was
+  // initialized with, a smaller batch or smaller images; outputs and
+  // buffers only change their shapes, nothing is allocated
+  virtual void Reshape(const Shape& input_shape) {
+    (this->forward_output_)->Reshape(this->OutputShape(input_shape));
+    if (this->backward_output_ != 0) {
+      (this->backward_output_)->Reshape(input_shape);
+    }
+  }
+
   // Two modes
   void SetTrainMode() {
     this->train_ = true;
@@ -110,6 +149,37 @@ class Layer {
   }
 
  protected:
+  virtual Shape OutputShape(const Shape& input_shape) const = 0;
+
+  // a forward output of shape, without data for inference only layers
+  shared_ptr<TensorType<DType> > MakeOutput(const Shape& shape) const {
+    if (this->inference_only_) {
+      return make_shared<TensorType<DType> >(static_cast<DType*>(NULL),
+        shape, false);
+    }
+    return make_shared<TensorType<DType> >(shape);
+  }
+
+  // a view of the data of tensor with its shape and capacity
+  static shared_ptr<TensorType<DType> > MakeView(
+    const TensorType<DType>& tensor) {
+    Shape capacity(1);
+    capacity[0] = tensor.capacity();
+    shared_ptr<TensorType<DType> > view = make_shared<TensorType<DType> >(
+      const_cast<DType*>(tensor.data()), capacity, false);
+    view->Reshape(tensor.shape());
+    return view;
+  }
+
+  // forward state of replica that must not be shared with this layer
+  virtual void ReplicateState(Layer<TensorType, DType>* replica) const {
+    CHECK(this->inference_only_) << "Replicate a training layer: " <<
+      this->name_;
+    replica->forward_input_.reset();
+    // reshaping the replica leaves this layer as it is
+    replica->forward_output_ = MakeView(*(this->forward_output_));
+  }
+
   shared_ptr<TensorType<DType> > forward_input_;
   shared_ptr<TensorType<DType> > forward_output_;
   shared_ptr<TensorType<DType> > backward_output_;
@@ -117,6 +187,7 @@ class Layer {
   const string name_;
   bool train_;
   bool backward_prop_;
+  bool inference_only_;
 };
 
 }  // namespace blitz
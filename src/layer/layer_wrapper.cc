@@ -1,5 +1,6 @@
 #include "layer/layer_wrapper.h"
 
+#include <algorithm>
 #include <list>
 #include <string>
 
@@ -9,6 +10,85 @@ namespace blitz {
 
 template<template <typename> class TensorType, typename DType>
 void LayerWrapper<TensorType, DType>::Init(const Shape& input_shape,
+  shared_ptr<FillerWrapper<TensorType, DType> > filler_wrapper,
+  shared_ptr<Scheduler<TensorType, DType> > scheduler) {
+  InitLayers(input_shape, filler_wrapper, scheduler);
+  data_shape_ = input_shape_ = input_shape;
+
+  // init error_
+  const Shape& output_shape = (*layers_.rbegin())->forward_output_shape();
+  error_ = make_shared<TensorType<DType> >(output_shape);
+
+  // set first layer not bprop
+  (*layers_.begin())->set_backward_prop(false);
+}
+
+template<template <typename> class TensorType, typename DType>
+void LayerWrapper<TensorType, DType>::InitInference(const Shape& input_shape,
+  shared_ptr<FillerWrapper<TensorType, DType> > filler_wrapper,
+  shared_ptr<Scheduler<TensorType, DType> > scheduler) {
+  for (LayerIterator it = begin(); it != end(); ++it) {
+    (*it)->set_inference_only(true);
+  }
+  InitLayers(input_shape, filler_wrapper, scheduler);
+  data_shape_ = input_shape_ = input_shape;
+  BindInference();
+}
+
+template<template <typename> class TensorType, typename DType>
+shared_ptr<LayerWrapper<TensorType, DType> >
+LayerWrapper<TensorType, DType>::Replicate() const {
+  list<shared_ptr<Layer<TensorType, DType> > > layers;
+  for (typename list<shared_ptr<Layer<TensorType, DType> > >::const_iterator
+    it = layers_.begin(); it != layers_.end(); ++it) {
+    layers.push_back((*it)->Replicate());
+  }
+  shared_ptr<LayerWrapper<TensorType, DType> > replica(
+    new LayerWrapper<TensorType, DType>(layers, cost_));
+  replica->sparse_target_ = sparse_target_;
+  // the plan is laid out for the data shape
+  replica->data_shape_ = data_shape_;
+  replica->Reshape(data_shape_);
+  replica->BindInference();
+  return replica;
+}
+
+template<template <typename> class TensorType, typename DType>
+void LayerWrapper<TensorType, DType>::BindInference() {
+  size_t output_size = 0;
+  size_t workspace_size = 0;
+  for (LayerIterator it = begin(); it != end(); ++it) {
+    output_size = std::max(output_size, (*it)->forward_output_shape().size());
+    workspace_size = std::max(workspace_size, (*it)->workspace_size());
+  }
+
+  // a layer reads the buffer of the one before and writes the other
+  Shape buffer_shape(1);
+  buffer_shape[0] = output_size;
+  buffers_[0] = make_shared<TensorType<DType> >(buffer_shape);
+  buffers_[1] = make_shared<TensorType<DType> >(buffer_shape);
+  if (workspace_size > 0) {
+    Shape workspace_shape(1);
+    workspace_shape[0] = workspace_size;
+    workspace_ = make_shared<TensorType<DType> >(workspace_shape);
+  }
+
+  size_t index = 0;
+  for (LayerIterator it = begin(); it != end(); ++it, ++index) {
+    (*it)->set_forward_output(make_shared<TensorType<DType> >(
+      buffers_[index % 2]->data(), (*it)->forward_output_shape(), false));
+    if ((*it)->workspace_size() > 0) {
+      (*it)->set_workspace(workspace_);
+    }
+  }
+
+  LOG(INFO) << "Inference plan: activation bytes " <<
+    2 * output_size * sizeof(DType) << " workspace bytes " <<
+    workspace_size * sizeof(DType);
+}
+
+template<template <typename> class TensorType, typename DType>
+void LayerWrapper<TensorType, DType>::InitLayers(const Shape& input_shape,
   shared_ptr<FillerWrapper<TensorType, DType> > filler_wrapper,
   shared_ptr<Scheduler<TensorType, DType> > scheduler) {
   // first input layer
@@ -25,18 +105,29 @@ void LayerWrapper<TensorType, DType>::Init(const Shape& input_shape,
     prev_layer = *layer_it;
     ++layer_it;
   }
+}
 
-  // init error_
-  const Shape& output_shape = (*layers_.rbegin())->forward_output_shape();
-  error_ = make_shared<TensorType<DType> >(output_shape);
-
-  // set first layer not bprop
-  (*layers_.begin())->set_backward_prop(false);
+template<template <typename> class TensorType, typename DType>
+void LayerWrapper<TensorType, DType>::Reshape(const Shape& input_shape) {
+  CHECK_EQ(input_shape.dimension(), data_shape_.dimension()) <<
+    "Input dimension mismatch";
+  Shape shape(input_shape);
+  for (LayerIterator it = begin(); it != end(); ++it) {
+    (*it)->Reshape(shape);
+    shape = (*it)->forward_output_shape();
+  }
+  if (error_ != 0) {
+    error_->Reshape(shape);
+  }
+  input_shape_ = input_shape;
 }
 
 template<template <typename> class TensorType, typename DType>
 void LayerWrapper<TensorType, DType>::ForwardProp(
   shared_ptr<TensorType<DType> > input) {
+  if (input->shape() != input_shape_) {
+    Reshape(input->shape());
+  }
   LayerIterator it = begin();
   while (it != end()) {
     (*it)->ForwardProp(input);
@@ -75,10 +166,15 @@ DType LayerWrapper<TensorType, DType>::Evaluate(
     const shared_ptr<TensorType<DType> > target, const string& eval_type) {
   shared_ptr<TensorType<DType> > output = (*layers_.rbegin())->forward_output();
   DType accuracy = 0.0;
-  if (eval_type == "classify") {
+  CheckTarget(*output, *target, sparse_target_);
+  if (eval_type == "classify" && sparse_target_) {
+    accuracy = Backend<TensorType, DType>::EvaluateClassifySparseFunc(
+      output.get(), target.get());
+  } else if (eval_type == "classify") {
     accuracy = Backend<TensorType, DType>::EvaluateClassifyFunc(
       output.get(), target.get());
   } else if (eval_type == "regress") {
+    CHECK(!sparse_target_) << "Sparse labels only classify";
     accuracy = Backend<TensorType, DType>::EvaluateRegressFunc(
       output.get(), target.get());
   }
@@ -103,6 +199,21 @@ void LayerWrapper<TensorType, DType>::SetInferenceMode() {
   }
 }
 
+template<template <typename> class TensorType, typename DType>
+string LayerWrapper<TensorType, DType>::description() const {
+  stringstream description;
+  typename list<shared_ptr<Layer<TensorType, DType> > >::const_iterator it =
+    layers_.begin();
+  for (size_t i = 0; it != layers_.end(); ++it, ++i) {
+    stringstream lines((*it)->description());
+    string line;
+    while (getline(lines, line)) {
+      description << "layers." << i << "." << line << "\n";
+    }
+  }
+  return description.str();
+}
+
 INSTANTIATE_CLASS(LayerWrapper);
 
 }  // namespace blitz
@@ -26,7 +26,8 @@ class LayerWrapper {
   explicit LayerWrapper(
     const list<shared_ptr<Layer<TensorType, DType> > >& layers,
     shared_ptr<Cost<TensorType, DType> > cost) :
-    layers_(layers), cost_(cost) {}
+    layers_(layers), cost_(cost), sparse_target_(false), data_shape_(0),
+    input_shape_(0) {}
 
   // STL like function
   void push_back(shared_ptr<Layer<TensorType, DType> > layer) {
@@ -42,6 +43,11 @@ class LayerWrapper {
     cost_ = cost;
   }
 
+  // targets are class indices, label_type sparse
+  void set_sparse_target(const bool sparse_target) {
+    sparse_target_ = sparse_target;
+  }
+
   // iterators
   LayerIterator begin() {
     return layers_.begin();
@@ -74,6 +80,24 @@ class LayerWrapper {
     shared_ptr<FillerWrapper<TensorType, DType> > filler_wrapper,
     shared_ptr<Scheduler<TensorType, DType> > scheduler);
 
+  // inference plan: layers keep their weights only, outputs alternate
+  // between two buffers of the largest output and forward scratch shares
+  // one workspace, no backward pass is possible afterwards
+  void InitInference(const Shape& data_shape,
+    shared_ptr<FillerWrapper<TensorType, DType> > filler_wrapper,
+    shared_ptr<Scheduler<TensorType, DType> > scheduler);
+
+  // after InitInference, a plan sharing the weights of this one with
+  // outputs and workspace of its own; plans sharing weights may run
+  // ForwardProp concurrently, one plan on one thread at a time
+  shared_ptr<LayerWrapper<TensorType, DType> > Replicate() const;
+
+  // after Init, adapts the layers to inputs of input_shape, which may
+  // have fewer samples than the data shape or, without affine layers in
+  // between, smaller images; the buffers of Init are reused as they are.
+  // ForwardProp reshapes to the shape of its input by itself.
+  void Reshape(const Shape& input_shape);
+
   void ForwardProp(shared_ptr<TensorType<DType> > input);
 
   void BackwardProp();
@@ -82,10 +106,30 @@ class LayerWrapper {
 
   void SetInferenceMode();
 
+  // after Init, the description lines of the layers, prefixed by
+  // layers.<index> as in Parser::model_description
+  string description() const;
+
  private:
+  void InitLayers(const Shape& data_shape,
+    shared_ptr<FillerWrapper<TensorType, DType> > filler_wrapper,
+    shared_ptr<Scheduler<TensorType, DType> > scheduler);
+
+  // buffers and workspace of the inference plan bound to the layers
+  void BindInference();
+
   list<shared_ptr<Layer<TensorType, DType> > > layers_;
   shared_ptr<Cost<TensorType, DType> > cost_;
   shared_ptr<TensorType<DType> > error_;
+  bool sparse_target_;
+
+  // the shape the layers were initialized with and the one they have now
+  Shape data_shape_;
+  Shape input_shape_;
+
+  // inference plan
+  shared_ptr<TensorType<DType> > buffers_[2];
+  shared_ptr<TensorType<DType> > workspace_;
 };
 
 }  // namespace blitz
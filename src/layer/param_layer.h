@@ -4,6 +4,7 @@
 #include <string>
 
 #include "backend/backend.h"
+#include "backend/sparse_tensor.h"
 #include "layer/layer.h"
 #include "util/common.h"
 #include "filler/filler.h"
@@ -187,8 +188,10 @@ class ParamLayer : public Layer<TensorType, DType> {
       // make beta tensor
       (this->bias_)->set_weight(
         make_shared<TensorType<DType> >(shape));
-      (this->bias_)->set_update(
-        make_shared<TensorType<DType> >(shape));
+      if (!this->inference_only_) {
+        (this->bias_)->set_update(
+          make_shared<TensorType<DType> >(shape));
+      }
       // set filler
       filler_wrapper->AddLayer((this->bias_)->filler_name(),
         (this->bias_)->name(), (this->bias_)->weight());
@@ -202,16 +205,18 @@ class ParamLayer : public Layer<TensorType, DType> {
       // make beta tensor
       (this->batch_norm_)->set_beta_weight(
         make_shared<TensorType<DType> >(shape));
-      (this->batch_norm_)->set_beta_update(
-        make_shared<TensorType<DType> >(shape));
       // make gamma tensor
       (this->batch_norm_)->set_gamma_weight(
         make_shared<TensorType<DType> >(shape));
-      (this->batch_norm_)->set_gamma_update(
-        make_shared<TensorType<DType> >(shape));
-      // input mean and variance
-      (this->batch_norm_)->set_input_hat(
-        make_shared<TensorType<DType> >(output_shape));
+      if (!this->inference_only_) {
+        (this->batch_norm_)->set_beta_update(
+          make_shared<TensorType<DType> >(shape));
+        (this->batch_norm_)->set_gamma_update(
+          make_shared<TensorType<DType> >(shape));
+        // input mean and variance, in the workspace for inference only
+        (this->batch_norm_)->set_input_hat(
+          make_shared<TensorType<DType> >(output_shape));
+      }
       (this->batch_norm_)->set_input_var(
         make_shared<TensorType<DType> >(shape));
       // set filler
@@ -235,6 +240,53 @@ class ParamLayer : public Layer<TensorType, DType> {
 
   virtual void InitImpl(const Shape& input_shape) = 0;
 
+  virtual size_t workspace_size() const {
+    if (batch_norm_ != 0 && this->inference_only_) {
+      return (this->forward_output_)->size();
+    }
+    return 0;
+  }
+
+  virtual void set_workspace(shared_ptr<TensorType<DType> > workspace) {
+    if (batch_norm_ != 0 && this->inference_only_) {
+      (this->batch_norm_)->set_input_hat(make_shared<TensorType<DType> >(
+        workspace->data(), (this->forward_output_)->shape(), false));
+    }
+  }
+
+  // bias and batch norm hold a value per output of a sample, which
+  // must keep its size
+  virtual void Reshape(const Shape& input_shape) {
+    Layer<TensorType, DType>::Reshape(input_shape);
+    const Shape& output_shape = (this->forward_output_)->shape();
+    const size_t output_size = output_shape.size() / output_shape[0];
+    if (bias_ != 0) {
+      CHECK_EQ(output_size, (this->bias_)->weight()->size()) <<
+        "Bias size mismatch: " << this->name_;
+    }
+    if (batch_norm_ != 0) {
+      CHECK_EQ(output_size, (this->batch_norm_)->beta_weight()->size()) <<
+        "Batch norm size mismatch: " << this->name_;
+      (this->batch_norm_)->input_hat()->Reshape(output_shape);
+    }
+  }
+
+  // batch statistics are forward state, gamma and beta are shared
+  virtual void ReplicateState(Layer<TensorType, DType>* replica) const {
+    Layer<TensorType, DType>::ReplicateState(replica);
+    if (batch_norm_ != 0) {
+      ParamLayer<TensorType, DType>* param_replica =
+        static_cast<ParamLayer<TensorType, DType>*>(replica);
+      param_replica->batch_norm_ = make_shared<BatchNorm>(*batch_norm_);
+      (param_replica->batch_norm_)->set_input_var(
+        make_shared<TensorType<DType> >(batch_norm_->input_var()->shape()));
+      if (batch_norm_->input_hat() != 0) {
+        (param_replica->batch_norm_)->set_input_hat(
+          this->MakeView(*(batch_norm_->input_hat())));
+      }
+    }
+  }
+
   // forward
   virtual void ForwardProp(shared_ptr<TensorType<DType> > forward_input) {
     Layer<TensorType, DType>::ForwardProp(forward_input);
@@ -360,7 +412,11 @@ class ParamLayer : public Layer<TensorType, DType> {
       batch_norm_time.count();
     #endif  // BLITZ_PERFORMANCE
 
-    (this->update_)->Fill(0);
+    // row sparse updates clear the rows they list themselves
+    if (dynamic_cast<RowSparseTensor<TensorType, DType>*>(
+      (this->update_).get()) == NULL) {
+      (this->update_)->Fill(0);
+    }
     Layer<TensorType, DType>::BackwardProp(backward_input);
   }
 
@@ -7,24 +7,20 @@ namespace blitz {
 template<template <typename> class TensorType, typename DType>
 void PoolingLayer<TensorType, DType>::InitImpl(const Shape& input_shape) {
   // input shape decode
-  int batch_size = input_shape[0];
   int input_channel = input_shape[1];
   int input_height = input_shape[2];
   int input_width = input_shape[3];
   // output shape encode
-  int output_channel = input_channel;
-  int output_height = (input_height - filter_) / stride_ + 1;
-  int output_width = (input_width - filter_) / stride_ + 1;
-
-  Shape output_shape(4);
-  output_shape[0] = batch_size;
-  output_shape[1] = output_channel;
-  output_shape[2] = output_height;
-  output_shape[3] = output_width;
+  Shape output_shape = OutputShape(input_shape);
+  int output_channel = output_shape[1];
+  int output_height = output_shape[2];
+  int output_width = output_shape[3];
 
   // forward and backward output
-  this->forward_output_ = make_shared<TensorType<DType> >(output_shape);
-  this->backward_output_ = make_shared<TensorType<DType> >(input_shape);
+  this->forward_output_ = this->MakeOutput(output_shape);
+  if (!this->inference_only_) {
+    this->backward_output_ = make_shared<TensorType<DType> >(input_shape);
+  }
 
   if (op_ == "max") {
     this->max_index_ = make_shared<TensorType<int> >(output_shape);
@@ -39,6 +35,25 @@ void PoolingLayer<TensorType, DType>::InitImpl(const Shape& input_shape) {
     output_height << " * "<< output_width;
 }
 
+template<template <typename> class TensorType, typename DType>
+Shape PoolingLayer<TensorType, DType>::OutputShape(
+  const Shape& input_shape) const {
+  Shape output_shape(4);
+  output_shape[0] = input_shape[0];
+  output_shape[1] = input_shape[1];
+  output_shape[2] = (input_shape[2] - filter_) / stride_ + 1;
+  output_shape[3] = (input_shape[3] - filter_) / stride_ + 1;
+  return output_shape;
+}
+
+template<template <typename> class TensorType, typename DType>
+void PoolingLayer<TensorType, DType>::Reshape(const Shape& input_shape) {
+  Layer<TensorType, DType>::Reshape(input_shape);
+  if (max_index_ != 0) {
+    max_index_->Reshape(this->forward_output_shape());
+  }
+}
+
 template<template <typename> class TensorType, typename DType>
 void PoolingLayer<TensorType, DType>::ForwardPropImpl(
   shared_ptr<TensorType<DType> > forward_input) {
@@ -66,6 +81,22 @@ void PoolingLayer<TensorType, DType>::BackwardPropImpl(
   }
 }
 
+template<template <typename> class TensorType, typename DType>
+shared_ptr<Layer<TensorType, DType> >
+PoolingLayer<TensorType, DType>::Replicate() const {
+  shared_ptr<PoolingLayer<TensorType, DType> > replica =
+    make_shared<PoolingLayer<TensorType, DType> >(*this);
+  this->ReplicateState(replica.get());
+  if (max_index_ != 0) {
+    // as large as the planned one, with its current shape
+    Shape capacity(1);
+    capacity[0] = max_index_->capacity();
+    replica->max_index_ = make_shared<TensorType<int> >(capacity);
+    (replica->max_index_)->Reshape(max_index_->shape());
+  }
+  return replica;
+}
+
 INSTANTIATE_CLASS(PoolingLayer);
 
 }  // namespace blitz
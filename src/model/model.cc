@@ -9,44 +9,77 @@ namespace blitz {
 template<template <typename> class TensorType, typename DType>
 void Model<TensorType, DType>::Inference(
   shared_ptr<DataIterator<TensorType, DType> > inference_set,
-  shared_ptr<DataIterator<TensorType, DType> > inference_label,
   shared_ptr<LayerWrapper<TensorType, DType> > layer_wrapper,
-  const string& eval_type) {
+  const string& eval_type, const string& output_format) {
   inference_set->Init();
-  inference_label->Init();
   layer_wrapper->SetInferenceMode();
 
   int niteration = inference_set->total() / inference_set->batch_size();
+  // the tail is forwarded as a smaller batch
+  const int nbatch = niteration + (inference_set->tail_size() > 0 ? 1 : 0);
   float accuracy = 0.0f;
+  // without labels only the outputs are written
+  const bool label = inference_set->has_label();
 
   ptime todayUtc(day_clock::universal_day(),
     second_clock::universal_time().time_of_day());
-  string output_file = "./result/" + to_simple_string(todayUtc) + ".csv";
-  ofstream os(output_file.c_str(), ofstream::out);
-
-  for (int i = 0; i < niteration; ++i) {
-    shared_ptr<TensorType<DType> > input = inference_set->GenerateTensor(i);
-    shared_ptr<TensorType<DType> > target = inference_label->GenerateTensor(i);
-
-    ForwardProp(layer_wrapper, input, target);
-
-    accuracy += layer_wrapper->Evaluate(target, eval_type);
-
-    (layer_wrapper->forward_output())->OutputCSV(os);
+  string output_file = "./result/" + to_simple_string(todayUtc) +
+    OutputWriter<TensorType, DType>::Extension(output_format);
+  // written in the background while the next batch is forwarded
+  OutputWriter<TensorType, DType> output_writer(
+    OutputWriter<TensorType, DType>::MakeSink(output_format, output_file));
+
+  for (int i = 0; i < nbatch; ++i) {
+    shared_ptr<TensorType<DType> > input, target;
+    if (i == niteration) {
+      inference_set->GenerateTail(&input, label ? &target : NULL);
+    } else if (label) {
+      inference_set->GenerateBatch(i, &input, &target);
+    } else {
+      input = inference_set->GenerateTensor(i);
+    }
+
+    // the cost is of no use here
+    layer_wrapper->ForwardProp(input);
+
+    if (label) {
+      accuracy += layer_wrapper->Evaluate(target, eval_type) *
+        input->shape()[0];
+    }
+
+    output_writer.Write((layer_wrapper->forward_output()).get());
   }
 
-  accuracy /= niteration;
-  LOG(INFO) << "Accuracy: " << accuracy;
+  if (label) {
+    accuracy /= inference_set->total();
+    LOG(INFO) << "Accuracy: " << accuracy;
+  }
+}
 
-  os.close();
+template<template <typename> class TensorType, typename DType>
+void Model<TensorType, DType>::Serve(Server<TensorType, DType>* server,
+  shared_ptr<LayerWrapper<TensorType, DType> > layer_wrapper) {
+  layer_wrapper->SetInferenceMode();
+  shared_ptr<TensorType<DType> > input =
+    make_shared<TensorType<DType> >(server->input_shape());
+  server->Start();
+
+  size_t requests = 0;
+  size_t batches = 0;
+  int rows = 0;
+  while ((rows = server->NextBatch(input.get())) > 0) {
+    layer_wrapper->ForwardProp(input);
+    server->Reply((layer_wrapper->forward_output()).get(), rows);
+    requests += rows;
+    ++batches;
+  }
+  LOG(INFO) << "Served requests: " << requests << " batches " << batches;
 }
 
 template<template <typename> class TensorType, typename DType>
 void Model<TensorType, DType>::Fit(
   shared_ptr<DataIterator<TensorType, DType> > data_set,
-  shared_ptr<DataIterator<TensorType, DType> > data_label,
   shared_ptr<DataIterator<TensorType, DType> > eval_set,
-  shared_ptr<DataIterator<TensorType, DType> > eval_label,
   shared_ptr<FillerWrapper<TensorType, DType> > filler_wrapper,
   shared_ptr<LayerWrapper<TensorType, DType> > layer_wrapper,
   shared_ptr<CallbackWrapper> callback_wrapper,
@@ -54,11 +87,12 @@ void Model<TensorType, DType>::Fit(
   const string& eval_type) {
   // init data set and label
   data_set->Init();
-  data_label->Init();
   eval_set->Init();
-  eval_label->Init();
   const Shape& input_shape = data_set->input_shape();
   layer_wrapper->Init(input_shape, filler_wrapper, scheduler);
+  if (!description_.empty()) {
+    serializer_.set_description(description_ + layer_wrapper->description());
+  }
 
   filler_wrapper->Fill();
 
@@ -67,29 +101,30 @@ void Model<TensorType, DType>::Fit(
 
     callback_wrapper->OnEpochBegin(i);
 
-    EpochFit(i, data_set, data_label, layer_wrapper,
+    EpochFit(i, data_set, layer_wrapper,
       callback_wrapper, scheduler);
 
     callback_wrapper->OnEpochEnd(i);
 
     layer_wrapper->SetInferenceMode();
-    Evaluation(eval_set, eval_label, layer_wrapper, eval_type);
+    Evaluation(eval_set, layer_wrapper, eval_type);
   }
 }
 
 template<template <typename> class TensorType, typename DType>
 void Model<TensorType, DType>::Fit(
   shared_ptr<DataIterator<TensorType, DType> > data_set,
-  shared_ptr<DataIterator<TensorType, DType> > data_label,
   shared_ptr<FillerWrapper<TensorType, DType> > filler_wrapper,
   shared_ptr<LayerWrapper<TensorType, DType> > layer_wrapper,
   shared_ptr<CallbackWrapper> callback_wrapper,
   shared_ptr<Scheduler<TensorType, DType> > scheduler) {
   // init data set and label
   data_set->Init();
-  data_label->Init();
   const Shape& input_shape = data_set->input_shape();
   layer_wrapper->Init(input_shape, filler_wrapper, scheduler);
+  if (!description_.empty()) {
+    serializer_.set_description(description_ + layer_wrapper->description());
+  }
   layer_wrapper->SetTrainMode();
 
   filler_wrapper->Fill();
@@ -97,7 +132,7 @@ void Model<TensorType, DType>::Fit(
   for (int i = 0; i < epoches_; ++i) {
     callback_wrapper->OnEpochBegin(i);
 
-    EpochFit(i, data_set, data_label, layer_wrapper,
+    EpochFit(i, data_set, layer_wrapper,
       callback_wrapper, scheduler);
 
     callback_wrapper->OnEpochEnd(i);
@@ -109,7 +144,6 @@ template<template <typename> class TensorType, typename DType>
 void Model<TensorType, DType>::EpochFit(
   int epoch,
   shared_ptr<DataIterator<TensorType, DType> > data_set,
-  shared_ptr<DataIterator<TensorType, DType> > data_label,
   shared_ptr<LayerWrapper<TensorType, DType> > layer_wrapper,
   shared_ptr<CallbackWrapper> callback_wrapper,
   shared_ptr<Scheduler<TensorType, DType> > scheduler) {
@@ -117,11 +151,12 @@ void Model<TensorType, DType>::EpochFit(
   time_point<system_clock> start, end;
   start = system_clock::now();
 
+  data_set->Shuffle(epoch);
   for (int i = 0; i < niteration; ++i) {
     callback_wrapper->OnBatchBegin(i);
 
-    shared_ptr<TensorType<DType> > input = data_set->GenerateTensor(i);
-    shared_ptr<TensorType<DType> > target = data_label->GenerateTensor(i);
+    shared_ptr<TensorType<DType> > input, target;
+    data_set->GenerateBatch(i, &input, &target);
 
     DType loss = ForwardProp(layer_wrapper, input, target);
 
@@ -130,6 +165,14 @@ void Model<TensorType, DType>::EpochFit(
     scheduler->Run(epoch, data_set->batch_size());
 
     callback_wrapper->OnBatchEnd(i, loss);
+
+    if (checkpoint_batches_ > 0 &&
+      (epoch * niteration + i + 1) % checkpoint_batches_ == 0) {
+      serializer_.SaveAsync(checkpoint_, *scheduler);
+    }
+  }
+  if (checkpoint_epochs_ > 0 && (epoch + 1) % checkpoint_epochs_ == 0) {
+    serializer_.SaveAsync(checkpoint_, *scheduler);
   }
   end = system_clock::now();
 
@@ -137,25 +180,47 @@ void Model<TensorType, DType>::EpochFit(
   LOG(INFO) << "Elapsed second: " << elapsed_seconds.count();
 }
 
+template<template <typename> class TensorType, typename DType>
+void Model<TensorType, DType>::Restore(const Shape& input_shape,
+  const string& checkpoint,
+  shared_ptr<FillerWrapper<TensorType, DType> > filler_wrapper,
+  shared_ptr<LayerWrapper<TensorType, DType> > layer_wrapper,
+  shared_ptr<Scheduler<TensorType, DType> > scheduler) {
+  layer_wrapper->InitInference(input_shape, filler_wrapper, scheduler);
+  serializer_.Load(checkpoint, scheduler.get());
+}
+
+template<template <typename> class TensorType, typename DType>
+void Model<TensorType, DType>::Save(const string& checkpoint,
+  shared_ptr<Scheduler<TensorType, DType> > scheduler) {
+  serializer_.Save(checkpoint, *scheduler);
+}
+
 template<template <typename> class TensorType, typename DType>
 void Model<TensorType, DType>::Evaluation(
   shared_ptr<DataIterator<TensorType, DType> > eval_set,
-  shared_ptr<DataIterator<TensorType, DType> > eval_label,
   shared_ptr<LayerWrapper<TensorType, DType> > layer_wrapper,
   const string& eval_type) {
   int niteration = eval_set->total() / eval_set->batch_size();
+  // the tail is evaluated as a smaller batch, batches count by samples
+  const int nbatch = niteration + (eval_set->tail_size() > 0 ? 1 : 0);
   float accuracy = 0.0f;
 
-  for (int i = 0; i < niteration; ++i) {
-    shared_ptr<TensorType<DType> > input = eval_set->GenerateTensor(i);
-    shared_ptr<TensorType<DType> > target = eval_label->GenerateTensor(i);
+  for (int i = 0; i < nbatch; ++i) {
+    shared_ptr<TensorType<DType> > input, target;
+    if (i == niteration) {
+      eval_set->GenerateTail(&input, &target);
+    } else {
+      eval_set->GenerateBatch(i, &input, &target);
+    }
 
     ForwardProp(layer_wrapper, input, target);
 
-    accuracy += layer_wrapper->Evaluate(target, eval_type);
+    accuracy += layer_wrapper->Evaluate(target, eval_type) *
+      input->shape()[0];
   }
 
-  accuracy /= niteration;
+  accuracy /= eval_set->total();
   LOG(INFO) << "Accuracy: " << accuracy;
 }
 
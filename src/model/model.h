@@ -8,6 +8,9 @@
 #include "data/data_iterator.h"
 #include "scheduler/scheduler.h"
 #include "layer/layer_wrapper.h"
+#include "model/output_writer.h"
+#include "model/seralize.h"
+#include "model/server.h"
 
 namespace blitz {
 
@@ -15,19 +18,38 @@ template<template <typename> class TensorType, typename DType>
 class Model {
  public:
   explicit Model(const int epoches) :
-    epoches_(epoches) {}
+    epoches_(epoches), checkpoint_batches_(0), checkpoint_epochs_(0) {}
 
+  // layers of the model, stored in the checkpoints saved along with what
+  // the layers choose in Fit
+  void set_description(const string& description) {
+    description_ = description;
+    serializer_.set_description(description);
+  }
+
+  // before Fit, snapshots of the training state are saved to checkpoint
+  // in the background every batches or epochs, 0 for never
+  void set_checkpoint(const string& checkpoint, const int batches,
+    const int epochs) {
+    checkpoint_ = checkpoint;
+    checkpoint_batches_ = batches;
+    checkpoint_epochs_ = epochs;
+  }
+
+  // outputs go to ./result in output_format, see OutputWriter
   void Inference(
     shared_ptr<DataIterator<TensorType, DType> > inference_set,
-    shared_ptr<DataIterator<TensorType, DType> > inference_label,
     shared_ptr<LayerWrapper<TensorType, DType> > layer_wrapper,
-    const string& eval_type);
+    const string& eval_type, const string& output_format = "csv");
+
+  // forwards the batches of server through an inference plan of its
+  // input shape until it has no more requests
+  void Serve(Server<TensorType, DType>* server,
+    shared_ptr<LayerWrapper<TensorType, DType> > layer_wrapper);
 
   void Fit(
     shared_ptr<DataIterator<TensorType, DType> > data_set,
-    shared_ptr<DataIterator<TensorType, DType> > data_label,
     shared_ptr<DataIterator<TensorType, DType> > eval_set,
-    shared_ptr<DataIterator<TensorType, DType> > eval_label,
     shared_ptr<FillerWrapper<TensorType, DType> > filler_wrapper,
     shared_ptr<LayerWrapper<TensorType, DType> > layer_wrapper,
     shared_ptr<CallbackWrapper> callback_wrapper,
@@ -36,15 +58,24 @@ class Model {
 
   void Fit(
     shared_ptr<DataIterator<TensorType, DType> > data_set,
-    shared_ptr<DataIterator<TensorType, DType> > data_label,
     shared_ptr<FillerWrapper<TensorType, DType> > filler_wrapper,
     shared_ptr<LayerWrapper<TensorType, DType> > layer_wrapper,
     shared_ptr<CallbackWrapper> callback_wrapper,
     shared_ptr<Scheduler<TensorType, DType> > scheduler);
 
+  // an inference plan sized for input_shape with the weights of a
+  // checkpoint, which the model maps for as long as it lives
+  void Restore(const Shape& input_shape, const string& checkpoint,
+    shared_ptr<FillerWrapper<TensorType, DType> > filler_wrapper,
+    shared_ptr<LayerWrapper<TensorType, DType> > layer_wrapper,
+    shared_ptr<Scheduler<TensorType, DType> > scheduler);
+
+  // after the snapshots in flight
+  void Save(const string& checkpoint,
+    shared_ptr<Scheduler<TensorType, DType> > scheduler);
+
   void Evaluation(
     shared_ptr<DataIterator<TensorType, DType> > eval_set,
-    shared_ptr<DataIterator<TensorType, DType> > eval_label,
     shared_ptr<LayerWrapper<TensorType, DType> > layer_wrapper,
     const string& eval_type);
 
@@ -52,7 +83,6 @@ class Model {
   void EpochFit(
     int epoch,
     shared_ptr<DataIterator<TensorType, DType> > data_set,
-    shared_ptr<DataIterator<TensorType, DType> > data_label,
     shared_ptr<LayerWrapper<TensorType, DType> > layer_wrapper,
     shared_ptr<CallbackWrapper> callback_wrapper,
     shared_ptr<Scheduler<TensorType, DType> > scheduler);
@@ -64,6 +94,12 @@ class Model {
     const shared_ptr<TensorType<DType> > target);
 
   const int epoches_;
+
+  string checkpoint_;
+  int checkpoint_batches_;
+  int checkpoint_epochs_;
+  string description_;
+  Serializer<TensorType, DType> serializer_;
 };
 
 }  // namespace blitz
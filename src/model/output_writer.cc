@@ -0,0 +1,292 @@
+#include "model/output_writer.h"
+
+#include <hdf5.h>
+#include <stdint.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include "backend/backends.h"
+#include "data/data_iterator.h"
+
+namespace blitz {
+
+namespace {
+
+// batches in flight between the forward pass and the sink
+const size_t kOutputBuffers = 4;
+
+const char kOutputMagic[8] = {'B', 'L', 'I', 'T', 'Z', 'O', 'U', 'T'};
+
+// bytes of formatted text written at once
+const size_t kTextBufferSize = 1 << 20;
+
+template<typename DType>
+struct Hdf5OutputType;
+
+template<>
+struct Hdf5OutputType<float> {
+  static hid_t Get() {
+    return H5T_NATIVE_FLOAT;
+  }
+};
+
+template<>
+struct Hdf5OutputType<double> {
+  static hid_t Get() {
+    return H5T_NATIVE_DOUBLE;
+  }
+};
+
+FILE* OpenFile(const string& path) {
+  FILE* file = fopen(path.c_str(), "wb");
+  if (file == NULL) {
+    LOG(FATAL) << "Output open error: " << path;
+  }
+  return file;
+}
+
+// values formatted as ostream << does with its default precision
+template<typename DType>
+class CSVSink : public OutputSink<DType> {
+ public:
+  explicit CSVSink(const string& path) :
+    file_(OpenFile(path)), buffer_(kTextBufferSize) {}
+
+  ~CSVSink() {
+    fclose(file_);
+  }
+
+  virtual void Write(const DType* data, const size_t rows,
+    const size_t dim) {
+    // a value takes at most 16 characters
+    const size_t line = dim * 16 + 1;
+    size_t used = 0;
+    for (size_t i = 0; i < rows; ++i) {
+      if (buffer_.size() - used < line) {
+        Flush(used);
+        used = 0;
+        if (buffer_.size() < line) {
+          buffer_.resize(line);
+        }
+      }
+      char* text = &buffer_[0];
+      for (size_t j = 0; j < dim; ++j) {
+        used += snprintf(text + used, buffer_.size() - used, "%g, ",
+          static_cast<double>(data[i * dim + j]));
+      }
+      text[used++] = '\n';
+    }
+    Flush(used);
+  }
+
+ private:
+  void Flush(const size_t size) {
+    if (size > 0 && fwrite(&buffer_[0], 1, size, file_) != size) {
+      LOG(FATAL) << "Output write error";
+    }
+  }
+
+  FILE* file_;
+  vector<char> buffer_;
+};
+
+template<typename DType>
+class BinarySink : public OutputSink<DType> {
+ public:
+  explicit BinarySink(const string& path) :
+    file_(OpenFile(path)), header_(false) {}
+
+  ~BinarySink() {
+    fclose(file_);
+  }
+
+  virtual void Write(const DType* data, const size_t rows,
+    const size_t dim) {
+    if (!header_) {
+      const uint32_t header[2] = {sizeof(DType),
+        static_cast<uint32_t>(dim)};
+      if (fwrite(kOutputMagic, sizeof(kOutputMagic), 1, file_) != 1 ||
+        fwrite(header, sizeof(header), 1, file_) != 1) {
+        LOG(FATAL) << "Output write error";
+      }
+      header_ = true;
+    }
+    if (fwrite(data, sizeof(DType), rows * dim, file_) != rows * dim) {
+      LOG(FATAL) << "Output write error";
+    }
+  }
+
+ private:
+  FILE* file_;
+  bool header_;
+};
+
+template<typename DType>
+class Hdf5Sink : public OutputSink<DType> {
+ public:
+  explicit Hdf5Sink(const string& path) : path_(path), file_id_(-1),
+    data_id_(-1), rows_(0) {
+    boost::lock_guard<boost::mutex> hdf5_lock(hdf5_mutex);
+    file_id_ = H5Fcreate(path.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
+      H5P_DEFAULT);
+    if (file_id_ < 0) {
+      LOG(FATAL) << "Output open error: " << path;
+    }
+  }
+
+  ~Hdf5Sink() {
+    boost::lock_guard<boost::mutex> hdf5_lock(hdf5_mutex);
+    if (data_id_ >= 0) {
+      H5Dclose(data_id_);
+    }
+    H5Fclose(file_id_);
+  }
+
+  virtual void Write(const DType* data, const size_t rows,
+    const size_t dim) {
+    boost::lock_guard<boost::mutex> hdf5_lock(hdf5_mutex);
+    if (data_id_ < 0) {
+      // rows grow without bound, a batch per chunk
+      hsize_t dims[2] = {0, dim};
+      hsize_t max_dims[2] = {H5S_UNLIMITED, dim};
+      hsize_t chunk_dims[2] = {rows, dim};
+      hid_t space_id = H5Screate_simple(2, dims, max_dims);
+      hid_t property_id = H5Pcreate(H5P_DATASET_CREATE);
+      H5Pset_chunk(property_id, 2, chunk_dims);
+      data_id_ = H5Dcreate2(file_id_, "output",
+        Hdf5OutputType<DType>::Get(), space_id, H5P_DEFAULT, property_id,
+        H5P_DEFAULT);
+      H5Pclose(property_id);
+      H5Sclose(space_id);
+      if (data_id_ < 0) {
+        LOG(FATAL) << "Output create error: " << path_;
+      }
+    }
+
+    hsize_t dims[2] = {rows_ + rows, dim};
+    hsize_t start[2] = {rows_, 0};
+    hsize_t count[2] = {rows, dim};
+    herr_t status = H5Dset_extent(data_id_, dims);
+    hid_t space_id = H5Dget_space(data_id_);
+    status = status < 0 ? status : H5Sselect_hyperslab(space_id,
+      H5S_SELECT_SET, start, NULL, count, NULL);
+    hid_t mem_id = H5Screate_simple(2, count, NULL);
+    status = status < 0 ? status : H5Dwrite(data_id_,
+      Hdf5OutputType<DType>::Get(), mem_id, space_id, H5P_DEFAULT, data);
+    H5Sclose(mem_id);
+    H5Sclose(space_id);
+    if (status < 0) {
+      LOG(FATAL) << "Output write error: " << path_;
+    }
+    rows_ += rows;
+  }
+
+ private:
+  const string path_;
+  hid_t file_id_;
+  hid_t data_id_;
+  hsize_t rows_;
+};
+
+}  // namespace
+
+template<template <typename> class TensorType, typename DType>
+OutputWriter<TensorType, DType>::OutputWriter(
+  shared_ptr<OutputSink<DType> > sink) :
+  sink_(sink), batches_(kOutputBuffers), stop_(false) {
+  for (size_t i = 0; i < batches_.size(); ++i) {
+    free_.push_back(&batches_[i]);
+  }
+  writer_.reset(new boost::thread(
+    &OutputWriter<TensorType, DType>::WriterLoop, this));
+}
+
+template<template <typename> class TensorType, typename DType>
+OutputWriter<TensorType, DType>::~OutputWriter() {
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    stop_ = true;
+    cond_.notify_all();
+  }
+  writer_->join();
+}
+
+template<template <typename> class TensorType, typename DType>
+shared_ptr<OutputSink<DType> > OutputWriter<TensorType, DType>::MakeSink(
+  const string& format, const string& path) {
+  shared_ptr<OutputSink<DType> > sink;
+  if (format == "csv") {
+    sink.reset(new CSVSink<DType>(path));
+  } else if (format == "binary") {
+    sink.reset(new BinarySink<DType>(path));
+  } else if (format == "hdf5") {
+    sink.reset(new Hdf5Sink<DType>(path));
+  } else {
+    LOG(FATAL) << "Unknown output format: " << format;
+  }
+  return sink;
+}
+
+template<template <typename> class TensorType, typename DType>
+string OutputWriter<TensorType, DType>::Extension(const string& format) {
+  if (format == "binary") {
+    return ".bin";
+  } else if (format == "hdf5") {
+    return ".h5";
+  }
+  return ".csv";
+}
+
+template<template <typename> class TensorType, typename DType>
+void OutputWriter<TensorType, DType>::Write(
+  const TensorType<DType>* output) {
+  Batch* batch = NULL;
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (free_.empty()) {
+      cond_.wait(lock);
+    }
+    batch = free_.front();
+    free_.pop_front();
+  }
+
+  batch->rows = output->shape()[0];
+  batch->dim = output->size() / batch->rows;
+  batch->data.resize(output->size());
+  Backend<TensorType, DType>::HostCopyFromFunc(output->data(),
+    output->size(), &(batch->data)[0]);
+
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  full_.push_back(batch);
+  cond_.notify_all();
+}
+
+template<template <typename> class TensorType, typename DType>
+void OutputWriter<TensorType, DType>::WriterLoop() {
+  while (true) {
+    Batch* batch = NULL;
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      while (full_.empty() && !stop_) {
+        cond_.wait(lock);
+      }
+      // batches in flight are written before stopping
+      if (full_.empty()) {
+        break;
+      }
+      batch = full_.front();
+      full_.pop_front();
+    }
+
+    sink_->Write(&(batch->data)[0], batch->rows, batch->dim);
+
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    free_.push_back(batch);
+    cond_.notify_all();
+  }
+}
+
+INSTANTIATE_CLASS(OutputWriter);
+
+}  // namespace blitz
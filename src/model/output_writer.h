@@ -0,0 +1,78 @@
+#ifndef SRC_MODEL_OUTPUT_WRITER_H_
+#define SRC_MODEL_OUTPUT_WRITER_H_
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "util/common.h"
+
+namespace blitz {
+
+// Where inference outputs go, rows of dim values at a time.
+template<typename DType>
+class OutputSink {
+ public:
+  virtual ~OutputSink() {}
+
+  virtual void Write(const DType* data, const size_t rows,
+    const size_t dim) = 0;
+};
+
+// Copies the outputs of a batch to a host buffer and hands it to a
+// writer thread, so that formatting and I/O overlap the next forward
+// pass. At most kOutputBuffers batches are in flight, Write blocks for
+// a free buffer once the sink falls behind.
+// format:
+// csv: "value, " per value and a line per row, as OutputCSV writes them
+// binary: a header of magic, sizeof(DType) and dim, then the raw rows
+// hdf5: an "output" set of rows * dim values, grown batch by batch
+template<template <typename> class TensorType, typename DType>
+class OutputWriter {
+ public:
+  explicit OutputWriter(shared_ptr<OutputSink<DType> > sink);
+
+  // drains the batches in flight
+  ~OutputWriter();
+
+  // a sink of format writing to path
+  static shared_ptr<OutputSink<DType> > MakeSink(const string& format,
+    const string& path);
+
+  // file extension of format
+  static string Extension(const string& format);
+
+  void Write(const TensorType<DType>* output);
+
+ private:
+  struct Batch {
+    vector<DType> data;
+    size_t rows;
+    size_t dim;
+  };
+
+  void WriterLoop();
+
+  shared_ptr<OutputSink<DType> > sink_;
+
+  // buffers, guarded by mutex_
+  vector<Batch> batches_;
+  std::deque<Batch*> free_;
+  std::deque<Batch*> full_;
+  bool stop_;
+  boost::mutex mutex_;
+  boost::condition_variable cond_;
+  scoped_ptr<boost::thread> writer_;
+
+  // disable copy
+  OutputWriter(const OutputWriter&);
+  OutputWriter& operator=(const OutputWriter&);
+};
+
+}  // namespace blitz
+
+#endif  // SRC_MODEL_OUTPUT_WRITER_H_
@@ -0,0 +1,473 @@
+#include "model/seralize.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <utility>
+
+#include "backend/backends.h"
+
+namespace blitz {
+
+namespace {
+
+uint64_t Align(const uint64_t offset, const uint64_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+string EntryKey(const CheckpointEntry& entry) {
+  const char* kinds[] = {" weight", " state", " model"};
+  return string(entry.name, strnlen(entry.name, kCheckpointNameSize)) +
+    kinds[std::min(entry.kind, static_cast<uint32_t>(kCheckpointModel))];
+}
+
+// name of the model entry
+const char kModelEntryName[] = "model";
+
+// whole bytes of data to a temporary file synced and renamed to path
+bool WriteFile(const string& path, const char* data, const size_t size) {
+  const string temp_path = path + ".tmp";
+  int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  size_t done = 0;
+  while (done < size) {
+    const ssize_t bytes = write(fd, data + done, size - done);
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes <= 0) {
+      break;
+    }
+    done += bytes;
+  }
+  const bool synced = done == size && fsync(fd) == 0;
+  if (close(fd) != 0 || !synced ||
+    rename(temp_path.c_str(), path.c_str()) != 0) {
+    unlink(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+template<typename DType>
+void Restore(DType* data, CPUTensor<DType>* tensor) {
+  tensor->View(data);
+}
+
+template<template <typename> class TensorType, typename DType>
+void Restore(DType* data, TensorType<DType>* tensor) {
+  Backend<TensorType, DType>::HostCopyToFunc(data, tensor->size(),
+    tensor->data());
+}
+
+}  // namespace
+
+template<template <typename> class TensorType, typename DType>
+Serializer<TensorType, DType>::~Serializer() {
+#ifndef BLITZ_INFER
+  if (writer_) {
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      stop_ = true;
+      cond_.notify_all();
+    }
+    writer_->join();
+  }
+#endif  // BLITZ_INFER
+  if (map_ != NULL) {
+    munmap(map_, map_size_);
+  }
+}
+
+template<template <typename> class TensorType, typename DType>
+void Serializer<TensorType, DType>::Entries(
+  const Scheduler<TensorType, DType>& scheduler, const string& description,
+  vector<CheckpointEntry>* entries, vector<TensorType<DType>*>* tensors) {
+  typedef typename Optimizer<TensorType, DType>::LayerParam LayerParam;
+  typedef map<string, shared_ptr<Optimizer<TensorType, DType> > > Optimizers;
+  typedef map<string, shared_ptr<LayerParam> > LayerParams;
+  const Optimizers& optimizers = scheduler.optimizers();
+  for (typename Optimizers::const_iterator it = optimizers.begin();
+    it != optimizers.end(); ++it) {
+    const LayerParams& layer_params = (it->second)->layer_params();
+    for (typename LayerParams::const_iterator param_it =
+      layer_params.begin(); param_it != layer_params.end(); ++param_it) {
+      const string& name = param_it->first;
+      CHECK_LT(name.size(), kCheckpointNameSize) <<
+        "Checkpoint name too long: " << name;
+      for (uint32_t kind = kCheckpointWeight; kind <= kCheckpointState;
+        ++kind) {
+        TensorType<DType>* tensor = kind == kCheckpointWeight ?
+          (param_it->second)->weight().get() :
+          (param_it->second)->state().get();
+        // inference only weights have no state
+        if (tensor == NULL) {
+          continue;
+        }
+        const Shape& shape = tensor->shape();
+        CHECK_LE(shape.dimension(), kCheckpointMaxDimension) <<
+          "Checkpoint dimension: " << name;
+        CheckpointEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        memcpy(entry.name, name.c_str(), name.size());
+        entry.kind = kind;
+        entry.dimension = shape.dimension();
+        for (size_t i = 0; i < shape.dimension(); ++i) {
+          entry.shape[i] = shape[i];
+        }
+        entry.size = tensor->size();
+        entries->push_back(entry);
+        tensors->push_back(tensor);
+      }
+    }
+  }
+  if (!description.empty()) {
+    CheckpointEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    memcpy(entry.name, kModelEntryName, sizeof(kModelEntryName));
+    entry.kind = kCheckpointModel;
+    entry.dimension = 1;
+    entry.shape[0] = description.size();
+    entry.size = (description.size() + sizeof(DType) - 1) / sizeof(DType);
+    entries->push_back(entry);
+    tensors->push_back(NULL);
+  }
+
+  uint64_t offset = Align(sizeof(CheckpointHeader) +
+    entries->size() * sizeof(CheckpointEntry), kCheckpointAlignment);
+  for (size_t i = 0; i < entries->size(); ++i) {
+    (*entries)[i].offset = offset;
+    offset = Align(offset + (*entries)[i].size * sizeof(DType),
+      kCheckpointTensorAlignment);
+  }
+}
+
+template<template <typename> class TensorType, typename DType>
+void Serializer<TensorType, DType>::Image(
+  const Scheduler<TensorType, DType>& scheduler, vector<char>* image) const {
+  vector<CheckpointEntry> entries;
+  vector<TensorType<DType>*> tensors;
+  Entries(scheduler, description_, &entries, &tensors);
+  CheckpointHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kCheckpointMagic, sizeof(header.magic));
+  header.version = kCheckpointVersion;
+  header.type_size = sizeof(DType);
+  header.num_entry = entries.size();
+  header.data_offset = Align(sizeof(header) +
+    entries.size() * sizeof(CheckpointEntry), kCheckpointAlignment);
+
+  const size_t size = entries.empty() ? header.data_offset :
+    entries.back().offset + entries.back().size * sizeof(DType);
+  image->resize(size);
+  memset(&(*image)[0], 0, header.data_offset);
+  memcpy(&(*image)[0], &header, sizeof(header));
+  if (!entries.empty()) {
+    memcpy(&(*image)[sizeof(header)], &entries[0],
+      entries.size() * sizeof(CheckpointEntry));
+  }
+  for (size_t i = 0; i < entries.size(); ++i) {
+    char* target = &(*image)[0] + entries[i].offset;
+    if (tensors[i] == NULL) {
+      memset(target, 0, entries[i].size * sizeof(DType));
+      memcpy(target, description_.data(), description_.size());
+    } else {
+      Backend<TensorType, DType>::HostCopyFromFunc(tensors[i]->data(),
+        entries[i].size, reinterpret_cast<DType*>(target));
+    }
+  }
+}
+
+template<template <typename> class TensorType, typename DType>
+void Serializer<TensorType, DType>::Save(const string& path,
+  const Scheduler<TensorType, DType>& scheduler) {
+  // a snapshot in flight must not land after this one
+  Wait();
+  vector<char> image;
+  Image(scheduler, &image);
+  if (!WriteFile(path, &image[0], image.size())) {
+    LOG(FATAL) << "Checkpoint write error: " << path;
+  }
+  LOG(INFO) << "Save checkpoint: " << path << " bytes " << image.size();
+}
+
+#ifndef BLITZ_INFER
+template<template <typename> class TensorType, typename DType>
+bool Serializer<TensorType, DType>::SaveAsync(const string& path,
+  const Scheduler<TensorType, DType>& scheduler) {
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    if (writing_) {
+      LOG(WARNING) << "Checkpoint writer busy, snapshot skipped: " << path;
+      return false;
+    }
+  }
+  if (!writer_) {
+    writer_.reset(new boost::thread(
+      &Serializer<TensorType, DType>::WriterLoop, this));
+  }
+
+  // the image of the file, the writer does not touch it until
+  // writing_ is set, the buffer is kept across snapshots
+  Image(scheduler, &snapshot_);
+
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  snapshot_path_ = path;
+  writing_ = true;
+  cond_.notify_all();
+  return true;
+}
+
+template<template <typename> class TensorType, typename DType>
+void Serializer<TensorType, DType>::Wait() {
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  while (writing_) {
+    cond_.wait(lock);
+  }
+}
+
+template<template <typename> class TensorType, typename DType>
+void Serializer<TensorType, DType>::WriterLoop() {
+  while (true) {
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      while (!writing_ && !stop_) {
+        cond_.wait(lock);
+      }
+      // a pending snapshot is still written before stopping
+      if (!writing_) {
+        return;
+      }
+    }
+    if (WriteFile(snapshot_path_, &snapshot_[0], snapshot_.size())) {
+      LOG(INFO) << "Save checkpoint: " << snapshot_path_ << " bytes " <<
+        snapshot_.size();
+    } else {
+      LOG(WARNING) << "Checkpoint write error: " << snapshot_path_;
+    }
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    writing_ = false;
+    cond_.notify_all();
+  }
+}
+#else
+template<template <typename> class TensorType, typename DType>
+bool Serializer<TensorType, DType>::SaveAsync(const string& path,
+  const Scheduler<TensorType, DType>& scheduler) {
+  LOG(FATAL) << "Built without the checkpoint writer";
+  return false;
+}
+
+template<template <typename> class TensorType, typename DType>
+void Serializer<TensorType, DType>::Wait() {}
+
+template<template <typename> class TensorType, typename DType>
+void Serializer<TensorType, DType>::WriterLoop() {}
+#endif  // BLITZ_INFER
+
+template<template <typename> class TensorType, typename DType>
+bool Serializer<TensorType, DType>::ReadDescription(const string& path,
+  string* description) {
+  std::ifstream file(path.c_str(), std::ios::binary);
+  CheckpointHeader header;
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+    memcmp(header.magic, kCheckpointMagic, sizeof(header.magic)) != 0) {
+    return false;
+  }
+  // the table of entries follows the header
+  CheckpointEntry entry;
+  for (uint64_t i = 0; i < header.num_entry; ++i) {
+    if (!file.read(reinterpret_cast<char*>(&entry), sizeof(entry))) {
+      return false;
+    }
+    if (entry.kind == kCheckpointModel) {
+      description->resize(entry.shape[0]);
+      return description->empty() || (file.seekg(entry.offset) &&
+        file.read(&(*description)[0], description->size()));
+    }
+  }
+  return false;
+}
+
+template<template <typename> class TensorType, typename DType>
+bool Serializer<TensorType, DType>::Check(const string& path,
+  const Scheduler<TensorType, DType>* scheduler, string* error) {
+  std::ifstream file(path.c_str(), std::ios::binary);
+  if (!file.is_open()) {
+    *error = "Checkpoint open error: " + path;
+    return false;
+  }
+  file.seekg(0, std::ios::end);
+  const uint64_t file_size = file.tellg();
+  file.seekg(0);
+  CheckpointHeader header;
+  if (file_size < sizeof(header) ||
+    !file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+    *error = "Checkpoint truncated: " + path;
+    return false;
+  }
+  if (memcmp(header.magic, kCheckpointMagic, sizeof(header.magic)) != 0) {
+    *error = "Not a checkpoint: " + path;
+    return false;
+  }
+  if (header.version != kCheckpointVersion) {
+    *error = "Checkpoint version: " + path;
+    return false;
+  }
+  if (header.type_size != sizeof(DType)) {
+    *error = "Checkpoint data type: " + path;
+    return false;
+  }
+  if (header.num_entry > (file_size - sizeof(header)) /
+    sizeof(CheckpointEntry)) {
+    *error = "Checkpoint truncated: " + path;
+    return false;
+  }
+
+  vector<CheckpointEntry> stored(header.num_entry);
+  map<string, const CheckpointEntry*> stored_entries;
+  for (size_t i = 0; i < stored.size(); ++i) {
+    CheckpointEntry& entry = stored[i];
+    if (!file.read(reinterpret_cast<char*>(&entry), sizeof(entry))) {
+      *error = "Checkpoint truncated: " + path;
+      return false;
+    }
+    const string key = EntryKey(entry);
+    // a model entry holds shape[0] bytes of text
+    if (entry.kind > kCheckpointModel ||
+      entry.dimension > kCheckpointMaxDimension ||
+      (entry.kind == kCheckpointModel &&
+      entry.shape[0] > entry.size * sizeof(DType))) {
+      *error = "Checkpoint entry corrupt: " + key;
+      return false;
+    }
+    if (entry.offset % kCheckpointTensorAlignment != 0) {
+      *error = "Checkpoint alignment: " + key;
+      return false;
+    }
+    if (entry.offset > file_size ||
+      entry.size > (file_size - entry.offset) / sizeof(DType)) {
+      *error = "Checkpoint truncated: " + path;
+      return false;
+    }
+    stored_entries[key] = &entry;
+  }
+  if (scheduler == NULL) {
+    return true;
+  }
+
+  vector<CheckpointEntry> entries;
+  vector<TensorType<DType>*> tensors;
+  Entries(*scheduler, "", &entries, &tensors);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const string key = EntryKey(entries[i]);
+    map<string, const CheckpointEntry*>::const_iterator it =
+      stored_entries.find(key);
+    if (it == stored_entries.end()) {
+      *error = "Checkpoint misses: " + key;
+      return false;
+    }
+    const CheckpointEntry& entry = *(it->second);
+    bool same_shape = entry.dimension == entries[i].dimension &&
+      entry.size == entries[i].size;
+    for (size_t j = 0; same_shape && j < entry.dimension; ++j) {
+      same_shape = entry.shape[j] == entries[i].shape[j];
+    }
+    if (!same_shape) {
+      *error = "Checkpoint shape mismatch: " + key;
+      return false;
+    }
+  }
+  return true;
+}
+
+template<template <typename> class TensorType, typename DType>
+void Serializer<TensorType, DType>::Load(const string& path,
+  Scheduler<TensorType, DType>* scheduler) {
+  CHECK(map_ == NULL) << "Checkpoint loaded twice: " << path;
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    LOG(FATAL) << "Checkpoint open error: " << path;
+  }
+  struct stat file_stat;
+  CHECK_EQ(fstat(fd, &file_stat), 0);
+  map_size_ = file_stat.st_size;
+  CHECK_GE(map_size_, sizeof(CheckpointHeader)) <<
+    "Checkpoint truncated: " << path;
+  // private, written tensors get copies of their pages
+  map_ = mmap(NULL, map_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map_ == MAP_FAILED) {
+    map_ = NULL;
+    LOG(FATAL) << "Checkpoint map error: " << path;
+  }
+
+  char* begin = static_cast<char*>(map_);
+  const CheckpointHeader* header =
+    reinterpret_cast<const CheckpointHeader*>(begin);
+  CHECK_EQ(memcmp(header->magic, kCheckpointMagic, sizeof(header->magic)),
+    0) << "Not a checkpoint: " << path;
+  CHECK_EQ(header->version, kCheckpointVersion) <<
+    "Checkpoint version: " << path;
+  CHECK_EQ(header->type_size, sizeof(DType)) <<
+    "Checkpoint data type: " << path;
+  CHECK_GE(map_size_, sizeof(CheckpointHeader) +
+    header->num_entry * sizeof(CheckpointEntry)) <<
+    "Checkpoint truncated: " << path;
+
+  const CheckpointEntry* stored = reinterpret_cast<const CheckpointEntry*>(
+    begin + sizeof(CheckpointHeader));
+  map<string, const CheckpointEntry*> stored_entries;
+  for (size_t i = 0; i < header->num_entry; ++i) {
+    stored_entries[EntryKey(stored[i])] = &stored[i];
+  }
+
+  vector<CheckpointEntry> entries;
+  vector<TensorType<DType>*> tensors;
+  Entries(*scheduler, "", &entries, &tensors);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const string key = EntryKey(entries[i]);
+    map<string, const CheckpointEntry*>::iterator it =
+      stored_entries.find(key);
+    if (it == stored_entries.end()) {
+      LOG(FATAL) << "Checkpoint misses: " << key;
+    }
+    const CheckpointEntry& entry = *(it->second);
+    bool same_shape = entry.dimension == entries[i].dimension &&
+      entry.size == entries[i].size;
+    for (size_t j = 0; same_shape && j < entry.dimension; ++j) {
+      same_shape = entry.shape[j] == entries[i].shape[j];
+    }
+    CHECK(same_shape) << "Checkpoint shape mismatch: " << key;
+    CHECK_EQ(entry.offset % kCheckpointTensorAlignment, 0) <<
+      "Checkpoint alignment: " << key;
+    CHECK_LE(entry.offset + entry.size * sizeof(DType), map_size_) <<
+      "Checkpoint truncated: " << path;
+    Restore(reinterpret_cast<DType*>(begin + entry.offset), tensors[i]);
+    stored_entries.erase(it);
+  }
+  // states are of no use to inference only weights
+  size_t unused = 0;
+  for (map<string, const CheckpointEntry*>::iterator it =
+    stored_entries.begin(); it != stored_entries.end(); ++it) {
+    unused += (it->second)->kind == kCheckpointWeight;
+  }
+  if (unused > 0) {
+    LOG(WARNING) << "Checkpoint weights unused: " << unused;
+  }
+  LOG(INFO) << "Load checkpoint: " << path << " tensors " << entries.size();
+}
+
+INSTANTIATE_CLASS(Serializer);
+
+}  // namespace blitz
@@ -0,0 +1,140 @@
+#ifndef SRC_MODEL_SERALIZE_H_
+#define SRC_MODEL_SERALIZE_H_
+
+#include <stdint.h>
+
+#ifndef BLITZ_INFER
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#endif  // BLITZ_INFER
+
+#include <string>
+#include <vector>
+
+#include "util/common.h"
+#include "scheduler/scheduler.h"
+
+namespace blitz {
+
+// Binary checkpoint of all tensors a scheduler updates: weights of
+// layers, biases and batch norm gamma and beta, each with its optimizer
+// state. A fixed header and a table of entries are followed at
+// data_offset by the tensors, little endian, each at an aligned offset,
+// so that a tensor is a plain slice of the mapped file.
+// A model entry may follow the tensors: the text description of the
+// layers that libblitz_infer builds without the yaml configuration.
+const char kCheckpointMagic[8] = {'B', 'L', 'I', 'T', 'Z', 'C', 'K', 'P'};
+const uint32_t kCheckpointVersion = 1;
+// data_offset is a multiple of the page size
+const uint64_t kCheckpointAlignment = 4096;
+const uint64_t kCheckpointTensorAlignment = 64;
+const size_t kCheckpointNameSize = 96;
+const size_t kCheckpointMaxDimension = 6;
+
+enum CheckpointKind {
+  kCheckpointWeight = 0,
+  kCheckpointState = 1,
+  // shape[0] bytes of text, size rounded up to whole DType
+  kCheckpointModel = 2
+};
+
+struct CheckpointHeader {
+  char magic[8];
+  uint32_t version;
+  // sizeof(DType) of the model
+  uint32_t type_size;
+  uint64_t num_entry;
+  uint64_t data_offset;
+};
+
+struct CheckpointEntry {
+  // layer parameter name, zero padded
+  char name[kCheckpointNameSize];
+  uint32_t kind;
+  uint32_t dimension;
+  uint64_t shape[kCheckpointMaxDimension];
+  // in bytes from the beginning of the file
+  uint64_t offset;
+  uint64_t size;
+};
+
+// Snapshots for SaveAsync are copied into a host image of the file,
+// a writer thread writes and syncs it while training goes on.
+// libblitz_infer is built without the writer.
+template<template <typename> class TensorType, typename DType>
+class Serializer {
+ public:
+  Serializer() : map_(NULL), map_size_(0), writing_(false), stop_(false) {}
+
+  ~Serializer();
+
+  // before Save, the model entry of the files written
+  void set_description(const string& description) {
+    description_ = description;
+  }
+
+  // the model entry of the file at path, false if it has none
+  static bool ReadDescription(const string& path, string* description);
+
+  // writes the tensors of scheduler to a temporary file, synced and
+  // renamed to path at the end
+  void Save(const string& path,
+    const Scheduler<TensorType, DType>& scheduler);
+
+  // copies the tensors of scheduler and returns, the writer saves them
+  // to path; false and nothing copied if it is still busy with the last
+  bool SaveAsync(const string& path,
+    const Scheduler<TensorType, DType>& scheduler);
+
+  // until the snapshot being written is on disk
+  void Wait();
+
+  // the checks of Load without failing: the header, the entries within
+  // the file and, given a scheduler, an entry of the same shape for each
+  // of its tensors; false and the first problem in error otherwise
+  static bool Check(const string& path,
+    const Scheduler<TensorType, DType>* scheduler, string* error);
+
+  // reads them from the mapped path, host tensors become views of the
+  // private mapping and share its pages with other processes until
+  // they are written; the serializer has to outlive the tensors
+  void Load(const string& path, Scheduler<TensorType, DType>* scheduler);
+
+ private:
+  // entries of the tensors of scheduler and the model entry of a non
+  // empty description, whose tensor is NULL, offsets of a new file
+  static void Entries(const Scheduler<TensorType, DType>& scheduler,
+    const string& description, vector<CheckpointEntry>* entries,
+    vector<TensorType<DType>*>* tensors);
+
+  // the whole file for the tensors of scheduler
+  void Image(const Scheduler<TensorType, DType>& scheduler,
+    vector<char>* image) const;
+
+  void WriterLoop();
+
+  void* map_;
+  size_t map_size_;
+  string description_;
+
+  // writer state, guarded by mutex_
+  vector<char> snapshot_;
+  string snapshot_path_;
+  bool writing_;
+  bool stop_;
+
+#ifndef BLITZ_INFER
+  boost::mutex mutex_;
+  boost::condition_variable cond_;
+  scoped_ptr<boost::thread> writer_;
+#endif  // BLITZ_INFER
+
+  // disable copy
+  Serializer(const Serializer&);
+  Serializer& operator=(const Serializer&);
+};
+
+}  // namespace blitz
+
+#endif  // SRC_MODEL_SERALIZE_H_
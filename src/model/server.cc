@@ -0,0 +1,359 @@
+#include "model/server.h"
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "backend/backends.h"
+
+namespace blitz {
+
+namespace {
+
+// false at the end of the stream or on an error
+bool ReadFull(const int fd, char* data, const size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t bytes = read(fd, data + done, size - done);
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes <= 0) {
+      return false;
+    }
+    done += bytes;
+  }
+  return true;
+}
+
+bool WriteFull(const int fd, const char* data, const size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t bytes = write(fd, data + done, size - done);
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes <= 0) {
+      return false;
+    }
+    done += bytes;
+  }
+  return true;
+}
+
+// the listening socket of the server, shut down on SIGTERM and SIGINT
+// to wake its acceptor, which stops the server
+int signal_listen_fd = -1;
+volatile sig_atomic_t signal_stop = 0;
+
+void StopSignalHandler(int signal) {
+  signal_stop = 1;
+  if (signal_listen_fd >= 0) {
+    shutdown(signal_listen_fd, SHUT_RDWR);
+  }
+}
+
+}  // namespace
+
+template<template <typename> class TensorType, typename DType>
+Server<TensorType, DType>::Client::~Client() {
+  // its writer closes the socket once the replies are written
+  boost::unique_lock<boost::mutex> lock(writer->mutex);
+  writer->closed = true;
+  writer->cond.notify_all();
+}
+
+template<template <typename> class TensorType, typename DType>
+Server<TensorType, DType>::Server(const string& socket_path,
+  const Shape& input_shape, const int max_latency, const DType mean,
+  const DType scale) :
+  socket_path_(socket_path), input_shape_(input_shape),
+  batch_size_(input_shape[0]),
+  sample_size_(input_shape.size() / input_shape[0]),
+  max_latency_(max_latency), mean_(mean), scale_(scale), listen_fd_(-1),
+  num_sources_(0), stop_(false) {
+  // a client that goes away fails its writes instead
+  signal(SIGPIPE, SIG_IGN);
+}
+
+template<template <typename> class TensorType, typename DType>
+Server<TensorType, DType>::~Server() {
+  Stop();
+  if (acceptor_) {
+    acceptor_->join();
+  }
+  // the acceptor is done, no client is added any more; the requests left
+  // are dropped, so that each client closes once its reader is done, and
+  // writers stalled by their clients are woken
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    queue_.clear();
+    batch_.clear();
+    for (size_t i = 0; i < client_fds_.size(); ++i) {
+      shutdown(client_fds_[i], SHUT_RDWR);
+    }
+  }
+  typename std::map<boost::thread::id, shared_ptr<boost::thread> >::iterator
+    it = threads_.begin();
+  for (; it != threads_.end(); ++it) {
+    (it->second)->join();
+  }
+  if (listen_fd_ >= 0) {
+    signal_listen_fd = -1;
+    close(listen_fd_);
+    unlink(socket_path_.c_str());
+  }
+}
+
+template<template <typename> class TensorType, typename DType>
+void Server<TensorType, DType>::Stop() {
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  if (stop_) {
+    return;
+  }
+  stop_ = true;
+  // wakes the acceptor and the readers, replies can still be written
+  if (listen_fd_ >= 0) {
+    shutdown(listen_fd_, SHUT_RDWR);
+  }
+  for (size_t i = 0; i < client_fds_.size(); ++i) {
+    shutdown(client_fds_[i], SHUT_RD);
+  }
+}
+
+template<template <typename> class TensorType, typename DType>
+void Server<TensorType, DType>::Start() {
+  if (socket_path_.empty()) {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    AddClient(STDIN_FILENO, STDOUT_FILENO);
+    LOG(INFO) << "Serve stdin";
+    return;
+  }
+
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  CHECK_LT(socket_path_.size(), sizeof(address.sun_path)) <<
+    "Socket path too long: " << socket_path_;
+  memcpy(address.sun_path, socket_path_.c_str(), socket_path_.size());
+
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd_ < 0) {
+    LOG(FATAL) << "Socket error: " << strerror(errno);
+  }
+  // a socket left by an earlier server
+  unlink(socket_path_.c_str());
+  if (bind(listen_fd_, reinterpret_cast<struct sockaddr*>(&address),
+    sizeof(address)) != 0 || listen(listen_fd_, SOMAXCONN) != 0) {
+    LOG(FATAL) << "Socket listen error: " << socket_path_ << " " <<
+      strerror(errno);
+  }
+  // the acceptor, it takes the lock to finish
+  num_sources_ = 1;
+  signal_listen_fd = listen_fd_;
+  signal(SIGTERM, StopSignalHandler);
+  signal(SIGINT, StopSignalHandler);
+  acceptor_.reset(new boost::thread(
+    &Server<TensorType, DType>::AcceptLoop, this));
+  LOG(INFO) << "Serve socket: " << socket_path_;
+}
+
+template<template <typename> class TensorType, typename DType>
+void Server<TensorType, DType>::AcceptLoop() {
+  while (true) {
+    int fd = accept(listen_fd_, NULL, NULL);
+    if (fd < 0 && signal_stop) {
+      LOG(INFO) << "Stop serving socket: " << socket_path_;
+      Stop();
+    }
+    ReapThreads();
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    if (stop_) {
+      if (fd >= 0) {
+        close(fd);
+      }
+      break;
+    }
+    if (fd < 0) {
+      if (errno != EINTR && errno != ECONNABORTED) {
+        LOG(WARNING) << "Socket accept error: " << strerror(errno);
+      }
+      continue;
+    }
+    client_fds_.push_back(fd);
+    AddClient(fd, fd);
+  }
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  --num_sources_;
+  cond_.notify_all();
+}
+
+template<template <typename> class TensorType, typename DType>
+void Server<TensorType, DType>::AddClient(const int read_fd,
+  const int write_fd) {
+  ++num_sources_;
+  shared_ptr<Writer> writer = make_shared<Writer>(write_fd);
+  // they take the lock to finish, after they are listed
+  shared_ptr<boost::thread> thread = make_shared<boost::thread>(
+    &Server<TensorType, DType>::WriteLoop, this, writer);
+  threads_[thread->get_id()] = thread;
+  thread = make_shared<boost::thread>(&Server<TensorType, DType>::ReadLoop,
+    this, make_shared<Client>(read_fd, writer));
+  threads_[thread->get_id()] = thread;
+}
+
+template<template <typename> class TensorType, typename DType>
+void Server<TensorType, DType>::ReadLoop(shared_ptr<Client> client) {
+  const size_t bytes = sample_size_ * sizeof(DType);
+  while (true) {
+    Request request;
+    request.sample.resize(sample_size_);
+    if (!ReadFull(client->read_fd,
+      reinterpret_cast<char*>(&request.sample[0]), bytes)) {
+      break;
+    }
+    request.client = client;
+    request.arrival = boost::get_system_time();
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    if (stop_) {
+      break;
+    }
+    queue_.push_back(request);
+    cond_.notify_all();
+  }
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  finished_threads_.push_back(boost::this_thread::get_id());
+  --num_sources_;
+  cond_.notify_all();
+}
+
+template<template <typename> class TensorType, typename DType>
+void Server<TensorType, DType>::WriteLoop(shared_ptr<Writer> writer) {
+  bool broken = false;
+  while (true) {
+    vector<DType> reply;
+    {
+      boost::unique_lock<boost::mutex> lock(writer->mutex);
+      while (writer->replies.empty() && !writer->closed) {
+        writer->cond.wait(lock);
+      }
+      if (writer->replies.empty()) {
+        break;
+      }
+      reply.swap(writer->replies.front());
+      writer->replies.pop_front();
+    }
+    // the replies of a client gone are dropped until it closes
+    if (!broken && !WriteFull(writer->fd,
+      reinterpret_cast<const char*>(&reply[0]), reply.size() * sizeof(DType))) {
+      broken = true;
+      LOG(WARNING) << "Client reply error: " << strerror(errno);
+    }
+  }
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  if (writer->fd != STDOUT_FILENO) {
+    client_fds_.erase(std::remove(client_fds_.begin(), client_fds_.end(),
+      writer->fd), client_fds_.end());
+    close(writer->fd);
+  }
+  finished_threads_.push_back(boost::this_thread::get_id());
+}
+
+template<template <typename> class TensorType, typename DType>
+void Server<TensorType, DType>::ReapThreads() {
+  vector<shared_ptr<boost::thread> > finished;
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    for (size_t i = 0; i < finished_threads_.size(); ++i) {
+      finished.push_back(threads_[finished_threads_[i]]);
+      threads_.erase(finished_threads_[i]);
+    }
+    finished_threads_.clear();
+  }
+  // they only have to return
+  for (size_t i = 0; i < finished.size(); ++i) {
+    finished[i]->join();
+  }
+}
+
+template<template <typename> class TensorType, typename DType>
+int Server<TensorType, DType>::NextBatch(TensorType<DType>* input) {
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  while (queue_.empty() && num_sources_ > 0) {
+    cond_.wait(lock);
+  }
+  if (queue_.empty()) {
+    return 0;
+  }
+  // until the batch is full, the oldest request is due, or no more
+  // requests can come
+  const boost::system_time deadline = queue_.front().arrival +
+    boost::posix_time::microseconds(max_latency_);
+  while (queue_.size() < batch_size_ && num_sources_ > 0 &&
+    cond_.timed_wait(lock, deadline)) {}
+  const size_t rows = std::min(batch_size_, queue_.size());
+  batch_.assign(queue_.begin(), queue_.begin() + rows);
+  queue_.erase(queue_.begin(), queue_.begin() + rows);
+  lock.unlock();
+
+  // only the requests are forwarded, the input was planned for a full
+  // batch and has room for them
+  Shape shape(input_shape_);
+  shape[0] = rows;
+  input->Reshape(shape);
+  input_buffer_.resize(rows * sample_size_);
+  for (size_t i = 0; i < rows; ++i) {
+    const vector<DType>& sample = batch_[i].sample;
+    DType* row = &input_buffer_[i * sample_size_];
+    for (size_t j = 0; j < sample_size_; ++j) {
+      row[j] = (sample[j] - mean_) * scale_;
+    }
+  }
+  Backend<TensorType, DType>::HostCopyToFunc(&input_buffer_[0],
+    input_buffer_.size(), input->data());
+  return rows;
+}
+
+template<template <typename> class TensorType, typename DType>
+void Server<TensorType, DType>::Reply(const TensorType<DType>* output,
+  const int rows) {
+  CHECK_EQ(static_cast<size_t>(rows), batch_.size());
+  const size_t output_size = output->size() / output->shape()[0];
+  output_buffer_.resize(output->size());
+  Backend<TensorType, DType>::HostCopyFromFunc(output->data(),
+    output->size(), &output_buffer_[0]);
+  // handed to the writers, a client that does not read never blocks
+  // the batches of the others
+  for (size_t i = 0; i < batch_.size(); ++i) {
+    Client* client = batch_[i].client.get();
+    if (client->broken) {
+      continue;
+    }
+    Writer* writer = client->writer.get();
+    boost::unique_lock<boost::mutex> lock(writer->mutex);
+    if (writer->replies.size() >= kMaxQueuedReplies) {
+      // its reader and writer are woken, the replies left are dropped
+      client->broken = true;
+      writer->replies.clear();
+      if (writer->fd != STDOUT_FILENO) {
+        shutdown(writer->fd, SHUT_RDWR);
+      }
+      LOG(WARNING) << "Client reply queue full, drop the client";
+      continue;
+    }
+    const DType* row = &output_buffer_[i * output_size];
+    writer->replies.push_back(vector<DType>(row, row + output_size));
+    writer->cond.notify_all();
+  }
+  // clients whose reader is done close with their last request
+  batch_.clear();
+}
+
+INSTANTIATE_CLASS(Server);
+
+}  // namespace blitz
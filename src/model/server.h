@@ -0,0 +1,139 @@
+#ifndef SRC_MODEL_SERVER_H_
+#define SRC_MODEL_SERVER_H_
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread_time.hpp>
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "util/common.h"
+#include "backend/shape.h"
+
+namespace blitz {
+
+// Serves predictions to the clients of a unix socket, or to stdin and
+// stdout without a socket path. A request is the DType values of one
+// sample and its reply the values of one output, both in host byte
+// order; a client may send requests without waiting for replies, which
+// come back in the order of its requests. A client that stops reading
+// its replies is dropped once it has kMaxQueuedReplies of them pending.
+// Requests of all clients are coalesced into batches of at most
+// batch_size samples: a batch is handed out once it is full or once its
+// oldest request has waited max_latency microseconds.
+// Samples are normalized by (x - mean) * scale as in training.
+// A socket server stops on SIGTERM or SIGINT: it takes no more requests
+// but replies to those it has, only one per process should serve a
+// socket.
+template<template <typename> class TensorType, typename DType>
+class Server {
+ public:
+  explicit Server(const string& socket_path, const Shape& input_shape,
+    const int max_latency, const DType mean = 0, const DType scale = 1);
+
+  ~Server();
+
+  // accepts clients, or reads stdin, in the background
+  void Start();
+
+  // takes no more clients or requests, those already read are still
+  // batched; stdin is left once its next request is read
+  void Stop();
+
+  // blocks for the next batch, copied to input reshaped to its requests,
+  // and returns their number; 0 once stdin is closed or the server is
+  // stopped, and every request is replied
+  int NextBatch(TensorType<DType>* input);
+
+  // rows of output, forwarded from the last batch, to its clients
+  void Reply(const TensorType<DType>* output, const int rows);
+
+  // [batch_size, sample shape] of the batches
+  const Shape& input_shape() const {
+    return input_shape_;
+  }
+
+ private:
+  // replies of a connection, written by a thread of its own so that a
+  // client which does not read stalls only itself; at most
+  // kMaxQueuedReplies are queued before the client is dropped
+  struct Writer {
+    explicit Writer(const int fd) : fd(fd), closed(false) {}
+
+    const int fd;
+    // guarded by mutex
+    std::deque<vector<DType> > replies;
+    bool closed;
+    boost::mutex mutex;
+    boost::condition_variable cond;
+  };
+
+  // a connection, closed when its reader and last request are done and
+  // its replies are written
+  struct Client {
+    Client(const int read_fd, shared_ptr<Writer> writer) :
+      read_fd(read_fd), writer(writer), broken(false) {}
+    ~Client();
+
+    const int read_fd;
+    shared_ptr<Writer> writer;
+    // written by the serving thread only
+    bool broken;
+  };
+
+  struct Request {
+    shared_ptr<Client> client;
+    vector<DType> sample;
+    boost::system_time arrival;
+  };
+
+  void AcceptLoop();
+  void ReadLoop(shared_ptr<Client> client);
+  void WriteLoop(shared_ptr<Writer> writer);
+  // starts the reader and the writer of a connection, with mutex_ held
+  void AddClient(const int read_fd, const int write_fd);
+  // joins the readers and writers that are done
+  void ReapThreads();
+
+  static const size_t kMaxQueuedReplies = 4096;
+
+  const string socket_path_;
+  const Shape input_shape_;
+  const size_t batch_size_;
+  const size_t sample_size_;
+  const int max_latency_;
+  const DType mean_;
+  const DType scale_;
+
+  int listen_fd_;
+  scoped_ptr<boost::thread> acceptor_;
+
+  // requests of the clients, guarded by mutex_; the acceptor and the
+  // readers are sources of requests, their sockets are shut down to stop;
+  // a socket is listed until its writer closes it
+  std::map<boost::thread::id, shared_ptr<boost::thread> > threads_;
+  vector<boost::thread::id> finished_threads_;
+  std::deque<Request> queue_;
+  vector<int> client_fds_;
+  int num_sources_;
+  bool stop_;
+  boost::mutex mutex_;
+  boost::condition_variable cond_;
+
+  // the batch handed out last and its host buffers
+  vector<Request> batch_;
+  vector<DType> input_buffer_;
+  vector<DType> output_buffer_;
+
+  // disable copy
+  Server(const Server&);
+  Server& operator=(const Server&);
+};
+
+}  // namespace blitz
+
+#endif  // SRC_MODEL_SERVER_H_
@@ -0,0 +1,216 @@
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "backend/backends.h"
+#include "model/seralize.h"
+#include "scheduler/gradientdescent.h"
+#include "scheduler/scheduler.h"
+#include "util/common.h"
+
+using namespace blitz;
+
+typedef Scheduler<CPUTensor, float> CPUScheduler;
+typedef Serializer<CPUTensor, float> CPUSerializer;
+typedef Optimizer<CPUTensor, float>::LayerParam LayerParam;
+
+const char DESCRIPTION[] = "data_shape 3 5 5\nlayers.0.type Conv\n";
+
+/*
+ * a conv weight and an affine weight and bias under two optimizers, each
+ * with an update so that the checkpoint carries their states as well
+ */
+shared_ptr<CPUScheduler> make_scheduler() {
+  map<string, shared_ptr<Optimizer<CPUTensor, float> > > optimizers;
+  optimizers["o1"] = make_shared<Gradientdescent<CPUTensor, float> >("o1",
+    0.1f, 0.0f, 0);
+  optimizers["o2"] = make_shared<Gradientdescent<CPUTensor, float> >("o2",
+    0.1f, 0.0f, 0);
+  shared_ptr<CPUScheduler> scheduler = make_shared<CPUScheduler>(optimizers);
+
+  Shape conv_shape(4);
+  conv_shape[0] = 4;
+  conv_shape[1] = 3;
+  conv_shape[2] = 3;
+  conv_shape[3] = 3;
+  scheduler->AddLayer("o1", "conv1", make_shared<CPUTensor<float> >(
+    conv_shape), make_shared<CPUTensor<float> >(conv_shape));
+
+  Shape affine_shape(2);
+  affine_shape[0] = 75;
+  affine_shape[1] = 10;
+  scheduler->AddLayer("o2", "fc1", make_shared<CPUTensor<float> >(
+    affine_shape), make_shared<CPUTensor<float> >(affine_shape));
+
+  Shape bias_shape(1);
+  bias_shape[0] = 10;
+  scheduler->AddLayer("o2", "fc1_bias", make_shared<CPUTensor<float> >(
+    bias_shape), make_shared<CPUTensor<float> >(bias_shape));
+  return scheduler;
+}
+
+// weights and states in the order of the optimizers and their layers
+vector<CPUTensor<float>*> tensors(const CPUScheduler& scheduler) {
+  typedef map<string, shared_ptr<Optimizer<CPUTensor, float> > > Optimizers;
+  typedef map<string, shared_ptr<LayerParam> > LayerParams;
+  vector<CPUTensor<float>*> result;
+  const Optimizers& optimizers = scheduler.optimizers();
+  for (Optimizers::const_iterator it = optimizers.begin();
+    it != optimizers.end(); ++it) {
+    const LayerParams& layer_params = (it->second)->layer_params();
+    for (LayerParams::const_iterator param_it = layer_params.begin();
+      param_it != layer_params.end(); ++param_it) {
+      result.push_back((param_it->second)->weight().get());
+      result.push_back((param_it->second)->state().get());
+    }
+  }
+  return result;
+}
+
+void random_fill(const CPUScheduler& scheduler) {
+  vector<CPUTensor<float>*> all = tensors(scheduler);
+  for (size_t i = 0; i < all.size(); ++i) {
+    for (size_t j = 0; j < all[i]->size(); ++j) {
+      (*all[i])[j] = static_cast<float>(rand()) / RAND_MAX - 0.5;
+    }
+  }
+}
+
+// values of every tensor, one after another
+vector<float> values(const CPUScheduler& scheduler) {
+  vector<CPUTensor<float>*> all = tensors(scheduler);
+  vector<float> result;
+  for (size_t i = 0; i < all.size(); ++i) {
+    result.insert(result.end(), all[i]->data(),
+      all[i]->data() + all[i]->size());
+  }
+  return result;
+}
+
+bool same_values(const vector<float>& left, const vector<float>& right) {
+  if (left.size() != right.size() || memcmp(&left[0], &right[0],
+    left.size() * sizeof(float)) != 0) {
+    std::cout << "tensors differ" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// serializer has to outlive scheduler, whose tensors map its file
+bool load(const string& path, CPUSerializer* serializer,
+  CPUScheduler* scheduler) {
+  string error;
+  if (!CPUSerializer::Check(path, scheduler, &error)) {
+    std::cout << error << std::endl;
+    return false;
+  }
+  serializer->Load(path, scheduler);
+  return true;
+}
+
+/*
+ * Save, then Load into zeroed tensors of the same shapes
+ */
+bool save_check(const string& path) {
+  shared_ptr<CPUScheduler> saved = make_scheduler();
+  random_fill(*saved);
+  CPUSerializer saver;
+  saver.set_description(DESCRIPTION);
+  saver.Save(path, *saved);
+
+  string description;
+  if (!CPUSerializer::ReadDescription(path, &description) ||
+    description != DESCRIPTION) {
+    std::cout << "description lost" << std::endl;
+    return false;
+  }
+  CPUSerializer loader;
+  shared_ptr<CPUScheduler> loaded = make_scheduler();
+  return load(path, &loader, loaded.get()) &&
+    same_values(values(*saved), values(*loaded));
+}
+
+/*
+ * SaveAsync copies the tensors before it returns, training may change
+ * them in place while the writer is busy
+ */
+bool save_async_check(const string& path) {
+  shared_ptr<CPUScheduler> saved = make_scheduler();
+  random_fill(*saved);
+  const vector<float> snapshot = values(*saved);
+  CPUSerializer saver;
+  if (!saver.SaveAsync(path, *saved)) {
+    std::cout << "writer busy" << std::endl;
+    return false;
+  }
+  vector<CPUTensor<float>*> all = tensors(*saved);
+  for (size_t i = 0; i < all.size(); ++i) {
+    for (size_t j = 0; j < all[i]->size(); ++j) {
+      (*all[i])[j] += 1;
+    }
+  }
+  saver.Wait();
+
+  CPUSerializer loader;
+  shared_ptr<CPUScheduler> loaded = make_scheduler();
+  return load(path, &loader, loaded.get()) &&
+    same_values(snapshot, values(*loaded));
+}
+
+/*
+ * Check rejects a file cut within the header, the entries and the tensors
+ */
+bool truncated_check(const string& path) {
+  std::ifstream file(path.c_str(), std::ios::binary);
+  const vector<char> bytes((std::istreambuf_iterator<char>(file)),
+    std::istreambuf_iterator<char>());
+  shared_ptr<CPUScheduler> scheduler = make_scheduler();
+  const size_t cuts[3] = {sizeof(CheckpointHeader) / 2,
+    sizeof(CheckpointHeader) + sizeof(CheckpointEntry) / 2,
+    bytes.size() - sizeof(float)};
+  const string truncated = path + ".truncated";
+  bool pass = true;
+  for (int i = 0; i < 3 && pass; ++i) {
+    std::ofstream out(truncated.c_str(), std::ios::binary);
+    out.write(&bytes[0], cuts[i]);
+    out.close();
+    string error;
+    if (CPUSerializer::Check(truncated, scheduler.get(), &error) ||
+      error.find("truncated") == string::npos) {
+      std::cout << "cut at " << cuts[i] << " accepted: " << error <<
+        std::endl;
+      pass = false;
+    }
+  }
+  unlink(truncated.c_str());
+  return pass;
+}
+
+int main() {
+  char path[] = "/tmp/blitz_checkpoint_XXXXXX";
+  const int fd = mkstemp(path);
+  if (fd < 0) {
+    std::cout << "mkstemp failed" << std::endl;
+    return 1;
+  }
+  close(fd);
+
+  bool pass = true;
+  bool result = save_check(path);
+  std::cout << "save and load: " << (result ? "pass" : "fail") << std::endl;
+  pass = pass && result;
+
+  result = truncated_check(path);
+  std::cout << "truncated: " << (result ? "pass" : "fail") << std::endl;
+  pass = pass && result;
+
+  result = save_async_check(path);
+  std::cout << "save async: " << (result ? "pass" : "fail") << std::endl;
+  pass = pass && result;
+
+  unlink(path);
+  return pass ? 0 : 1;
+}
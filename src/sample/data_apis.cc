@@ -14,13 +14,14 @@ int main() {
   std::cout << "model_type :" << model_type << std::endl;
 
   blitz::shared_ptr<blitz::DataIterator<blitz::CPUTensor, float> >
-    data_iterator = parser.data_label<blitz::CPUTensor, float>();
+    data_iterator = parser.data_set<blitz::CPUTensor, float>();
 
   data_iterator->Init();
 
-  blitz::shared_ptr<blitz::CPUTensor<float> > tensor = data_iterator->GenerateTensor(0);
+  blitz::shared_ptr<blitz::CPUTensor<float> > input, target;
+  data_iterator->GenerateBatch(0, &input, &target);
 
-  const blitz::Shape& shape = tensor->shape();
+  const blitz::Shape& shape = target->shape();
 
   for (size_t i = 0; i < shape.dimension(); ++i) {
     std::cout << "dimension " << i << " : " << shape[i] << std::endl;
@@ -1,30 +1,717 @@
-#include <yaml-cpp/yaml.h>
+#include <hdf5.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-#include "initializer/parser.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "data/data_iterator.h"
+#include "data/record.h"
 #include "util/common.h"
 #include "backend/cpu_tensor.h"
+#include "backend/sparse_tensor.h"
 
-int main() {
-  blitz::Parser parser(YAML::LoadFile("example/alexnet_conv_batch.yaml"));
+using namespace blitz;
 
-  blitz::shared_ptr<blitz::DataIterator<blitz::CPUTensor, float> >
-    data_iterator = parser.data_set<blitz::CPUTensor, float>();
+typedef DataIterator<CPUTensor, float> Iterator;
 
-  data_iterator->Init();
+// shards of uneven size, so that batches and windows span files
+const int SHARDS = 3;
+const int SHARD_SAMPLES[SHARDS] = {37, 25, 41};
+const int FEATURES = 4;
+const int BATCH_SIZE = 8;
+const int POOL_SIZE = 4;
 
-  // normal
-  blitz::shared_ptr<blitz::CPUTensor<float> > tensor = data_iterator->GenerateTensor(0);
+// files of a single stream, batches of COMPACT_BATCH_SIZE samples of
+// COMPACT_FEATURES elements are no multiple of the vector width
+const int COMPACT_SAMPLES = 21;
+const int COMPACT_FEATURES = 13;
+const int COMPACT_BATCH_SIZE = 5;
+const float TOLERANCE = 1e-5;
 
-  // update index
-  tensor = data_iterator->GenerateTensor(45);
+/*
+ * feature k of sample i is i * FEATURES + k, its label is i; sample_num
+ * may claim fewer samples than the sets hold
+ */
+void write_shard(const string& file, int first, int samples,
+  int sample_num) {
+  vector<float> data(samples * FEATURES);
+  vector<float> label(samples);
+  for (int i = 0; i < samples; ++i) {
+    for (int k = 0; k < FEATURES; ++k) {
+      data[i * FEATURES + k] = (first + i) * FEATURES + k;
+    }
+    label[i] = first + i;
+  }
 
-  // update index
-  tensor = data_iterator->GenerateTensor(90);
+  hid_t file_id = H5Fcreate(file.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
+    H5P_DEFAULT);
+  hsize_t data_dims[2] = {static_cast<hsize_t>(samples), FEATURES};
+  hid_t space_id = H5Screate_simple(2, data_dims, NULL);
+  hid_t set_id = H5Dcreate2(file_id, "data", H5T_NATIVE_FLOAT, space_id,
+    H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Dwrite(set_id, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT, &data[0]);
+  H5Dclose(set_id);
+  H5Sclose(space_id);
 
-  // update index
-  tensor = data_iterator->GenerateTensor(900);
+  hsize_t label_dims[2] = {static_cast<hsize_t>(samples), 1};
+  space_id = H5Screate_simple(2, label_dims, NULL);
+  set_id = H5Dcreate2(file_id, "label", H5T_NATIVE_FLOAT, space_id,
+    H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Dwrite(set_id, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT, &label[0]);
+  H5Dclose(set_id);
+  H5Sclose(space_id);
 
-  return 0;
+  hsize_t num_dims[1] = {1};
+  space_id = H5Screate_simple(1, num_dims, NULL);
+  set_id = H5Dcreate2(file_id, "sample_num", H5T_NATIVE_INT, space_id,
+    H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Dwrite(set_id, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+    &sample_num);
+  H5Dclose(set_id);
+  H5Sclose(space_id);
+  H5Fclose(file_id);
 }
 
+/*
+ * a record file of num_sample rows of sample_size elements of type
+ */
+void write_record(const string& path, const uint32_t type,
+  const uint64_t num_sample, const uint64_t sample_size, const void* data,
+  const size_t bytes) {
+  RecordHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kRecordMagic, sizeof(header.magic));
+  header.version = kRecordVersion;
+  header.type = type;
+  header.num_sample = num_sample;
+  header.sample_size = sample_size;
+  header.data_offset = kRecordAlignment;
+  std::ofstream file(path.c_str(), std::ios::binary);
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  const vector<char> padding(header.data_offset - sizeof(header), 0);
+  file.write(&padding[0], padding.size());
+  file.write(static_cast<const char*>(data), bytes);
+}
+
+/*
+ * a shard of a single stream, data and labels stored as the given types
+ */
+void write_typed_shard(const string& file, const hid_t type,
+  const void* data, const int samples, const int features,
+  const hid_t label_type, const void* label) {
+  hid_t file_id = H5Fcreate(file.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
+    H5P_DEFAULT);
+  hsize_t data_dims[2] = {static_cast<hsize_t>(samples),
+    static_cast<hsize_t>(features)};
+  hid_t space_id = H5Screate_simple(2, data_dims, NULL);
+  hid_t set_id = H5Dcreate2(file_id, "data", type, space_id, H5P_DEFAULT,
+    H5P_DEFAULT, H5P_DEFAULT);
+  H5Dwrite(set_id, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+  H5Dclose(set_id);
+  H5Sclose(space_id);
+
+  hsize_t label_dims[2] = {static_cast<hsize_t>(samples), 1};
+  space_id = H5Screate_simple(2, label_dims, NULL);
+  set_id = H5Dcreate2(file_id, "label", label_type, space_id,
+    H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Dwrite(set_id, label_type, H5S_ALL, H5S_ALL, H5P_DEFAULT, label);
+  H5Dclose(set_id);
+  H5Sclose(space_id);
+
+  hsize_t num_dims[1] = {1};
+  space_id = H5Screate_simple(1, num_dims, NULL);
+  set_id = H5Dcreate2(file_id, "sample_num", H5T_NATIVE_INT, space_id,
+    H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Dwrite(set_id, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT, &samples);
+  H5Dclose(set_id);
+  H5Sclose(space_id);
+  H5Fclose(file_id);
+}
+
+/*
+ * half float bits of value, exact for normal values of at most 11
+ * significant bits
+ */
+uint16_t half_bits(const float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint16_t sign = (bits >> 16) & 0x8000;
+  if ((bits & 0x7fffffff) == 0) {
+    return sign;
+  }
+  const int exponent = static_cast<int>((bits >> 23) & 0xff) - 127 + 15;
+  return sign | (exponent << 10) | ((bits >> 13) & 0x3ff);
+}
+
+string write_shards(const string& directory) {
+  const string list = directory + "/shards.txt";
+  std::ofstream list_file(list.c_str());
+  int first = 0;
+  for (int i = 0; i < SHARDS; ++i) {
+    std::stringstream file;
+    file << directory << "/shard" << i << ".h5";
+    write_shard(file.str(), first, SHARD_SAMPLES[i], SHARD_SAMPLES[i]);
+    list_file << file.str() << "\n";
+    first += SHARD_SAMPLES[i];
+  }
+  return list;
+}
+
+shared_ptr<Iterator> make_iterator(const string& list, const bool shuffle,
+  const int io_threads, const string& io_engine) {
+  Shape input_shape(2);
+  input_shape[0] = BATCH_SIZE;
+  input_shape[1] = FEATURES;
+  Shape label_shape(2);
+  label_shape[0] = BATCH_SIZE;
+  label_shape[1] = 1;
+  shared_ptr<Iterator> iterator = make_shared<Iterator>(list, input_shape,
+    list, label_shape, BATCH_SIZE, POOL_SIZE);
+  iterator->set_shuffle(shuffle);
+  iterator->set_io_threads(io_threads);
+  iterator->set_io_engine(io_engine);
+  iterator->Init();
+  return iterator;
+}
+
+shared_ptr<Iterator> make_stream_iterator(const string& data,
+  const string& label, const int batch_size, const int features,
+  const float mean, const float scale) {
+  Shape input_shape(2);
+  input_shape[0] = batch_size;
+  input_shape[1] = features;
+  Shape label_shape(2);
+  label_shape[0] = batch_size;
+  label_shape[1] = 1;
+  shared_ptr<Iterator> iterator = make_shared<Iterator>(data, input_shape,
+    label, label_shape, batch_size, POOL_SIZE);
+  iterator->set_normalization(mean, scale);
+  iterator->Init();
+  return iterator;
+}
+
+bool values_compare(const char* name, const CPUTensor<float>& tensor,
+  const float* expect) {
+  for (size_t i = 0; i < tensor.size(); ++i) {
+    if (fabs(tensor[i] - expect[i]) > TOLERANCE * (1 + fabs(expect[i]))) {
+      std::cout << name << " element " << i << " " << tensor[i] <<
+        " expected " << expect[i] << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * the whole batches and the tail, in file order, against data and label
+ * computed one element at a time
+ */
+bool stream_check(const char* name, Iterator& iterator,
+  const vector<float>& data, const vector<float>& label) {
+  const int batch_size = iterator.batch_size();
+  const int features = data.size() / label.size();
+  if (iterator.total() != static_cast<int>(label.size())) {
+    std::cout << name << " total " << iterator.total() << std::endl;
+    return false;
+  }
+  const int num_batch = iterator.total() / batch_size;
+  shared_ptr<CPUTensor<float> > input, target;
+  for (int i = 0; i <= num_batch; ++i) {
+    if (i < num_batch) {
+      iterator.GenerateBatch(i, &input, &target);
+    } else {
+      iterator.GenerateTail(&input, &target);
+    }
+    if (!values_compare(name, *input, &data[i * batch_size * features]) ||
+      !values_compare(name, *target, &label[i * batch_size])) {
+      std::cout << name << " batch " << i << " differs" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// sample ids of a batch, -1 if its features or label do not match
+bool batch_samples(const CPUTensor<float>& input,
+  const CPUTensor<float>& target, vector<int>* samples) {
+  for (size_t i = 0; i < target.size(); ++i) {
+    const int sample = static_cast<int>(target[i]);
+    for (int k = 0; k < FEATURES; ++k) {
+      if (input[i * FEATURES + k] != sample * FEATURES + k) {
+        std::cout << "sample " << sample << " misaligned with its label" <<
+          std::endl;
+        return false;
+      }
+    }
+    samples->push_back(sample);
+  }
+  return true;
+}
+
+// every sample of [0, total) exactly once
+bool covers(const vector<int>& samples, int total) {
+  vector<int> count(total, 0);
+  for (size_t i = 0; i < samples.size(); ++i) {
+    if (samples[i] < 0 || samples[i] >= total || count[samples[i]]++ > 0) {
+      std::cout << "sample " << samples[i] << " out of range or repeated" <<
+        std::endl;
+      return false;
+    }
+  }
+  if (static_cast<int>(samples.size()) != total) {
+    std::cout << samples.size() << " of " << total << " samples" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool epoch_samples(Iterator& iterator, vector<int>* samples) {
+  const int num_batch = iterator.total() / BATCH_SIZE;
+  for (int i = 0; i < num_batch; ++i) {
+    shared_ptr<CPUTensor<float> > input, target;
+    iterator.GenerateBatch(i, &input, &target);
+    if (!batch_samples(*input, *target, samples)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * whole batches in file order, then the tail covers the rest once
+ */
+bool sequential_check(const string& list) {
+  shared_ptr<Iterator> iterator = make_iterator(list, false, 1, "pread");
+  const int total = iterator->total();
+  vector<int> samples;
+  if (!epoch_samples(*iterator, &samples)) {
+    return false;
+  }
+  for (size_t i = 0; i < samples.size(); ++i) {
+    if (samples[i] != static_cast<int>(i)) {
+      std::cout << "batch sample " << i << " is " << samples[i] << std::endl;
+      return false;
+    }
+  }
+  if (iterator->tail_size() != total % BATCH_SIZE) {
+    std::cout << "tail size " << iterator->tail_size() << std::endl;
+    return false;
+  }
+  shared_ptr<CPUTensor<float> > input, target;
+  iterator->GenerateTail(&input, &target);
+  if (!batch_samples(*input, *target, &samples)) {
+    return false;
+  }
+  // random access back into the first window
+  iterator->GenerateBatch(1, &input, &target);
+  vector<int> again;
+  if (!batch_samples(*input, *target, &again) || again[0] != BATCH_SIZE) {
+    std::cout << "random access to batch 1 failed" << std::endl;
+    return false;
+  }
+  return covers(samples, total);
+}
+
+/*
+ * two shuffled epochs, each a permutation of the whole batches
+ */
+bool shuffle_check(const string& list) {
+  shared_ptr<Iterator> iterator = make_iterator(list, true, 1, "pread");
+  const int whole = iterator->total() / BATCH_SIZE * BATCH_SIZE;
+  vector<int> first, second;
+  if (!epoch_samples(*iterator, &first) || !covers(first, whole)) {
+    return false;
+  }
+  iterator->Shuffle(1);
+  if (!epoch_samples(*iterator, &second) || !covers(second, whole)) {
+    return false;
+  }
+  bool sequential = true;
+  for (size_t i = 0; i < first.size(); ++i) {
+    sequential = sequential && first[i] == static_cast<int>(i);
+  }
+  if (sequential || first == second) {
+    std::cout << "epochs are not shuffled" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool same_bytes(Iterator& left, Iterator& right) {
+  const int num_batch = left.total() / BATCH_SIZE;
+  for (int i = 0; i < num_batch; ++i) {
+    shared_ptr<CPUTensor<float> > left_input, left_target;
+    shared_ptr<CPUTensor<float> > right_input, right_target;
+    left.GenerateBatch(i, &left_input, &left_target);
+    right.GenerateBatch(i, &right_input, &right_target);
+    if (memcmp(left_input->data(), right_input->data(),
+      left_input->size() * sizeof(float)) != 0 ||
+      memcmp(left_target->data(), right_target->data(),
+      left_target->size() * sizeof(float)) != 0) {
+      std::cout << "batch " << i << " differs" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * pread on one and on several io threads and io_uring read the same bytes,
+ * io_uring falls back to pread where the kernel lacks it
+ */
+bool engine_check(const string& list) {
+  shared_ptr<Iterator> pread = make_iterator(list, false, 1, "pread");
+  shared_ptr<Iterator> threads = make_iterator(list, false, SHARDS, "pread");
+  shared_ptr<Iterator> uring = make_iterator(list, false, 1, "io_uring");
+  return same_bytes(*pread, *threads) && same_bytes(*pread, *uring);
+}
 
+/*
+ * the first Init writes the index, the next one counts from it; a shard
+ * rewritten at the same size right after is counted again
+ */
+bool index_check(const string& directory, const string& list) {
+  struct stat index_stat;
+  if (stat((list + ".index").c_str(), &index_stat) != 0) {
+    std::cout << "no index next to " << list << std::endl;
+    return false;
+  }
+  int total = 0;
+  for (int i = 0; i < SHARDS; ++i) {
+    total += SHARD_SAMPLES[i];
+  }
+  shared_ptr<Iterator> iterator = make_iterator(list, false, 1, "pread");
+  if (iterator->total() != total) {
+    std::cout << "indexed total " << iterator->total() << std::endl;
+    return false;
+  }
+
+  // the loader of an iterator may hold the shard open, hdf5 does not
+  // truncate a file that is open
+  const string shard = string(directory) + "/shard0.h5";
+  iterator.reset();
+  write_shard(shard, 0, SHARD_SAMPLES[0], SHARD_SAMPLES[0] - 1);
+  iterator = make_iterator(list, false, 1, "pread");
+  const int rewritten_total = iterator->total();
+  iterator.reset();
+  write_shard(shard, 0, SHARD_SAMPLES[0], SHARD_SAMPLES[0]);
+  if (rewritten_total != total - 1) {
+    std::cout << "rewritten shard total " << rewritten_total << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/*
+ * float records, mapped as batch views without normalization and copied
+ * with it
+ */
+bool record_check(const string& directory) {
+  const int samples = 3 * BATCH_SIZE - 3;
+  vector<float> data(samples * FEATURES);
+  vector<float> label(samples);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = i % 97 - 40.0f;
+  }
+  for (int i = 0; i < samples; ++i) {
+    label[i] = i;
+  }
+  const string data_path = directory + "/data.rec";
+  const string label_path = directory + "/label.rec";
+  write_record(data_path, kRecordFloat32, samples, FEATURES, &data[0],
+    data.size() * sizeof(float));
+  write_record(label_path, kRecordFloat32, samples, 1, &label[0],
+    label.size() * sizeof(float));
+
+  const float mean = 1.5f;
+  const float scale = 0.25f;
+  vector<float> normalized(data.size());
+  for (size_t i = 0; i < data.size(); ++i) {
+    normalized[i] = (data[i] - mean) * scale;
+  }
+  bool pass = stream_check("record view", *make_stream_iterator(data_path,
+    label_path, BATCH_SIZE, FEATURES, 0, 1), data, label);
+  pass = pass && stream_check("record copy", *make_stream_iterator(
+    data_path, label_path, BATCH_SIZE, FEATURES, mean, scale), normalized,
+    label);
+  unlink(data_path.c_str());
+  unlink(label_path.c_str());
+  return pass;
+}
+
+/*
+ * uint8 and fp16 samples, in records and in hdf5 shards, normalized while
+ * batches are filled; batches and the tail are no multiple of the
+ * vector width, so that the vector loops leave a remainder
+ */
+bool compact_check(const string& directory) {
+  const int size = COMPACT_SAMPLES * COMPACT_FEATURES;
+  vector<uint8_t> bytes(size);
+  vector<uint16_t> halves(size);
+  vector<float> byte_values(size);
+  vector<float> half_values(size);
+  for (int i = 0; i < size; ++i) {
+    bytes[i] = (i * 37) % 256;
+    byte_values[i] = bytes[i];
+    // quarters in [-16, 16)
+    half_values[i] = ((i * 29) % 128) * 0.25f - 16.0f;
+    halves[i] = half_bits(half_values[i]);
+  }
+  vector<float> label(COMPACT_SAMPLES);
+  for (int i = 0; i < COMPACT_SAMPLES; ++i) {
+    label[i] = i;
+  }
+
+  hid_t half_type = H5Tcopy(H5T_IEEE_F32LE);
+  H5Tset_fields(half_type, 15, 10, 5, 0, 10);
+  H5Tset_size(half_type, 2);
+  H5Tset_ebias(half_type, 15);
+  H5Tset_precision(half_type, 16);
+
+  struct Case {
+    const char* name;
+    uint32_t record_type;
+    hid_t hdf5_type;
+    const void* data;
+    size_t element_size;
+    const vector<float>* values;
+    float mean;
+    float scale;
+  };
+  const Case cases[] = {
+    {"uint8", kRecordUInt8, H5T_NATIVE_UCHAR, &bytes[0], sizeof(uint8_t),
+      &byte_values, 127.5f, 1.0f / 128},
+    {"fp16", kRecordFloat16, half_type, &halves[0], sizeof(uint16_t),
+      &half_values, 2.0f, 0.5f}
+  };
+
+  const string data_path = directory + "/compact.rec";
+  const string label_path = directory + "/compact_label.rec";
+  const string shard = directory + "/compact.h5";
+  const string list = directory + "/compact.txt";
+  std::ofstream(list.c_str()) << shard << "\n";
+  write_record(label_path, kRecordFloat32, COMPACT_SAMPLES, 1, &label[0],
+    label.size() * sizeof(float));
+  bool pass = true;
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]) && pass; ++i) {
+    const Case& c = cases[i];
+    vector<float> normalized(size);
+    for (int j = 0; j < size; ++j) {
+      normalized[j] = ((*c.values)[j] - c.mean) * c.scale;
+    }
+    write_record(data_path, c.record_type, COMPACT_SAMPLES, COMPACT_FEATURES,
+      c.data, size * c.element_size);
+    write_typed_shard(shard, c.hdf5_type, c.data, COMPACT_SAMPLES,
+      COMPACT_FEATURES, H5T_NATIVE_FLOAT, &label[0]);
+    const string record_name = string(c.name) + " record";
+    const string hdf5_name = string(c.name) + " hdf5";
+    pass = stream_check(record_name.c_str(), *make_stream_iterator(data_path,
+      label_path, COMPACT_BATCH_SIZE, COMPACT_FEATURES, c.mean, c.scale),
+      normalized, label) && stream_check(hdf5_name.c_str(),
+      *make_stream_iterator(list, list, COMPACT_BATCH_SIZE, COMPACT_FEATURES,
+      c.mean, c.scale), normalized, label);
+  }
+  H5Tclose(half_type);
+  unlink(data_path.c_str());
+  unlink(label_path.c_str());
+  unlink(shard.c_str());
+  unlink((list + ".index").c_str());
+  unlink(list.c_str());
+  return pass;
+}
+
+/*
+ * int32 class indices as labels of normalized samples, in a record and in
+ * an hdf5 shard, are read as exact indices and left unnormalized
+ */
+bool class_index_check(const string& directory) {
+  const int size = COMPACT_SAMPLES * COMPACT_FEATURES;
+  const float mean = 1.5f;
+  const float scale = 0.25f;
+  vector<float> data(size);
+  vector<float> normalized(size);
+  for (int i = 0; i < size; ++i) {
+    data[i] = i * 0.5f;
+    normalized[i] = (data[i] - mean) * scale;
+  }
+  // far from the mean, so that a normalized index can't pass
+  vector<int32_t> classes(COMPACT_SAMPLES);
+  vector<float> label(COMPACT_SAMPLES);
+  for (int i = 0; i < COMPACT_SAMPLES; ++i) {
+    classes[i] = (i * 7) % 1000 + 100;
+    label[i] = classes[i];
+  }
+
+  const string data_path = directory + "/class.rec";
+  const string label_path = directory + "/class_label.rec";
+  const string shard = directory + "/class.h5";
+  const string list = directory + "/class.txt";
+  std::ofstream(list.c_str()) << shard << "\n";
+  write_record(data_path, kRecordFloat32, COMPACT_SAMPLES, COMPACT_FEATURES,
+    &data[0], size * sizeof(float));
+  write_record(label_path, kRecordInt32, COMPACT_SAMPLES, 1, &classes[0],
+    classes.size() * sizeof(int32_t));
+  write_typed_shard(shard, H5T_NATIVE_FLOAT, &data[0], COMPACT_SAMPLES,
+    COMPACT_FEATURES, H5T_NATIVE_INT32, &classes[0]);
+
+  const bool pass = stream_check("int32 record", *make_stream_iterator(
+    data_path, label_path, COMPACT_BATCH_SIZE, COMPACT_FEATURES, mean, scale),
+    normalized, label) && stream_check("int32 hdf5", *make_stream_iterator(
+    list, list, COMPACT_BATCH_SIZE, COMPACT_FEATURES, mean, scale),
+    normalized, label);
+  unlink(data_path.c_str());
+  unlink(label_path.c_str());
+  unlink(shard.c_str());
+  unlink((list + ".index").c_str());
+  unlink(list.c_str());
+  return pass;
+}
+
+/*
+ * a batch of sparse rows holds the rows of its samples, zero based and
+ * scaled
+ */
+bool sparse_compare(const char* name, const CPUTensor<float>& tensor,
+  const vector<vector<int> >& column, const vector<vector<float> >& value,
+  const int first) {
+  const SparseTensor<CPUTensor, float>* sparse =
+    dynamic_cast<const SparseTensor<CPUTensor, float>*>(&tensor);
+  if (sparse == NULL || sparse->rows() != tensor.shape()[0]) {
+    std::cout << name << " batch is not sparse or has wrong rows" <<
+      std::endl;
+    return false;
+  }
+  const size_t* row_offset = sparse->row_offset();
+  for (size_t i = 0; i < sparse->rows(); ++i) {
+    const vector<int>& expect_column = column[first + i];
+    const vector<float>& expect_value = value[first + i];
+    const size_t count = row_offset[i + 1] - row_offset[i];
+    if (count != expect_column.size()) {
+      std::cout << name << " sample " << first + i << " " << count <<
+        " entries expected " << expect_column.size() << std::endl;
+      return false;
+    }
+    for (size_t j = 0; j < count; ++j) {
+      if (sparse->column()[row_offset[i] + j] != expect_column[j] ||
+        sparse->value()[row_offset[i] + j] != expect_value[j]) {
+        std::cout << name << " sample " << first + i << " entry " << j <<
+          " differs" << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/*
+ * a libsvm file as data and labels: rows without entries, blank lines
+ * between samples, targets read as labels
+ */
+bool libsvm_check(const string& directory) {
+  const float scale = 0.5f;
+  vector<vector<int> > column(COMPACT_SAMPLES);
+  vector<vector<float> > value(COMPACT_SAMPLES);
+  vector<float> label(COMPACT_SAMPLES);
+  const string path = directory + "/samples.svm";
+  std::ofstream file(path.c_str());
+  for (int i = 0; i < COMPACT_SAMPLES; ++i) {
+    label[i] = i % 3 - 1;
+    file << label[i];
+    // every fifth sample has no entries
+    for (int j = 0; j < COMPACT_FEATURES && i % 5 != 2; ++j) {
+      if ((i + j) % 3 == 0) {
+        const float stored = i + j * 0.25f;
+        file << " " << j + 1 << ":" << stored;
+        column[i].push_back(j);
+        value[i].push_back(stored * scale);
+      }
+    }
+    file << (i % 4 == 0 ? "\n\n" : "\n");
+  }
+  file.close();
+
+  bool pass = true;
+  shared_ptr<Iterator> iterator = make_stream_iterator(path, path,
+    COMPACT_BATCH_SIZE, COMPACT_FEATURES, 0, scale);
+  if (iterator->total() != COMPACT_SAMPLES) {
+    std::cout << "libsvm total " << iterator->total() << std::endl;
+    pass = false;
+  }
+  const int num_batch = COMPACT_SAMPLES / COMPACT_BATCH_SIZE;
+  shared_ptr<CPUTensor<float> > input, target;
+  for (int i = 0; i <= num_batch && pass; ++i) {
+    if (i < num_batch) {
+      iterator->GenerateBatch(i, &input, &target);
+    } else {
+      iterator->GenerateTail(&input, &target);
+    }
+    if (!sparse_compare("libsvm", *input, column, value,
+      i * COMPACT_BATCH_SIZE) ||
+      !values_compare("libsvm", *target, &label[i * COMPACT_BATCH_SIZE])) {
+      std::cout << "libsvm batch " << i << " differs" << std::endl;
+      pass = false;
+    }
+  }
+  iterator.reset();
+  unlink(path.c_str());
+  return pass;
+}
+
+int main() {
+  char directory[] = "/tmp/blitz_data_XXXXXX";
+  if (mkdtemp(directory) == NULL) {
+    std::cout << "mkdtemp failed" << std::endl;
+    return 1;
+  }
+  const string list = write_shards(directory);
+
+  bool pass = true;
+  bool result = sequential_check(list);
+  std::cout << "sequential and tail: " << (result ? "pass" : "fail") <<
+    std::endl;
+  pass = pass && result;
+
+  result = index_check(directory, list);
+  std::cout << "index: " << (result ? "pass" : "fail") << std::endl;
+  pass = pass && result;
+
+  result = shuffle_check(list);
+  std::cout << "shuffle: " << (result ? "pass" : "fail") << std::endl;
+  pass = pass && result;
+
+  result = engine_check(list);
+  std::cout << "io engines: " << (result ? "pass" : "fail") << std::endl;
+  pass = pass && result;
+
+  result = record_check(directory);
+  std::cout << "record files: " << (result ? "pass" : "fail") << std::endl;
+  pass = pass && result;
+
+  result = compact_check(directory);
+  std::cout << "uint8 and fp16: " << (result ? "pass" : "fail") << std::endl;
+  pass = pass && result;
+
+  result = class_index_check(directory);
+  std::cout << "int32 class indices: " << (result ? "pass" : "fail") <<
+    std::endl;
+  pass = pass && result;
+
+  result = libsvm_check(directory);
+  std::cout << "libsvm: " << (result ? "pass" : "fail") << std::endl;
+  pass = pass && result;
+
+  for (int i = 0; i < SHARDS; ++i) {
+    std::stringstream file;
+    file << directory << "/shard" << i << ".h5";
+    unlink(file.str().c_str());
+  }
+  unlink((list + ".index").c_str());
+  unlink(list.c_str());
+  rmdir(directory);
+
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,179 @@
+#include <pthread.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+#include "backend/backends.h"
+#include "infer/blitz_infer.h"
+#include "model/seralize.h"
+#include "scheduler/gradientdescent.h"
+#include "scheduler/scheduler.h"
+
+using namespace blitz;
+
+// conv, pooling and a softmax affine layer on 3 x 10 x 10 samples
+const int BATCH_SIZE = 6;
+const int BATCHES = 4;
+const int ROUNDS = 20;
+const float TOLERANCE = 1e-5;
+
+const char DESCRIPTION[] =
+  "data_shape 3 10 10\n"
+  "data_mean 0.5\n"
+  "data_scale 2\n"
+  "layers.0.type Conv\n"
+  "layers.0.name conv1\n"
+  "layers.0.filler f\n"
+  "layers.0.optimizer o\n"
+  "layers.0.fshape 6 3 3 3\n"
+  "layers.0.padding 1\n"
+  "layers.0.activation.type Rectlin\n"
+  "layers.1.type Pooling\n"
+  "layers.1.name pool1\n"
+  "layers.1.fshape 2\n"
+  "layers.1.stride 2\n"
+  "layers.1.op max\n"
+  "layers.2.type Affine\n"
+  "layers.2.name fc1\n"
+  "layers.2.filler f\n"
+  "layers.2.optimizer o\n"
+  "layers.2.nout 7\n"
+  "layers.2.activation.type Softmax\n";
+
+void random_fill(CPUTensor<float>* tensor) {
+  for (size_t i = 0; i < tensor->size(); ++i) {
+    (*tensor)[i] = static_cast<float>(rand()) / RAND_MAX - 0.5;
+  }
+}
+
+/*
+ * weights of the description, as bin/blitz saves them after training
+ */
+void write_checkpoint(const string& path) {
+  map<string, shared_ptr<Optimizer<CPUTensor, float> > > optimizers;
+  optimizers["o"] = make_shared<Gradientdescent<CPUTensor, float> >("o",
+    0.0f, 0.0f, 0);
+  Scheduler<CPUTensor, float> scheduler(optimizers);
+
+  Shape conv_shape(4);
+  conv_shape[0] = 6;
+  conv_shape[1] = 3;
+  conv_shape[2] = 3;
+  conv_shape[3] = 3;
+  shared_ptr<CPUTensor<float> > conv =
+    make_shared<CPUTensor<float> >(conv_shape);
+  random_fill(conv.get());
+  scheduler.AddLayer("o", "conv1", conv, shared_ptr<CPUTensor<float> >());
+
+  Shape affine_shape(2);
+  affine_shape[0] = 6 * 5 * 5;
+  affine_shape[1] = 7;
+  shared_ptr<CPUTensor<float> > affine =
+    make_shared<CPUTensor<float> >(affine_shape);
+  random_fill(affine.get());
+  scheduler.AddLayer("o", "fc1", affine, shared_ptr<CPUTensor<float> >());
+
+  Serializer<CPUTensor, float> serializer;
+  serializer.set_description(DESCRIPTION);
+  serializer.Save(path, scheduler);
+}
+
+struct Predictions {
+  blitz_infer_model* model;
+  const vector<float>* input;
+  const vector<float>* expected;
+  int rows;
+  bool pass;
+};
+
+/*
+ * predicts the same batch ROUNDS times, every result matches expected
+ */
+void* predict_rounds(void* arg) {
+  Predictions* predictions = static_cast<Predictions*>(arg);
+  vector<float> output(predictions->expected->size());
+  for (int i = 0; i < ROUNDS && predictions->pass; ++i) {
+    if (blitz_infer_predict_batch(predictions->model,
+      &(*predictions->input)[0], predictions->rows, &output[0]) != 0) {
+      std::cout << "predict error: " << blitz_infer_error() << std::endl;
+      predictions->pass = false;
+    }
+    for (size_t j = 0; j < output.size() && predictions->pass; ++j) {
+      const float expected = (*predictions->expected)[j];
+      if (fabs(output[j] - expected) > TOLERANCE * (1 + fabs(expected))) {
+        std::cout << "round " << i << " output " << j << " " << output[j] <<
+          " expected " << expected << std::endl;
+        predictions->pass = false;
+      }
+    }
+  }
+  return NULL;
+}
+
+int main(int argc, char** argv) {
+  char path[] = "/tmp/blitz_infer_XXXXXX";
+  const int fd = mkstemp(path);
+  if (fd < 0) {
+    std::cout << "mkstemp failed" << std::endl;
+    return 1;
+  }
+  close(fd);
+  write_checkpoint(path);
+
+  const int num_threads = argc > 1 ? atoi(argv[1]) : 0;
+  blitz_infer_model* model = blitz_infer_create(path, BATCH_SIZE,
+    num_threads);
+  if (model == NULL) {
+    std::cout << "create error: " << blitz_infer_error() << std::endl;
+    unlink(path);
+    return 1;
+  }
+  blitz_infer_model* replica = blitz_infer_replicate(model);
+  const size_t input_size = blitz_infer_input_size(model);
+  const size_t output_size = blitz_infer_output_size(model);
+
+  // whole batches and a partial one, each predicted alone first
+  vector<vector<float> > inputs(BATCHES);
+  vector<vector<float> > expected(BATCHES);
+  vector<int> rows(BATCHES);
+  bool pass = true;
+  for (int i = 0; i < BATCHES; ++i) {
+    rows[i] = i + 1 == BATCHES ? BATCH_SIZE / 2 : BATCH_SIZE;
+    inputs[i].resize(rows[i] * input_size);
+    for (size_t j = 0; j < inputs[i].size(); ++j) {
+      inputs[i][j] = static_cast<float>(rand()) / RAND_MAX;
+    }
+    expected[i].resize(rows[i] * output_size);
+    if (blitz_infer_predict_batch(model, &inputs[i][0], rows[i],
+      &expected[i][0]) != 0) {
+      std::cout << "predict error: " << blitz_infer_error() << std::endl;
+      pass = false;
+    }
+  }
+
+  // the model and its replica on two threads, each over every batch
+  for (int i = 0; i < BATCHES && pass; ++i) {
+    const int other = (i + 1) % BATCHES;
+    Predictions predictions[2] = {
+      {model, &inputs[i], &expected[i], rows[i], true},
+      {replica, &inputs[other], &expected[other], rows[other], true}
+    };
+    pthread_t threads[2];
+    for (int j = 0; j < 2; ++j) {
+      pthread_create(&threads[j], NULL, predict_rounds, &predictions[j]);
+    }
+    for (int j = 0; j < 2; ++j) {
+      pthread_join(threads[j], NULL);
+      pass = pass && predictions[j].pass;
+    }
+  }
+  std::cout << "replicas on two threads: " << (pass ? "pass" : "fail") <<
+    std::endl;
+
+  blitz_infer_destroy(replica);
+  blitz_infer_destroy(model);
+  unlink(path);
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+#include "backend/backends.h"
+#include "filler/gaussian.h"
+#include "layer/affine.h"
+#include "layer/conv.h"
+#include "layer/layer_wrapper.h"
+#include "layer/pooling_layer.h"
+#include "scheduler/gradientdescent.h"
+#include "transform/cross_entropy_multi.h"
+#include "transform/rectlin.h"
+#include "transform/softmax.h"
+#include "util/common.h"
+
+using namespace blitz;
+
+typedef LayerWrapper<CPUTensor, float> CPULayerWrapper;
+typedef Scheduler<CPUTensor, float> CPUScheduler;
+typedef Optimizer<CPUTensor, float>::LayerParam LayerParam;
+
+// conv, max pooling and affine with a bias; the tail is smaller than the
+// planned batch and is no divisor of it
+const int BATCH_SIZE = 8;
+const int TAIL_SIZE = 3;
+const int CHANNELS = 3;
+const int IMAGE = 10;
+const int FILTERS = 6;
+const int CLASSES = 10;
+const float TOLERANCE = 1e-4;
+
+// a net planned for batch_size samples and its scheduler, which lists
+// the weights and updates of its layers
+struct Net {
+  shared_ptr<CPULayerWrapper> layer_wrapper;
+  shared_ptr<CPUScheduler> scheduler;
+};
+
+Shape data_shape(const int batch_size) {
+  Shape shape(4);
+  shape[0] = batch_size;
+  shape[1] = CHANNELS;
+  shape[2] = IMAGE;
+  shape[3] = IMAGE;
+  return shape;
+}
+
+Net make_net(const int batch_size, const string& algorithm) {
+  Shape filter_shape(4);
+  filter_shape[0] = FILTERS;
+  filter_shape[1] = CHANNELS;
+  filter_shape[2] = 3;
+  filter_shape[3] = 3;
+  list<shared_ptr<Layer<CPUTensor, float> > > layers;
+  layers.push_back(make_shared<Conv<CPUTensor, float> >("conv", "filler",
+    "optimizer", make_shared<Rectlin<CPUTensor, float> >(), filter_shape,
+    1, 1, 0, 0, "blas", algorithm));
+  layers.push_back(make_shared<PoolingLayer<CPUTensor, float> >("pool", 2,
+    2, "max"));
+  shared_ptr<Affine<CPUTensor, float> > affine =
+    make_shared<Affine<CPUTensor, float> >("affine", "filler", "optimizer",
+    make_shared<Softmax<CPUTensor, float> >(), CLASSES);
+  affine->set_bias(make_shared<ParamLayer<CPUTensor, float>::Bias>(
+    "affine_bias", "filler", "optimizer"));
+  layers.push_back(affine);
+
+  map<string, shared_ptr<Filler<CPUTensor, float> > > fillers;
+  fillers["filler"] = make_shared<Gaussian<CPUTensor, float> >("filler");
+  map<string, shared_ptr<Optimizer<CPUTensor, float> > > optimizers;
+  optimizers["optimizer"] =
+    make_shared<Gradientdescent<CPUTensor, float> >("optimizer", 0.1f, 0.0f,
+    0);
+
+  Net net;
+  net.layer_wrapper = make_shared<CPULayerWrapper>(layers,
+    make_shared<CrossEntropyMulti<CPUTensor, float> >());
+  net.scheduler = make_shared<CPUScheduler>(optimizers);
+  net.layer_wrapper->Init(data_shape(batch_size),
+    make_shared<FillerWrapper<CPUTensor, float> >(fillers), net.scheduler);
+  return net;
+}
+
+// the weights or the updates of the layers, in the order of the scheduler
+vector<CPUTensor<float>*> params(const CPUScheduler& scheduler,
+  const bool update) {
+  typedef map<string, shared_ptr<LayerParam> > LayerParams;
+  const LayerParams& layer_params =
+    scheduler.optimizers().begin()->second->layer_params();
+  vector<CPUTensor<float>*> result;
+  for (LayerParams::const_iterator it = layer_params.begin();
+    it != layer_params.end(); ++it) {
+    result.push_back(update ? (it->second)->update().get() :
+      (it->second)->weight().get());
+  }
+  return result;
+}
+
+void random_fill(CPUTensor<float>* tensor) {
+  for (size_t i = 0; i < tensor->size(); ++i) {
+    (*tensor)[i] = static_cast<float>(rand()) / RAND_MAX - 0.5f;
+  }
+}
+
+// one hot targets of random classes
+shared_ptr<CPUTensor<float> > make_target(const int batch_size) {
+  Shape shape(2);
+  shape[0] = batch_size;
+  shape[1] = CLASSES;
+  shared_ptr<CPUTensor<float> > target = make_shared<CPUTensor<float> >(shape);
+  target->Fill(0);
+  for (int i = 0; i < batch_size; ++i) {
+    (*target)[i * CLASSES + rand() % CLASSES] = 1;
+  }
+  return target;
+}
+
+vector<float> values(const CPUTensor<float>& tensor) {
+  return vector<float>(tensor.data(), tensor.data() + tensor.size());
+}
+
+bool values_compare(const string& name, const vector<float>& result,
+  const vector<float>& expect) {
+  if (result.size() != expect.size()) {
+    std::cout << name << " size " << result.size() << " expected " <<
+      expect.size() << std::endl;
+    return false;
+  }
+  for (size_t i = 0; i < result.size(); ++i) {
+    if (fabs(result[i] - expect[i]) > TOLERANCE * (1 + fabs(expect[i]))) {
+      std::cout << name << " element " << i << " " << result[i] <<
+        " expected " << expect[i] << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// forward, cost derivative and backward of a training step, without the
+// optimizer, returns the output and the updates one after another
+vector<float> train_step(const Net& net, shared_ptr<CPUTensor<float> > input,
+  shared_ptr<CPUTensor<float> > target) {
+  net.layer_wrapper->ForwardProp(input);
+  vector<float> result = values(*(net.layer_wrapper->forward_output()));
+  net.layer_wrapper->DerivativeCost(target);
+  net.layer_wrapper->BackwardProp();
+  const vector<CPUTensor<float>*> updates = params(*net.scheduler, true);
+  for (size_t i = 0; i < updates.size(); ++i) {
+    const vector<float> update = values(*updates[i]);
+    result.insert(result.end(), update.begin(), update.end());
+  }
+  return result;
+}
+
+/*
+ * a net planned for BATCH_SIZE samples trains on a tail batch as a net
+ * planned for the tail does, and on whole batches as before afterwards;
+ * in inference mode it evaluates the tail as the net of the tail does
+ */
+bool reshape_check(const string& algorithm) {
+  const Net net = make_net(BATCH_SIZE, algorithm);
+  const Net tail_net = make_net(TAIL_SIZE, algorithm);
+  const vector<CPUTensor<float>*> weights = params(*net.scheduler, false);
+  const vector<CPUTensor<float>*> tail_weights =
+    params(*tail_net.scheduler, false);
+  for (size_t i = 0; i < weights.size(); ++i) {
+    random_fill(weights[i]);
+    std::copy(weights[i]->data(), weights[i]->data() + weights[i]->size(),
+      tail_weights[i]->data());
+  }
+
+  shared_ptr<CPUTensor<float> > input = make_shared<CPUTensor<float> >(
+    data_shape(BATCH_SIZE));
+  random_fill(input.get());
+  shared_ptr<CPUTensor<float> > target = make_target(BATCH_SIZE);
+  shared_ptr<CPUTensor<float> > tail = make_shared<CPUTensor<float> >(
+    data_shape(TAIL_SIZE));
+  random_fill(tail.get());
+  shared_ptr<CPUTensor<float> > tail_target = make_target(TAIL_SIZE);
+
+  net.layer_wrapper->SetTrainMode();
+  tail_net.layer_wrapper->SetTrainMode();
+  const vector<float> whole = train_step(net, input, target);
+  bool pass = values_compare(algorithm + " train tail",
+    train_step(net, tail, tail_target),
+    train_step(tail_net, tail, tail_target));
+  pass = pass && values_compare(algorithm + " train whole after tail",
+    train_step(net, input, target), whole);
+  if (!pass) {
+    return false;
+  }
+
+  // targets of the classes the tail net predicts for all but the last
+  // sample, so that the accuracy is neither 0 nor 1
+  net.layer_wrapper->SetInferenceMode();
+  tail_net.layer_wrapper->SetInferenceMode();
+  tail_net.layer_wrapper->ForwardProp(tail);
+  const vector<float> tail_output =
+    values(*(tail_net.layer_wrapper->forward_output()));
+  tail_target->Fill(0);
+  for (int i = 0; i < TAIL_SIZE; ++i) {
+    const float* row = &tail_output[i * CLASSES];
+    const int predict = std::max_element(row, row + CLASSES) - row;
+    (*tail_target)[i * CLASSES + (i < TAIL_SIZE - 1 ? predict :
+      (predict + 1) % CLASSES)] = 1;
+  }
+  const float expect = static_cast<float>(TAIL_SIZE - 1) / TAIL_SIZE;
+
+  net.layer_wrapper->ForwardProp(input);
+  net.layer_wrapper->ForwardProp(tail);
+  pass = values_compare(algorithm + " eval tail",
+    values(*(net.layer_wrapper->forward_output())), tail_output);
+  const float accuracy = net.layer_wrapper->Evaluate(tail_target,
+    "classify");
+  if (fabs(accuracy - expect) > TOLERANCE) {
+    std::cout << algorithm << " eval tail accuracy " << accuracy <<
+      " expected " << expect << std::endl;
+    pass = false;
+  }
+  return pass;
+}
+
+int main() {
+  srand(1);
+  const char* algorithms[] = {"gemm", "batch", "chunk"};
+  bool pass = true;
+  for (size_t i = 0; i < sizeof(algorithms) / sizeof(algorithms[0]); ++i) {
+    bool result = reshape_check(algorithms[i]);
+    std::cout << "reshape " << algorithms[i] << ": " <<
+      (result ? "pass" : "fail") << std::endl;
+    pass = pass && result;
+  }
+  return pass ? 0 : 1;
+}
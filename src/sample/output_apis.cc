@@ -0,0 +1,197 @@
+#include <hdf5.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#include "backend/backends.h"
+#include "model/output_writer.h"
+#include "util/common.h"
+
+using namespace blitz;
+
+typedef OutputWriter<CPUTensor, float> CPUOutputWriter;
+
+// more batches than buffers in flight, a tail batch, and csv batches
+// larger than the text buffer of the sink
+const int BATCHES = 6;
+const int BATCH_SIZE = 4096;
+const int TAIL_SIZE = 5;
+const int DIM = 33;
+
+// integers, fractions, large, tiny and negative values, some of more
+// digits than the default precision
+float output_value(const size_t index) {
+  switch (index % 6) {
+    case 0:
+      return index;
+    case 1:
+      return index * 0.001f;
+    case 2:
+      return -1.5f * index;
+    case 3:
+      return 1e7f + index;
+    case 4:
+      return 1.0f / (index + 1);
+    default:
+      return 3.14159265f * index * 1e-9f;
+  }
+}
+
+vector<shared_ptr<CPUTensor<float> > > make_outputs() {
+  vector<shared_ptr<CPUTensor<float> > > outputs;
+  size_t index = 0;
+  for (int i = 0; i <= BATCHES; ++i) {
+    Shape shape(2);
+    shape[0] = i < BATCHES ? BATCH_SIZE : TAIL_SIZE;
+    shape[1] = DIM;
+    shared_ptr<CPUTensor<float> > output =
+      make_shared<CPUTensor<float> >(shape);
+    for (size_t j = 0; j < output->size(); ++j) {
+      (*output)[j] = output_value(index++);
+    }
+    outputs.push_back(output);
+  }
+  return outputs;
+}
+
+// the writer drains its batches and closes its sink once destroyed
+void write_outputs(const string& format, const string& path,
+  const vector<shared_ptr<CPUTensor<float> > >& outputs) {
+  CPUOutputWriter writer(CPUOutputWriter::MakeSink(format, path));
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    writer.Write(outputs[i].get());
+  }
+}
+
+string read_file(const string& path) {
+  std::ifstream file(path.c_str(), std::ios::binary);
+  return string(std::istreambuf_iterator<char>(file),
+    std::istreambuf_iterator<char>());
+}
+
+// rows of the outputs, in order
+vector<float> concatenate(
+  const vector<shared_ptr<CPUTensor<float> > >& outputs) {
+  vector<float> values;
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    values.insert(values.end(), outputs[i]->data(),
+      outputs[i]->data() + outputs[i]->size());
+  }
+  return values;
+}
+
+/*
+ * the csv sink writes byte for byte what OutputCSV writes
+ */
+bool csv_check(const string& directory,
+  const vector<shared_ptr<CPUTensor<float> > >& outputs) {
+  const string path = directory + "/output.csv";
+  const string expect_path = directory + "/expect.csv";
+  write_outputs("csv", path, outputs);
+  {
+    std::ofstream expect_file(expect_path.c_str());
+    for (size_t i = 0; i < outputs.size(); ++i) {
+      outputs[i]->OutputCSV(expect_file);
+    }
+  }
+  const string result = read_file(path);
+  const string expect = read_file(expect_path);
+  unlink(path.c_str());
+  unlink(expect_path.c_str());
+  if (result != expect) {
+    size_t i = 0;
+    while (i < result.size() && i < expect.size() && result[i] == expect[i]) {
+      ++i;
+    }
+    std::cout << "csv differs at byte " << i << " of " << expect.size() <<
+      ": " << result.substr(i, 20) << " expected " << expect.substr(i, 20) <<
+      std::endl;
+    return false;
+  }
+  return true;
+}
+
+/*
+ * the binary sink writes its header and then the rows as they are
+ */
+bool binary_check(const string& directory,
+  const vector<shared_ptr<CPUTensor<float> > >& outputs) {
+  const string path = directory + "/output.bin";
+  write_outputs("binary", path, outputs);
+  const string result = read_file(path);
+  unlink(path.c_str());
+
+  const vector<float> values = concatenate(outputs);
+  const uint32_t header[2] = {sizeof(float), DIM};
+  string expect("BLITZOUT");
+  expect.append(reinterpret_cast<const char*>(header), sizeof(header));
+  expect.append(reinterpret_cast<const char*>(&values[0]),
+    values.size() * sizeof(float));
+  if (result != expect) {
+    std::cout << "binary output of " << result.size() << " bytes differs, " <<
+      expect.size() << " expected" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/*
+ * the hdf5 sink writes all rows to its "output" set
+ */
+bool hdf5_check(const string& directory,
+  const vector<shared_ptr<CPUTensor<float> > >& outputs) {
+  const string path = directory + "/output.h5";
+  write_outputs("hdf5", path, outputs);
+
+  const vector<float> expect = concatenate(outputs);
+  hid_t file_id = H5Fopen(path.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+  hid_t set_id = H5Dopen2(file_id, "output", H5P_DEFAULT);
+  hid_t space_id = H5Dget_space(set_id);
+  hsize_t dims[2] = {0, 0};
+  bool pass = H5Sget_simple_extent_ndims(space_id) == 2;
+  H5Sget_simple_extent_dims(space_id, dims, NULL);
+  pass = pass && dims[1] == static_cast<hsize_t>(DIM) &&
+    dims[0] * dims[1] == expect.size();
+  vector<float> result(expect.size());
+  pass = pass && H5Dread(set_id, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL,
+    H5P_DEFAULT, &result[0]) >= 0 && result == expect;
+  H5Sclose(space_id);
+  H5Dclose(set_id);
+  H5Fclose(file_id);
+  unlink(path.c_str());
+  if (!pass) {
+    std::cout << "hdf5 output of " << dims[0] << " x " << dims[1] <<
+      " differs" << std::endl;
+  }
+  return pass;
+}
+
+int main() {
+  char directory[] = "/tmp/blitz_output_XXXXXX";
+  if (mkdtemp(directory) == NULL) {
+    std::cout << "mkdtemp failed" << std::endl;
+    return 1;
+  }
+  const vector<shared_ptr<CPUTensor<float> > > outputs = make_outputs();
+
+  bool pass = true;
+  bool result = csv_check(directory, outputs);
+  std::cout << "csv: " << (result ? "pass" : "fail") << std::endl;
+  pass = pass && result;
+
+  result = binary_check(directory, outputs);
+  std::cout << "binary: " << (result ? "pass" : "fail") << std::endl;
+  pass = pass && result;
+
+  result = hdf5_check(directory, outputs);
+  std::cout << "hdf5: " << (result ? "pass" : "fail") << std::endl;
+  pass = pass && result;
+
+  rmdir(directory);
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,181 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <boost/thread/thread.hpp>
+
+#include "backend/backends.h"
+#include "model/server.h"
+#include "util/common.h"
+
+using namespace blitz;
+
+typedef Server<CPUTensor, float> CPUServer;
+
+// requests of all clients are sent at once, so that batches fill up long
+// before the latency bound; the last batch is partial
+const int CLIENTS = 3;
+const int REQUESTS = 11;
+const int BATCH_SIZE = 4;
+const int FEATURES = 5;
+const int MAX_LATENCY = 200000;
+const float MEAN = 1.5f;
+const float SCALE = 0.5f;
+
+float sample_value(const int client, const int request, const int feature) {
+  return client * 1000 + request * 10 + feature;
+}
+
+bool write_full(const int fd, const char* data, size_t size) {
+  while (size > 0) {
+    const ssize_t bytes = write(fd, data, size);
+    if (bytes <= 0) {
+      return false;
+    }
+    data += bytes;
+    size -= bytes;
+  }
+  return true;
+}
+
+bool read_full(const int fd, char* data, size_t size) {
+  while (size > 0) {
+    const ssize_t bytes = read(fd, data, size);
+    if (bytes <= 0) {
+      return false;
+    }
+    data += bytes;
+    size -= bytes;
+  }
+  return true;
+}
+
+/*
+ * sends every request before reading a reply, the replies must be the
+ * normalized samples in the order of the requests
+ */
+void client_run(const string& socket_path, const int client, bool* pass) {
+  *pass = false;
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  memcpy(address.sun_path, socket_path.c_str(), socket_path.size());
+  if (fd < 0 || connect(fd, reinterpret_cast<struct sockaddr*>(&address),
+    sizeof(address)) != 0) {
+    std::cout << "client " << client << " connect failed" << std::endl;
+    return;
+  }
+
+  vector<float> requests(REQUESTS * FEATURES);
+  for (int i = 0; i < REQUESTS; ++i) {
+    for (int j = 0; j < FEATURES; ++j) {
+      requests[i * FEATURES + j] = sample_value(client, i, j);
+    }
+  }
+  vector<float> replies(requests.size());
+  if (!write_full(fd, reinterpret_cast<const char*>(&requests[0]),
+    requests.size() * sizeof(float)) ||
+    !read_full(fd, reinterpret_cast<char*>(&replies[0]),
+    replies.size() * sizeof(float))) {
+    std::cout << "client " << client << " io failed" << std::endl;
+    close(fd);
+    return;
+  }
+  close(fd);
+
+  for (size_t i = 0; i < replies.size(); ++i) {
+    const float expect = (requests[i] - MEAN) * SCALE;
+    if (replies[i] != expect) {
+      std::cout << "client " << client << " reply " << i / FEATURES <<
+        " feature " << i % FEATURES << " " << replies[i] << " expected " <<
+        expect << std::endl;
+      return;
+    }
+  }
+  *pass = true;
+}
+
+/*
+ * replies to each batch with its input, records the rows of the batches
+ */
+void serve(CPUServer* server, vector<int>* batch_rows, bool* pass) {
+  *pass = true;
+  CPUTensor<float> input(server->input_shape());
+  int rows;
+  while ((rows = server->NextBatch(&input)) > 0) {
+    batch_rows->push_back(rows);
+    if (rows > BATCH_SIZE || static_cast<int>(input.shape()[0]) != rows) {
+      std::cout << "batch of " << rows << " rows, input of " <<
+        input.shape()[0] << std::endl;
+      *pass = false;
+    }
+    server->Reply(&input, rows);
+  }
+}
+
+bool serve_check(const string& socket_path) {
+  Shape input_shape(2);
+  input_shape[0] = BATCH_SIZE;
+  input_shape[1] = FEATURES;
+  CPUServer server(socket_path, input_shape, MAX_LATENCY, MEAN, SCALE);
+  server.Start();
+
+  vector<int> batch_rows;
+  bool serve_pass;
+  boost::thread server_thread(serve, &server, &batch_rows, &serve_pass);
+  bool client_pass[CLIENTS];
+  vector<shared_ptr<boost::thread> > clients;
+  for (int i = 0; i < CLIENTS; ++i) {
+    clients.push_back(make_shared<boost::thread>(client_run, socket_path, i,
+      &client_pass[i]));
+  }
+  bool pass = true;
+  for (int i = 0; i < CLIENTS; ++i) {
+    clients[i]->join();
+    pass = pass && client_pass[i];
+  }
+  server.Stop();
+  server_thread.join();
+  pass = pass && serve_pass;
+
+  // every request in exactly one batch, coalesced across clients
+  int total = 0;
+  int full = 0;
+  for (size_t i = 0; i < batch_rows.size(); ++i) {
+    total += batch_rows[i];
+    full += batch_rows[i] == BATCH_SIZE;
+  }
+  if (total != CLIENTS * REQUESTS) {
+    std::cout << "batches hold " << total << " requests" << std::endl;
+    pass = false;
+  }
+  if (full < CLIENTS * REQUESTS / BATCH_SIZE / 2) {
+    std::cout << "only " << full << " full batches of " <<
+      batch_rows.size() << std::endl;
+    pass = false;
+  }
+  return pass;
+}
+
+int main() {
+  char directory[] = "/tmp/blitz_server_XXXXXX";
+  if (mkdtemp(directory) == NULL) {
+    std::cout << "mkdtemp failed" << std::endl;
+    return 1;
+  }
+  const string socket_path = string(directory) + "/server.sock";
+
+  bool pass = true;
+  bool result = serve_check(socket_path);
+  std::cout << "batching and reply order: " << (result ? "pass" : "fail") <<
+    std::endl;
+  pass = pass && result;
+
+  rmdir(directory);
+  return pass ? 0 : 1;
+}
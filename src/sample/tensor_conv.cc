@@ -1,5 +1,12 @@
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
 #include "backend/backends.h"
+#include "util/blitz_thread_pool.h"
 
 using namespace blitz;
 
@@ -108,7 +115,184 @@ void report_conv_update(CPUTensor<float>& update) {
   }
 }
 
-int main() {
+// relative to the magnitude of the gemm result
+const float TOLERANCE = 1e-4;
+
+bool tensor_compare(const char* name, const CPUTensor<float>& expect,
+  const CPUTensor<float>& result) {
+  for (size_t i = 0; i < expect.size(); ++i) {
+    float scale = std::max(1.0f, std::fabs(expect[i]));
+    if (std::fabs(expect[i] - result[i]) > TOLERANCE * scale) {
+      std::cout << name << " wrong index " << i << " value " <<
+        result[i] << ": " << expect[i] << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * batch, direct and chunk against gemm for one batch size and
+ * stride/padding config, chunks of 2 leave a tail of 1 of 5 images
+ */
+bool algorithm_compare(int batch_size, int stride, int padding) {
+  const int input_channel = 3;
+  const int input_height = 11;
+  const int input_width = 9;
+  const int output_channel = 4;
+  const int filter_size = 3;
+  const int output_height = (input_height + 2 * padding - filter_size) /
+    stride + 1;
+  const int output_width = (input_width + 2 * padding - filter_size) /
+    stride + 1;
+  const int chunk_size = 2;
+
+  Shape input_shape(4);
+  input_shape[0] = batch_size;
+  input_shape[1] = input_channel;
+  input_shape[2] = input_height;
+  input_shape[3] = input_width;
+
+  Shape filter_shape(4);
+  filter_shape[0] = output_channel;
+  filter_shape[1] = input_channel;
+  filter_shape[2] = filter_size;
+  filter_shape[3] = filter_size;
+
+  Shape output_shape(4);
+  output_shape[0] = batch_size;
+  output_shape[1] = output_channel;
+  output_shape[2] = output_height;
+  output_shape[3] = output_width;
+
+  Shape unpack_shape(2);
+  unpack_shape[0] = input_channel * filter_size * filter_size;
+  unpack_shape[1] = output_height * output_width;
+
+  Shape chunk_unpack_shape(2);
+  chunk_unpack_shape[0] = unpack_shape[0];
+  chunk_unpack_shape[1] = unpack_shape[1] * chunk_size;
+
+  Shape chunk_shape(2);
+  chunk_shape[0] = output_channel;
+  chunk_shape[1] = unpack_shape[1] * chunk_size;
+
+  CPUTensor<float> input(input_shape);
+  CPUTensor<float> weight(filter_shape);
+  CPUTensor<float> output(output_shape);
+  Backend<CPUTensor, float>::UniformDistributionFunc(-1, 1, &input);
+  Backend<CPUTensor, float>::UniformDistributionFunc(-1, 1, &weight);
+  Backend<CPUTensor, float>::UniformDistributionFunc(-1, 1, &output);
+
+  CPUTensor<float> unpack(unpack_shape);
+  CPUTensor<float> chunk_unpack(chunk_unpack_shape);
+  CPUTensor<float> chunk(chunk_shape);
+  const int num_threads = ThreadPool::GetInstance().num_threads();
+  vector<shared_ptr<CPUTensor<float> > > unpack_batch(num_threads);
+  vector<shared_ptr<CPUTensor<float> > > update_batch(num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    unpack_batch[i] = make_shared<CPUTensor<float> >(unpack_shape);
+    update_batch[i] = make_shared<CPUTensor<float> >(filter_shape);
+  }
+
+  // gemm
+  CPUTensor<float> forward_gemm(output_shape);
+  CPUTensor<float> backward_gemm(input_shape);
+  CPUTensor<float> update_gemm(filter_shape);
+  Backend<CPUTensor, float>::Convolution2DForwardFunc(
+    &input, &weight, padding, padding, stride, stride,
+    &unpack, &forward_gemm);
+  Backend<CPUTensor, float>::Convolution2DBackwardFunc(
+    &output, &weight, padding, padding, stride, stride,
+    &unpack, &backward_gemm);
+  update_gemm.Fill(0);
+  Backend<CPUTensor, float>::Convolution2DUpdateFunc(
+    &input, &output, padding, padding, stride, stride,
+    &unpack, &update_gemm);
+
+  bool pass = true;
+  CPUTensor<float> forward(output_shape);
+  CPUTensor<float> backward(input_shape);
+  CPUTensor<float> update(filter_shape);
+
+  // batch
+  Backend<CPUTensor, float>::Convolution2DForwardFunc(
+    &input, &weight, padding, padding, stride, stride,
+    &unpack_batch, &forward);
+  pass = tensor_compare("batch forward", forward_gemm, forward) && pass;
+  Backend<CPUTensor, float>::Convolution2DBackwardFunc(
+    &output, &weight, padding, padding, stride, stride,
+    &unpack_batch, &backward);
+  pass = tensor_compare("batch backward", backward_gemm, backward) && pass;
+  update.Fill(0);
+  for (int i = 0; i < num_threads; ++i) {
+    update_batch[i]->Fill(0);
+  }
+  Backend<CPUTensor, float>::Convolution2DUpdateFunc(
+    &input, &output, padding, padding, stride, stride,
+    &unpack_batch, &update_batch, &update);
+  pass = tensor_compare("batch update", update_gemm, update) && pass;
+
+  // direct
+  Backend<CPUTensor, float>::Convolution2DForwardFunc(
+    &input, &weight, padding, padding, stride, stride, &forward);
+  pass = tensor_compare("direct forward", forward_gemm, forward) && pass;
+
+  // chunk
+  Backend<CPUTensor, float>::Convolution2DForwardFunc(
+    &input, &weight, padding, padding, stride, stride,
+    &chunk_unpack, &chunk, &forward);
+  pass = tensor_compare("chunk forward", forward_gemm, forward) && pass;
+  update.Fill(0);
+  Backend<CPUTensor, float>::Convolution2DUpdateFunc(
+    &input, &output, padding, padding, stride, stride,
+    &chunk_unpack, &chunk, &update);
+  pass = tensor_compare("chunk update", update_gemm, update) && pass;
+
+  return pass;
+}
+
+// a single image and 5 images, fewer than and not a multiple of the
+// threads, so that the batch algorithm splits images into tiles
+bool algorithms_compare() {
+  const int batch_sizes[] = {1, 5};
+  const int strides[] = {1, 1, 2, 2, 3};
+  const int paddings[] = {0, 1, 0, 1, 2};
+  bool pass = true;
+  for (size_t i = 0; i < 2; ++i) {
+    for (size_t j = 0; j < 5; ++j) {
+      if (!algorithm_compare(batch_sizes[i], strides[j], paddings[j])) {
+        std::cout << "batch " << batch_sizes[i] << " stride " <<
+          strides[j] << " padding " << paddings[j] << " failed" << std::endl;
+        pass = false;
+      }
+    }
+  }
+  return pass;
+}
+
+// on a pool of one thread, in a child process as a process sizes its
+// pool once
+bool algorithms_compare_serial() {
+  pid_t pid = fork();
+  if (pid == 0) {
+    ThreadPool::Init(1);
+    _exit(algorithms_compare() ? 0 : 1);
+  }
+  int status = 0;
+  return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+    WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char** argv) {
+  // forked before the pool starts its threads
+  bool serial_pass = algorithms_compare_serial();
+
+  // before the first kernel, which would make a pool of one thread
+  int num_threads = argc > 1 ? atoi(argv[1]) :
+    ThreadPool::DefaultNumThreads();
+  ThreadPool::Init(std::max(num_threads, 2));
+
   Shape input_shape(4);
   // batch_size
   input_shape[0] = 1;
@@ -166,7 +350,8 @@ int main() {
   // naive
   output.Fill(0);
   Backend<CPUTensor, float>::Convolution2DForwardFunc(
-    &input, &weight, stride_height, stride_width, &output);
+    &input, &weight, padding_height, padding_width,
+    stride_height, stride_width, &output);
 
   std::cout << "naive:" << std::endl;
   report_conv_forward(output);
@@ -191,5 +376,14 @@ int main() {
 
   report_conv_update(update);
 
-  return 0;
+  // every algorithm against gemm, on 1 and on num_threads threads
+  std::cout << "algorithms compare 1 thread: " <<
+    (serial_pass ? "pass" : "fail") << std::endl;
+
+  bool parallel_pass = algorithms_compare();
+  std::cout << "algorithms compare " <<
+    ThreadPool::GetInstance().num_threads() << " threads: " <<
+    (parallel_pass ? "pass" : "fail") << std::endl;
+
+  return serial_pass && parallel_pass ? 0 : 1;
 }
@@ -18,27 +18,10 @@ void forward_profile(
   // output.Fill(0);
   // naive parallel
   std::cout << "naive parallel:" << std::endl;
-  if (padding_height == 0 && padding_width == 0) {
-    for (int i = 0; i < ITER; ++i) {
-      Backend<CPUTensor, float>::Convolution2DForwardFunc(
-        &input, &weight, stride_height, stride_width, &output);
-    }
-  } else {
-    Shape input_shape(4);
-    // batch_size
-    input_shape[0] = input.shape()[0];
-    // input channel
-    input_shape[1] = input.shape()[1];
-    // input height
-    input_shape[2] = input.shape()[2] + 2 * padding_height;
-    // input width
-    input_shape[3] = input.shape()[3] + 2 * padding_width;
-    CPUTensor<float> padding_input(input_shape);
-    Backend<CPUTensor, float>::UniformDistributionFunc(0.0f, 100.0f, &padding_input);
-    for (int i = 0; i < ITER; ++i) {
-      Backend<CPUTensor, float>::Convolution2DForwardFunc(
-        &padding_input, &weight, stride_height, stride_width, &output);
-    }
+  for (int i = 0; i < ITER; ++i) {
+    Backend<CPUTensor, float>::Convolution2DForwardFunc(
+      &input, &weight, padding_height, padding_width,
+      stride_height, stride_width, &output);
   }
 
   // batch gemm parallel
@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include "backend/backends.h"
+#include "util/blitz_thread_pool.h"
+
+using namespace blitz;
+
+// a batch of BATCH rows over VOCAB columns, right matrices of DIM columns,
+// DIM is not a multiple of the avx width
+const int BATCH = 12;
+const int VOCAB = 300;
+const int DIM = 33;
+const int NONZEROS = 6;
+const float UNTOUCHED = 3.0f;
+const float TOLERANCE = 1e-4;
+
+float random_value() {
+  return static_cast<float>(rand()) / RAND_MAX - 0.5f;
+}
+
+void random_fill(CPUTensor<float>* tensor) {
+  for (size_t i = 0; i < tensor->size(); ++i) {
+    (*tensor)[i] = random_value();
+  }
+}
+
+void copy(const CPUTensor<float>& source, CPUTensor<float>* target) {
+  std::copy(source.data(), source.data() + source.size(), target->data());
+}
+
+/*
+ * compressed sparse rows of the batch, which starts after a leading row
+ * as batches of a larger stream do, and the same batch dense
+ */
+void make_batch(vector<size_t>* row_offset, vector<int>* column,
+  vector<float>* value, CPUTensor<float>* dense) {
+  dense->Fill(0);
+  row_offset->assign(1, 0);
+  column->clear();
+  value->clear();
+  for (int i = -1; i < BATCH; ++i) {
+    std::set<int> columns;
+    while (columns.size() < static_cast<size_t>(NONZEROS)) {
+      columns.insert(rand() % VOCAB);
+    }
+    for (std::set<int>::iterator it = columns.begin(); it != columns.end();
+      ++it) {
+      column->push_back(*it);
+      value->push_back(random_value());
+      if (i >= 0) {
+        (*dense)[i * VOCAB + *it] = value->back();
+      }
+    }
+    row_offset->push_back(column->size());
+  }
+}
+
+bool approximate(const float result, const float expect) {
+  return fabs(result - expect) <= TOLERANCE * (1 + fabs(expect));
+}
+
+/*
+ * rows of result in rows match expect, the other rows hold untouched
+ */
+bool rows_compare(const char* name, const CPUTensor<float>& result,
+  const CPUTensor<float>& expect, const CPUTensor<float>& untouched,
+  const vector<int>& rows) {
+  const size_t dim = result.size() / result.shape()[0];
+  vector<bool> listed(result.shape()[0], false);
+  for (size_t i = 0; i < rows.size(); ++i) {
+    listed[rows[i]] = true;
+  }
+  for (size_t i = 0; i < result.size(); ++i) {
+    const float expected = listed[i / dim] ? expect[i] : untouched[i];
+    if (!approximate(result[i], expected)) {
+      std::cout << name << " row " << i / dim << " column " << i % dim <<
+        " " << result[i] << " expected " << expected << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * rows are the sorted distinct columns of the batch
+ */
+bool rows_check(const char* name, const vector<int>& rows,
+  const vector<size_t>& row_offset, const vector<int>& column) {
+  vector<int> expect(column.begin() + row_offset[1],
+    column.begin() + row_offset[BATCH + 1]);
+  std::sort(expect.begin(), expect.end());
+  expect.erase(std::unique(expect.begin(), expect.end()), expect.end());
+  if (rows != expect) {
+    std::cout << name << " rows differ" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/*
+ * sparse dot and transpose dot against MatrixDotFunc of the dense batch
+ */
+bool sparse_dot_check() {
+  Shape dense_shape(2);
+  dense_shape[0] = BATCH;
+  dense_shape[1] = VOCAB;
+  CPUTensor<float> dense(dense_shape);
+  vector<size_t> row_offset;
+  vector<int> column;
+  vector<float> value;
+  make_batch(&row_offset, &column, &value, &dense);
+
+  Shape weight_shape(2);
+  weight_shape[0] = VOCAB;
+  weight_shape[1] = DIM;
+  Shape output_shape(2);
+  output_shape[0] = BATCH;
+  output_shape[1] = DIM;
+
+  // output = batch * weight
+  CPUTensor<float> weight(weight_shape);
+  random_fill(&weight);
+  CPUTensor<float> output(output_shape);
+  output.Fill(UNTOUCHED);
+  Backend<CPUTensor, float>::SparseMatrixDotFunc(&row_offset[1], &column[0],
+    &value[0], &weight, &output);
+  CPUTensor<float> expect(output_shape);
+  Backend<CPUTensor, float>::MatrixDotFunc(&dense, &weight, false, false,
+    1, 0, &expect);
+  vector<int> all_rows(BATCH);
+  for (int i = 0; i < BATCH; ++i) {
+    all_rows[i] = i;
+  }
+  bool pass = rows_compare("sparse dot", output, expect, output, all_rows);
+
+  // update = batch^T * backward, listed rows are cleared first
+  CPUTensor<float> backward(output_shape);
+  random_fill(&backward);
+  CPUTensor<float> update(weight_shape);
+  update.Fill(UNTOUCHED);
+  CPUTensor<float> untouched(weight_shape);
+  untouched.Fill(UNTOUCHED);
+  vector<int> rows;
+  Backend<CPUTensor, float>::SparseMatrixTransposeDotFunc(&row_offset[1],
+    &column[0], &value[0], &backward, &update, &rows);
+  CPUTensor<float> expect_update(weight_shape);
+  Backend<CPUTensor, float>::MatrixDotFunc(&dense, &backward, true, false,
+    1, 0, &expect_update);
+  pass = pass && rows_check("sparse transpose dot", rows, row_offset,
+    column);
+  pass = pass && rows_compare("sparse transpose dot", update, expect_update,
+    untouched, rows);
+  return pass;
+}
+
+/*
+ * embedding forward and backward against MatrixDotFunc of one hot rows,
+ * ids repeat within the batch
+ */
+bool embedding_check() {
+  Shape input_shape(2);
+  input_shape[0] = BATCH;
+  input_shape[1] = NONZEROS;
+  CPUTensor<float> input(input_shape);
+  Shape one_hot_shape(2);
+  one_hot_shape[0] = input.size();
+  one_hot_shape[1] = VOCAB;
+  CPUTensor<float> one_hot(one_hot_shape);
+  one_hot.Fill(0);
+  for (size_t i = 0; i < input.size(); ++i) {
+    // fewer ids than positions
+    input[i] = rand() % (VOCAB / 10);
+    one_hot[i * VOCAB + static_cast<int>(input[i])] = 1;
+  }
+
+  Shape weight_shape(2);
+  weight_shape[0] = VOCAB;
+  weight_shape[1] = DIM;
+  Shape output_shape(2);
+  output_shape[0] = input.size();
+  output_shape[1] = DIM;
+
+  CPUTensor<float> weight(weight_shape);
+  random_fill(&weight);
+  CPUTensor<float> output(output_shape);
+  Backend<CPUTensor, float>::EmbeddingForwardFunc(&input, &weight, &output);
+  CPUTensor<float> expect(output_shape);
+  Backend<CPUTensor, float>::MatrixDotFunc(&one_hot, &weight, false, false,
+    1, 0, &expect);
+  vector<int> all_rows(output_shape[0]);
+  for (size_t i = 0; i < all_rows.size(); ++i) {
+    all_rows[i] = i;
+  }
+  bool pass = rows_compare("embedding forward", output, expect, output,
+    all_rows);
+
+  CPUTensor<float> backward(output_shape);
+  random_fill(&backward);
+  CPUTensor<float> update(weight_shape);
+  update.Fill(UNTOUCHED);
+  CPUTensor<float> untouched(weight_shape);
+  untouched.Fill(UNTOUCHED);
+  vector<int> rows;
+  Backend<CPUTensor, float>::EmbeddingBackwardUpdateFunc(&input, &backward,
+    &update, &rows);
+  CPUTensor<float> expect_update(weight_shape);
+  Backend<CPUTensor, float>::MatrixDotFunc(&one_hot, &backward, true, false,
+    1, 0, &expect_update);
+  std::set<int> ids(input.data(), input.data() + input.size());
+  if (rows != vector<int>(ids.begin(), ids.end())) {
+    std::cout << "embedding backward rows differ" << std::endl;
+    pass = false;
+  }
+  pass = pass && rows_compare("embedding backward", update, expect_update,
+    untouched, rows);
+  return pass;
+}
+
+/*
+ * rows of the sparse update match GradientdescentFunc over the whole
+ * weight, weight and velocity of the other rows are left as they are
+ */
+bool gradientdescent_check() {
+  const float momentum_coef = 0.9;
+  const float learning_rate = 0.1;
+  const float decay = 0.01;
+  Shape shape(2);
+  shape[0] = VOCAB;
+  shape[1] = DIM;
+  CPUTensor<float> weight(shape);
+  CPUTensor<float> gradient(shape);
+  CPUTensor<float> velocity(shape);
+  random_fill(&weight);
+  random_fill(&gradient);
+  random_fill(&velocity);
+  CPUTensor<float> dense_weight(shape);
+  CPUTensor<float> dense_gradient(shape);
+  CPUTensor<float> dense_velocity(shape);
+  copy(weight, &dense_weight);
+  copy(gradient, &dense_gradient);
+  copy(velocity, &dense_velocity);
+  CPUTensor<float> old_weight(shape);
+  CPUTensor<float> old_velocity(shape);
+  copy(weight, &old_weight);
+  copy(velocity, &old_velocity);
+
+  std::set<int> row_set;
+  while (row_set.size() < static_cast<size_t>(BATCH * NONZEROS / 2)) {
+    row_set.insert(rand() % VOCAB);
+  }
+  const vector<int> rows(row_set.begin(), row_set.end());
+
+  Backend<CPUTensor, float>::SparseGradientdescentFunc(&rows[0], rows.size(),
+    momentum_coef, learning_rate, decay, BATCH, &weight, &gradient,
+    &velocity);
+  Backend<CPUTensor, float>::GradientdescentFunc(momentum_coef,
+    learning_rate, decay, BATCH, &dense_weight, &dense_gradient,
+    &dense_velocity);
+  return rows_compare("sparse gradientdescent weight", weight, dense_weight,
+    old_weight, rows) && rows_compare("sparse gradientdescent velocity",
+    velocity, dense_velocity, old_velocity, rows);
+}
+
+int main(int argc, char** argv) {
+  // before the first kernel, which would make a pool of one thread
+  int num_threads = argc > 1 ? atoi(argv[1]) :
+    ThreadPool::DefaultNumThreads();
+  ThreadPool::Init(std::max(num_threads, 2));
+  srand(1);
+
+  bool pass = true;
+  bool result = sparse_dot_check();
+  std::cout << "sparse dot: " << (result ? "pass" : "fail") << std::endl;
+  pass = pass && result;
+
+  result = embedding_check();
+  std::cout << "embedding: " << (result ? "pass" : "fail") << std::endl;
+  pass = pass && result;
+
+  result = gradientdescent_check();
+  std::cout << "sparse gradientdescent: " << (result ? "pass" : "fail") <<
+    std::endl;
+  pass = pass && result;
+
+  return pass ? 0 : 1;
+}
@@ -1,5 +1,6 @@
 #include "scheduler/gradientdescent.h"
 #include "backend/backends.h"
+#include "backend/sparse_tensor.h"
 
 namespace blitz {
 
@@ -18,9 +19,20 @@ void Gradientdescent<TensorType, DType>::OptimizeImpl(
   shared_ptr<TensorType<DType> > gradient = layer_param->update();
   shared_ptr<TensorType<DType> > velocity = layer_param->state();
 
-  Backend<TensorType, DType>::GradientdescentFunc(
-    momentum_coef_, learning_rate, decay_, batch_size,
-    weight.get(), gradient.get(), velocity.get());
+  // rows untouched by the batch keep their weight and velocity
+  const RowSparseTensor<TensorType, DType>* row_sparse_gradient =
+    dynamic_cast<const RowSparseTensor<TensorType, DType>*>(gradient.get());
+  if (row_sparse_gradient != NULL && !row_sparse_gradient->dense()) {
+    const vector<int>& rows = row_sparse_gradient->rows();
+    Backend<TensorType, DType>::SparseGradientdescentFunc(
+      rows.empty() ? NULL : &rows[0], rows.size(),
+      momentum_coef_, learning_rate, decay_, batch_size,
+      weight.get(), gradient.get(), velocity.get());
+  } else {
+    Backend<TensorType, DType>::GradientdescentFunc(
+      momentum_coef_, learning_rate, decay_, batch_size,
+      weight.get(), gradient.get(), velocity.get());
+  }
 }
 
 INSTANTIATE_CLASS(Gradientdescent);
@@ -12,12 +12,15 @@ namespace blitz {
 template<template <typename> class TensorType, typename DType>
 class Optimizer {
  public:
+  // weights of inference only layers come without update and state
   class LayerParam {
    public:
     LayerParam(shared_ptr<TensorType<DType> > weight,
       shared_ptr<TensorType<DType> > update) : weight_(weight),
       update_(update) {
-      state_ = make_shared<TensorType<DType> >(weight->shape());
+      if (update != 0) {
+        state_ = make_shared<TensorType<DType> >(weight->shape());
+      }
     }
 
     shared_ptr<TensorType<DType> > weight() {
@@ -87,6 +90,9 @@ class Optimizer {
     }
   }
 
+  const map<string, shared_ptr<LayerParam> >& layer_params() const {
+    return layer_params_;
+  }
 
  protected:
   DType ChangeLearningRate(const int epoch) {
@@ -24,6 +24,11 @@ class Scheduler {
     shared_ptr<TensorType<DType> > weight,
     shared_ptr<TensorType<DType> > update);
 
+  const map<string, shared_ptr<Optimizer<TensorType, DType> > >&
+    optimizers() const {
+    return optimizers_;
+  }
+
  private:
   map<string, shared_ptr<Optimizer<TensorType, DType> > > optimizers_;
 };
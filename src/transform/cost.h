@@ -21,6 +21,20 @@ class Cost {
     shared_ptr<TensorType<DType> > result) = 0;
 };
 
+// label_type sparse: one class index per sample instead of a one-hot row,
+// dense targets have the shape of the output
+template<template <typename> class TensorType, typename DType>
+inline void CheckTarget(const TensorType<DType>& output,
+  const TensorType<DType>& target, const bool sparse_target) {
+  if (sparse_target) {
+    CHECK_EQ(target.size(), output.shape()[0]) <<
+      "Sparse labels are one class index per sample";
+  } else {
+    CHECK_EQ(target.size(), output.size()) <<
+      "Dense labels have the shape of the output";
+  }
+}
+
 }  // namespace blitz
 
 #endif  // SRC_TRANSFORM_COST_H_
@@ -7,6 +7,11 @@ template<template <typename> class TensorType, typename DType>
 DType CrossEntropyMulti<TensorType, DType>::Apply(
   const shared_ptr<TensorType<DType> > output,
   const shared_ptr<TensorType<DType> > target) {
+  CheckTarget(*output, *target, sparse_target_);
+  if (sparse_target_) {
+    return Backend<TensorType, DType>::CrossEntropyMultiSparseApplyFunc(
+      output.get(), target.get());
+  }
   return Backend<TensorType, DType>::CrossEntropyMultiApplyFunc(
       output.get(), target.get());
 }
@@ -16,6 +21,12 @@ void CrossEntropyMulti<TensorType, DType>::Derivative(
   const shared_ptr<TensorType<DType> > output,
   const shared_ptr<TensorType<DType> > target,
   shared_ptr<TensorType<DType> > result) {
+  CheckTarget(*output, *target, sparse_target_);
+  if (sparse_target_) {
+    Backend<TensorType, DType>::CrossEntropyMultiSparseDerivativeFunc(
+      output.get(), target.get(), result.get());
+    return;
+  }
   Backend<TensorType, DType>::CrossEntropyMultiDerivativeFunc(
       output.get(), target.get(), result.get());
 }
@@ -8,7 +8,10 @@ namespace blitz {
 template<template <typename> class TensorType, typename DType>
 class CrossEntropyMulti : public Cost<TensorType, DType> {
  public:
-  explicit CrossEntropyMulti(const DType scale = 1.0) : scale_(scale) {}
+  // sparse_target: targets are class indices, label_type sparse
+  explicit CrossEntropyMulti(const DType scale = 1.0,
+    const bool sparse_target = false) :
+    scale_(scale), sparse_target_(sparse_target) {}
   ~CrossEntropyMulti() {}
 
   virtual DType Apply(const shared_ptr<TensorType<DType> > output,
@@ -21,6 +24,7 @@ class CrossEntropyMulti : public Cost<TensorType, DType> {
 
  private:
   const float scale_;
+  const bool sparse_target_;
 };
 
 }  // namespace blitz
@@ -1,9 +1,45 @@
 #include "util/blitz_cpu_function.h"
 
+#include <cstring>
+
+#ifdef BLITZ_AVX
+#include <immintrin.h>
+#endif
+
 #include "util/common.h"
 
 namespace blitz {
 
+namespace {
+
+float HalfToFloat(const uint16_t half) {
+  const uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+  uint32_t exponent = (half >> 10) & 0x1f;
+  uint32_t mantissa = half & 0x3ff;
+  uint32_t bits;
+  if (exponent == 0x1f) {
+    // inf and nan
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  } else if (exponent != 0) {
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  } else if (mantissa == 0) {
+    bits = sign;
+  } else {
+    // subnormal, shift into a normal float
+    exponent = 113;
+    while ((mantissa & 0x400) == 0) {
+      mantissa <<= 1;
+      --exponent;
+    }
+    bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+  }
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+}  // namespace
+
 template<>
 void BlitzCPUGemm<float>(const bool transa, const bool transb,
   const int M, const int N, const int K,
@@ -28,6 +64,28 @@ void BlitzCPUGemm<double>(const bool transa, const bool transb,
       B, ldb, beta, C, N);
 }
 
+template<>
+void BlitzCPUGemm<float>(const bool transa, const bool transb,
+  const int M, const int N, const int K,
+  float* A, const int lda, float* B, const int ldb,
+  float* C, const int ldc, float alpha, float beta) {
+  CBLAS_TRANSPOSE TransA = transa ? CblasTrans : CblasNoTrans;
+  CBLAS_TRANSPOSE TransB = transb ? CblasTrans : CblasNoTrans;
+  cblas_sgemm(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda,
+      B, ldb, beta, C, ldc);
+}
+
+template<>
+void BlitzCPUGemm<double>(const bool transa, const bool transb,
+  const int M, const int N, const int K,
+  double* A, const int lda, double* B, const int ldb,
+  double* C, const int ldc, double alpha, double beta) {
+  CBLAS_TRANSPOSE TransA = transa ? CblasTrans : CblasNoTrans;
+  CBLAS_TRANSPOSE TransB = transb ? CblasTrans : CblasNoTrans;
+  cblas_dgemm(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda,
+      B, ldb, beta, C, ldc);
+}
+
 template<>
 void BlitzCPUCopy<float>(const float* X, const int N, float* Y) {
   cblas_scopy(N, X, 1, Y, 1);
@@ -38,5 +96,114 @@ void BlitzCPUCopy<double>(const double* X, const int N, double* Y) {
   cblas_dcopy(N, X, 1, Y, 1);
 }
 
+template<typename DType>
+void BlitzCPUNormalize(const uint8_t* source, const size_t N,
+  const DType mean, const DType scale, DType* target) {
+  for (size_t i = 0; i < N; ++i) {
+    target[i] = (source[i] - mean) * scale;
+  }
+}
+
+template<typename DType>
+void BlitzCPUNormalizeHalf(const uint16_t* source, const size_t N,
+  const DType mean, const DType scale, DType* target) {
+  for (size_t i = 0; i < N; ++i) {
+    target[i] = (HalfToFloat(source[i]) - mean) * scale;
+  }
+}
+
+template<typename DType>
+void BlitzCPUNormalize(const float* source, const size_t N,
+  const DType mean, const DType scale, DType* target) {
+  for (size_t i = 0; i < N; ++i) {
+    target[i] = (source[i] - mean) * scale;
+  }
+}
+
+#ifdef BLITZ_AVX
+// eight elements per step, unaligned loads and stores
+template<>
+void BlitzCPUNormalize<float>(const uint8_t* source, const size_t N,
+  const float mean, const float scale, float* target) {
+  const __m256 mean_v = _mm256_set1_ps(mean);
+  const __m256 scale_v = _mm256_set1_ps(scale);
+  size_t i = 0;
+  for (; i + 8 <= N; i += 8) {
+    __m128i bytes = _mm_loadl_epi64(
+      reinterpret_cast<const __m128i*>(source + i));
+    __m256i ints = _mm256_insertf128_si256(_mm256_castsi128_si256(
+      _mm_cvtepu8_epi32(bytes)), _mm_cvtepu8_epi32(_mm_srli_si128(bytes, 4)),
+      1);
+    __m256 value = _mm256_cvtepi32_ps(ints);
+    _mm256_storeu_ps(target + i,
+      _mm256_mul_ps(_mm256_sub_ps(value, mean_v), scale_v));
+  }
+  for (; i < N; ++i) {
+    target[i] = (source[i] - mean) * scale;
+  }
+}
+
+#ifdef __F16C__
+template<>
+void BlitzCPUNormalizeHalf<float>(const uint16_t* source, const size_t N,
+  const float mean, const float scale, float* target) {
+  const __m256 mean_v = _mm256_set1_ps(mean);
+  const __m256 scale_v = _mm256_set1_ps(scale);
+  size_t i = 0;
+  for (; i + 8 <= N; i += 8) {
+    __m256 value = _mm256_cvtph_ps(_mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(source + i)));
+    _mm256_storeu_ps(target + i,
+      _mm256_mul_ps(_mm256_sub_ps(value, mean_v), scale_v));
+  }
+  for (; i < N; ++i) {
+    target[i] = (HalfToFloat(source[i]) - mean) * scale;
+  }
+}
+#endif  // __F16C__
+
+template<>
+void BlitzCPUNormalize<float>(const float* source, const size_t N,
+  const float mean, const float scale, float* target) {
+  const __m256 mean_v = _mm256_set1_ps(mean);
+  const __m256 scale_v = _mm256_set1_ps(scale);
+  size_t i = 0;
+  for (; i + 8 <= N; i += 8) {
+    __m256 value = _mm256_loadu_ps(source + i);
+    _mm256_storeu_ps(target + i,
+      _mm256_mul_ps(_mm256_sub_ps(value, mean_v), scale_v));
+  }
+  for (; i < N; ++i) {
+    target[i] = (source[i] - mean) * scale;
+  }
+}
+#endif  // BLITZ_AVX
+
+template void BlitzCPUNormalize<double>(const uint8_t* source,
+  const size_t N, const double mean, const double scale, double* target);
+template void BlitzCPUNormalizeHalf<double>(const uint16_t* source,
+  const size_t N, const double mean, const double scale, double* target);
+template void BlitzCPUNormalize<double>(const float* source,
+  const size_t N, const double mean, const double scale, double* target);
+#ifndef BLITZ_AVX
+template void BlitzCPUNormalize<float>(const uint8_t* source,
+  const size_t N, const float mean, const float scale, float* target);
+template void BlitzCPUNormalize<float>(const float* source,
+  const size_t N, const float mean, const float scale, float* target);
+#endif  // BLITZ_AVX
+#if !defined(BLITZ_AVX) || !defined(__F16C__)
+template void BlitzCPUNormalizeHalf<float>(const uint16_t* source,
+  const size_t N, const float mean, const float scale, float* target);
+#endif
+
+int BlitzCPUBlasThreads(const int num_threads) {
+#ifdef USE_MKL
+  return mkl_set_num_threads_local(num_threads);
+#else
+  // ATLAS fixes its threads at build time
+  return 0;
+#endif
+}
+
 }  // namespace blitz
 
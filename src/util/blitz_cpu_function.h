@@ -17,7 +17,10 @@
 
 #endif
 
+#include <stdint.h>
+
 #include <cmath>
+#include <cstddef>
 
 namespace blitz {
 
@@ -26,9 +29,33 @@ void BlitzCPUGemm(const bool transa, const bool transb,
   const int M, const int N, const int K,
   DType* A, DType* B, DType* C, DType alpha, DType beta);
 
+// explicit leading dimensions, for tiles of larger row major matrices
+template<typename DType>
+void BlitzCPUGemm(const bool transa, const bool transb,
+  const int M, const int N, const int K,
+  DType* A, const int lda, DType* B, const int ldb,
+  DType* C, const int ldc, DType alpha, DType beta);
+
 template<typename DType>
 void BlitzCPUCopy(const DType* X, const int N, DType* Y);
 
+// target[i] = (source[i] - mean) * scale, for compact source data
+template<typename DType>
+void BlitzCPUNormalize(const uint8_t* source, const size_t N,
+  const DType mean, const DType scale, DType* target);
+
+// source holds IEEE half precision bits
+template<typename DType>
+void BlitzCPUNormalizeHalf(const uint16_t* source, const size_t N,
+  const DType mean, const DType scale, DType* target);
+
+template<typename DType>
+void BlitzCPUNormalize(const float* source, const size_t N,
+  const DType mean, const DType scale, DType* target);
+
+// BLAS threads of the calling thread, returns the previous setting
+int BlitzCPUBlasThreads(const int num_threads);
+
 template <typename DType>
 inline DType BlitzCPUSafeLog(DType input) {
   return log(input > exp(-50.0) ? input : exp(-50.0));
@@ -0,0 +1,76 @@
+#ifndef SRC_UTIL_BLITZ_LOGGING_H_
+#define SRC_UTIL_BLITZ_LOGGING_H_
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+namespace blitz {
+
+// Stands in for glog in libblitz_infer: the LOG and CHECK macros the
+// layers and kernels use, warnings and errors go to stderr and fatal
+// messages abort. INFO messages are dropped.
+enum LogSeverity {
+  kLogINFO = 0,
+  kLogWARNING = 1,
+  kLogERROR = 2,
+  kLogFATAL = 3
+};
+
+class LogMessage {
+ public:
+  LogMessage(const char* file, const int line, const LogSeverity severity) :
+    severity_(severity) {
+    static const char* const kNames[] = {"I", "W", "E", "F"};
+    if (severity_ >= kLogWARNING) {
+      stream_ << kNames[severity_] << " " << file << ":" << line << "] ";
+    }
+  }
+
+  ~LogMessage() {
+    if (severity_ >= kLogWARNING) {
+      stream_ << "\n";
+      std::cerr << stream_.str();
+    }
+    if (severity_ == kLogFATAL) {
+      abort();
+    }
+  }
+
+  std::ostream& stream() {
+    return stream_;
+  }
+
+ private:
+  const LogSeverity severity_;
+  std::ostringstream stream_;
+
+  // disable copy
+  LogMessage(const LogMessage&);
+  LogMessage& operator=(const LogMessage&);
+};
+
+// turns the stream of a failed check into a void expression
+class LogVoidify {
+ public:
+  void operator&(std::ostream&) {}
+};
+
+}  // namespace blitz
+
+#define LOG(severity) \
+  ::blitz::LogMessage(__FILE__, __LINE__, ::blitz::kLog##severity).stream()
+
+#define CHECK(condition) \
+  (condition) ? (void) 0 : ::blitz::LogVoidify() & \
+  LOG(FATAL) << "Check failed: " #condition " "
+
+#define CHECK_OP(a, b, op) CHECK((a) op (b))
+#define CHECK_EQ(a, b) CHECK_OP(a, b, ==)
+#define CHECK_NE(a, b) CHECK_OP(a, b, !=)
+#define CHECK_LT(a, b) CHECK_OP(a, b, <)
+#define CHECK_LE(a, b) CHECK_OP(a, b, <=)
+#define CHECK_GT(a, b) CHECK_OP(a, b, >)
+#define CHECK_GE(a, b) CHECK_OP(a, b, >=)
+
+#endif  // SRC_UTIL_BLITZ_LOGGING_H_
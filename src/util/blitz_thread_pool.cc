@@ -0,0 +1,364 @@
+#include "util/blitz_thread_pool.h"
+
+#include <sched.h>
+#include <unistd.h>
+
+#include "util/blitz_cpu_function.h"
+#include "util/common.h"
+
+namespace blitz {
+
+namespace {
+
+// participant id of the calling thread, -1 outside the pool
+__thread int blitz_thread_id = -1;
+
+// rounds a worker spins before it sleeps
+const int kSpinRounds = 256;
+
+struct WorkerArg {
+  ThreadPool* pool;
+  int tid;
+};
+
+pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+// size asked for by the first Init, guarded by init_mutex
+pthread_mutex_t init_mutex = PTHREAD_MUTEX_INITIALIZER;
+bool init_called = false;
+int init_threads = 1;
+
+}  // namespace
+
+ThreadPool* ThreadPool::instance_ = NULL;
+
+ThreadPool& ThreadPool::GetInstance() {
+  if (instance_ == NULL) {
+    pthread_once(&pool_once, &ThreadPool::Create);
+  }
+  return *instance_;
+}
+
+void ThreadPool::Create() {
+  pthread_mutex_lock(&init_mutex);
+  const int num_threads = init_threads;
+  pthread_mutex_unlock(&init_mutex);
+  instance_ = new ThreadPool(num_threads);
+}
+
+void ThreadPool::Init(int num_threads) {
+  CHECK_GT(num_threads, 0);
+  pthread_mutex_lock(&init_mutex);
+  const bool first = !init_called;
+  if (first) {
+    init_called = true;
+    init_threads = num_threads;
+  }
+  pthread_mutex_unlock(&init_mutex);
+  pthread_once(&pool_once, &ThreadPool::Create);
+
+  // a kernel may have made the default pool before the first Init
+  if (instance_->num_threads_ != num_threads) {
+    LOG(WARNING) << "Thread pool already has " << instance_->num_threads_ <<
+      " threads, " << num_threads << " ignored";
+  } else if (first) {
+    blitz_thread_id = 0;
+  }
+}
+
+int ThreadPool::DefaultNumThreads() {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
+    int count = CPU_COUNT(&cpu_set);
+    if (count > 0) {
+      return count;
+    }
+  }
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? static_cast<int>(count) : 1;
+}
+
+ThreadPool::ThreadPool(int num_threads) :
+  num_threads_(num_threads), stop_(false), queued_(0), sleeping_(0),
+  queues_(num_threads) {
+  pthread_mutex_init(&sleep_mutex_, NULL);
+  pthread_cond_init(&sleep_cond_, NULL);
+  for (int i = 0; i < num_threads_; ++i) {
+    queues_[i] = new Queue();
+    queues_[i]->size = 0;
+    pthread_mutex_init(&(queues_[i]->mutex), NULL);
+  }
+  Start();
+}
+
+ThreadPool::~ThreadPool() {
+  Stop();
+  for (int i = 0; i < num_threads_; ++i) {
+    pthread_mutex_destroy(&(queues_[i]->mutex));
+    delete queues_[i];
+  }
+  pthread_cond_destroy(&sleep_cond_);
+  pthread_mutex_destroy(&sleep_mutex_);
+}
+
+void ThreadPool::Start() {
+  workers_.resize(num_threads_ - 1);
+  for (int i = 1; i < num_threads_; ++i) {
+    WorkerArg* arg = new WorkerArg();
+    arg->pool = this;
+    arg->tid = i;
+    if (pthread_create(&workers_[i - 1], NULL, WorkerEntry, arg) != 0) {
+      LOG(FATAL) << "Create worker thread error: " << i;
+    }
+  }
+}
+
+void ThreadPool::Stop() {
+  pthread_mutex_lock(&sleep_mutex_);
+  stop_ = true;
+  pthread_cond_broadcast(&sleep_cond_);
+  pthread_mutex_unlock(&sleep_mutex_);
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    pthread_join(workers_[i], NULL);
+  }
+  workers_.clear();
+}
+
+void* ThreadPool::WorkerEntry(void* arg) {
+  WorkerArg* worker_arg = static_cast<WorkerArg*>(arg);
+  ThreadPool* pool = worker_arg->pool;
+  int tid = worker_arg->tid;
+  delete worker_arg;
+  blitz_thread_id = tid;
+  // parallelism comes from the pool, BLAS calls on workers stay serial
+  BlitzCPUBlasThreads(1);
+  pool->WorkerLoop(tid);
+  return NULL;
+}
+
+void ThreadPool::WorkerLoop(int tid) {
+  int idle = 0;
+  while (!stop_) {
+    if (RunOne(tid)) {
+      idle = 0;
+    } else if (++idle < kSpinRounds) {
+      sched_yield();
+    } else {
+      pthread_mutex_lock(&sleep_mutex_);
+      ++sleeping_;
+      // pairs with the barrier in WakeSleepers, either the pusher sees
+      // this worker asleep or this worker sees the push
+      __sync_synchronize();
+      while (queued_ == 0 && !stop_) {
+        pthread_cond_wait(&sleep_cond_, &sleep_mutex_);
+      }
+      --sleeping_;
+      pthread_mutex_unlock(&sleep_mutex_);
+      idle = 0;
+    }
+  }
+}
+
+int ThreadPool::CurrentThread() const {
+  return blitz_thread_id < num_threads_ ? blitz_thread_id : -1;
+}
+
+void ThreadPool::Push(int tid, const Chunk& chunk) {
+  Queue* queue = queues_[tid];
+  pthread_mutex_lock(&(queue->mutex));
+  queue->chunks.push_back(chunk);
+  __sync_fetch_and_add(&(queue->size), 1);
+  pthread_mutex_unlock(&(queue->mutex));
+  __sync_fetch_and_add(&queued_, 1);
+}
+
+bool ThreadPool::Pop(int tid, Chunk* chunk) {
+  Queue* queue = queues_[tid];
+  bool found = false;
+  pthread_mutex_lock(&(queue->mutex));
+  if (!queue->chunks.empty()) {
+    *chunk = queue->chunks.back();
+    queue->chunks.pop_back();
+    __sync_fetch_and_sub(&(queue->size), 1);
+    found = true;
+  }
+  pthread_mutex_unlock(&(queue->mutex));
+  return found;
+}
+
+bool ThreadPool::Steal(int tid, Chunk* chunk) {
+  for (int i = 1; i < num_threads_; ++i) {
+    Queue* queue = queues_[(tid + i) % num_threads_];
+    if (queue->size == 0) {
+      continue;
+    }
+    bool found = false;
+    pthread_mutex_lock(&(queue->mutex));
+    if (!queue->chunks.empty()) {
+      *chunk = queue->chunks.front();
+      queue->chunks.pop_front();
+      __sync_fetch_and_sub(&(queue->size), 1);
+      found = true;
+    }
+    pthread_mutex_unlock(&(queue->mutex));
+    if (found) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ThreadPool::RunOne(int tid) {
+  if (queued_ == 0) {
+    return false;
+  }
+  Chunk chunk;
+  if (Pop(tid, &chunk) || Steal(tid, &chunk)) {
+    __sync_fetch_and_sub(&queued_, 1);
+    Execute(chunk, tid);
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::Execute(const Chunk& chunk, int tid) {
+  chunk.job->Run(chunk.begin, chunk.end, tid);
+  // the job may be released once pending_ drops to zero
+  __sync_fetch_and_sub(&(chunk.job->pending_), 1);
+}
+
+void ThreadPool::WakeSleepers() {
+  // the push must be visible before sleeping_ is read
+  __sync_synchronize();
+  if (sleeping_ > 0) {
+    pthread_mutex_lock(&sleep_mutex_);
+    pthread_cond_broadcast(&sleep_cond_);
+    pthread_mutex_unlock(&sleep_mutex_);
+  }
+}
+
+void ThreadPool::Submit(Job* job, size_t begin, size_t end) {
+  __sync_fetch_and_add(&(job->pending_), 1);
+  Chunk chunk;
+  chunk.job = job;
+  chunk.begin = begin;
+  chunk.end = end;
+  int tid = CurrentThread();
+  Push(tid < 0 ? 0 : tid, chunk);
+  WakeSleepers();
+}
+
+void ThreadPool::Wait(Job* job) {
+  int tid = CurrentThread();
+  if (tid < 0) {
+    // outsiders can not help, chunks are finished by the participants
+    while (job->pending_ > 0) {
+      sched_yield();
+    }
+    return;
+  }
+  while (job->pending_ > 0) {
+    if (!RunOne(tid)) {
+      sched_yield();
+    }
+  }
+}
+
+void ThreadPool::Run(Job* job, size_t begin, size_t end, size_t grain) {
+  const size_t range = end - begin;
+  const size_t target = num_threads_ * 4;
+  size_t chunk_size = (range + target - 1) / target;
+  if (chunk_size < grain) {
+    chunk_size = grain;
+  }
+  const size_t num_chunks = (range + chunk_size - 1) / chunk_size;
+  int tid = CurrentThread();
+  if (tid < 0) {
+    tid = 0;
+  }
+  __sync_fetch_and_add(&(job->pending_), static_cast<int>(num_chunks));
+  // deal chunks round-robin so that every participant starts locally
+  for (size_t i = 0; i < num_chunks; ++i) {
+    Chunk chunk;
+    chunk.job = job;
+    chunk.begin = begin + i * chunk_size;
+    chunk.end = chunk.begin + chunk_size < end ? chunk.begin + chunk_size : end;
+    Push((tid + i) % num_threads_, chunk);
+  }
+  WakeSleepers();
+  // BLAS calls inside the chunks of this thread must not fork again
+  int blas_threads = BlitzCPUBlasThreads(1);
+  Wait(job);
+  BlitzCPUBlasThreads(blas_threads);
+}
+
+size_t TaskGraph::AddTask(Task* task) {
+  Node node;
+  node.task = task;
+  node.num_predecessors = 0;
+  node.remaining = 0;
+  nodes_.push_back(node);
+  return nodes_.size() - 1;
+}
+
+void TaskGraph::AddDependency(size_t before, size_t after) {
+  CHECK_LT(before, nodes_.size());
+  CHECK_LT(after, nodes_.size());
+  nodes_[before].successors.push_back(after);
+  ++(nodes_[after].num_predecessors);
+}
+
+void TaskGraph::GraphJob::Run(size_t begin, size_t end, int tid) {
+  ThreadPool& pool = ThreadPool::GetInstance();
+  for (size_t i = begin; i < end; ++i) {
+    Node& node = graph_->nodes_[i];
+    node.task->Run(tid);
+    for (size_t j = 0; j < node.successors.size(); ++j) {
+      size_t next = node.successors[j];
+      if (__sync_sub_and_fetch(&(graph_->nodes_[next].remaining), 1) == 0) {
+        pool.Submit(this, next, next + 1);
+      }
+    }
+  }
+}
+
+void TaskGraph::Run() {
+  ThreadPool& pool = ThreadPool::GetInstance();
+  vector<size_t> ready;
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    nodes_[i].remaining = nodes_[i].num_predecessors;
+    if (nodes_[i].num_predecessors == 0) {
+      ready.push_back(i);
+    }
+  }
+  if (pool.num_threads() == 1) {
+    // topological order on the calling thread
+    int tid = pool.CurrentThread();
+    tid = tid < 0 ? 0 : tid;
+    size_t executed = 0;
+    while (!ready.empty()) {
+      size_t index = ready.back();
+      ready.pop_back();
+      nodes_[index].task->Run(tid);
+      ++executed;
+      for (size_t j = 0; j < nodes_[index].successors.size(); ++j) {
+        size_t next = nodes_[index].successors[j];
+        if (--(nodes_[next].remaining) == 0) {
+          ready.push_back(next);
+        }
+      }
+    }
+    CHECK_EQ(executed, nodes_.size()) << "Task graph has a cycle";
+    return;
+  }
+  GraphJob job(this);
+  for (size_t i = 0; i < ready.size(); ++i) {
+    pool.Submit(&job, ready[i], ready[i] + 1);
+  }
+  int blas_threads = BlitzCPUBlasThreads(1);
+  pool.Wait(&job);
+  BlitzCPUBlasThreads(blas_threads);
+}
+
+}  // namespace blitz
@@ -0,0 +1,232 @@
+#ifndef SRC_UTIL_BLITZ_THREAD_POOL_H_
+#define SRC_UTIL_BLITZ_THREAD_POOL_H_
+
+#include <pthread.h>
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+namespace blitz {
+
+// Persistent work-stealing pool shared by all CPU kernels, created once
+// per process. The thread of the first Init is participant 0, the
+// workers are 1..n-1.
+// Each participant owns a deque: it pops its own work from the back,
+// idle participants steal from the front of the others.
+// Threads outside the pool hand their parallel sections to the
+// participants and wait, they run no chunks themselves so that the ids
+// of the threads running a job stay distinct.
+class ThreadPool {
+ public:
+  // a job is split into [begin, end) chunks, pending_ counts unfinished ones
+  class Job {
+   public:
+    Job() : pending_(0) {}
+    virtual ~Job() {}
+    virtual void Run(size_t begin, size_t end, int tid) = 0;
+
+   private:
+    volatile int pending_;
+
+    friend class ThreadPool;
+  };
+
+  static ThreadPool& GetInstance();
+
+  // before any kernel; the first call sizes the pool, later ones keep it
+  // and leave their thread outside the pool
+  static void Init(int num_threads);
+
+  // cores this process may run on, follows taskset and cpusets
+  static int DefaultNumThreads();
+
+  // scheduled chunks of a job, the caller helps until the job is done
+  void Submit(Job* job, size_t begin, size_t end);
+  void Wait(Job* job);
+
+  // split [begin, end) into chunks no smaller than grain
+  void Run(Job* job, size_t begin, size_t end, size_t grain);
+
+  // -1 for threads outside the pool
+  int CurrentThread() const;
+
+  bool InPool() const {
+    return CurrentThread() >= 0;
+  }
+
+  int num_threads() const {
+    return num_threads_;
+  }
+
+  ~ThreadPool();
+
+ private:
+  struct Chunk {
+    Job* job;
+    size_t begin;
+    size_t end;
+  };
+
+  // chunks is only touched under mutex, size mirrors it for thieves
+  // that check for work without taking the lock
+  struct Queue {
+    pthread_mutex_t mutex;
+    std::deque<Chunk> chunks;
+    volatile int size;
+  };
+
+  explicit ThreadPool(int num_threads);
+
+  // instance_ of the size of the first Init, 1 without one
+  static void Create();
+
+  void Start();
+  void Stop();
+  void Push(int tid, const Chunk& chunk);
+  bool Pop(int tid, Chunk* chunk);
+  bool Steal(int tid, Chunk* chunk);
+  bool RunOne(int tid);
+  void Execute(const Chunk& chunk, int tid);
+  // after a push, wakes workers that went to sleep
+  void WakeSleepers();
+  void WorkerLoop(int tid);
+
+  static void* WorkerEntry(void* arg);
+
+  int num_threads_;
+  volatile bool stop_;
+  volatile int queued_;
+  volatile int sleeping_;
+
+  pthread_mutex_t sleep_mutex_;
+  pthread_cond_t sleep_cond_;
+
+  std::vector<Queue*> queues_;
+  std::vector<pthread_t> workers_;
+
+  static ThreadPool* instance_;
+
+  // disable copy
+  ThreadPool(const ThreadPool&);
+  ThreadPool& operator=(const ThreadPool&);
+};
+
+// Adapts a range functor with operator()(begin, end, tid)
+template<typename Functor>
+class ParallelForJob : public ThreadPool::Job {
+ public:
+  explicit ParallelForJob(Functor& functor) : functor_(functor) {}
+
+  virtual void Run(size_t begin, size_t end, int tid) {
+    functor_(begin, end, tid);
+  }
+
+ private:
+  Functor& functor_;
+};
+
+// Run functor over [begin, end) on the pool.
+// Ranges of at most grain items run inline on the calling thread,
+// larger ones are cut into about four chunks per thread.
+template<typename Functor>
+void BlitzParallelFor(size_t begin, size_t end, Functor& functor,
+  size_t grain = 1) {
+  if (begin >= end) {
+    return;
+  }
+  ThreadPool& pool = ThreadPool::GetInstance();
+  if (end - begin <= grain || pool.num_threads() == 1) {
+    int tid = pool.CurrentThread();
+    functor(begin, end, tid < 0 ? 0 : tid);
+    return;
+  }
+  ParallelForJob<Functor> job(functor);
+  pool.Run(&job, begin, end, grain);
+}
+
+// Sum of functor(begin, end) partial results, one slot per thread
+template<typename DType, typename Functor>
+class ParallelSumFunctor {
+ public:
+  ParallelSumFunctor(Functor& functor, int num_threads) :
+    functor_(functor), partial_(num_threads, DType(0)) {}
+
+  void operator()(size_t begin, size_t end, int tid) {
+    partial_[tid] += functor_(begin, end);
+  }
+
+  DType sum() const {
+    DType sum = 0;
+    for (size_t i = 0; i < partial_.size(); ++i) {
+      sum += partial_[i];
+    }
+    return sum;
+  }
+
+ private:
+  Functor& functor_;
+  std::vector<DType> partial_;
+};
+
+template<typename DType, typename Functor>
+DType BlitzParallelSum(size_t begin, size_t end, Functor& functor,
+  size_t grain = 1) {
+  ParallelSumFunctor<DType, Functor> sum_functor(functor,
+    ThreadPool::GetInstance().num_threads());
+  BlitzParallelFor(begin, end, sum_functor, grain);
+  return sum_functor.sum();
+}
+
+// Static DAG of tasks run on the pool, a task starts once all of its
+// predecessors have finished. Tasks are not owned by the graph.
+class TaskGraph {
+ public:
+  class Task {
+   public:
+    virtual ~Task() {}
+    virtual void Run(int tid) = 0;
+  };
+
+  TaskGraph() {}
+
+  size_t AddTask(Task* task);
+
+  // after does not start until before is done
+  void AddDependency(size_t before, size_t after);
+
+  // blocks until every task has run, the graph can be run again
+  void Run();
+
+  size_t size() const {
+    return nodes_.size();
+  }
+
+ private:
+  struct Node {
+    Task* task;
+    std::vector<size_t> successors;
+    int num_predecessors;
+    volatile int remaining;
+  };
+
+  class GraphJob : public ThreadPool::Job {
+   public:
+    explicit GraphJob(TaskGraph* graph) : graph_(graph) {}
+
+    virtual void Run(size_t begin, size_t end, int tid);
+
+   private:
+    TaskGraph* graph_;
+  };
+
+  std::vector<Node> nodes_;
+
+  // disable copy
+  TaskGraph(const TaskGraph&);
+  TaskGraph& operator=(const TaskGraph&);
+};
+
+}  // namespace blitz
+
+#endif  // SRC_UTIL_BLITZ_THREAD_POOL_H_
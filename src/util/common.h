@@ -1,8 +1,12 @@
 #ifndef SRC_UTIL_COMMON_H_
 #define SRC_UTIL_COMMON_H_
 
-// logging
+// logging, libblitz_infer does without glog
+#ifdef BLITZ_INFER
+#include "util/blitz_logging.h"
+#else
 #include <glog/logging.h>
+#endif  // BLITZ_INFER
 
 #include <iostream>
 